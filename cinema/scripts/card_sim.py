@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Card payment terminal simulator (see src/card.h for the protocol).
+
+native_posix prints the pseudotty of uart1 at boot
+("UART_1 connected to pseudotty: /dev/pts/N"); attach to it:
+
+    west build -b native_posix -- -DOVERLAY_CONFIG=card.conf
+    scripts/card_sim.py /dev/pts/N --latency 800 --jitter 400 --decline 10
+
+--drop makes the terminal ignore a share of the requests, to exercise
+the timeout and the reversal of late approvals (--late). With --pty the
+simulator opens its own pseudotty instead, e.g. for a board behind socat.
+A summary with the latency and throughput of the answered requests is
+printed every --report seconds and on Ctrl-C.
+
+Only uses the standard library.
+"""
+
+import argparse
+import heapq
+import os
+import pty
+import random
+import select
+import sys
+import time
+import tty
+
+
+class Terminal:
+    """Answers requests after a random latency, several can be in flight."""
+
+    def __init__(self, fd, args):
+        self.fd = fd
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.rx = b""
+        self.timers = []        # (due, seq, line, late)
+        self.seq = 0
+        self.pending = {}       # id -> (received, amount)
+        self.latencies = []
+        self.counts = {"A": 0, "OK": 0, "NO": 0, "CX": 0, "R": 0, "dropped": 0, "late": 0}
+        self.started = time.monotonic()
+
+    def later(self, delay, line, late=False):
+        self.seq += 1
+        heapq.heappush(self.timers, (time.monotonic() + delay, self.seq, line, late))
+
+    def send(self, line):
+        os.write(self.fd, (line + "\n").encode())
+
+    def answer(self, line, late):
+        verb, rid = line.split()[:2]
+        rid = int(rid)
+        if late:
+            self.counts["late"] += 1
+        elif rid in self.pending:
+            received, _ = self.pending.pop(rid)
+            self.latencies.append(time.monotonic() - received)
+            self.counts[verb] += 1
+        else:
+            return              # Cancelled meanwhile
+        self.send(line)
+
+    def request(self, line):
+        fields = line.split()
+        if not fields:
+            return
+        if fields[0] == "A" and len(fields) == 3:
+            rid, amount = int(fields[1]), int(fields[2])
+            self.counts["A"] += 1
+            self.pending[rid] = (time.monotonic(), amount)
+            delay = max(0, self.args.latency + self.rng.uniform(-self.args.jitter, self.args.jitter)) / 1000
+            if self.rng.uniform(0, 100) < self.args.drop:
+                self.counts["dropped"] += 1
+                del self.pending[rid]
+                if self.args.late:
+                    self.later(self.args.late, "OK %d %06d" % (rid, self.rng.randrange(1000000)), True)
+            elif self.rng.uniform(0, 100) < self.args.decline:
+                self.later(delay, "NO %d" % rid)
+            else:
+                self.later(delay, "OK %d %06d" % (rid, self.rng.randrange(1000000)))
+        elif fields[0] == "C" and len(fields) == 2:
+            rid = int(fields[1])
+            if rid in self.pending:
+                received, _ = self.pending.pop(rid)
+                self.latencies.append(time.monotonic() - received)
+                self.counts["CX"] += 1
+                self.send("CX %d" % rid)
+        elif fields[0] == "R" and len(fields) == 2:
+            self.counts["R"] += 1
+        print("<", line, flush=True)
+
+    def report(self):
+        elapsed = time.monotonic() - self.started
+        lat = sorted(self.latencies)
+        print("--- %d requests, %d approved, %d declined, %d cancelled, %d dropped (%d approved late, %d reversed)"
+              % (self.counts["A"], self.counts["OK"], self.counts["NO"], self.counts["CX"],
+                 self.counts["dropped"], self.counts["late"], self.counts["R"]))
+        if lat:
+            print("--- latency ms: mean %.0f, p50 %.0f, max %.0f; %.2f answers/s"
+                  % (1000 * sum(lat) / len(lat), 1000 * lat[len(lat) // 2], 1000 * lat[-1],
+                     len(lat) / elapsed), flush=True)
+
+    def run(self):
+        next_report = time.monotonic() + self.args.report
+        while True:
+            now = time.monotonic()
+            while self.timers and self.timers[0][0] <= now:
+                _, _, line, late = heapq.heappop(self.timers)
+                self.answer(line, late)
+            if now >= next_report:
+                self.report()
+                next_report = now + self.args.report
+            timeout = next_report - now
+            if self.timers:
+                timeout = min(timeout, self.timers[0][0] - now)
+            ready, _, _ = select.select([self.fd], [], [], max(timeout, 0))
+            if ready:
+                data = os.read(self.fd, 256)
+                if not data:
+                    return
+                self.rx += data
+                while b"\n" in self.rx:
+                    line, self.rx = self.rx.split(b"\n", 1)
+                    self.request(line.decode(errors="replace").strip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("tty", nargs="?", help="pseudotty or serial port of the machine")
+    parser.add_argument("--pty", action="store_true", help="open a new pseudotty")
+    parser.add_argument("--latency", type=float, default=1000, help="mean answer time, ms")
+    parser.add_argument("--jitter", type=float, default=300, help="uniform jitter around the latency, ms")
+    parser.add_argument("--decline", type=float, default=0, help="share of declined requests, percent")
+    parser.add_argument("--drop", type=float, default=0, help="share of requests never answered, percent")
+    parser.add_argument("--late", type=float, default=0, help="approve dropped requests after this many seconds")
+    parser.add_argument("--report", type=float, default=30, help="seconds between summaries")
+    parser.add_argument("--seed", type=int, help="random seed, for repeatable runs")
+    args = parser.parse_args()
+
+    if args.pty:
+        fd, slave = pty.openpty()
+        tty.setraw(slave)
+        print("Terminal on", os.ttyname(slave), flush=True)
+    elif args.tty:
+        fd = os.open(args.tty, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(fd)
+    else:
+        parser.error("give a tty or --pty")
+
+    terminal = Terminal(fd, args)
+    try:
+        terminal.run()
+    except KeyboardInterrupt:
+        pass
+    terminal.report()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
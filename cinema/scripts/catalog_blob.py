@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Generate the binary catalog blob (see src/catalog_blob.h).
+
+The input uses the same commands as the runtime update over uart1:
+
+    BEGIN <versao>
+    MOVIE <nome>
+    SESSION <horas> <custo>
+    RULE <types> <days> <from_h> <to_h> <kind> <value>
+    COMMIT
+
+Prices are compiled here, with the same rules as src/pricing.c, so the
+firmware only reads them. Without RULE lines the built-in rules are used.
+
+    scripts/catalog_blob.py catalog.txt catalog.bin
+    scripts/catalog_blob.py catalog.txt catalog.hex --hex 0xfc000
+
+On native_posix the blob goes into the flash simulator image at the
+offset of the storage partition:
+
+    dd if=catalog.bin of=flash.bin bs=1 seek=$((0xfc000)) conv=notrunc
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+BLOB_MAGIC = 0x42544143
+BLOB_FORMAT = 1
+N_TICKET_TYPES = 4
+HEADER = struct.Struct("<IHHIIIIIIIII")
+MOVIE = struct.Struct("<IHH")
+SESSION = struct.Struct("<ii")
+ALIGN = 4
+MAX_PRICE = 0xff        # Sales, tickets and their signature keep the price in one byte
+
+RULE_PERCENT_OFF, RULE_AMOUNT_OFF, RULE_FIXED = 0, 1, 2
+ALL_TYPES, ALL_DAYS, WEEKDAY_UNKNOWN = 0xff, 0, -1
+
+# Mirror of default_rules[] in src/pricing.c
+DEFAULT_RULES = [
+    (ALL_TYPES, 1 << 2, 0, 23, RULE_FIXED, 6),
+    (ALL_TYPES, ALL_DAYS, 0, 17, RULE_AMOUNT_OFF, 2),
+    (1 << 1, ALL_DAYS, 0, 23, RULE_PERCENT_OFF, 20),
+    (1 << 2, ALL_DAYS, 0, 23, RULE_PERCENT_OFF, 30),
+    (1 << 3, ALL_DAYS, 0, 23, RULE_AMOUNT_OFF, 1),
+]
+
+
+def rule_price(rules, horas, ticket, custo, weekday=WEEKDAY_UNKNOWN):
+    """Same evaluation as pricing_compile()."""
+    price = custo
+    for types, days, from_h, to_h, kind, value in rules:
+        if not types & (1 << ticket) or not from_h <= horas <= to_h:
+            continue
+        if days != ALL_DAYS and (weekday == WEEKDAY_UNKNOWN or not days & (1 << weekday)):
+            continue
+        if kind == RULE_PERCENT_OFF:
+            price -= (price * value + 99) // 100
+        elif kind == RULE_AMOUNT_OFF:
+            price -= value
+        elif kind == RULE_FIXED:
+            price = value
+        price = max(price, 0)
+    return price
+
+
+def parse(lines):
+    versao, movies, rules = 0, [], []
+    for n, line in enumerate(lines, 1):
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+        cmd, _, arg = line.partition(" ")
+        if cmd == "BEGIN":
+            versao = int(arg or "0", 0)
+        elif cmd == "MOVIE":
+            movies.append((arg, []))
+        elif cmd == "SESSION":
+            if not movies:
+                sys.exit(f"line {n}: SESSION before MOVIE")
+            horas, custo = (int(v, 0) for v in arg.split())
+            movies[-1][1].append((horas, custo))
+        elif cmd == "RULE":
+            rules.append(tuple(int(v, 0) for v in arg.split()))
+        elif cmd in ("COMMIT", "ABORT"):
+            break
+        else:
+            sys.exit(f"line {n}: unknown command {cmd}")
+    return versao, movies, rules or DEFAULT_RULES
+
+
+def align(buf):
+    buf += b"\0" * (-len(buf) % ALIGN)
+
+
+def build(versao, movies, rules):
+    movie_recs, session_recs, prices, strings = bytearray(), bytearray(), bytearray(), bytearray()
+    n_sessions = 0
+    for nome, sessoes in movies:
+        movie_recs += MOVIE.pack(len(strings), n_sessions, len(sessoes))
+        strings += nome.encode() + b"\0"
+        for horas, custo in sessoes:
+            if not 0 <= custo <= MAX_PRICE:
+                sys.exit(f"{nome}: price {custo} outside 0-{MAX_PRICE}")
+            session_recs += SESSION.pack(horas, custo)
+            prices += struct.pack(f"<{N_TICKET_TYPES}h",
+                                  *(rule_price(rules, horas, t, custo) for t in range(N_TICKET_TYPES)))
+            n_sessions += 1
+
+    body = bytearray()
+    offsets = []
+    for section in (movie_recs, session_recs, prices, strings):
+        align(body)
+        offsets.append(HEADER.size + len(body))
+        body += section
+    size = HEADER.size + len(body)
+    crc = binascii.crc32(body) & 0xffffffff
+    header = HEADER.pack(BLOB_MAGIC, BLOB_FORMAT, N_TICKET_TYPES, versao, len(movies), n_sessions,
+                         *offsets, size, crc)
+    return header + body
+
+
+def intel_hex(data, base):
+    out = []
+
+    def record(rtype, addr, payload):
+        rec = bytes([len(payload), addr >> 8, addr & 0xff, rtype]) + payload
+        out.append(":" + (rec + bytes([-sum(rec) & 0xff])).hex().upper())
+
+    for off in range(0, len(data), 16):
+        addr = base + off
+        if off == 0 or addr & 0xffff < 16:
+            record(4, 0, struct.pack(">H", addr >> 16))
+        record(0, addr & 0xffff, data[off:off + 16])
+    record(1, 0, b"")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", type=argparse.FileType("r"))
+    parser.add_argument("output")
+    parser.add_argument("--hex", type=lambda v: int(v, 0), metavar="ADDR",
+                        help="write Intel HEX at the address of the catalog partition")
+    args = parser.parse_args()
+
+    blob = build(*parse(args.input))
+    if args.hex is not None:
+        with open(args.output, "w") as f:
+            f.write(intel_hex(blob, args.hex))
+    else:
+        with open(args.output, "wb") as f:
+            f.write(blob)
+    print(f"{args.output}: {len(blob)} bytes")
+
+
+if __name__ == "__main__":
+    main()
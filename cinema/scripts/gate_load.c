@@ -0,0 +1,144 @@
+/** @file gate_load.c
+ * @brief Host load test of the door ticket set (src/ticket_set.c)
+ *
+ *     cc -O2 -Isrc -o gate_load scripts/gate_load.c src/ticket_set.c src/hmac.c src/sign_sw.c
+ *     ./gate_load [tickets] [baud]
+ *
+ * Fills a set sized as the gate sizes it with the ids of real signed
+ * tickets, then runs a door session at the scanner line rate: every
+ * ticket is scanned once, one scan in ten is a ticket scanned again, and
+ * every scan costs what it costs in gate.c (signature check and
+ * admission). Checks that each ticket goes in exactly once, that the set
+ * refuses tickets beyond its size and leaves no trace of a refused one,
+ * and reports the time per scan against the time a line takes on the
+ * wire. Exits with 1 on a wrong answer.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hmac.h"
+#include "ticket_set.h"
+
+/* Defines */
+#define DEFAULT_TICKETS 20000
+#define DEFAULT_BAUD 9600
+#define LINE_CHARS 58               // "CINEMA3000/0/000123/1/4/7/<16 hex>" and CR LF, typical
+#define BITS_PER_CHAR 10            // 8N1
+#define REPEAT_EVERY 10
+
+static struct hmac_key key;
+
+/**
+ * @brief Brief decription of now_ns().
+ *
+ * @return Monotonic time in nanoseconds
+ *
+ */
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Brief decription of sign().
+ *
+ * Signature of ticket seq of kiosk 0, session 4, 7 euros, as
+ * ticket_sign.c computes it (message layout in ticket_sign.c)
+ *
+ * @return First 64 bits of the signature, little endian, the id of the
+ *         ticket in the set
+ *
+ */
+static uint64_t sign(uint32_t seq) {
+    static const uint8_t tail[7] = { 1, 0, 0, 0, 4, 0, 7 };
+    uint8_t block[SIGN_BLOCK_LEN], mac[SIGN_HASH_LEN];
+    sign_hash_ctx ctx;
+    uint64_t id = 0;
+    int i;
+
+    memset(block, 0, sizeof(block));
+    for(i=0; i<4; i++) {
+        block[1 + i] = seq >> (8 * i);
+    }
+    hmac_start(&key, &ctx);
+    sign_hash_update(&ctx, block, sizeof(block));
+    sign_hash_update(&ctx, tail, sizeof(tail));
+    hmac_finish(&key, &ctx, mac);
+    for(i=7; i>=0; i--) {
+        id = (id << 8) | mac[i];
+    }
+    return id;
+}
+
+int main(int argc, char **argv) {
+    static const char secret[] = "cinema3000-demo-key";
+    int tickets = (argc > 1) ? atoi(argv[1]) : DEFAULT_TICKETS;
+    int baud = (argc > 2) ? atoi(argv[2]) : DEFAULT_BAUD;
+    uint32_t n_buckets = TICKET_SET_BUCKETS(tickets);
+    struct ticket_bucket *buckets = calloc(n_buckets, sizeof(*buckets));
+    struct ticket_set set;
+    long long start, t, worst = 0, total = 0, in_set = 0;
+    int i, scans = 0, ret, admitted = 0, wrong = 0;
+    uint32_t next = 0;
+    double line_us = 1e6 * LINE_CHARS * BITS_PER_CHAR / baud;
+    uint64_t id;
+
+    hmac_setkey(&key, (const uint8_t *)secret, sizeof(secret) - 1);
+    ticket_set_init(&set, buckets, n_buckets, tickets);
+
+    /* Door session: new tickets in order, every REPEAT_EVERY-th scan repeats an admitted one */
+    while(next < (uint32_t)tickets) {
+        bool repeat = (scans % REPEAT_EVERY == REPEAT_EVERY - 1) && (next > 0);
+        uint32_t seq = repeat ? (uint32_t)rand() % next : next++;
+
+        start = now_ns();
+        id = sign(seq);
+        t = now_ns();
+        ret = ticket_set_admit(&set, id);
+        in_set += now_ns() - t;
+        t = now_ns() - start;
+        total += t;
+        if(t > worst) {
+            worst = t;
+        }
+        scans++;
+        if(ret != (repeat ? -EALREADY : 0)) {
+            if(wrong++ < 5) {
+                printf("scan %d, ticket %u: %d\n", scans, (unsigned int)seq, ret);
+            }
+        }
+        admitted += (ret == 0);
+    }
+
+    /* Every ticket in, and one more does not fit and leaves no trace */
+    for(i=0; i<tickets; i++) {
+        if(!ticket_set_contains(&set, sign(i))) {
+            wrong++;
+        }
+    }
+    id = sign(tickets);
+    if((ticket_set_admit(&set, id) != -ENOSPC) || ticket_set_contains(&set, id)) {
+        printf("ticket %d should not fit\n", tickets);
+        wrong++;
+    }
+
+    printf("%d tickets in %u buckets (%u bytes, %.1f%% full), %d kicks\n", admitted, (unsigned int)n_buckets,
+           (unsigned int)(n_buckets * sizeof(*buckets)), 100.0 * set.count / (n_buckets * TICKET_SET_WAYS),
+           (int)set.kicks);
+    printf("%d scans: %.2f us average (%.3f us in the set), %.2f us worst; a line takes %.0f us at %d baud\n",
+           scans, total / 1e3 / scans, in_set / 1e3 / scans, worst / 1e3, line_us, baud);
+    printf("%d wrong answers\n", wrong);
+    free(buckets);
+    return (wrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Host client of the management protocol (see src/mgmt.h).
+
+    scripts/mgmt.py /dev/ttyACM1 ping
+    scripts/mgmt.py /dev/ttyACM1 info
+    scripts/mgmt.py /dev/ttyACM1 counters
+    scripts/mgmt.py /dev/ttyACM1 sales --from 0
+    scripts/mgmt.py /dev/ttyACM1 analytics
+    scripts/mgmt.py /dev/ttyACM1 catalog catalog.txt
+    scripts/mgmt.py /dev/ttyACM1 clock [set]
+
+End-of-day collection from a fleet, one CSV per machine in OUTDIR; each
+machine resumes from the last sale collected and gets its wall clock set
+from this host (the machines sell by the local time, see src/wallclock.c):
+
+    scripts/mgmt.py collect OUTDIR /dev/ttyACM1 /dev/ttyACM3 ...
+
+Needs pyserial.
+"""
+
+import argparse
+import calendar
+import csv
+import os
+import struct
+import sys
+import time
+
+import serial
+
+PING, CATALOG_INFO, COUNTERS, SALES, CATALOG_LINE, ANALYTICS, CLOCK, ERROR = 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x7f
+RESPONSE = 0x80
+SALE = struct.Struct("<IIIHBB")
+HOUR_BUCKET = struct.Struct("<IIH4HH")
+SESSION_BUCKET = struct.Struct("<IHH")
+COINS = [1, 2, 5, 10]
+TICKET_TYPES = ["Normal", "Estudante", "Senior", "Grupo"]
+
+
+def crc16_ccitt(seed, data):
+    """Same as crc16_ccitt() of Zephyr."""
+    for b in data:
+        e = (seed ^ b) & 0xff
+        f = (e ^ (e << 4)) & 0xff
+        seed = ((seed >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xffff
+    return seed
+
+
+def cobs_encode(data):
+    out, block = bytearray(), bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                out += b"\xff" + block
+                block = bytearray()
+    return bytes(out + bytes([len(block) + 1]) + block)
+
+
+def cobs_decode(data):
+    out, i = bytearray(), 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS frame")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Machine:
+    def __init__(self, port, baudrate=115200, timeout=2.0):
+        self.ser = serial.Serial(port, baudrate, timeout=timeout)
+        self.seq = 0
+        self.rx = bytearray()
+
+    def send(self, cmd, payload=b""):
+        self.seq = (self.seq + 1) & 0xff
+        raw = bytes([cmd, self.seq]) + payload
+        raw += struct.pack("<H", crc16_ccitt(0xffff, raw))
+        self.ser.write(cobs_encode(raw) + b"\0")
+
+    def recv(self, cmd):
+        """Next answer to the last request, as payload bytes."""
+        while True:
+            while b"\0" not in self.rx:
+                chunk = self.ser.read(max(1, self.ser.in_waiting))
+                if not chunk:
+                    raise TimeoutError("no answer")
+                self.rx += chunk
+            enc, _, self.rx = self.rx.partition(b"\0")
+            try:
+                frame = cobs_decode(enc)
+            except ValueError:
+                continue
+            if len(frame) < 4 or crc16_ccitt(0xffff, frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+                continue
+            if frame[1] != self.seq:
+                continue
+            if frame[0] == ERROR | RESPONSE:
+                raise OSError(frame[2], os.strerror(frame[2]))
+            if frame[0] == cmd | RESPONSE:
+                return frame[2:-2]
+
+    def request(self, cmd, payload=b"", retries=3):
+        for attempt in range(retries):
+            self.send(cmd, payload)
+            try:
+                return self.recv(cmd)
+            except TimeoutError:
+                if attempt == retries - 1:
+                    raise
+
+    def ping(self):
+        return self.request(PING)[0]
+
+    def info(self):
+        versao, n_movies, n_sessions = struct.unpack("<IHH", self.request(CATALOG_INFO))
+        return {"versao": versao, "movies": n_movies, "sessions": n_sessions}
+
+    def counters(self):
+        groups = {}
+        payload = self.request(COUNTERS)
+        while payload:
+            n = payload[0]
+            group, i = payload[1:1 + n].decode(), 1 + n
+            groups.setdefault(group, {})
+            while i < len(payload):
+                n = payload[i]
+                name = payload[i + 1:i + 1 + n].decode()
+                groups[group][name] = struct.unpack_from("<I", payload, i + 1 + n)[0]
+                i += 1 + n + 4
+            payload = self.recv(COUNTERS)
+        return groups
+
+    def sales(self, from_seq=0):
+        """Returns (sales, next_seq); sales are streamed until an empty frame."""
+        sales = []
+        payload = self.request(SALES, struct.pack("<I", from_seq))
+        while len(payload) != 4:
+            sales += [SALE.unpack_from(payload, i) for i in range(0, len(payload), SALE.size)]
+            payload = self.recv(SALES)
+        return sales, struct.unpack("<I", payload)[0]
+
+    def analytics(self):
+        """Returns (hours, versao, sessions) as lists of dicts."""
+        hours, sessions, versao = [], [], None
+        payload = self.request(ANALYTICS)
+        while payload:
+            if payload[0:1] == b"H":
+                for i in range(1, len(payload), HOUR_BUCKET.size):
+                    hour, revenue, tickets, *coins, _ = HOUR_BUCKET.unpack_from(payload, i)
+                    hours.append({"hour": hour, "revenue": revenue, "tickets": tickets,
+                                  "coins": dict(zip(COINS, coins))})
+            elif payload[0:1] == b"S":
+                versao = struct.unpack_from("<I", payload, 1)[0]
+                for i in range(5, len(payload), SESSION_BUCKET.size):
+                    revenue, tickets, session = SESSION_BUCKET.unpack_from(payload, i)
+                    sessions.append({"session": session, "revenue": revenue, "tickets": tickets})
+            payload = self.recv(ANALYTICS)
+        return hours, versao, sessions
+
+    def catalog(self, lines, retries=3):
+        """Sends a catalog update, BEGIN to COMMIT.
+
+        A catalog line is not idempotent (a MOVIE or SESSION sent twice is
+        staged twice), so lines are never resent: a lost answer restarts
+        the update from BEGIN, which drops the staged one. If the lost
+        answer was the one to COMMIT, the version is already on sale."""
+        lines = [line.strip() for line in lines if line.strip() and not line.strip().startswith("#")]
+        versao = int(lines[0].split()[1], 0) if lines and lines[0].startswith("BEGIN ") else None
+        for attempt in range(retries):
+            try:
+                return self.catalog_lines(lines)
+            except TimeoutError:
+                if versao is not None and self.info()["versao"] == versao:
+                    return f"OK {versao}"
+                if attempt == retries - 1:
+                    raise
+
+    def catalog_lines(self, lines):
+        for line in lines:
+            answer = self.request(CATALOG_LINE, line.encode(), retries=1).decode()
+            while answer == "ERR busy":
+                time.sleep(0.5)
+                answer = self.request(CATALOG_LINE, line.encode(), retries=1).decode()
+            if not answer.startswith("OK"):
+                raise RuntimeError(f"{line}: {answer}")
+            last = answer
+        return last
+
+    def clock(self, set_clock=False):
+        """Sets the wall clock to the local time of this host if asked, returns the machine's local time."""
+        payload = struct.pack("<I", calendar.timegm(time.localtime())) if set_clock else b""
+        return struct.unpack("<I", self.request(CLOCK, payload))[0]
+
+
+def write_sales(writer, sales):
+    for seq, uptime_ms, versao, session, ticket, price in sales:
+        writer.writerow([seq, uptime_ms, versao, session, TICKET_TYPES[ticket], price])
+
+
+def collect(outdir, ports):
+    os.makedirs(outdir, exist_ok=True)
+    failed = 0
+    for port in ports:
+        name = os.path.basename(port)
+        seq_file = os.path.join(outdir, name + ".seq")
+        csv_file = os.path.join(outdir, name + ".csv")
+        try:
+            from_seq = int(open(seq_file).read()) if os.path.exists(seq_file) else 0
+            machine = Machine(port)
+            start = time.monotonic()
+            sales, next_seq = machine.sales(from_seq)
+            elapsed = time.monotonic() - start
+            new_file = not os.path.exists(csv_file)
+            with open(csv_file, "a", newline="") as f:
+                writer = csv.writer(f)
+                if new_file:
+                    writer.writerow(["seq", "uptime_ms", "versao", "session", "ticket", "price"])
+                write_sales(writer, sales)
+            with open(seq_file, "w") as f:
+                f.write(str(next_seq))
+            machine.clock(set_clock=True)
+            lost = (sales[0][0] - from_seq) if sales else 0
+            print(f"{port}: {len(sales)} sales in {elapsed:.2f} s, next {next_seq}"
+                  + (f", {lost} lost" if lost else ""))
+        except (OSError, TimeoutError, serial.SerialException) as e:
+            print(f"{port}: {e}", file=sys.stderr)
+            failed += 1
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial port, or 'collect' for the fleet collection")
+    parser.add_argument("command", help="ping, info, counters, sales, analytics, catalog, clock, or the OUTDIR of collect")
+    parser.add_argument("args", nargs="*")
+    parser.add_argument("--from", dest="from_seq", type=int, default=0)
+    args = parser.parse_args()
+
+    if args.port == "collect":
+        return collect(args.command, args.args)
+
+    machine = Machine(args.port)
+    if args.command == "ping":
+        print(f"protocol {machine.ping()}")
+    elif args.command == "info":
+        print(machine.info())
+    elif args.command == "counters":
+        for group, values in machine.counters().items():
+            for name, value in values.items():
+                print(f"{group}.{name} {value}")
+    elif args.command == "sales":
+        sales, next_seq = machine.sales(args.from_seq)
+        write_sales(csv.writer(sys.stdout), sales)
+        print(f"# next {next_seq}", file=sys.stderr)
+    elif args.command == "analytics":
+        hours, versao, sessions = machine.analytics()
+        for h in hours:
+            print(f"hour {h['hour']}: {h['tickets']} tickets, {h['revenue']} euros, coins {h['coins']}")
+        for ses in sessions:
+            print(f"catalog {versao} session {ses['session']}: {ses['tickets']} tickets, {ses['revenue']} euros")
+    elif args.command == "clock":
+        try:
+            local_s = machine.clock(set_clock=args.args[:1] == ["set"])
+            print(time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(local_s)))
+        except OSError as e:
+            print(f"clock not set ({e.strerror})", file=sys.stderr)
+            return 1
+    elif args.command == "catalog":
+        with open(args.args[0]) as f:
+            print(machine.catalog(f))
+    else:
+        parser.error(f"unknown command {args.command}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
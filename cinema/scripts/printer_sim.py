@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Serial thermal printer simulator (see src/printer.c).
+
+native_posix prints the pseudotty of uart1 at boot
+("UART_1 connected to pseudotty: /dev/pts/N"); attach to it:
+
+    west build -b native_posix -- -DOVERLAY_CONFIG=printer.conf
+    scripts/printer_sim.py /dev/pts/N --cps 300 --paper 40 --reload 15
+
+The printer has a small input buffer drained at --cps bytes per second
+and asks for XOFF/XON around it. --paper is the roll length in lines;
+when it ends the printer stops, reports paper end to DLE EOT 4 and
+takes a new roll after --reload seconds (never with 0). Each ticket is
+shown once it is cut; bitmaps (GS v 0) are drawn with --preview. With --pty the simulator opens its own pseudotty
+instead, e.g. for a board behind socat. A summary is printed every
+--report seconds and on Ctrl-C.
+
+Only uses the standard library.
+"""
+
+import argparse
+import os
+import pty
+import select
+import sys
+import termios
+import time
+import tty
+
+XON, XOFF, DLE, EOT, ESC, GS = 0x11, 0x13, 0x10, 0x04, 0x1b, 0x1d
+STATUS_OK, PAPER_END = 0x12, 0x60
+DOTS_PER_LINE = 24          # Paper used by a text line, in dot lines
+ARGS = {ord("@"): 0, ord("a"): 1, ord("E"): 1, ord("!"): 1, ord("V"): 1}     # Parameter bytes of ESC x / GS x
+
+
+class Printer:
+    def __init__(self, fd, args):
+        self.fd = fd
+        self.args = args
+        self.buf = bytearray()
+        self.paper = args.paper
+        self.out_since = None
+        self.xoff = False
+        self.rx_state = None        # DLE, DLE EOT
+        self.line = bytearray()
+        self.ticket = []
+        self.raster_w = self.raster_left = 0
+        self.raster = bytearray()
+        self.last_print = time.monotonic()
+        self.tickets = self.nbytes = self.xoffs = self.paper_outs = self.queries = 0
+
+    def send(self, b):
+        os.write(self.fd, bytes([b]))
+
+    def receive(self, data):
+        for b in data:
+            # DLE EOT n is answered as it arrives, even with a full buffer
+            if self.rx_state is None and b == DLE:
+                self.rx_state = DLE
+                continue
+            if self.rx_state == DLE:
+                self.rx_state = EOT if b == EOT else None
+                if b != EOT:
+                    self.buf += bytes([DLE, b])
+                continue
+            if self.rx_state == EOT:
+                self.rx_state = None
+                self.queries += 1
+                self.send(STATUS_OK | (PAPER_END if self.paper == 0 else 0))
+                continue
+            self.buf.append(b)
+            self.nbytes += 1
+        self.flow()
+
+    def flow(self):
+        if not self.xoff and len(self.buf) >= self.args.buffer * 3 // 4:
+            self.xoff = True
+            self.xoffs += 1
+            self.send(XOFF)
+        elif self.xoff and len(self.buf) <= self.args.buffer // 4:
+            self.xoff = False
+            self.send(XON)
+
+    def feed(self):
+        """Prints the line being built, uses one line of paper."""
+        self.ticket.append(self.line.decode("latin-1"))
+        self.line = bytearray()
+        self.use_paper()
+
+    def use_paper(self):
+        self.paper -= 1
+        if self.paper == 0:
+            self.paper_outs += 1
+            self.out_since = time.monotonic()
+            print("-- paper end --")
+
+    def run(self, now):
+        if self.paper == 0:
+            if self.args.reload > 0 and now - self.out_since >= self.args.reload:
+                self.paper = self.args.paper
+                print("-- new roll --")
+            else:
+                self.last_print = now
+                return
+        budget = int((now - self.last_print) * self.args.cps)
+        if budget == 0:
+            return
+        self.last_print = now
+        while budget > 0 and self.buf and self.paper != 0:
+            if self.raster_left > 0:
+                # Bitmap data is printed as it arrives, the buffer is smaller than the bitmap
+                n = min(budget, self.raster_left, len(self.buf))
+                before = len(self.raster) // self.raster_w
+                self.raster += self.buf[:n]
+                del self.buf[:n]
+                budget -= n
+                self.raster_left -= n
+                for row in range(before, len(self.raster) // self.raster_w):
+                    if row % DOTS_PER_LINE == DOTS_PER_LINE - 1:
+                        self.use_paper()
+                if self.raster_left == 0:
+                    self.bitmap()
+                continue
+            b = self.buf[0]
+            if b == GS and len(self.buf) >= 2 and self.buf[1] == ord("v"):
+                if len(self.buf) < 8:
+                    break
+                self.raster_w = self.buf[4] | (self.buf[5] << 8)
+                self.raster_left = self.raster_w * (self.buf[6] | (self.buf[7] << 8))
+                self.raster = bytearray()
+                del self.buf[:8]
+                budget -= 8
+                continue
+            if b in (ESC, GS):
+                if len(self.buf) < 2 or len(self.buf) < 2 + ARGS.get(self.buf[1], 0):
+                    break
+                cmd, n = self.buf[1], 2 + ARGS.get(self.buf[1], 0)
+                del self.buf[:n]
+                if b == GS and cmd == ord("V"):
+                    self.cut()
+                elif b == ESC and cmd == ord("@"):
+                    self.line = bytearray()
+                budget -= n
+                continue
+            del self.buf[0]
+            budget -= 1
+            if b == ord("\n"):
+                self.feed()
+            elif b >= 0x20:
+                self.line.append(b)
+        self.flow()
+
+    def bitmap(self):
+        """Adds the bitmap just printed to the ticket."""
+        w, rows = self.raster_w * 8, len(self.raster) // self.raster_w
+        if not self.args.preview:
+            self.ticket.append("[bitmap %dx%d]" % (w, rows))
+            return
+
+        def dot(x, y):
+            return y < rows and self.raster[y * self.raster_w + x // 8] >> (7 - x % 8) & 1
+
+        inked = [x for x in range(w) if any(dot(x, y) for y in range(rows))]
+        if not inked:
+            return
+        for y in range(0, rows, 2):
+            self.ticket.append("".join(" \u2580\u2584\u2588"[dot(x, y) + 2 * dot(x, y + 1)]
+                                       for x in range(inked[0], inked[-1] + 1)).rstrip())
+
+    def cut(self):
+        if self.line:
+            self.feed()
+        self.tickets += 1
+        width = max([len(l) for l in self.ticket] + [20])
+        print("+" + "-" * (width + 2) + "+")
+        for l in self.ticket:
+            print("| " + l.center(width) + " |")
+        print("+" + "-" * (width + 2) + "+")
+        self.ticket = []
+        sys.stdout.flush()
+
+    def report(self, elapsed):
+        print("%.0f s: %d tickets (%.1f/min), %d bytes, %d XOFF, %d paper ends, %d status queries, %d bytes buffered"
+              % (elapsed, self.tickets, 60.0 * self.tickets / max(elapsed, 1e-3), self.nbytes,
+                 self.xoffs, self.paper_outs, self.queries, len(self.buf)))
+        sys.stdout.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("port", nargs="?", help="pseudotty of the machine (omit with --pty)")
+    ap.add_argument("--pty", action="store_true", help="open a pseudotty and print its name")
+    ap.add_argument("--cps", type=float, default=300.0, help="bytes printed per second")
+    ap.add_argument("--buffer", type=int, default=64, help="input buffer of the printer in bytes")
+    ap.add_argument("--paper", type=int, default=0, help="lines per roll, 0 never runs out")
+    ap.add_argument("--reload", type=float, default=10.0, help="seconds to load a new roll, 0 never")
+    ap.add_argument("--preview", action="store_true", help="draw the bitmaps")
+    ap.add_argument("--report", type=float, default=30.0, help="seconds between summaries")
+    args = ap.parse_args()
+
+    if args.pty:
+        fd, slave = pty.openpty()
+        tty.setraw(slave, termios.TCSANOW)
+        print("printer on %s" % os.ttyname(slave))
+    elif args.port:
+        fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(fd, termios.TCSANOW)
+    else:
+        ap.error("give the port or --pty")
+    if args.paper == 0:
+        args.paper = -1     # Never reaches 0
+
+    printer = Printer(fd, args)
+    start = last = time.monotonic()
+    try:
+        while True:
+            ready, _, _ = select.select([fd], [], [], 0.02)
+            if ready:
+                printer.receive(os.read(fd, 4096))
+            now = time.monotonic()
+            printer.run(now)
+            if now - last >= args.report:
+                printer.report(now - start)
+                last = now
+    except KeyboardInterrupt:
+        printer.report(time.monotonic() - start)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Links the seat sync UARTs of two kiosks (see src/seat_sync.h).
+
+Build both kiosks for native_posix with peer.conf, one of them with
+CONFIG_CINEMA_SEAT_KIOSK_ID=1, and pass the pseudotty each one prints
+at boot ("UART_1 connected to pseudotty: /dev/pts/N"):
+
+    scripts/pty_link.py /dev/pts/N /dev/pts/M --report 5
+
+Bytes are forwarded both ways unchanged (--loss drops a share of the
+frames, to exercise the claim timeout). Every frame is decoded on the
+way and a summary is printed every --report seconds and on Ctrl-C:
+claims per second, grant latency, the conflict rate (claims answered
+with an empty grant, i.e. seats lost to the other kiosk) and the claims
+answered busy because they crossed a claim of the other kiosk.
+
+Only uses the standard library.
+"""
+
+import argparse
+import os
+import random
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+RECORDS = {ord("C"): struct.Struct("<HB"), ord("B"): struct.Struct("<HB"), ord("G"): struct.Struct("<HQ"),
+           ord("S"): struct.Struct("<HQ"), ord("F"): struct.Struct("<HQ")}
+
+
+def crc16_ccitt(seed, data):
+    """Same as crc16_ccitt() of Zephyr."""
+    for b in data:
+        e = (seed ^ b) & 0xff
+        f = (e ^ (e << 4)) & 0xff
+        seed = ((seed >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xffff
+    return seed
+
+
+def cobs_decode(data):
+    out, i = bytearray(), 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS frame")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse(frame):
+    """Returns (versao, [(type, session, value), ...]) of a decoded frame."""
+    if len(frame) < 6 or crc16_ccitt(0xffff, frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+        raise ValueError("bad CRC")
+    versao = struct.unpack("<I", frame[:4])[0]
+    body, i, records = frame[4:-2], 0, []
+    while i < len(body):
+        rec = RECORDS.get(body[i])
+        if rec is None or i + 1 + rec.size > len(body):
+            raise ValueError("bad record")
+        records.append((chr(body[i]),) + rec.unpack_from(body, i + 1))
+        i += 1 + rec.size
+    return versao, records
+
+
+class Stats:
+    def __init__(self):
+        self.frames = self.bad = self.dropped = 0
+        self.claims = self.seats_claimed = self.grants = self.empty = self.busy = 0
+        self.seats_granted = self.sold = self.freed = 0
+        self.latency = []
+        self.pending = {}       # (kiosk, session) -> time of the oldest unanswered claim
+
+    def record(self, kiosk, kind, session, value, now):
+        if kind == "C":
+            self.claims += 1
+            self.seats_claimed += value
+            self.pending.setdefault((kiosk, session), now)
+        elif kind == "G":
+            self.grants += 1
+            seats = bin(value).count("1")
+            self.seats_granted += seats
+            if seats == 0:
+                self.empty += 1
+            # The grant goes to the other kiosk
+            since = self.pending.pop((1 - kiosk, session), None)
+            if since is not None:
+                self.latency.append(now - since)
+        elif kind == "B":
+            # Crossing claims, the other kiosk kept its seats
+            self.busy += 1
+            self.pending.pop((1 - kiosk, session), None)
+        elif kind == "S":
+            self.sold += bin(value).count("1")
+        else:
+            self.freed += bin(value).count("1")
+
+    def report(self, elapsed):
+        lat = sorted(self.latency)
+        print("%.0f s: %d frames (%d bad, %d dropped), %.1f claims/s, %d seats claimed, %d granted"
+              % (elapsed, self.frames, self.bad, self.dropped, self.claims / max(elapsed, 1e-3),
+                 self.seats_claimed, self.seats_granted))
+        print("    conflicts %d/%d (%.1f%%), busy %d, sold %d, given back %d, unanswered claims %d"
+              % (self.empty, self.claims, 100.0 * self.empty / max(self.claims, 1), self.busy,
+                 self.sold, self.freed, len(self.pending)))
+        if lat:
+            print("    grant latency ms: avg %.1f p50 %.1f p99 %.1f max %.1f"
+                  % (1000 * sum(lat) / len(lat), 1000 * lat[len(lat) // 2],
+                     1000 * lat[min(len(lat) - 1, len(lat) * 99 // 100)], 1000 * lat[-1]))
+        sys.stdout.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("kiosk0", help="seat link pseudotty of kiosk 0")
+    ap.add_argument("kiosk1", help="seat link pseudotty of kiosk 1")
+    ap.add_argument("--loss", type=float, default=0.0, help="percentage of frames dropped")
+    ap.add_argument("--report", type=float, default=10.0, help="seconds between summaries")
+    ap.add_argument("--verbose", action="store_true", help="print every record")
+    ap.add_argument("--seed", type=int, default=None)
+    args = ap.parse_args()
+
+    rng = random.Random(args.seed)
+    fds = [os.open(p, os.O_RDWR | os.O_NOCTTY) for p in (args.kiosk0, args.kiosk1)]
+    for fd in fds:
+        tty.setraw(fd, termios.TCSANOW)
+    rx = [bytearray(), bytearray()]
+    stats = Stats()
+    start = last = time.monotonic()
+
+    try:
+        while True:
+            ready, _, _ = select.select(fds, [], [], 0.5)
+            now = time.monotonic()
+            for kiosk, fd in enumerate(fds):
+                if fd not in ready:
+                    continue
+                rx[kiosk] += os.read(fd, 4096)
+                while b"\x00" in rx[kiosk]:
+                    raw, _, rest = bytes(rx[kiosk]).partition(b"\x00")
+                    rx[kiosk] = bytearray(rest)
+                    if not raw:
+                        continue
+                    stats.frames += 1
+                    if rng.random() * 100 < args.loss:
+                        stats.dropped += 1
+                        continue
+                    os.write(fds[1 - kiosk], raw + b"\x00")
+                    try:
+                        versao, records = parse(cobs_decode(raw))
+                    except ValueError:
+                        stats.bad += 1
+                        continue
+                    for kind, session, value in records:
+                        if args.verbose:
+                            print("%d -> %d v%d %s session %d %s" % (kiosk, 1 - kiosk, versao, kind, session,
+                                  value if kind in "CB" else "%016x" % value))
+                        stats.record(kiosk, kind, session, value, now)
+            if now - last >= args.report:
+                stats.report(now - start)
+                last = now
+    except KeyboardInterrupt:
+        stats.report(time.monotonic() - start)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,290 @@
+/** @file qr_bench.c
+ * @brief Host benchmark and round-trip check of the QR encoder (src/qr.c)
+ *
+ *     cc -O2 -Isrc -o qr_bench scripts/qr_bench.c src/qr.c
+ *     ./qr_bench [codes] [code.pbm]
+ *
+ * Encodes ticket codes of every length up to QR_MAX_PAYLOAD and reports
+ * the time per code, then decodes every symbol again with a decoder
+ * written apart from the encoder (format information by nearest
+ * codeword, unmasking from the mask formulas, Reed-Solomon syndromes
+ * from its own GF(256) arithmetic) and checks the payload comes back.
+ * The last symbol can be written as a PBM image, with its quiet zone,
+ * to check it with a phone. Exits with 1 when a symbol does not decode.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qr.h"
+
+/* Defines */
+#define DEFAULT_CODES 20000
+#define QUIET 4
+#define PBM_SCALE 8
+
+/* Blocks at level M: number of blocks, data and error correction codewords per block */
+static const int blocks_m[QR_MAX_VERSION + 1][3] = { { 0, 0, 0 }, { 1, 16, 10 }, { 1, 28, 16 }, { 1, 44, 26 }, { 2, 32, 18 } };
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Brief decription of gf_mul().
+ *
+ * Multiplication in GF(256) with the polynomial 0x11d, bit by bit
+ *
+ * @return a * b
+ *
+ */
+static int gf_mul(int a, int b) {
+    int r = 0;
+
+    while(b) {
+        if(b & 1) {
+            r ^= a;
+        }
+        a <<= 1;
+        if(a & 0x100) {
+            a ^= 0x11d;
+        }
+        b >>= 1;
+    }
+    return r;
+}
+
+/**
+ * @brief Brief decription of format_word().
+ *
+ * @param data  Level and mask, 5 bits
+ *
+ * @return BCH(15,5) codeword of the format information, masked with 0x5412
+ *
+ */
+static int format_word(int data) {
+    int rem = data << 10, i;
+
+    for(i=14; i>=10; i--) {
+        if(rem & (1 << i)) {
+            rem ^= 0x537 << (i - 10);
+        }
+    }
+    return ((data << 10) | rem) ^ 0x5412;
+}
+
+static int mask_bit(int mask, int x, int y) {
+    switch(mask) {
+    case 0: return (x + y) % 2 == 0;
+    case 1: return y % 2 == 0;
+    case 2: return x % 3 == 0;
+    case 3: return (x + y) % 3 == 0;
+    case 4: return (x / 3 + y / 2) % 2 == 0;
+    case 5: return x * y % 2 + x * y % 3 == 0;
+    case 6: return (x * y % 2 + x * y % 3) % 2 == 0;
+    default: return ((x + y) % 2 + x * y % 3) % 2 == 0;
+    }
+}
+
+/**
+ * @brief Brief decription of is_function().
+ *
+ * @return true if module (x, y) of a symbol of the given size is not a data module
+ *
+ */
+static int is_function(int size, int x, int y) {
+    if((x == 6) || (y == 6)) {
+        return 1;                                                   // Timing
+    }
+    if(((x < 9) && (y < 9)) || ((x >= size - 8) && (y < 9)) || ((x < 9) && (y >= size - 8))) {
+        return 1;                                                   // Finders, separators and format
+    }
+    if((size > 21) && (abs(x - (size - 7)) <= 2) && (abs(y - (size - 7)) <= 2)) {
+        return 1;                                                   // Alignment
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of decode().
+ *
+ * @param *qr   Symbol
+ * @param *out  Payload, at least QR_MAX_PAYLOAD bytes
+ *
+ * @return Length of the payload, -1 if the symbol does not decode
+ *
+ */
+static int decode(const struct qr_code *qr, uint8_t *out) {
+    static const int fx[15] = { 8, 8, 8, 8, 8, 8, 8, 8, 7, 5, 4, 3, 2, 1, 0 };
+    static const int fy[15] = { 0, 1, 2, 3, 4, 5, 7, 8, 8, 8, 8, 8, 8, 8, 8 };
+    uint8_t cw[100], block[60], data[64];
+    int size = qr->size, version = (size - 17) / 4, raw = 0, fmt = -1, best = 16, mask;
+    int i, d, n, x, y, right, vert, j, bit, b, nb, nd, ne, k, s, len, p;
+
+    if((version < 1) || (version > QR_MAX_VERSION) || !qr_module(qr, 8, size - 8)) {
+        return -1;
+    }
+    for(i=0; i<15; i++) {
+        raw |= qr_module(qr, fx[i], fy[i]) << i;
+    }
+    for(d=0; d<32; d++) {
+        n = __builtin_popcount(format_word(d) ^ raw);
+        if(n < best) {
+            best = n;
+            fmt = d;
+        }
+    }
+    if((best > 3) || ((fmt >> 3) != 0)) {
+        return -1;      // Not level M
+    }
+    mask = fmt & 7;
+
+    memset(cw, 0, sizeof(cw));
+    nb = blocks_m[version][0];
+    nd = blocks_m[version][1];
+    ne = blocks_m[version][2];
+    n = nb * (nd + ne);
+    bit = 0;
+    for(right=size-1; right>=1; right-=2) {
+        if(right == 6) {
+            right = 5;
+        }
+        for(vert=0; vert<size; vert++) {
+            for(j=0; j<2; j++) {
+                x = right - j;
+                y = (((right + 1) & 2) == 0) ? size - 1 - vert : vert;
+                if(is_function(size, x, y) || (bit >= n * 8)) {
+                    continue;
+                }
+                if(qr_module(qr, x, y) ^ mask_bit(mask, x, y)) {
+                    cw[bit >> 3] |= 0x80 >> (bit & 7);
+                }
+                bit++;
+            }
+        }
+    }
+
+    /* De-interleave, every syndrome of every block must be zero, keep the data */
+    for(b=0; b<nb; b++) {
+        for(i=0; i<nd; i++) {
+            block[i] = cw[i * nb + b];
+        }
+        for(i=0; i<ne; i++) {
+            block[nd + i] = cw[nb * nd + i * nb + b];
+        }
+        for(k=0, p=1; k<ne; k++, p=gf_mul(p, 2)) {
+            for(i=0, s=0; i<nd+ne; i++) {
+                s = gf_mul(s, p) ^ block[i];
+            }
+            if(s != 0) {
+                return -1;
+            }
+        }
+        memcpy(&data[b * nd], block, nd);
+    }
+
+    if((data[0] >> 4) != 4) {
+        return -1;      // Not byte mode
+    }
+    len = ((data[0] & 0x0f) << 4) | (data[1] >> 4);
+    if(len + 2 > nb * nd) {
+        return -1;
+    }
+    for(i=0; i<len; i++) {
+        out[i] = (data[1 + i] << 4) | (data[2 + i] >> 4);
+    }
+    return len;
+}
+
+/**
+ * @brief Brief decription of write_pbm().
+ *
+ * @return 0 on success, -1 if the file could not be written
+ *
+ */
+static int write_pbm(const char *path, const struct qr_code *qr) {
+    int dim = (qr->size + 2 * QUIET) * PBM_SCALE, x, y;
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL) {
+        return -1;
+    }
+    fprintf(f, "P1\n%d %d\n", dim, dim);
+    for(y=0; y<dim; y++) {
+        for(x=0; x<dim; x++) {
+            int mx = x / PBM_SCALE - QUIET, my = y / PBM_SCALE - QUIET;
+            fputc(((mx >= 0) && (my >= 0) && (mx < qr->size) && (my < qr->size) && qr_module(qr, mx, my)) ? '1' : '0', f);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static struct qr_code qr;
+    uint8_t payload[QR_MAX_PAYLOAD + 1], back[QR_MAX_PAYLOAD];
+    int codes = (argc > 1) ? atoi(argv[1]) : DEFAULT_CODES;
+    int per_version[QR_MAX_VERSION + 1] = { 0 }, masks[8] = { 0 };
+    long long start, elapsed = 0;
+    int i, len, n, failed = 0;
+
+    for(i=0; i<codes; i++) {
+        /* Lengths cycle through every version, bytes cover the whole 0-255 range */
+        len = i % (QR_MAX_PAYLOAD + 1);
+        for(n=0; n<len; n++) {
+            payload[n] = (uint8_t)(i * 31 + n * 7);
+        }
+        start = now_ns();
+        if(qr_encode(payload, len, &qr) != 0) {
+            printf("code %d: %d bytes do not fit\n", i, len);
+            return 1;
+        }
+        elapsed += now_ns() - start;
+        per_version[qr.version]++;
+        masks[qr.mask]++;
+        n = decode(&qr, back);
+        if((n != len) || (memcmp(back, payload, len) != 0)) {
+            if(failed++ < 5) {
+                printf("code %d: %d bytes, version %d, mask %d does not decode\n", i, len, qr.version, qr.mask);
+            }
+        }
+    }
+    if(qr_encode(payload, QR_MAX_PAYLOAD + 1, &qr) != -EMSGSIZE) {
+        printf("%d bytes should not fit\n", QR_MAX_PAYLOAD + 1);
+        failed++;
+    }
+
+    printf("%d codes in %.1f ms, %.2f us per code\n", codes, elapsed / 1e6, elapsed / 1e3 / codes);
+    printf("versions 1-%d:", QR_MAX_VERSION);
+    for(i=1; i<=QR_MAX_VERSION; i++) {
+        printf(" %d", per_version[i]);
+    }
+    printf(", masks 0-7:");
+    for(i=0; i<8; i++) {
+        printf(" %d", masks[i]);
+    }
+    printf("\nround trip: %d of %d codes failed\n", failed, codes);
+
+    if(argc > 2) {
+        len = snprintf((char *)payload, sizeof(payload), "CINEMA3000/000123/1/4/0");
+        qr_encode(payload, len, &qr);
+        if(write_pbm(argv[2], &qr) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        printf("\"%s\" (version %d, mask %d) written to %s\n", payload, qr.version, qr.mask, argv[2]);
+    }
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/** @file raster_bench.c
+ * @brief Host benchmark of the raster ticket renderer (src/raster.c)
+ *
+ *     cc -O2 -Isrc -o raster_bench scripts/raster_bench.c src/raster.c src/font.c
+ *     ./raster_bench [tickets] [ticket.pbm]
+ *
+ * With -DCONFIG_CINEMA_QR and src/qr.c the tickets carry a QR code,
+ * encoded in make_job() as the stations do.
+ *
+ * Renders the tickets one dot line at a time, as the printer thread
+ * does, and reports lines/ms. The last ticket can be written as a PBM
+ * image to check the output.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "raster.h"
+
+/* Defines */
+#define DEFAULT_TICKETS 20000
+
+static const char *filmes[] = { "Filme A", "Filme B", "A Viagem de Chihiro", "Ação em Lisboa" };
+static const char *tipos[] = { "Normal", "Estudante", "Senior" };
+
+/**
+ * @brief Brief decription of now_ns().
+ *
+ * @return Monotonic time in nanoseconds
+ *
+ */
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Brief decription of make_job().
+ *
+ * @param *job  Filled with the ticket number i
+ * @param i     Ticket number
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void make_job(struct print_job *job, int i) {
+#ifdef CONFIG_CINEMA_QR
+    char code[QR_MAX_PAYLOAD + 1];
+    int len;
+#endif
+
+    memset(job, 0, sizeof(*job));
+    job->seq = i;
+    job->horas = 15 + (i % 4) * 2;
+    job->price = 5 + (i % 3);
+    job->station = i % 2;
+    strncpy(job->filme, filmes[i % 4], sizeof(job->filme) - 1);
+    strncpy(job->tipo, tipos[i % 3], sizeof(job->tipo) - 1);
+#ifdef CONFIG_CINEMA_QR
+    len = snprintf(code, sizeof(code), "CINEMA3000/%06u/1/%d/%d", (unsigned int)job->seq, i % 8, i % 3);
+    qr_encode((const uint8_t *)code, len, &job->code);
+#endif
+}
+
+/**
+ * @brief Brief decription of write_pbm().
+ *
+ * Renders one ticket to a PBM file
+ *
+ * @param *path  File name
+ * @param *job   Ticket
+ *
+ * @return 0 on success, -1 if the file could not be written
+ *
+ */
+static int write_pbm(const char *path, const struct print_job *job) {
+    static struct raster r;
+    uint8_t line[RASTER_LINE_BYTES];
+    FILE *f = fopen(path, "wb");
+
+    if(f == NULL) {
+        return -1;
+    }
+    raster_begin(&r, job, false);
+    fprintf(f, "P4\n%d %d\n", RASTER_DOTS, raster_height(&r));
+    while(raster_next_line(&r, line)) {
+        fwrite(line, 1, sizeof(line), f);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static struct raster r;
+    uint8_t line[RASTER_LINE_BYTES];
+    struct print_job job;
+    int tickets = (argc > 1) ? atoi(argv[1]) : DEFAULT_TICKETS;
+    long long start, elapsed, lines = 0;
+    unsigned int check = 0;
+    int i;
+
+    start = now_ns();
+    for(i=0; i<tickets; i++) {
+        make_job(&job, i);
+        raster_begin(&r, &job, false);
+        while(raster_next_line(&r, line)) {
+            check += line[i % RASTER_LINE_BYTES];   // Keeps the compiler from dropping the work
+            lines++;
+        }
+    }
+    elapsed = now_ns() - start;
+
+    printf("%d tickets, %lld lines of %d dots in %.1f ms\n", tickets, lines, RASTER_DOTS, elapsed / 1e6);
+    printf("%.1f lines/ms, %.2f us per ticket (check %u)\n",
+           lines / (elapsed / 1e6), elapsed / 1e3 / tickets, check);
+
+    if(argc > 2) {
+        if(write_pbm(argv[2], &job) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        printf("Last ticket written to %s\n", argv[2]);
+    }
+    return 0;
+}
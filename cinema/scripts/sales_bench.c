@@ -0,0 +1,206 @@
+/** @file sales_bench.c
+ * @brief Host benchmark and round-trip check of the sales codec (src/sales_codec.c)
+ *
+ *     cc -O2 -Isrc -o sales_bench scripts/sales_bench.c src/sales_codec.c
+ *     ./sales_bench [sales] [page_size]
+ *
+ * Makes a day of sales as a kiosk sees them (bursts before the sessions,
+ * a few sessions on sale at once, mostly normal tickets, a catalog update
+ * now and then) and lays them out in pages as sales.c does. Reports the
+ * bytes per sale, the sales per page and the pages (flash erases) the
+ * day takes against the struct sale layout, and the encode and decode
+ * time per sale against copying the structs. Every page is decoded again
+ * in pieces of random size, as a stream arrives, and must give back the
+ * same sales; the end of a page filled with 0xff must stop the decoder.
+ * Exits with 1 on a wrong record.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sales_codec.h"
+
+/* Defines */
+#define DEFAULT_SALES 100000
+#define DEFAULT_PAGE_SIZE 256
+#define SESSIONS_ON_SALE 4
+#define UPDATE_EVERY 5000           // Sales between catalog updates
+
+static const uint8_t type_price[4] = { 7, 5, 5, 6 };
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Brief decription of make_sales().
+ *
+ * @param *s  Buffer for the sales
+ * @param n   Number of sales
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void make_sales(struct sale *s, int n) {
+    uint32_t uptime = 1000, versao = 1;
+    int i, session = 0, r;
+
+    for(i=0; i<n; i++) {
+        r = rand();
+        if(i % UPDATE_EVERY == UPDATE_EVERY - 1) {
+            versao++;
+        }
+        /* A group buys together, otherwise seconds to minutes apart */
+        uptime += (r % 4 == 0) ? 2000 + r % 8000 : 15000 + r % 300000;
+        if(r % 5 == 0) {
+            session = (session + 1 + r % (SESSIONS_ON_SALE - 1)) % SESSIONS_ON_SALE;
+        }
+        s[i].seq = i;
+        s[i].uptime_ms = uptime;
+        s[i].versao = versao;
+        s[i].session = (versao * 7 + session) % 200;
+        s[i].type = ((r >> 8) % 10 < 6) ? 0 : 1 + (r >> 8) % 3;
+        s[i].price = type_price[s[i].type] + ((s[i].session % 3 == 0) ? 2 : 0);
+    }
+}
+
+/**
+ * @brief Brief decription of same_sale().
+ *
+ * @return true if the two sales have the same fields
+ *
+ */
+static int same_sale(const struct sale *a, const struct sale *b) {
+    return (a->seq == b->seq) && (a->uptime_ms == b->uptime_ms) && (a->versao == b->versao) &&
+           (a->session == b->session) && (a->type == b->type) && (a->price == b->price);
+}
+
+int main(int argc, char **argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : DEFAULT_SALES;
+    int page_size = (argc > 2) ? atoi(argv[2]) : DEFAULT_PAGE_SIZE;
+    struct sale *sales = malloc(n * sizeof(struct sale));
+    struct sale *back = malloc(n * sizeof(struct sale));
+    uint8_t *pages = malloc((size_t)n * SALE_ENC_MAX + page_size);
+    int *page_used = malloc(n * sizeof(int));
+    struct sales_codec enc, next;
+    struct sales_decoder dec;
+    struct sale extra;
+    uint8_t buf[SALE_ENC_MAX];
+    long long start, t_enc, t_dec, t_raw;
+    long bytes = 0;
+    int i, len, n_pages = 0, used, off, got, chunk, p, k, failed = 0;
+
+    if((sales == NULL) || (back == NULL) || (pages == NULL) || (page_used == NULL) || (page_size < SALE_ENC_MAX)) {
+        printf("usage: %s [sales] [page_size >= %d]\n", argv[0], SALE_ENC_MAX);
+        return 1;
+    }
+    srand(1);
+    make_sales(sales, n);
+
+    /* Raw layout: the struct copied as it is */
+    memset(back, 0, n * sizeof(struct sale));
+    start = now_ns();
+    memcpy(back, sales, n * sizeof(struct sale));
+    t_raw = now_ns() - start;
+
+    /* Encode into pages, a new page with a full record when one does not fit */
+    memset(pages, 0xff, (size_t)n * SALE_ENC_MAX + page_size);
+    sales_codec_reset(&enc);
+    page_used[0] = 0;
+    start = now_ns();
+    for(i=0; i<n; i++) {
+        next = enc;
+        len = sales_encode(&next, &sales[i], buf);
+        if(page_used[n_pages] + len > page_size) {
+            page_used[++n_pages] = 0;
+            sales_codec_reset(&next);
+            len = sales_encode(&next, &sales[i], buf);
+        }
+        memcpy(&pages[(size_t)n_pages * page_size + page_used[n_pages]], buf, len);
+        page_used[n_pages] += len;
+        enc = next;
+        bytes += len;
+    }
+    t_enc = now_ns() - start;
+    n_pages++;
+
+    /* Decode every page in one go, up to the 0xff of its unused end */
+    memset(back, 0, n * sizeof(struct sale));
+    k = 0;
+    start = now_ns();
+    for(p=0; p<n_pages; p++) {
+        sales_decoder_reset(&dec);
+        got = sales_decode(&dec, &pages[(size_t)p * page_size], page_size, &back[k], n - k, &used);
+        k += (got > 0) ? got : 0;
+        if((used == page_size) || (sales_decode(&dec, &pages[(size_t)p * page_size + used], page_size - used,
+                                                &extra, 1, &off) == -EBADMSG)) {
+            continue;       // Full page, or the decoder stays stopped at the first 0xff
+        }
+        if(failed++ < 5) {
+            printf("page %d: decoding does not stop at the end of the records\n", p);
+        }
+    }
+    t_dec = now_ns() - start;
+    if(k != n) {
+        printf("%d sales decoded from whole pages, %d encoded\n", k, n);
+        failed++;
+    }
+
+    /* Decode again as a stream in pieces of 1 to 16 bytes, the way the records arrive */
+    memset(back, 0, n * sizeof(struct sale));
+    k = 0;
+    for(p=0; p<n_pages; p++) {
+        sales_decoder_reset(&dec);
+        for(off=0; off<page_used[p]; off+=used) {
+            chunk = 1 + rand() % 16;
+            if(chunk > page_used[p] - off) {
+                chunk = page_used[p] - off;
+            }
+            got = sales_decode(&dec, &pages[(size_t)p * page_size + off], chunk, &back[k], n - k, &used);
+            if(got < 0) {
+                printf("page %d: bad record at byte %d\n", p, off + used);
+                return 1;
+            }
+            k += got;
+        }
+        if(dec.hdr != 0) {
+            printf("page %d: ends in the middle of a record\n", p);
+            failed++;
+        }
+    }
+    if(k != n) {
+        printf("%d sales decoded, %d encoded\n", k, n);
+        failed++;
+    }
+    for(i=0; i<k; i++) {
+        if(!same_sale(&sales[i], &back[i]) && (failed++ < 5)) {
+            printf("sale %d does not decode to the same record\n", i);
+        }
+    }
+
+    printf("%d sales, %d byte pages\n", n, page_size);
+    printf("struct sale: %zu bytes per sale, %zu per page, %zu pages\n", sizeof(struct sale),
+           page_size / sizeof(struct sale), (n * sizeof(struct sale) + page_size - 1) / page_size);
+    printf("encoded:     %.2f bytes per sale, %.1f per page, %d pages (%.1fx fewer erases)\n",
+           (double)bytes / n, (double)n / n_pages, n_pages,
+           (double)((n * sizeof(struct sale) + page_size - 1) / page_size) / n_pages);
+    printf("encode %.1f ns, decode %.1f ns, struct copy %.1f ns per sale\n",
+           (double)t_enc / n, (double)t_dec / n, (double)t_raw / n);
+    printf("round trip: %d wrong\n", failed);
+    free(sales);
+    free(back);
+    free(pages);
+    free(page_used);
+    return (failed == 0) ? 0 : 1;
+}
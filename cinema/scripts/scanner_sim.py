@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Barcode scanner simulator for the door validator (see src/gate.h).
+
+Sends ticket codes signed like the kiosks sign them (src/ticket_sign.c)
+at the line rate of a scanner on the given baud rate:
+
+    west build -b native_posix -- -DOVERLAY_CONFIG=gate.conf
+    scripts/scanner_sim.py /dev/pts/N --tickets 20000 --repeat 10 --forged 2
+
+--repeat scans a share of the tickets again (the door must refuse them)
+and --forged sends codes with a changed price. Run with the key the
+firmware was built with (CONFIG_CINEMA_SIGN_KEY). The expected counts
+are printed at the end, to compare with the "gate" stats group.
+
+Only uses the standard library.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import pty
+import random
+import struct
+import sys
+import time
+import tty
+
+BITS_PER_CHAR = 10      # 8N1
+
+
+def code(key, kiosk, seq, versao, session, price, forged=False):
+    """Text of the QR code of a ticket."""
+    msg = struct.pack("<BI", kiosk, seq).ljust(64, b"\0") + struct.pack("<IHB", versao, session, price)
+    sig = hmac.new(key, msg, hashlib.sha256).hexdigest()[:16]
+    if forged:
+        price += 1
+    return "CINEMA3000/%d/%06u/%u/%d/%d/%s" % (kiosk, seq, versao, session, price, sig)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("tty", nargs="?", help="pseudotty or serial port of the machine")
+    parser.add_argument("--pty", action="store_true", help="open a new pseudotty")
+    parser.add_argument("--key", default="cinema3000-demo-key", help="signature key")
+    parser.add_argument("--tickets", type=int, default=1000, help="different tickets to scan")
+    parser.add_argument("--repeat", type=float, default=0, help="share of scans of a ticket already scanned, percent")
+    parser.add_argument("--forged", type=float, default=0, help="share of forged codes, percent")
+    parser.add_argument("--baud", type=int, default=9600, help="scanner baud rate, sets the line rate")
+    parser.add_argument("--seed", type=int, help="random seed, for repeatable runs")
+    args = parser.parse_args()
+
+    if args.pty:
+        fd, slave = pty.openpty()
+        tty.setraw(slave)
+        print("Scanner on", os.ttyname(slave), flush=True)
+        input("Press Enter to start")
+    elif args.tty:
+        fd = os.open(args.tty, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(fd)
+    else:
+        parser.error("give a tty or --pty")
+
+    rng = random.Random(args.seed)
+    key = args.key.encode()
+    counts = {"admitted": 0, "used": 0, "invalid": 0}
+    started = due = time.monotonic()
+    sent = 0
+    seq = 0
+    try:
+        while seq < args.tickets:
+            roll = rng.uniform(0, 100)
+            if seq > 0 and roll < args.repeat:
+                line = code(key, 0, rng.randrange(seq), 1, 4, 7)
+                counts["used"] += 1
+            elif roll < args.repeat + args.forged:
+                line = code(key, 0, args.tickets + rng.randrange(1 << 20), 1, 4, 7, forged=True)
+                counts["invalid"] += 1
+            else:
+                line = code(key, 0, seq, 1, 4, 7)
+                seq += 1
+                counts["admitted"] += 1
+            data = (line + "\r\n").encode()
+            os.write(fd, data)
+            sent += 1
+            # Paced at the wire speed, back to back as a scanner in continuous mode
+            due += len(data) * BITS_PER_CHAR / args.baud
+            time.sleep(max(0, due - time.monotonic()))
+    except KeyboardInterrupt:
+        pass
+    elapsed = time.monotonic() - started
+    print("%d scans in %.1f s (%.1f/s): expect admitted %d, used %d, invalid %d"
+          % (sent, elapsed, sent / elapsed if elapsed else 0, counts["admitted"], counts["used"], counts["invalid"]))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,225 @@
+/** @file sign_check.c
+ * @brief Host check and benchmark of the software signature path
+ *
+ *     cc -O2 -Isrc -o sign_check scripts/sign_check.c src/sign_sw.c src/hmac.c
+ *     ./sign_check [signatures]
+ *
+ * Checks src/sign_sw.c against the FIPS 180-4 SHA-256 examples and
+ * src/hmac.c against the RFC 4231 HMAC-SHA256 test cases, then times a
+ * ticket signature computed from scratch and from a precomputed id, as
+ * ticket_sign.c does. Exits with 1 when a vector does not match.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hmac.h"
+
+/* Defines */
+#define DEFAULT_SIGNATURES 100000
+#define TAIL_LEN 7
+
+/* Structure of one test vector, data in hex */
+struct vector {
+    const char *key;            // NULL for plain SHA-256
+    const char *data;
+    const char *digest;         // Expected digest, may be truncated
+};
+
+static const struct vector vectors[] = {
+    /* FIPS 180-4 examples */
+    { NULL, "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { NULL, "616263", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { NULL, "6162636462636465636465666465666765666768666768696768696a68696a6b696a6b6c6a6b6c6d6b6c6d6e6c6d6e6f6d6e6f706e6f7071",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    /* RFC 4231 test cases 1, 2, 3, 4, 5 (truncated to 128 bits), 6 and 7 */
+    { "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", "4869205468657265",
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { "4a656665", "7768617420646f2079612077616e7420666f72206e6f7468696e673f",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd",
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+    { "0102030405060708090a0b0c0d0e0f10111213141516171819",
+      "cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd",
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+    { "0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c", "546573742057697468205472756e636174696f6e",
+      "a3b6167473100ee06e0c796c2955552b" },
+    { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "54657374205573696e67204c6172676572205468616e20426c6f636b2d53697a65204b6579202d2048617368204b6579204669727374",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "5468697320697320612074657374207573696e672061206c6172676572207468616e20626c6f636b2d73697a65206b657920616e642061206c6172676572207468616e20626c6f636b2d73697a6520646174612e20546865206b6579206e6565647320746f20626520686173686564206265666f7265206265696e6720757365642062792074686520484d414320616c676f726974686d2e",
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+};
+
+/**
+ * @brief Brief decription of now_ns().
+ *
+ * @return Monotonic time in nanoseconds
+ *
+ */
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Brief decription of unhex().
+ *
+ * @param *hex  Hex string
+ * @param *out  strlen(hex) / 2 bytes
+ *
+ * @return Number of bytes
+ *
+ */
+static size_t unhex(const char *hex, uint8_t *out) {
+    size_t i, n = strlen(hex) / 2;
+    unsigned int b;
+
+    for(i=0; i<n; i++) {
+        sscanf(&hex[2*i], "%2x", &b);
+        out[i] = b;
+    }
+    return n;
+}
+
+/**
+ * @brief Brief decription of check_vector().
+ *
+ * @param *v  Test vector
+ *
+ * @return 0 if the digest matches, -1 otherwise
+ *
+ */
+static int check_vector(const struct vector *v) {
+    static uint8_t key[256], data[256], expected[SIGN_HASH_LEN];
+    uint8_t digest[SIGN_HASH_LEN];
+    struct hmac_key k;
+    sign_hash_ctx ctx;
+    size_t key_len, data_len, n, i;
+
+    data_len = unhex(v->data, data);
+    n = unhex(v->digest, expected);
+    if(v->key == NULL) {
+        /* Also in uneven pieces, to go through the partial block buffer */
+        sign_hash_init(&ctx);
+        for(i=0; i<data_len; i+=7) {
+            sign_hash_update(&ctx, &data[i], (data_len - i < 7) ? data_len - i : 7);
+        }
+        sign_hash_final(&ctx, digest);
+    } else {
+        key_len = unhex(v->key, key);
+        hmac_setkey(&k, key, key_len);
+        hmac_start(&k, &ctx);
+        sign_hash_update(&ctx, data, data_len);
+        hmac_finish(&k, &ctx, digest);
+    }
+    return (memcmp(digest, expected, n) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Brief decription of check_million().
+ *
+ * FIPS 180-4 example with one million 'a'
+ *
+ * @return 0 if the digest matches, -1 otherwise
+ *
+ */
+static int check_million(void) {
+    static const char *expected = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+    uint8_t block[1000], digest[SIGN_HASH_LEN], want[SIGN_HASH_LEN];
+    sign_hash_ctx ctx;
+    int i;
+
+    memset(block, 'a', sizeof(block));
+    sign_hash_init(&ctx);
+    for(i=0; i<1000; i++) {
+        sign_hash_update(&ctx, block, sizeof(block));
+    }
+    sign_hash_final(&ctx, digest);
+    unhex(expected, want);
+    return (memcmp(digest, want, SIGN_HASH_LEN) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Brief decription of sign_id().
+ *
+ * Block 0 of a ticket message, as in ticket_sign.c
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sign_id(const struct hmac_key *k, uint32_t seq, sign_hash_ctx *ctx) {
+    uint8_t block[SIGN_BLOCK_LEN];
+
+    memset(block, 0, sizeof(block));
+    block[1] = seq;
+    block[2] = seq >> 8;
+    block[3] = seq >> 16;
+    block[4] = seq >> 24;
+    hmac_start(k, ctx);
+    sign_hash_update(ctx, block, sizeof(block));
+}
+
+int main(int argc, char **argv) {
+    static const char secret[] = "cinema3000-demo-key";
+    static const uint8_t tail[TAIL_LEN] = { 1, 0, 0, 0, 4, 0, 7 };     // Version 1, session 4, 7 euros
+    int signatures = (argc > 1) ? atoi(argv[1]) : DEFAULT_SIGNATURES;
+    uint8_t mac[SIGN_HASH_LEN];
+    unsigned int check = 0;
+    long long start, full, precomputed;
+    struct hmac_key k;
+    sign_hash_ctx ctx, ready;
+    int i, failed = 0;
+
+    for(i=0; i<(int)(sizeof(vectors) / sizeof(vectors[0])); i++) {
+        if(check_vector(&vectors[i]) != 0) {
+            printf("vector %d does not match\n", i);
+            failed++;
+        }
+    }
+    if(check_million() != 0) {
+        printf("one million 'a' does not match\n");
+        failed++;
+    }
+    printf("%d of %d vectors failed\n", failed, (int)(sizeof(vectors) / sizeof(vectors[0])) + 1);
+
+    hmac_setkey(&k, (const uint8_t *)secret, sizeof(secret) - 1);
+    start = now_ns();
+    for(i=0; i<signatures; i++) {
+        sign_id(&k, i, &ctx);
+        sign_hash_update(&ctx, tail, TAIL_LEN);
+        hmac_finish(&k, &ctx, mac);
+        check += mac[0];
+    }
+    full = now_ns() - start;
+
+    sign_id(&k, 0, &ready);
+    start = now_ns();
+    for(i=0; i<signatures; i++) {
+        ctx = ready;
+        sign_hash_update(&ctx, tail, TAIL_LEN);
+        hmac_finish(&k, &ctx, mac);
+        check += mac[0];
+    }
+    precomputed = now_ns() - start;
+
+    printf("%d signatures: %.2f us from scratch, %.2f us from a precomputed id (check %u)\n",
+           signatures, full / 1e3 / signatures, precomputed / 1e3 / signatures, check);
+    printf("ticket 0, version 1, session 4, 7 euros, key \"%s\": ", secret);
+    for(i=0; i<8; i++) {
+        printf("%02x", mac[i]);
+    }
+    printf("\n");
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/** @file analytics.c
+ * @brief Rolling sales analytics in fixed memory
+ *
+ * Revenue, tickets and inserted coins are aggregated per hour in a ring of
+ * CONFIG_CINEMA_ANALYTICS_HOURS buckets, and revenue and tickets per session
+ * of the catalog on sale in CONFIG_CINEMA_ANALYTICS_SESSIONS counters.
+ * Updates are O(1) and nothing is allocated. Per session counters restart
+ * when the catalog version changes, since session ids change with it.
+ * The 16-bit counters stop at UINT16_MAX instead of wrapping, so a full
+ * counter reads as "at least" that many.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <spinlock.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "analytics.h"
+
+/* Defines */
+#define N_HOURS CONFIG_CINEMA_ANALYTICS_HOURS
+#define N_SESSIONS CONFIG_CINEMA_ANALYTICS_SESSIONS
+#define MS_PER_HOUR (60 * 60 * 1000)
+
+static struct hour_bucket hours[N_HOURS];
+static struct session_bucket sessions[N_SESSIONS];
+static uint32_t sessions_versao = 0;
+static struct k_spinlock analytics_lock;
+
+/**
+ * @brief Brief decription of current_bucket().
+ *
+ * Bucket of the current hour, recycling the bucket of the same hour
+ * N_HOURS ago. Must be called with analytics_lock held
+ *
+ * @return Pointer to the bucket of this hour
+ *
+ */
+static struct hour_bucket *current_bucket(void) {
+    uint32_t now = k_uptime_get() / MS_PER_HOUR;
+    struct hour_bucket *bucket = &hours[now % N_HOURS];
+
+    if(bucket->hour != now) {
+        memset(bucket, 0, sizeof(*bucket));
+        bucket->hour = now;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Brief decription of bucket_used().
+ *
+ * @param *bucket  Hourly bucket
+ *
+ * @return true if a ticket was sold or a coin inserted in that hour
+ *
+ */
+static bool bucket_used(const struct hour_bucket *bucket) {
+    int c;
+
+    for(c=0; c<N_COINS; c++) {
+        if(bucket->coins[c] > 0) {
+            return true;
+        }
+    }
+    return bucket->tickets > 0;
+}
+
+/**
+ * @brief Brief decription of analytics_sale().
+ *
+ * Accounts one ticket sold
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param price    Price paid in euros
+ *
+ * @return Doesn't return anything
+ *
+ */
+void analytics_sale(uint32_t versao, int session, int price) {
+    k_spinlock_key_t key = k_spin_lock(&analytics_lock);
+    struct hour_bucket *bucket = current_bucket();
+
+    bucket->tickets = MIN(bucket->tickets + 1, UINT16_MAX);
+    bucket->revenue += price;
+
+    if(versao != sessions_versao) {
+        memset(sessions, 0, sizeof(sessions));
+        sessions_versao = versao;
+    }
+    if(session < N_SESSIONS) {
+        sessions[session].session = session;
+        sessions[session].tickets = MIN(sessions[session].tickets + 1, UINT16_MAX);
+        sessions[session].revenue += price;
+    }
+    k_spin_unlock(&analytics_lock, key);
+}
+
+/**
+ * @brief Brief decription of analytics_coin().
+ *
+ * Accounts one coin inserted
+ *
+ * @param coin  Coin type, COIN_x
+ *
+ * @return Doesn't return anything
+ *
+ */
+void analytics_coin(int coin) {
+    k_spinlock_key_t key = k_spin_lock(&analytics_lock);
+    struct hour_bucket *bucket = current_bucket();
+
+    bucket->coins[coin] = MIN(bucket->coins[coin] + 1, UINT16_MAX);
+    k_spin_unlock(&analytics_lock, key);
+}
+
+/**
+ * @brief Brief decription of analytics_hours().
+ *
+ * Copies the hourly buckets, newest first. Hours older than
+ * N_HOURS or without activity are not returned
+ *
+ * @param *out  Buffer for the buckets
+ * @param max   Size of out, in buckets
+ *
+ * @return Number of buckets copied
+ *
+ */
+int analytics_hours(struct hour_bucket *out, int max) {
+    k_spinlock_key_t key = k_spin_lock(&analytics_lock);
+    uint32_t now = k_uptime_get() / MS_PER_HOUR;
+    struct hour_bucket *bucket;
+    int i, n = 0;
+
+    for(i=0; (i<N_HOURS) && (i<=now) && (n<max); i++) {
+        bucket = &hours[(now - i) % N_HOURS];
+        if((bucket->hour == now - i) && bucket_used(bucket)) {
+            out[n++] = *bucket;
+        }
+    }
+    k_spin_unlock(&analytics_lock, key);
+    return n;
+}
+
+/**
+ * @brief Brief decription of analytics_sessions().
+ *
+ * Copies the counters of the sessions that sold tickets
+ *
+ * @param *versao  Catalog version the session ids refer to
+ * @param *out     Buffer for the counters
+ * @param max      Size of out, in counters
+ *
+ * @return Number of counters copied
+ *
+ */
+int analytics_sessions(uint32_t *versao, struct session_bucket *out, int max) {
+    k_spinlock_key_t key = k_spin_lock(&analytics_lock);
+    int i, n = 0;
+
+    *versao = sessions_versao;
+    for(i=0; (i<N_SESSIONS) && (n<max); i++) {
+        if(sessions[i].tickets > 0) {
+            out[n++] = sessions[i];
+        }
+    }
+    k_spin_unlock(&analytics_lock, key);
+    return n;
+}
@@ -0,0 +1,37 @@
+/** @file analytics.h
+ * @brief Rolling sales analytics in fixed memory
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <stdint.h>
+
+#include "cinema.h"
+
+/* Structure with the totals of one hour */
+struct hour_bucket {
+    uint32_t hour;              // Hours since boot
+    uint32_t revenue;
+    uint16_t tickets;
+    uint16_t coins[N_COINS];    // Coins inserted, per coin type
+    uint16_t reserved;
+};
+
+/* Structure with the totals of one session */
+struct session_bucket {
+    uint32_t revenue;
+    uint16_t tickets;
+    uint16_t session;           // Session id
+};
+
+void analytics_sale(uint32_t versao, int session, int price);
+void analytics_coin(int coin);
+int analytics_hours(struct hour_bucket *out, int max);
+int analytics_sessions(uint32_t *versao, struct session_bucket *out, int max);
+
+#endif /* ANALYTICS_H */
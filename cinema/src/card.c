@@ -0,0 +1,463 @@
+/** @file card.c
+ * @brief Card payment terminal
+ *
+ * Talks to an external card terminal on the UART chosen as
+ * cinema,card-uart (see card.h for the protocol). Bytes are received and
+ * sent by interrupts; answers and timeouts are handled in the system work
+ * queue, so card_authorize() and card_cancel() return right away and the
+ * state machine polls card_get_event() while it keeps drawing. Up to
+ * CARD_MAX_PENDING requests can be outstanding at the same time.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <sys/printk.h>
+#include <sys/ring_buffer.h>
+#include <stats/stats.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "card.h"
+#include "power.h"
+
+/* Defines */
+#define CARD_UART_NODE DT_CHOSEN(cinema_card_uart)
+#define CARD_MAX_PENDING 4
+#define CARD_LINE_LEN 32
+#define CARD_RX_QUEUE_LEN 4
+#define CARD_TX_BUF_SIZE 128
+#define CARD_TIMEOUT_MS (CONFIG_CINEMA_CARD_TIMEOUT_S * MSEC_PER_SEC)
+
+/* States of a request slot */
+#define SLOT_FREE 0
+#define SLOT_PENDING 1
+#define SLOT_CANCELLING 2   // Cancel sent, waiting for the answer
+
+/* Structure of one outstanding request */
+struct card_request {
+    uint16_t id;
+    uint8_t state;
+    int64_t started;
+};
+
+/* Structure of one received line */
+struct card_rx_line {
+    char text[CARD_LINE_LEN];
+};
+
+static const struct device * card_dev = DEVICE_DT_GET(CARD_UART_NODE);
+
+static struct card_request requests[CARD_MAX_PENDING];
+static uint16_t next_id = 1;
+static struct k_spinlock lock;      // Protects requests[], next_id and the TX ring
+
+K_MSGQ_DEFINE(card_rx_msgq, sizeof(struct card_rx_line), CARD_RX_QUEUE_LEN, 1);
+K_MSGQ_DEFINE(card_events, sizeof(struct card_event), CARD_MAX_PENDING, 4);
+static struct card_rx_line rx_line;
+static int rx_len = 0;
+
+RING_BUF_DECLARE(card_tx_ring, CARD_TX_BUF_SIZE);
+
+static void card_rx_handler(struct k_work *work);
+static void card_timeout_handler(struct k_work *work);
+static K_WORK_DEFINE(card_rx_work, card_rx_handler);
+static K_WORK_DELAYABLE_DEFINE(card_timeout_work, card_timeout_handler);
+
+/* Card terminal stats */
+STATS_SECT_START(card_stats)
+STATS_SECT_ENTRY32(requests)
+STATS_SECT_ENTRY32(approved)
+STATS_SECT_ENTRY32(declined)
+STATS_SECT_ENTRY32(cancelled)
+STATS_SECT_ENTRY32(timeouts)
+STATS_SECT_ENTRY32(reversals)
+STATS_SECT_ENTRY32(latency_sum_ms)
+STATS_SECT_ENTRY32(latency_max_ms)
+STATS_SECT_END;
+
+STATS_SECT_DECL(card_stats) card_stats;
+
+STATS_NAME_START(card_stats)
+STATS_NAME(card_stats, requests)
+STATS_NAME(card_stats, approved)
+STATS_NAME(card_stats, declined)
+STATS_NAME(card_stats, cancelled)
+STATS_NAME(card_stats, timeouts)
+STATS_NAME(card_stats, reversals)
+STATS_NAME(card_stats, latency_sum_ms)
+STATS_NAME(card_stats, latency_max_ms)
+STATS_NAME_END(card_stats);
+
+/**
+ * @brief Brief decription of card_send().
+ *
+ * Queues one line for transmission, must be called with lock held
+ *
+ * @param *line  Line, with its '\n'
+ *
+ * @return 0 on success, -ENOBUFS if the TX ring buffer is full
+ *
+ */
+static int card_send(const char *line) {
+    uint32_t len = strlen(line);
+
+    if(ring_buf_space_get(&card_tx_ring) < len) {
+        return -ENOBUFS;
+    }
+    ring_buf_put(&card_tx_ring, (const uint8_t *)line, len);
+    uart_irq_tx_enable(card_dev);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of find_request().
+ *
+ * @param id  Request id
+ *
+ * @return Slot of the request, NULL if it is not outstanding
+ *
+ */
+static struct card_request *find_request(int id) {
+    int i;
+
+    for(i=0; i<CARD_MAX_PENDING; i++) {
+        if((requests[i].state != SLOT_FREE) && (requests[i].id == id)) {
+            return &requests[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Brief decription of schedule_timeout().
+ *
+ * Schedules the timeout work for the oldest outstanding request,
+ * must be called with lock held
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void schedule_timeout(void) {
+    int64_t oldest = INT64_MAX;
+    int i;
+
+    for(i=0; i<CARD_MAX_PENDING; i++) {
+        if((requests[i].state != SLOT_FREE) && (requests[i].started < oldest)) {
+            oldest = requests[i].started;
+        }
+    }
+    if(oldest != INT64_MAX) {
+        k_work_reschedule(&card_timeout_work, K_MSEC(MAX(oldest + CARD_TIMEOUT_MS - k_uptime_get(), 0)));
+    }
+}
+
+/**
+ * @brief Brief decription of finish().
+ *
+ * Frees a request slot and reports its result, must be called with lock held
+ *
+ * @param *req    Request
+ * @param result  CARD_x
+ * @param auth    Authorisation code
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void finish(struct card_request *req, int result, uint32_t auth) {
+    struct card_event event = { .id = req->id, .result = result, .auth = auth };
+    uint32_t latency = k_uptime_get() - req->started;
+
+    STATS_INCN(card_stats, latency_sum_ms, latency);
+    if(latency > card_stats.latency_max_ms) {
+        STATS_SET(card_stats, latency_max_ms, latency);
+    }
+    req->state = SLOT_FREE;
+    /* One event slot per request slot, never full */
+    k_msgq_put(&card_events, &event, K_NO_WAIT);
+    power_activity();   // Wake the state machine to handle the result
+}
+
+/**
+ * @brief Brief decription of reverse().
+ *
+ * Asks the terminal to reverse an approval, must be called with lock held
+ *
+ * @param id  Request id
+ *
+ * @return 0 on success, -ENOBUFS if the reversal could not be queued
+ *
+ */
+static int reverse(int id) {
+    char line[CARD_LINE_LEN];
+    int ret;
+
+    snprintf(line, sizeof(line), "R %d\n", id);
+    ret = card_send(line);
+    if(ret == 0) {
+        STATS_INC(card_stats, reversals);
+    }
+    return ret;
+}
+
+/**
+ * @brief Brief decription of card_rx_handler().
+ *
+ * Handles the answers received from the terminal
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void card_rx_handler(struct k_work *work) {
+    struct card_rx_line line;
+    struct card_request *req;
+    k_spinlock_key_t key;
+    char *arg;
+    int id;
+
+    ARG_UNUSED(work);
+
+    while(k_msgq_get(&card_rx_msgq, &line, K_NO_WAIT) == 0) {
+        arg = strchr(line.text, ' ');
+        if(arg == NULL) {
+            continue;
+        }
+        *arg++ = '\0';
+        id = strtol(arg, &arg, 10);
+
+        key = k_spin_lock(&lock);
+        req = find_request(id);
+        if(strcmp(line.text, "OK") == 0) {
+            if(req != NULL) {
+                STATS_INC(card_stats, approved);
+                finish(req, CARD_APPROVED, strtoul(arg, NULL, 10));
+            } else {
+                /* Approved after the timeout, the customer got nothing */
+                reverse(id);
+            }
+        } else if((req != NULL) && (strcmp(line.text, "NO") == 0)) {
+            STATS_INC(card_stats, declined);
+            finish(req, CARD_DECLINED, 0);
+        } else if((req != NULL) && (strcmp(line.text, "CX") == 0)) {
+            STATS_INC(card_stats, cancelled);
+            finish(req, CARD_CANCELLED, 0);
+        }
+        k_spin_unlock(&lock, key);
+    }
+}
+
+/**
+ * @brief Brief decription of card_timeout_handler().
+ *
+ * Gives up on the requests the terminal did not answer in time
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void card_timeout_handler(struct k_work *work) {
+    char line[CARD_LINE_LEN];
+    k_spinlock_key_t key;
+    int64_t now = k_uptime_get();
+    int i;
+
+    ARG_UNUSED(work);
+
+    key = k_spin_lock(&lock);
+    for(i=0; i<CARD_MAX_PENDING; i++) {
+        if((requests[i].state != SLOT_FREE) && (now - requests[i].started >= CARD_TIMEOUT_MS)) {
+            snprintf(line, sizeof(line), "C %d\n", requests[i].id);
+            card_send(line);
+            STATS_INC(card_stats, timeouts);
+            finish(&requests[i], CARD_TIMEOUT, 0);
+        }
+    }
+    schedule_timeout();
+    k_spin_unlock(&lock, key);
+}
+
+/**
+ * @brief Brief decription of card_authorize().
+ *
+ * Asks the terminal to charge an amount, returns immediately
+ *
+ * @param amount  Amount in euros
+ *
+ * @return Id of the request, -EBUSY if too many requests are outstanding,
+ *         -ENOBUFS if the request could not be queued
+ *
+ */
+int card_authorize(int amount) {
+    char line[CARD_LINE_LEN];
+    k_spinlock_key_t key;
+    int i, id, ret;
+
+    key = k_spin_lock(&lock);
+    for(i=0; (i<CARD_MAX_PENDING) && (requests[i].state != SLOT_FREE); i++) {
+    }
+    if(i == CARD_MAX_PENDING) {
+        k_spin_unlock(&lock, key);
+        return -EBUSY;
+    }
+    id = next_id;
+    snprintf(line, sizeof(line), "A %d %d\n", id, amount * 100);
+    ret = card_send(line);
+    if(ret == 0) {
+        next_id = (next_id == UINT16_MAX) ? 1 : next_id + 1;
+        requests[i].id = id;
+        requests[i].state = SLOT_PENDING;
+        requests[i].started = k_uptime_get();
+        STATS_INC(card_stats, requests);
+        schedule_timeout();
+    }
+    k_spin_unlock(&lock, key);
+    return (ret == 0) ? id : ret;
+}
+
+/**
+ * @brief Brief decription of card_cancel().
+ *
+ * Asks the terminal to cancel a request, its result still comes as an
+ * event (CARD_CANCELLED, or CARD_APPROVED if the payment was already done)
+ *
+ * @param id  Id returned by card_authorize()
+ *
+ * @return 0 on success, -ENOENT if the request is not outstanding,
+ *         -ENOBUFS if the cancel could not be queued
+ *
+ */
+int card_cancel(int id) {
+    char line[CARD_LINE_LEN];
+    struct card_request *req;
+    k_spinlock_key_t key;
+    int ret = -ENOENT;
+
+    key = k_spin_lock(&lock);
+    req = find_request(id);
+    if((req != NULL) && (req->state == SLOT_PENDING)) {
+        snprintf(line, sizeof(line), "C %d\n", id);
+        ret = card_send(line);
+        if(ret == 0) {
+            req->state = SLOT_CANCELLING;
+        }
+    } else if(req != NULL) {
+        ret = 0;    // Already cancelling
+    }
+    k_spin_unlock(&lock, key);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of card_reverse().
+ *
+ * Reverses an approval the state machine did not sell anything for
+ *
+ * @param id  Id of the approved request
+ *
+ * @return 0 on success, -ENOBUFS if the reversal could not be queued
+ *
+ */
+int card_reverse(int id) {
+    k_spinlock_key_t key;
+    int ret;
+
+    key = k_spin_lock(&lock);
+    ret = reverse(id);
+    k_spin_unlock(&lock, key);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of card_get_event().
+ *
+ * Result of a finished request, never waits
+ *
+ * @param *event  Filled with the result
+ *
+ * @return 0 if there was a result, -EAGAIN otherwise
+ *
+ */
+int card_get_event(struct card_event *event) {
+    return (k_msgq_get(&card_events, event, K_NO_WAIT) == 0) ? 0 : -EAGAIN;
+}
+
+/**
+ * @brief Brief decription of card_uart_isr().
+ *
+ * UART interrupt: splits the received bytes in lines and feeds the
+ * transmitter from the ring buffer
+ *
+ * @param *dev        UART device
+ * @param *user_data  Unused
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void card_uart_isr(const struct device *dev, void *user_data) {
+    uint8_t c, *data;
+    uint32_t len;
+
+    ARG_UNUSED(user_data);
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(uart_irq_rx_ready(dev)) {
+            while(uart_fifo_read(dev, &c, 1) == 1) {
+                if((c == '\n') || (c == '\r')) {
+                    /* Lines that do not fit in the queue are dropped, the request times out */
+                    if(rx_len > 0) {
+                        rx_line.text[rx_len] = '\0';
+                        if(k_msgq_put(&card_rx_msgq, &rx_line, K_NO_WAIT) == 0) {
+                            k_work_submit(&card_rx_work);
+                        }
+                    }
+                    rx_len = 0;
+                } else if(rx_len < CARD_LINE_LEN - 1) {
+                    rx_line.text[rx_len++] = c;
+                }
+            }
+        }
+        if(uart_irq_tx_ready(dev)) {
+            len = ring_buf_get_claim(&card_tx_ring, &data, CARD_TX_BUF_SIZE);
+            if(len == 0) {
+                uart_irq_tx_disable(dev);
+            } else {
+                len = uart_fifo_fill(dev, data, len);
+                ring_buf_get_finish(&card_tx_ring, len);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of card_init().
+ *
+ * Enables the card terminal UART interrupts and registers the stats
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int card_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(card_dev)) {
+        printk("Error: card terminal uart is not ready\n");
+        return -ENODEV;
+    }
+    uart_irq_callback_user_data_set(card_dev, card_uart_isr, NULL);
+    uart_irq_rx_enable(card_dev);
+    return stats_init_and_reg(STATS_HDR(card_stats), STATS_SIZE_32, 8,
+                              STATS_NAME_INIT_PARMS(card_stats), "card");
+}
+
+SYS_INIT(card_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
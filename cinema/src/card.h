@@ -0,0 +1,51 @@
+/** @file card.h
+ * @brief Card payment terminal
+ *
+ * Text protocol on the card terminal UART, one request or answer per
+ * line ending in '\n'. Requests carry an id chosen by the machine and
+ * several requests may be outstanding; answers can come in any order.
+ *
+ *     machine  -> terminal   A <id> <amount in cents>   authorise
+ *                            C <id>                     cancel a pending request
+ *                            R <id>                     reverse an approval nothing was sold for
+ *     terminal -> machine    OK <id> <auth code>        approved
+ *                            NO <id>                    declined
+ *                            CX <id>                    cancelled
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CARD_H
+#define CARD_H
+
+#include <errno.h>
+#include <stdint.h>
+
+/* Results of a request */
+#define CARD_APPROVED 0
+#define CARD_DECLINED 1
+#define CARD_CANCELLED 2
+#define CARD_TIMEOUT 3
+
+/* Structure reported to the state machine when a request ends */
+struct card_event {
+    uint16_t id;
+    uint8_t result;     // CARD_x
+    uint32_t auth;      // Authorisation code, when approved
+};
+
+#ifdef CONFIG_CINEMA_CARD
+int card_authorize(int amount);
+int card_cancel(int id);
+int card_reverse(int id);
+int card_get_event(struct card_event *event);
+#else
+static inline int card_authorize(int amount) { return -ENOTSUP; }
+static inline int card_cancel(int id) { return -ENOTSUP; }
+static inline int card_reverse(int id) { return -ENOTSUP; }
+static inline int card_get_event(struct card_event *event) { return -EAGAIN; }
+#endif
+
+#endif /* CARD_H */
@@ -0,0 +1,40 @@
+/** @file catalog.c
+ * @brief Catalog of movies and sessions
+ *
+ * Catalog compiled into the image, used at boot when there is no
+ * catalog blob in flash. Its prices are compiled at boot
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <sys/util.h>
+
+#include "catalog.h"
+
+static const char default_strings[] = "Filme A\0Filme B";
+
+static const struct movie default_movies[] = {
+    {0, 0, 3},      // Filme A
+    {8, 3, 2}       // Filme B
+};
+
+static const struct session default_sessoes[] = {
+    {19,9},
+    {21,11},
+    {23,9},
+    {19,10},
+    {21,12}
+};
+
+const struct catalog default_catalog = {
+    .versao = 1,
+    .n_movies = ARRAY_SIZE(default_movies),
+    .n_sessions = ARRAY_SIZE(default_sessoes),
+    .movies = default_movies,
+    .sessoes = default_sessoes,
+    .strings = default_strings,
+    .prices = NULL
+};
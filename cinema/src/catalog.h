@@ -0,0 +1,100 @@
+/** @file catalog.h
+ * @brief Catalog of movies and sessions
+ *
+ * A catalog is a flat view over records: movies, sessions, a string pool
+ * with the movie names and the compiled price table. The records may live
+ * in RAM (built-in or uploaded catalogs) or in place in flash (catalog blob),
+ * the state machine does not know the difference.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+
+/* Defines */
+#define MAX_MOVIES 2        // Maximum number of movies of a catalog held in RAM
+#define MAX_SESSIONS 3      // Maximum number of session for one movie, in RAM
+#define MAX_NAME 16         // Maximum length of a movie name, with terminator
+#define MAX_SESSION_IDS (MAX_MOVIES * MAX_SESSIONS)
+#define MAX_PRICE UINT8_MAX // Highest price, sales, tickets and their signature keep it in one byte
+
+/* Ticket types, columns of the price table */
+#define TICKET_NORMAL 0
+#define TICKET_STUDENT 1
+#define TICKET_SENIOR 2
+#define TICKET_BUNDLE 3     // Price of each ticket of a group purchase
+#define N_TICKET_TYPES 4
+
+/* Structure to define hours and price for each session */
+struct session {
+    int32_t horas;
+    int32_t custo;
+};
+
+/* Structure to define one movie, its sessions are consecutive */
+struct movie {
+    uint32_t nome;          // Offset of the name in the string pool
+    uint16_t first;         // Session id of the first session
+    uint16_t n_sessoes;
+};
+
+/* Structure with every movie on sale */
+struct catalog {
+    uint32_t versao;
+    int n_movies;
+    int n_sessions;
+    const struct movie *movies;
+    const struct session *sessoes;
+    const char *strings;
+    const int16_t (*prices)[N_TICKET_TYPES];   // [session id][ticket type]
+};
+
+extern const struct catalog default_catalog;
+
+/**
+ * @brief Brief decription of movie_nome().
+ *
+ * @param *cat   Catalog
+ * @param movie  Movie index
+ *
+ * @return Name of the movie
+ *
+ */
+static inline const char *movie_nome(const struct catalog *cat, int movie) {
+    return &cat->strings[cat->movies[movie].nome];
+}
+
+/**
+ * @brief Brief decription of session_id().
+ *
+ * @param *cat    Catalog
+ * @param movie   Movie index
+ * @param sessao  Session index inside the movie
+ *
+ * @return Session id, index of the session in the catalog
+ *
+ */
+static inline int session_id(const struct catalog *cat, int movie, int sessao) {
+    return cat->movies[movie].first + sessao;
+}
+
+/**
+ * @brief Brief decription of movie_session().
+ *
+ * @param *cat    Catalog
+ * @param movie   Movie index
+ * @param sessao  Session index inside the movie
+ *
+ * @return Pointer to the session record
+ *
+ */
+static inline const struct session *movie_session(const struct catalog *cat, int movie, int sessao) {
+    return &cat->sessoes[session_id(cat, movie, sessao)];
+}
+
+#endif /* CATALOG_H */
@@ -0,0 +1,190 @@
+/** @file catalog_blob.c
+ * @brief Binary catalog blob stored in its own flash partition
+ *
+ * The blob is read in place: the catalog view points straight at the
+ * records in memory-mapped flash, nothing is copied or parsed into RAM.
+ * Opening checks the header and every offset and count inside the movie
+ * and session records, so no record can point outside the blob; it reads
+ * the records once but copies nothing. The CRC of the whole blob is only
+ * checked when catalog_blob_verify() is called (or at boot with
+ * CONFIG_CINEMA_CATALOG_BLOB_VERIFY).
+ *
+ * On native_posix the partition lives in the flash simulator, whose
+ * backing memory is used as the mapping.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <device.h>
+#include <devicetree.h>
+#include <sys/crc.h>
+#include <sys/printk.h>
+#ifdef CONFIG_FLASH_SIMULATOR
+#include <drivers/flash/flash_simulator.h>
+#endif
+
+#include "catalog_blob.h"
+
+/* Defines */
+#if DT_NODE_EXISTS(DT_NODELABEL(catalog_partition))
+#define BLOB_PARTITION DT_NODELABEL(catalog_partition)
+#else
+#define BLOB_PARTITION DT_NODELABEL(storage_partition)
+#endif
+#define BLOB_OFFSET DT_REG_ADDR(BLOB_PARTITION)
+#define BLOB_MAX_SIZE DT_REG_SIZE(BLOB_PARTITION)
+#define BLOB_ALIGN 4
+#define BLOB_MAX_HORAS 23
+
+/* View over the records in flash */
+static struct catalog blob_catalog;
+static const struct blob_header *blob = NULL;
+
+/**
+ * @brief Brief decription of blob_base().
+ *
+ * Address of the catalog partition in the memory map
+ *
+ * @return Pointer to the first byte of the partition
+ *
+ */
+static const uint8_t *blob_base(void) {
+#ifdef CONFIG_FLASH_SIMULATOR
+    size_t size;
+    /* partition -> partitions -> flash -> flash controller */
+    const struct device *flash_dev = DEVICE_DT_GET(DT_PARENT(DT_GPARENT(BLOB_PARTITION)));
+
+    return (const uint8_t *)flash_simulator_get_memory(flash_dev, &size) + BLOB_OFFSET;
+#else
+    return (const uint8_t *)(CONFIG_FLASH_BASE_ADDRESS + BLOB_OFFSET);
+#endif
+}
+
+/**
+ * @brief Brief decription of section_ok().
+ *
+ * Checks that a section is aligned and inside the blob
+ *
+ * @param *hdr  Blob header
+ * @param off   Offset of the section
+ * @param len   Size of the section in bytes
+ *
+ * @return true if the section is valid
+ *
+ */
+static bool section_ok(const struct blob_header *hdr, uint32_t off, uint32_t len) {
+    return ((off % BLOB_ALIGN) == 0) && (off >= sizeof(*hdr)) && (off <= hdr->size) && (len <= hdr->size - off);
+}
+
+/**
+ * @brief Brief decription of records_ok().
+ *
+ * Checks the fields of the records that index other parts of the blob:
+ * movie names inside the string pool, movie sessions inside the session
+ * table, session hours and prices in range (0 to MAX_PRICE)
+ *
+ * @param *hdr  Blob header, with its sections already checked
+ *
+ * @return true if every record is valid
+ *
+ */
+static bool records_ok(const struct blob_header *hdr) {
+    const struct movie *movies = (const struct movie *)((const uint8_t *)hdr + hdr->movies_off);
+    const struct session *sessoes = (const struct session *)((const uint8_t *)hdr + hdr->sessions_off);
+    const int16_t *prices = (const int16_t *)((const uint8_t *)hdr + hdr->prices_off);
+    uint32_t strings_len = hdr->size - hdr->strings_off;
+    uint32_t i;
+
+    for(i=0; i<hdr->n_movies; i++) {
+        if((movies[i].nome >= strings_len) || (movies[i].first > hdr->n_sessions) ||
+           (movies[i].n_sessoes > hdr->n_sessions - movies[i].first)) {
+            return false;
+        }
+    }
+    for(i=0; i<hdr->n_sessions; i++) {
+        if((sessoes[i].horas < 0) || (sessoes[i].horas > BLOB_MAX_HORAS)) {
+            return false;
+        }
+    }
+    for(i=0; i<hdr->n_sessions * N_TICKET_TYPES; i++) {
+        if((prices[i] < 0) || (prices[i] > MAX_PRICE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Brief decription of catalog_blob_open().
+ *
+ * Checks the header and the records of the blob and builds the view over them
+ *
+ * @return Pointer to the catalog, NULL if the partition has no valid blob
+ *
+ */
+const struct catalog *catalog_blob_open(void) {
+    const struct blob_header *hdr = (const struct blob_header *)blob_base();
+    const char *strings;
+
+    if((hdr->magic != BLOB_MAGIC) || (hdr->format != BLOB_FORMAT) || (hdr->n_types != N_TICKET_TYPES)) {
+        return NULL;
+    }
+    if((hdr->size > BLOB_MAX_SIZE) || (hdr->n_movies == 0) ||
+       (hdr->n_movies > hdr->size) || (hdr->n_sessions > hdr->size) ||
+       !section_ok(hdr, hdr->movies_off, hdr->n_movies * sizeof(struct movie)) ||
+       !section_ok(hdr, hdr->sessions_off, hdr->n_sessions * sizeof(struct session)) ||
+       !section_ok(hdr, hdr->prices_off, hdr->n_sessions * N_TICKET_TYPES * sizeof(int16_t)) ||
+       !section_ok(hdr, hdr->strings_off, 1)) {
+        printk("Error: catalog blob header is not valid\n");
+        return NULL;
+    }
+    /* Names can never run out of the blob */
+    strings = (const char *)hdr + hdr->strings_off;
+    if(strings[hdr->size - hdr->strings_off - 1] != '\0') {
+        printk("Error: catalog blob string pool is not terminated\n");
+        return NULL;
+    }
+    if(!records_ok(hdr)) {
+        printk("Error: catalog blob record out of range\n");
+        return NULL;
+    }
+
+    blob = hdr;
+    if(IS_ENABLED(CONFIG_CINEMA_CATALOG_BLOB_VERIFY) && (catalog_blob_verify() < 0)) {
+        blob = NULL;
+        printk("Error: catalog blob crc mismatch\n");
+        return NULL;
+    }
+
+    blob_catalog.versao = hdr->versao;
+    blob_catalog.n_movies = hdr->n_movies;
+    blob_catalog.n_sessions = hdr->n_sessions;
+    blob_catalog.movies = (const struct movie *)((const uint8_t *)hdr + hdr->movies_off);
+    blob_catalog.sessoes = (const struct session *)((const uint8_t *)hdr + hdr->sessions_off);
+    blob_catalog.prices = (const int16_t (*)[N_TICKET_TYPES])((const uint8_t *)hdr + hdr->prices_off);
+    blob_catalog.strings = strings;
+    return &blob_catalog;
+}
+
+/**
+ * @brief Brief decription of catalog_blob_verify().
+ *
+ * Checks the CRC of the blob opened by catalog_blob_open()
+ *
+ * @return 0 if the blob is intact, -ENOENT if there is no blob,
+ *         -EIO on crc mismatch
+ *
+ */
+int catalog_blob_verify(void) {
+    if(blob == NULL) {
+        return -ENOENT;
+    }
+    if(crc32_ieee((const uint8_t *)blob + sizeof(*blob), blob->size - sizeof(*blob)) != blob->crc) {
+        return -EIO;
+    }
+    return 0;
+}
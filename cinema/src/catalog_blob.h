@@ -0,0 +1,48 @@
+/** @file catalog_blob.h
+ * @brief Binary catalog blob stored in its own flash partition
+ *
+ * Layout (little-endian, every section 4 byte aligned, offsets from the
+ * start of the blob), generated on the host by scripts/catalog_blob.py:
+ *
+ *     struct blob_header
+ *     struct movie    movies[n_movies]
+ *     struct session  sessoes[n_sessions]
+ *     int16_t         prices[n_sessions][N_TICKET_TYPES]
+ *     char            strings[]           NUL terminated movie names
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CATALOG_BLOB_H
+#define CATALOG_BLOB_H
+
+#include <stdint.h>
+
+#include "catalog.h"
+
+/* Defines */
+#define BLOB_MAGIC 0x42544143   // "CATB"
+#define BLOB_FORMAT 1           // Bumped on every layout change
+
+/* Structure at the start of the blob */
+struct blob_header {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t n_types;           // Columns of the price table, N_TICKET_TYPES
+    uint32_t versao;            // Catalog version
+    uint32_t n_movies;
+    uint32_t n_sessions;
+    uint32_t movies_off;
+    uint32_t sessions_off;
+    uint32_t prices_off;
+    uint32_t strings_off;
+    uint32_t size;              // Size of the whole blob
+    uint32_t crc;               // CRC-32 (IEEE) of the blob after the header
+};
+
+const struct catalog *catalog_blob_open(void);
+int catalog_blob_verify(void);
+
+#endif /* CATALOG_BLOB_H */
@@ -0,0 +1,259 @@
+/** @file catalog_update.c
+ * @brief Runtime catalog and price update
+ *
+ * Receives a new catalog (and optionally new pricing rules) through the
+ * management protocol (MGMT_CATALOG_LINE), one text command per line:
+ *
+ *     BEGIN <versao>
+ *     MOVIE <nome>
+ *     SESSION <horas> <custo>
+ *     RULE <types> <days> <from_h> <to_h> <kind> <value>
+ *     COMMIT | ABORT
+ *
+ * The update is built in the inactive snapshot and published on COMMIT,
+ * without stopping sales. The version is required and must be newer than
+ * the catalog on sale: seats, analytics and ticket signatures tell the
+ * catalogs apart by it, so BEGIN and COMMIT refuse an older or equal one
+ * with "ERR -22". BEGIN answers "ERR busy" only while the
+ * catalog is being repriced for a new day; the host just retries.
+ * Without RULE lines the built-in rules are used. Lines with values out
+ * of range (hours outside 0-23, negative prices or over MAX_PRICE, unknown
+ * rule kinds) are refused with "ERR -22" and leave the update unchanged.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/printk.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog_update.h"
+#include "snapshot.h"
+
+/* Defines */
+#define RULE_FIELDS 6
+#define MAX_HORAS 23
+#define MAX_PERCENT 100
+#define ALL_WEEKDAYS (BIT(7) - 1)
+
+/* Update being staged */
+static struct catalog_store *staged = NULL;
+static int n_strings = 0;
+static struct price_rule staged_rules[MAX_RULES];
+static int n_staged_rules = 0;
+
+/**
+ * @brief Brief decription of parse_int().
+ *
+ * Reads the next decimal integer of a line
+ *
+ * @param **p    Cursor in the line, moved past the number
+ * @param *val   Value read
+ *
+ * @return 0 on success, -EINVAL if there is no number
+ *
+ */
+static int parse_int(const char **p, long *val) {
+    char *end;
+
+    *val = strtol(*p, &end, 0);
+    if(end == *p) {
+        return -EINVAL;
+    }
+    *p = end;
+    return 0;
+}
+
+/**
+ * @brief Brief decription of session_ok().
+ *
+ * Checks the fields of a SESSION line
+ *
+ * @param horas  Hour of the session
+ * @param custo  Base price in euros
+ *
+ * @return true if both are in range
+ *
+ */
+static bool session_ok(long horas, long custo) {
+    return (horas >= 0) && (horas <= MAX_HORAS) && (custo >= 0) && (custo <= MAX_PRICE);
+}
+
+/**
+ * @brief Brief decription of rule_ok().
+ *
+ * Checks the fields of a RULE line, in the order of the line
+ *
+ * @param *val  types, days, from_h, to_h, kind, value
+ *
+ * @return true if every field is in range
+ *
+ */
+static bool rule_ok(const long *val) {
+    if((val[0] < 0) || (val[0] > ALL_TYPES) || (val[1] < 0) || (val[1] > ALL_WEEKDAYS)) {
+        return false;
+    }
+    if((val[2] < 0) || (val[2] > val[3]) || (val[3] > MAX_HORAS)) {
+        return false;
+    }
+    switch(val[4]){
+        case(RULE_PERCENT_OFF):
+            return (val[5] >= 0) && (val[5] <= MAX_PERCENT);
+
+        case(RULE_AMOUNT_OFF):
+        case(RULE_FIXED):
+            return (val[5] >= 0) && (val[5] <= MAX_PRICE);
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Brief decription of commit_update().
+ *
+ * Checks the staged catalog, compiles its prices and puts it on sale
+ *
+ * @return 0 on success, -EINVAL if the catalog is empty, a movie has
+ *         no sessions or more than MAX_SESSIONS, or the version is not
+ *         newer than the catalog on sale
+ *
+ */
+static int commit_update(void) {
+    struct catalog *cat = &staged->cat;
+    int m;
+
+    if((cat->n_movies == 0) || (cat->versao <= snapshot_peek()->versao)) {
+        return -EINVAL;
+    }
+    for(m=0; m<cat->n_movies; m++) {
+        if((staged->movies[m].n_sessoes == 0) || (staged->movies[m].n_sessoes > MAX_SESSIONS)) {
+            return -EINVAL;
+        }
+    }
+    if(n_staged_rules > 0) {
+        snapshot_compile(staged, staged_rules, n_staged_rules);
+    } else {
+        snapshot_compile(staged, default_rules, n_default_rules);
+    }
+    snapshot_publish(cat);
+    staged = NULL;
+    return 0;
+}
+
+/**
+ * @brief Brief decription of catalog_update_line().
+ *
+ * Executes one update command
+ *
+ * @param *line       Command, without the line terminator
+ * @param *reply      Buffer for the answer to the host
+ * @param reply_len   Size of reply
+ *
+ * @return 0 if the command was accepted, negative error code otherwise
+ *
+ */
+int catalog_update_line(const char *line, char *reply, int reply_len) {
+    const char *p;
+    long val[RULE_FIELDS];
+    struct movie *filme;
+    int i, ret = 0;
+
+    if(strncmp(line, "BEGIN", 5) == 0) {
+        p = line + 5;
+        if((parse_int(&p, &val[0]) < 0) || (val[0] <= 0) || ((uint32_t)val[0] <= snapshot_peek()->versao)) {
+            snprintk(reply, reply_len, "ERR %d", -EINVAL);
+            return -EINVAL;
+        }
+        if(staged != NULL) {
+            snapshot_unstage(staged);
+        }
+        staged = snapshot_stage();
+        if(staged == NULL) {
+            snprintk(reply, reply_len, "ERR busy");
+            return -EBUSY;
+        }
+        memset(staged, 0, sizeof(*staged));
+        staged->staged = true;
+        staged->cat.movies = staged->movies;
+        staged->cat.sessoes = staged->sessoes;
+        staged->cat.strings = staged->strings;
+        staged->cat.prices = staged->prices;
+        n_strings = 0;
+        n_staged_rules = 0;
+        staged->cat.versao = val[0];
+    } else if(staged == NULL) {
+        ret = -EPERM;
+    } else if(strncmp(line, "MOVIE ", 6) == 0) {
+        if(staged->cat.n_movies < MAX_MOVIES) {
+            filme = &staged->movies[staged->cat.n_movies++];
+            filme->nome = n_strings;
+            filme->first = staged->cat.n_sessions;
+            strncpy(&staged->strings[n_strings], line + 6, MAX_NAME - 1);
+            n_strings += MAX_NAME;
+        } else {
+            ret = -ENOMEM;
+        }
+    } else if(strncmp(line, "SESSION", 7) == 0) {
+        p = line + 7;
+        if((staged->cat.n_movies == 0) || (parse_int(&p, &val[0]) < 0) || (parse_int(&p, &val[1]) < 0) ||
+           !session_ok(val[0], val[1])) {
+            ret = -EINVAL;
+        } else {
+            filme = &staged->movies[staged->cat.n_movies - 1];
+            if((filme->n_sessoes < MAX_SESSIONS) && (staged->cat.n_sessions < MAX_SESSION_IDS)) {
+                staged->sessoes[staged->cat.n_sessions].horas = val[0];
+                staged->sessoes[staged->cat.n_sessions].custo = val[1];
+                staged->cat.n_sessions++;
+                filme->n_sessoes++;
+            } else {
+                ret = -ENOMEM;
+            }
+        }
+    } else if(strncmp(line, "RULE", 4) == 0) {
+        p = line + 4;
+        for(i=0; (i<RULE_FIELDS) && (ret == 0); i++) {
+            ret = parse_int(&p, &val[i]);
+        }
+        if((ret == 0) && !rule_ok(val)) {
+            ret = -EINVAL;
+        }
+        if(ret == 0) {
+            if(n_staged_rules < MAX_RULES) {
+                staged_rules[n_staged_rules].types = val[0];
+                staged_rules[n_staged_rules].days = val[1];
+                staged_rules[n_staged_rules].from_h = val[2];
+                staged_rules[n_staged_rules].to_h = val[3];
+                staged_rules[n_staged_rules].kind = val[4];
+                staged_rules[n_staged_rules].value = val[5];
+                n_staged_rules++;
+            } else {
+                ret = -ENOMEM;
+            }
+        }
+    } else if(strncmp(line, "COMMIT", 6) == 0) {
+        val[0] = staged->cat.versao;
+        ret = commit_update();
+        if(ret == 0) {
+            snprintk(reply, reply_len, "OK %ld", val[0]);
+            return 0;
+        }
+    } else if(strncmp(line, "ABORT", 5) == 0) {
+        snapshot_unstage(staged);
+        staged = NULL;
+    } else {
+        ret = -EINVAL;
+    }
+
+    if(ret == 0) {
+        snprintk(reply, reply_len, "OK");
+    } else {
+        snprintk(reply, reply_len, "ERR %d", ret);
+    }
+    return ret;
+}
@@ -0,0 +1,17 @@
+/** @file catalog_update.h
+ * @brief Runtime catalog and price update
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CATALOG_UPDATE_H
+#define CATALOG_UPDATE_H
+
+/* Maximum length of one update line, with terminator */
+#define UPDATE_LINE_LEN 48
+
+int catalog_update_line(const char *line, char *reply, int reply_len);
+
+#endif /* CATALOG_UPDATE_H */
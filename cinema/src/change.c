@@ -0,0 +1,314 @@
+/** @file change.c
+ * @brief Coin inventory and change dispensing
+ *
+ * Keeps the number of coins of each type held by the machine (coins
+ * inserted by customers stay in the machine) and a table with the
+ * minimum-coin change of every amount up to CHANGE_MAX for that stock.
+ *
+ * The table is a bounded coin change dynamic program with one layer per
+ * coin type: layer L holds, for each amount, the fewest coins using only
+ * types 0..L within their stock, and how many coins of type L that takes.
+ * When the stock of type L changes only layers L..N_COINS-1 are rebuilt.
+ * Answering is then N_COINS table reads, never a search. The customer
+ * stations share the stock, every call takes change_lock.
+ *
+ * The change a purchase leaves is reserved when the purchase is checked:
+ * those coins leave the stock (no other station can pay with them) and
+ * are paid out when the customer asks for the change. A new reservation
+ * of a station replaces the one it held.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <init.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "change.h"
+
+/* Defines */
+#define NO_CHANGE 0xff      // Amount impossible with the stock
+#define N_STATIONS CONFIG_CINEMA_TERMINALS
+
+static uint16_t stock[N_COINS];
+static uint8_t n_coins[N_COINS][CHANGE_MAX + 1];   // Fewest coins, layer by layer
+static uint8_t take[N_COINS][CHANGE_MAX + 1];      // Coins of the layer type used
+static uint8_t reserved[N_STATIONS][N_COINS];      // Change held for each station, out of the stock
+static K_MUTEX_DEFINE(change_lock);
+
+/* Coin stock stats, one entry per coin type */
+STATS_SECT_START(coins_stats)
+STATS_SECT_ENTRY32(stock_1eur)
+STATS_SECT_ENTRY32(stock_2eur)
+STATS_SECT_ENTRY32(stock_5eur)
+STATS_SECT_ENTRY32(stock_10eur)
+STATS_SECT_ENTRY32(no_change)
+STATS_SECT_END;
+
+STATS_SECT_DECL(coins_stats) coins_stats;
+
+STATS_NAME_START(coins_stats)
+STATS_NAME(coins_stats, stock_1eur)
+STATS_NAME(coins_stats, stock_2eur)
+STATS_NAME(coins_stats, stock_5eur)
+STATS_NAME(coins_stats, stock_10eur)
+STATS_NAME(coins_stats, no_change)
+STATS_NAME_END(coins_stats);
+
+/**
+ * @brief Brief decription of rebuild().
+ *
+ * Rebuilds the layers from coin type first up to the last one
+ *
+ * @param first  First coin type whose stock changed
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void rebuild(int first) {
+    int l, a, j, best, best_j, prev, value;
+
+    for(l=first; l<N_COINS; l++) {
+        value = coin_values[l];
+        for(a=0; a<=CHANGE_MAX; a++) {
+            best = NO_CHANGE;
+            best_j = 0;
+            for(j=0; (j<=stock[l]) && (j*value<=a); j++) {
+                if(l == 0) {
+                    prev = (a == j*value) ? 0 : NO_CHANGE;
+                } else {
+                    prev = n_coins[l-1][a - j*value];
+                }
+                if((prev != NO_CHANGE) && (prev + j < best)) {
+                    best = prev + j;
+                    best_j = j;
+                }
+            }
+            n_coins[l][a] = best;
+            take[l][a] = best_j;
+        }
+    }
+
+    STATS_SET(coins_stats, stock_1eur, stock[COIN_1EUR]);
+    STATS_SET(coins_stats, stock_2eur, stock[COIN_2EUR]);
+    STATS_SET(coins_stats, stock_5eur, stock[COIN_5EUR]);
+    STATS_SET(coins_stats, stock_10eur, stock[COIN_10EUR]);
+}
+
+/**
+ * @brief Brief decription of change_init().
+ *
+ * Loads the initial float, CONFIG_CINEMA_CHANGE_FLOAT coins of each type
+ *
+ * @return 0 on success, negative error code from the stats subsystem otherwise
+ *
+ */
+static int change_init(const struct device *dev) {
+    int c;
+
+    ARG_UNUSED(dev);
+
+    for(c=0; c<N_COINS; c++) {
+        stock[c] = CONFIG_CINEMA_CHANGE_FLOAT;
+    }
+    rebuild(0);
+    return stats_init_and_reg(STATS_HDR(coins_stats), STATS_SIZE_32, 5,
+                              STATS_NAME_INIT_PARMS(coins_stats), "coins");
+}
+
+SYS_INIT(change_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/**
+ * @brief Brief decription of change_coin_in().
+ *
+ * Adds an inserted coin to the stock
+ *
+ * @param coin  Coin type, COIN_x
+ *
+ * @return Doesn't return anything
+ *
+ */
+void change_coin_in(int coin) {
+    k_mutex_lock(&change_lock, K_FOREVER);
+    stock[coin]++;
+    rebuild(coin);
+    k_mutex_unlock(&change_lock);
+}
+
+/**
+ * @brief Brief decription of take_coins().
+ *
+ * Takes the minimum number of coins for an amount out of the stock.
+ * Must be called with change_lock held
+ *
+ * @param amount  Change to give, in euros
+ * @param coins   Filled with the number of coins of each type taken
+ *
+ * @return 0 on success, -ENOENT if the stock cannot pay that amount
+ *
+ */
+static int take_coins(int amount, uint8_t coins[N_COINS]) {
+    int l, lowest = N_COINS;
+
+    if((amount < 0) || (amount > CHANGE_MAX) || (n_coins[N_COINS-1][amount] == NO_CHANGE)) {
+        STATS_INC(coins_stats, no_change);
+        return -ENOENT;
+    }
+    for(l=N_COINS-1; l>=0; l--) {
+        coins[l] = take[l][amount];
+        amount -= coins[l] * coin_values[l];
+        if(coins[l] > 0) {
+            stock[l] -= coins[l];
+            lowest = l;
+        }
+    }
+    if(lowest < N_COINS) {
+        rebuild(lowest);
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of put_coins().
+ *
+ * Puts coins back in the stock. Must be called with change_lock held
+ *
+ * @param coins  Number of coins of each type
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void put_coins(const uint8_t coins[N_COINS]) {
+    int c, lowest = N_COINS;
+
+    for(c=N_COINS-1; c>=0; c--) {
+        if(coins[c] > 0) {
+            stock[c] += coins[c];
+            lowest = c;
+        }
+    }
+    if(lowest < N_COINS) {
+        rebuild(lowest);
+    }
+}
+
+/**
+ * @brief Brief decription of change_reserve().
+ *
+ * Holds the change of an amount for a station, in place of what it
+ * held before. The coins stay out of the stock until change_commit()
+ *
+ * @param station  Customer station
+ * @param amount   Change to hold, in euros
+ *
+ * @return 0 on success, -ENOENT if the stock cannot pay that amount
+ *         (the station keeps what it held)
+ *
+ */
+int change_reserve(int station, int amount) {
+    uint8_t coins[N_COINS];
+    int c, ret;
+
+    k_mutex_lock(&change_lock, K_FOREVER);
+    put_coins(reserved[station]);
+    ret = take_coins(amount, coins);
+    if(ret == 0) {
+        memcpy(reserved[station], coins, N_COINS);
+    } else {
+        /* Nothing was taken, the coins held go out of the stock again */
+        for(c=0; c<N_COINS; c++) {
+            stock[c] -= reserved[station][c];
+        }
+        rebuild(0);
+    }
+    k_mutex_unlock(&change_lock);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of change_commit().
+ *
+ * Hands out the change held for a station, to be dispensed
+ *
+ * @param station  Customer station
+ * @param coins    Filled with the number of coins of each type to dispense
+ *
+ * @return Doesn't return anything
+ *
+ */
+void change_commit(int station, uint8_t coins[N_COINS]) {
+    k_mutex_lock(&change_lock, K_FOREVER);
+    memcpy(coins, reserved[station], N_COINS);
+    memset(reserved[station], 0, N_COINS);
+    k_mutex_unlock(&change_lock);
+}
+
+/**
+ * @brief Brief decription of change_make().
+ *
+ * Takes the minimum number of coins for an amount out of the stock
+ *
+ * @param amount  Change to give, in euros
+ * @param coins   Filled with the number of coins of each type to dispense
+ *
+ * @return 0 on success, -ENOENT if the stock cannot pay that amount
+ *
+ */
+int change_make(int amount, uint8_t coins[N_COINS]) {
+    int ret;
+
+    k_mutex_lock(&change_lock, K_FOREVER);
+    ret = take_coins(amount, coins);
+    k_mutex_unlock(&change_lock);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of change_stock().
+ *
+ * @param coin  Coin type, COIN_x
+ *
+ * @return Coins of that type in the machine
+ *
+ */
+int change_stock(int coin) {
+    return stock[coin];
+}
+
+/**
+ * @brief Brief decription of change_return().
+ *
+ * Puts back in the stock coins taken by change_make() that were not dispensed
+ *
+ * @param coins  Number of coins of each type to put back
+ *
+ * @return Doesn't return anything
+ *
+ */
+void change_return(const uint8_t coins[N_COINS]) {
+    k_mutex_lock(&change_lock, K_FOREVER);
+    put_coins(coins);
+    k_mutex_unlock(&change_lock);
+}
+
+/**
+ * @brief Brief decription of change_empty().
+ *
+ * Marks a coin type as exhausted, after its hopper failed to dispense
+ *
+ * @param coin  Coin type, COIN_x
+ *
+ * @return Doesn't return anything
+ *
+ */
+void change_empty(int coin) {
+    k_mutex_lock(&change_lock, K_FOREVER);
+    stock[coin] = 0;
+    rebuild(coin);
+    k_mutex_unlock(&change_lock);
+}
@@ -0,0 +1,28 @@
+/** @file change.h
+ * @brief Coin inventory and change dispensing
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CHANGE_H
+#define CHANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cinema.h"
+
+/* Defines */
+#define CHANGE_MAX CONFIG_CINEMA_CHANGE_MAX     // Biggest balance, and so change, accepted
+
+void change_coin_in(int coin);
+int change_reserve(int station, int amount);
+void change_commit(int station, uint8_t coins[N_COINS]);
+int change_make(int amount, uint8_t coins[N_COINS]);
+int change_stock(int coin);
+void change_return(const uint8_t coins[N_COINS]);
+void change_empty(int coin);
+
+#endif /* CHANGE_H */
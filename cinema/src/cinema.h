@@ -0,0 +1,43 @@
+/** @file cinema.h
+ * @brief Shared definitions of the cinema ticket vending machine
+ *
+ * Declarations used by main.c and by the optional modules that plug
+ * into the state machine (instrumentation, extra input sources, ...)
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef CINEMA_H
+#define CINEMA_H
+
+#include <stdint.h>
+
+/* Button indexes, same order as buttons_pins[] */
+#define BUT_UP 0        // UP
+#define BUT_DOWN 1      // DOWN
+#define BUT_SELECT 2    // SELECT
+#define BUT_RETURN 3    // RETURN
+#define BUT_1EUR 4      // 1 euro
+#define BUT_2EUR 5      // 2 euros
+#define BUT_5EUR 6      // 5 euros
+#define BUT_10EUR 7     // 10 euros
+#define N_BUTTONS 8     // Number of buttons
+
+/* Keys of the keypad (keypad.c) without a button of their own, after the buttons */
+#define BUT_DIGIT 8     // Digit n is BUT_DIGIT + n
+#define N_INPUTS 18     // Number of button and key indexes
+
+/* Coin types, in the order of the coin buttons */
+#define COIN_1EUR 0
+#define COIN_2EUR 1
+#define COIN_5EUR 2
+#define COIN_10EUR 3
+#define N_COINS 4
+
+static const uint8_t coin_values[N_COINS] = {1, 2, 5, 10}; /* Value of each coin type in euros */
+
+void press_Button(int i);
+
+#endif /* CINEMA_H */
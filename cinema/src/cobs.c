@@ -0,0 +1,86 @@
+/** @file cobs.c
+ * @brief Consistent Overhead Byte Stuffing
+ *
+ * Framing of the serial protocols (management, seat sync): frames are
+ * COBS encoded so 0x00 only appears as the frame delimiter.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <stdint.h>
+
+#include "cobs.h"
+
+/**
+ * @brief Brief decription of cobs_encode().
+ *
+ * Consistent Overhead Byte Stuffing, removes every 0x00 from a buffer
+ *
+ * @param *in   Data to encode
+ * @param len   Size of in
+ * @param *out  Encoded data, at least COBS_MAX(len) bytes
+ *
+ * @return Size of the encoded data
+ *
+ */
+int cobs_encode(const uint8_t *in, int len, uint8_t *out) {
+    int code_pos = 0, out_len = 1, i;
+    uint8_t code = 1;
+
+    for(i=0; i<len; i++) {
+        if(in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = out_len++;
+            code = 1;
+        } else {
+            out[out_len++] = in[i];
+            code++;
+            if(code == 0xff) {
+                out[code_pos] = code;
+                code_pos = out_len++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return out_len;
+}
+
+/**
+ * @brief Brief decription of cobs_decode().
+ *
+ * Reverses cobs_encode()
+ *
+ * @param *in   Encoded data, without the 0x00 delimiter
+ * @param len   Size of in
+ * @param *out  Decoded data
+ * @param max   Size of out
+ *
+ * @return Size of the decoded data, -EINVAL if in is not valid COBS
+ *
+ */
+int cobs_decode(const uint8_t *in, int len, uint8_t *out, int max) {
+    int i = 0, out_len = 0, j;
+    uint8_t code;
+
+    while(i < len) {
+        code = in[i++];
+        if((code == 0) || (i + code - 1 > len) || (out_len + code - 1 > max)) {
+            return -EINVAL;
+        }
+        for(j=1; j<code; j++) {
+            out[out_len++] = in[i++];
+        }
+        if((code != 0xff) && (i < len)) {
+            if(out_len >= max) {
+                return -EINVAL;
+            }
+            out[out_len++] = 0;
+        }
+    }
+    return out_len;
+}
@@ -0,0 +1,20 @@
+/** @file cobs.h
+ * @brief Consistent Overhead Byte Stuffing
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+
+/* Defines */
+#define COBS_MAX(n) ((n) + ((n) / 254) + 1)     // Encoded size of n bytes, worst case
+
+int cobs_encode(const uint8_t *in, int len, uint8_t *out);
+int cobs_decode(const uint8_t *in, int len, uint8_t *out, int max);
+
+#endif /* COBS_H */
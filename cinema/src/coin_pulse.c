@@ -0,0 +1,245 @@
+/** @file coin_pulse.c
+ * @brief Pulse train coin acceptor on a single line
+ *
+ * Multi-coin acceptors report each coin as a train of active low pulses
+ * on one line, pulses_per_coin[] pulses per coin type. The interrupt only
+ * timestamps both edges with k_cycle_get_32() into a single producer /
+ * single consumer ring (no locks, the ISR owns the head and the decoder
+ * the tail). The decoder runs in the system work queue: it measures the
+ * pulses, drops glitches shorter than PULSE_MIN_US, rejects trains with
+ * pulses longer than PULSE_MAX_US, and ends a train after TRAIN_GAP_US
+ * without edges. Decoded coins are queued for the state machine, so
+ * coins inserted faster than it polls are all counted.
+ *
+ * Edge timestamps keep the line level in bit 0, one cycle of resolution
+ * is not needed.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/gpio.h>
+#include <sys/atomic.h>
+#include <sys/printk.h>
+#include <stats/stats.h>
+
+#include "cinema.h"
+#include "coin_pulse.h"
+#include "power.h"
+
+/* Defines */
+#define GPIO0_NODE DT_NODELABEL(gpio0)
+#define COIN_PULSE_PIN 3        // Former 1 euro button, frees pins 4, 28 and 29
+#define EDGE_RING_LEN 64        // Power of two
+#define COIN_QUEUE_LEN 8
+#define PULSE_MIN_US 10000      // Shorter pulses are noise
+#define PULSE_MAX_US 150000     // Longer pulses are a fault of the acceptor
+#define TRAIN_GAP_US 200000     // Idle time that ends a train
+
+static const uint8_t pulses_per_coin[N_COINS] = {1, 2, 5, 10};  /* Acceptor programming, per coin type */
+
+static const struct device * gpio0_dev = DEVICE_DT_GET(GPIO0_NODE);
+static struct gpio_callback coin_cb_data;
+
+/* Edge ring, head written by the ISR, tail by the decoder */
+static uint32_t edges[EDGE_RING_LEN];
+static atomic_t edge_head = ATOMIC_INIT(0);
+static atomic_t edge_tail = ATOMIC_INIT(0);
+static atomic_t overrun = ATOMIC_INIT(0);
+
+K_MSGQ_DEFINE(coin_msgq, sizeof(uint8_t), COIN_QUEUE_LEN, 1);
+
+/* Decoder state, only touched by the work item */
+static uint32_t pulse_start;
+static uint32_t last_edge;
+static bool in_pulse = false;
+static bool bad_train = false;
+static int n_pulses = 0;
+
+static void decoder_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(decoder_work, decoder_handler);
+
+/* Coin acceptor stats */
+STATS_SECT_START(coin_pulse_stats)
+STATS_SECT_ENTRY32(edges)
+STATS_SECT_ENTRY32(coins)
+STATS_SECT_ENTRY32(glitches)
+STATS_SECT_ENTRY32(bad_trains)
+STATS_SECT_ENTRY32(overruns)
+STATS_SECT_END;
+
+STATS_SECT_DECL(coin_pulse_stats) coin_pulse_stats;
+
+STATS_NAME_START(coin_pulse_stats)
+STATS_NAME(coin_pulse_stats, edges)
+STATS_NAME(coin_pulse_stats, coins)
+STATS_NAME(coin_pulse_stats, glitches)
+STATS_NAME(coin_pulse_stats, bad_trains)
+STATS_NAME(coin_pulse_stats, overruns)
+STATS_NAME_END(coin_pulse_stats);
+
+/**
+ * @brief Brief decription of coin_edge().
+ *
+ * Interrupt on both edges of the coin line, only stores the timestamp
+ *
+ * @param *dev  Pointer to the GPIO Device that triggered the callback
+ * @param *cb   Pointer to the gpio_callback structure
+ * @param pins  Bitmask indicating which pins triggered the callback
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void coin_edge(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    uint32_t now = k_cycle_get_32();
+    atomic_val_t head = atomic_get(&edge_head);
+    int active;
+
+    if(!(pins & BIT(COIN_PULSE_PIN))) {
+        return;
+    }
+    active = gpio_pin_get(dev, COIN_PULSE_PIN);
+    if(head - atomic_get(&edge_tail) >= EDGE_RING_LEN) {
+        /* Decoder late, the train in progress is lost */
+        atomic_set(&overrun, 1);
+        STATS_INC(coin_pulse_stats, overruns);
+    } else {
+        edges[head & (EDGE_RING_LEN - 1)] = (now & ~1U) | (active ? 1U : 0U);
+        atomic_set(&edge_head, head + 1);
+    }
+    k_work_reschedule(&decoder_work, K_NO_WAIT);
+}
+
+/**
+ * @brief Brief decription of end_train().
+ *
+ * Classifies a finished pulse train and queues its coin
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void end_train(void) {
+    uint8_t coin;
+
+    for(coin=0; coin<N_COINS; coin++) {
+        if(pulses_per_coin[coin] == n_pulses) {
+            break;
+        }
+    }
+    if(bad_train || in_pulse || (coin == N_COINS)) {
+        STATS_INC(coin_pulse_stats, bad_trains);
+    } else if(k_msgq_put(&coin_msgq, &coin, K_NO_WAIT) == 0) {
+        STATS_INC(coin_pulse_stats, coins);
+        power_activity();
+    } else {
+        printk("Error: coin queue full\n");
+    }
+    n_pulses = 0;
+    in_pulse = false;
+    bad_train = false;
+}
+
+/**
+ * @brief Brief decription of decoder_handler().
+ *
+ * Bottom half: measures the pulses of the captured edges and ends the
+ * train once the line has been idle for TRAIN_GAP_US
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void decoder_handler(struct k_work *work) {
+    atomic_val_t tail = atomic_get(&edge_tail);
+    uint32_t edge, width_us, idle_us;
+
+    ARG_UNUSED(work);
+
+    if(atomic_cas(&overrun, 1, 0)) {
+        bad_train = true;
+    }
+    while(tail != atomic_get(&edge_head)) {
+        edge = edges[tail & (EDGE_RING_LEN - 1)];
+        atomic_set(&edge_tail, ++tail);
+        STATS_INC(coin_pulse_stats, edges);
+
+        if(edge & 1U) {             // Pulse starts
+            pulse_start = edge;
+            in_pulse = true;
+        } else if(in_pulse) {       // Pulse ends
+            width_us = k_cyc_to_us_floor32(edge - pulse_start);
+            in_pulse = false;
+            if(width_us < PULSE_MIN_US) {
+                STATS_INC(coin_pulse_stats, glitches);
+            } else if(width_us > PULSE_MAX_US) {
+                bad_train = true;
+            } else {
+                n_pulses++;
+            }
+        }
+        last_edge = edge;
+    }
+
+    if((n_pulses > 0) || bad_train || in_pulse) {
+        idle_us = k_cyc_to_us_floor32(k_cycle_get_32() - last_edge);
+        if(idle_us >= TRAIN_GAP_US) {
+            end_train();
+        } else {
+            k_work_reschedule(&decoder_work, K_USEC(TRAIN_GAP_US - idle_us));
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of coin_pulse_get().
+ *
+ * Next decoded coin, never waits
+ *
+ * @return Coin type (COIN_x), -EAGAIN if no coin was inserted
+ *
+ */
+int coin_pulse_get(void) {
+    uint8_t coin;
+
+    return (k_msgq_get(&coin_msgq, &coin, K_NO_WAIT) == 0) ? coin : -EAGAIN;
+}
+
+/**
+ * @brief Brief decription of coin_pulse_init().
+ *
+ * Configures the coin line with an interrupt on both edges
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int coin_pulse_init(const struct device *dev) {
+    int ret;
+
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(gpio0_dev)) {
+        printk("Error: gpio0 device is not ready\n");
+        return -ENODEV;
+    }
+    ret = gpio_pin_configure(gpio0_dev, COIN_PULSE_PIN, GPIO_INPUT | GPIO_PULL_UP | GPIO_ACTIVE_LOW);
+    if(ret == 0) {
+        ret = gpio_pin_interrupt_configure(gpio0_dev, COIN_PULSE_PIN, GPIO_INT_EDGE_BOTH);
+    }
+    if(ret < 0) {
+        printk("Error: gpio configuration failed for the coin line, error:%d\n\r", ret);
+        return ret;
+    }
+    gpio_init_callback(&coin_cb_data, coin_edge, BIT(COIN_PULSE_PIN));
+    gpio_add_callback(gpio0_dev, &coin_cb_data);
+    return stats_init_and_reg(STATS_HDR(coin_pulse_stats), STATS_SIZE_32, 5,
+                              STATS_NAME_INIT_PARMS(coin_pulse_stats), "coin_pulse");
+}
+
+SYS_INIT(coin_pulse_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,20 @@
+/** @file coin_pulse.h
+ * @brief Pulse train coin acceptor on a single line
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef COIN_PULSE_H
+#define COIN_PULSE_H
+
+#include <errno.h>
+
+#ifdef CONFIG_CINEMA_COIN_PULSE
+int coin_pulse_get(void);
+#else
+static inline int coin_pulse_get(void) { return -EAGAIN; }
+#endif
+
+#endif /* COIN_PULSE_H */
@@ -0,0 +1,82 @@
+/** @file font.c
+ * @brief 5x7 bitmap font of the ticket renderer and the pixel display
+ *
+ * Uppercase only, which is all the tickets and the menus need. Text is
+ * UTF-8: the accented letters of Latin-1 are drawn without the accent,
+ * any other character as '?'. Plain C, also built on the host.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include "font.h"
+
+/* 5x7 font, ' ' to '_', bit 4 is the leftmost dot. Lowercase is printed in uppercase */
+const uint8_t font_5x7[FONT_GLYPHS][FONT_GLYPH_H] = {
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x04,0x04,0x04,0x04,0x00,0x00,0x04},     // ' ' !
+    {0x0a,0x0a,0x0a,0x00,0x00,0x00,0x00}, {0x0a,0x0a,0x1f,0x0a,0x1f,0x0a,0x0a},     // " #
+    {0x04,0x0f,0x14,0x0e,0x05,0x1e,0x04}, {0x18,0x19,0x02,0x04,0x08,0x13,0x03},     // $ %
+    {0x0c,0x12,0x14,0x08,0x15,0x12,0x0d}, {0x0c,0x04,0x08,0x00,0x00,0x00,0x00},     // & '
+    {0x02,0x04,0x08,0x08,0x08,0x04,0x02}, {0x08,0x04,0x02,0x02,0x02,0x04,0x08},     // ( )
+    {0x00,0x04,0x15,0x0e,0x15,0x04,0x00}, {0x00,0x04,0x04,0x1f,0x04,0x04,0x00},     // * +
+    {0x00,0x00,0x00,0x00,0x0c,0x04,0x08}, {0x00,0x00,0x00,0x1f,0x00,0x00,0x00},     // , -
+    {0x00,0x00,0x00,0x00,0x00,0x0c,0x0c}, {0x00,0x01,0x02,0x04,0x08,0x10,0x00},     // . /
+    {0x0e,0x11,0x13,0x15,0x19,0x11,0x0e}, {0x04,0x0c,0x04,0x04,0x04,0x04,0x0e},     // 0 1
+    {0x0e,0x11,0x01,0x02,0x04,0x08,0x1f}, {0x1f,0x02,0x04,0x02,0x01,0x11,0x0e},     // 2 3
+    {0x02,0x06,0x0a,0x12,0x1f,0x02,0x02}, {0x1f,0x10,0x1e,0x01,0x01,0x11,0x0e},     // 4 5
+    {0x06,0x08,0x10,0x1e,0x11,0x11,0x0e}, {0x1f,0x01,0x02,0x04,0x08,0x08,0x08},     // 6 7
+    {0x0e,0x11,0x11,0x0e,0x11,0x11,0x0e}, {0x0e,0x11,0x11,0x0f,0x01,0x02,0x0c},     // 8 9
+    {0x00,0x0c,0x0c,0x00,0x0c,0x0c,0x00}, {0x00,0x0c,0x0c,0x00,0x0c,0x04,0x08},     // : ;
+    {0x02,0x04,0x08,0x10,0x08,0x04,0x02}, {0x00,0x00,0x1f,0x00,0x1f,0x00,0x00},     // < =
+    {0x08,0x04,0x02,0x01,0x02,0x04,0x08}, {0x0e,0x11,0x01,0x02,0x04,0x00,0x04},     // > ?
+    {0x0e,0x11,0x01,0x0d,0x15,0x15,0x0e}, {0x0e,0x11,0x11,0x11,0x1f,0x11,0x11},     // @ A
+    {0x1e,0x11,0x11,0x1e,0x11,0x11,0x1e}, {0x0e,0x11,0x10,0x10,0x10,0x11,0x0e},     // B C
+    {0x1c,0x12,0x11,0x11,0x11,0x12,0x1c}, {0x1f,0x10,0x10,0x1e,0x10,0x10,0x1f},     // D E
+    {0x1f,0x10,0x10,0x1e,0x10,0x10,0x10}, {0x0e,0x11,0x10,0x17,0x11,0x11,0x0f},     // F G
+    {0x11,0x11,0x11,0x1f,0x11,0x11,0x11}, {0x0e,0x04,0x04,0x04,0x04,0x04,0x0e},     // H I
+    {0x07,0x02,0x02,0x02,0x02,0x12,0x0c}, {0x11,0x12,0x14,0x18,0x14,0x12,0x11},     // J K
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x1f}, {0x11,0x1b,0x15,0x15,0x11,0x11,0x11},     // L M
+    {0x11,0x11,0x19,0x15,0x13,0x11,0x11}, {0x0e,0x11,0x11,0x11,0x11,0x11,0x0e},     // N O
+    {0x1e,0x11,0x11,0x1e,0x10,0x10,0x10}, {0x0e,0x11,0x11,0x11,0x15,0x12,0x0d},     // P Q
+    {0x1e,0x11,0x11,0x1e,0x14,0x12,0x11}, {0x0f,0x10,0x10,0x0e,0x01,0x01,0x1e},     // R S
+    {0x1f,0x04,0x04,0x04,0x04,0x04,0x04}, {0x11,0x11,0x11,0x11,0x11,0x11,0x0e},     // T U
+    {0x11,0x11,0x11,0x11,0x11,0x0a,0x04}, {0x11,0x11,0x11,0x15,0x15,0x15,0x0a},     // V W
+    {0x11,0x11,0x0a,0x04,0x0a,0x11,0x11}, {0x11,0x11,0x11,0x0a,0x04,0x04,0x04},     // X Y
+    {0x1f,0x01,0x02,0x04,0x08,0x10,0x1f}, {0x0e,0x08,0x08,0x08,0x08,0x08,0x0e},     // Z [
+    {0x00,0x10,0x08,0x04,0x02,0x01,0x00}, {0x0e,0x02,0x02,0x02,0x02,0x02,0x0e},     // \ ]
+    {0x04,0x0a,0x11,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x1f},     // ^ _
+};
+
+/* Base letter of the Latin-1 letters (UTF-8 0xc3 0x80 to 0xc3 0xbf), for the accents of the movie names */
+static const char latin1_base[] = "AAAAAAACEEEEIIIIDNOOOOOXOUUUUYPSAAAAAAACEEEEIIIIDNOOOOO/OUUUUYPY";
+
+/**
+ * @brief Brief decription of font_glyph().
+ *
+ * Takes the next character of a text
+ *
+ * @param **text  Text, UTF-8, moved past the character
+ *
+ * @return Glyph index in font_5x7, -1 for a byte that is drawn as nothing
+ *         (continuation bytes of a character already drawn as '?')
+ *
+ */
+int font_glyph(const char **text) {
+    const unsigned char *p = (const unsigned char *)*text;
+    unsigned char c = *p++;
+
+    if((c == 0xc3) && (*p >= 0x80) && (*p <= 0xbf)) {
+        c = latin1_base[*p++ - 0x80];
+    } else if(c >= 0x80) {
+        /* Other multi-byte characters: one '?' for the lead byte, nothing for the rest */
+        *text = (const char *)p;
+        return (c < 0xc0) ? -1 : FONT_UNKNOWN;
+    }
+    *text = (const char *)p;
+    if((c >= 'a') && (c <= 'z')) {
+        c -= 'a' - 'A';
+    }
+    return ((c >= FONT_FIRST) && (c < FONT_FIRST + FONT_GLYPHS)) ? c - FONT_FIRST : FONT_UNKNOWN;
+}
@@ -0,0 +1,25 @@
+/** @file font.h
+ * @brief 5x7 bitmap font of the ticket renderer and the pixel display
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+/* Defines */
+#define FONT_GLYPH_W 5
+#define FONT_GLYPH_H 7
+#define FONT_FIRST ' '
+#define FONT_GLYPHS 64              // ' ' to '_'
+#define FONT_UNKNOWN ('?' - FONT_FIRST)
+
+extern const uint8_t font_5x7[FONT_GLYPHS][FONT_GLYPH_H];
+
+int font_glyph(const char **text);
+
+#endif /* FONT_H */
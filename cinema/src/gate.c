@@ -0,0 +1,283 @@
+/** @file gate.c
+ * @brief Door validator
+ *
+ * Lines are assembled by the scanner UART interrupt and checked by
+ * gate_run() in main. A ticket with a right signature is looked up in the
+ * set of the tickets already let in and added to it in the same step,
+ * under a spinlock, so the same ticket can never enter twice. The set
+ * id is the signature (64 bits): it is an HMAC output, so the ids are
+ * spread evenly and nobody without the key can make two tickets clash. CONFIG_CINEMA_GATE_TICKETS tickets take
+ * TICKET_SET_BUCKETS() * 32 bytes (about 4.4 bytes per ticket).
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <init.h>
+#include <spinlock.h>
+#include <sys/byteorder.h>
+#include <sys/printk.h>
+#include <stats/stats.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gate.h"
+#include "ticket_set.h"
+#include "ticket_sign.h"
+
+/* Defines */
+#define GATE_UART_NODE DT_CHOSEN(cinema_scanner_uart)
+#define GATE_LINE_LEN 80
+#define GATE_RX_QUEUE_LEN 8
+#define GATE_TICKETS CONFIG_CINEMA_GATE_TICKETS
+#define GATE_PREFIX "CINEMA3000/"
+#define GATE_FIELDS 5               // Kiosk, seq, version, session and price
+
+/* Structure of one received line */
+struct gate_line {
+    char text[GATE_LINE_LEN];
+};
+
+/* Structure of a decoded ticket code */
+struct gate_code {
+    uint32_t fields[GATE_FIELDS];
+    uint8_t sig[TICKET_SIG_LEN];
+};
+
+static const struct device * gate_dev = DEVICE_DT_GET(GATE_UART_NODE);
+
+static struct ticket_bucket buckets[TICKET_SET_BUCKETS(GATE_TICKETS)];
+static struct ticket_set used;
+static struct k_spinlock lock;      // Protects used
+
+K_MSGQ_DEFINE(gate_rx_msgq, sizeof(struct gate_line), GATE_RX_QUEUE_LEN, 1);
+static struct gate_line rx_line;
+static int rx_len = 0;
+
+static const char *results[] = { "Entrada autorizada", "Bilhete ja usado", "Bilhete invalido",
+                                 "Codigo desconhecido", "Registo de entradas cheio" };
+
+/* Gate stats */
+STATS_SECT_START(gate_stats)
+STATS_SECT_ENTRY32(scans)
+STATS_SECT_ENTRY32(admitted)
+STATS_SECT_ENTRY32(used)
+STATS_SECT_ENTRY32(invalid)
+STATS_SECT_ENTRY32(malformed)
+STATS_SECT_ENTRY32(full)
+STATS_SECT_ENTRY32(dropped)
+STATS_SECT_ENTRY32(check_max_us)
+STATS_SECT_END;
+
+STATS_SECT_DECL(gate_stats) gate_stats;
+
+STATS_NAME_START(gate_stats)
+STATS_NAME(gate_stats, scans)
+STATS_NAME(gate_stats, admitted)
+STATS_NAME(gate_stats, used)
+STATS_NAME(gate_stats, invalid)
+STATS_NAME(gate_stats, malformed)
+STATS_NAME(gate_stats, full)
+STATS_NAME(gate_stats, dropped)
+STATS_NAME(gate_stats, check_max_us)
+STATS_NAME_END(gate_stats);
+
+/**
+ * @brief Brief decription of hex_value().
+ *
+ * @return Value of a hex digit, -1 if c is not one
+ *
+ */
+static int hex_value(char c) {
+    if((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    if((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Brief decription of parse_code().
+ *
+ * @param *text  Scanned line
+ * @param *code  Decoded code
+ *
+ * @return 0 on success, -EINVAL if the line is not a ticket code
+ *
+ */
+static int parse_code(const char *text, struct gate_code *code) {
+    char *end;
+    int i, hi, lo;
+
+    if(strncmp(text, GATE_PREFIX, strlen(GATE_PREFIX)) != 0) {
+        return -EINVAL;
+    }
+    text += strlen(GATE_PREFIX);
+    for(i=0; i<GATE_FIELDS; i++) {
+        if((*text < '0') || (*text > '9')) {
+            return -EINVAL;
+        }
+        code->fields[i] = strtoul(text, &end, 10);
+        if(*end != '/') {
+            return -EINVAL;
+        }
+        text = end + 1;
+    }
+    for(i=0; i<TICKET_SIG_LEN; i++) {
+        hi = hex_value(text[2*i]);
+        lo = (hi < 0) ? -1 : hex_value(text[2*i + 1]);
+        if(lo < 0) {
+            return -EINVAL;
+        }
+        code->sig[i] = (hi << 4) | lo;
+    }
+    return (text[2 * TICKET_SIG_LEN] == '\0') ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Brief decription of gate_check().
+ *
+ * Checks one scanned line and lets the ticket in if it may enter
+ *
+ * @param *text  Scanned line
+ *
+ * @return GATE_x
+ *
+ */
+static int gate_check(const char *text) {
+    struct gate_code code;
+    k_spinlock_key_t key;
+    int ret;
+
+    if(parse_code(text, &code) != 0) {
+        return GATE_MALFORMED;
+    }
+    if(ticket_verify(code.fields[0], code.fields[1], code.fields[2], code.fields[3], code.fields[4], code.sig) != 0) {
+        return GATE_INVALID;
+    }
+    key = k_spin_lock(&lock);
+    ret = ticket_set_admit(&used, sys_get_le64(code.sig));
+    k_spin_unlock(&lock, key);
+    if(ret == -EALREADY) {
+        return GATE_USED;
+    }
+    return (ret == 0) ? GATE_ADMITTED : GATE_FULL;
+}
+
+/**
+ * @brief Brief decription of gate_run().
+ *
+ * Checks the scanned tickets forever, runs in place of the stations
+ *
+ * @return Doesn't return anything
+ *
+ */
+void gate_run(void) {
+    struct gate_line line;
+    uint32_t start, us;
+    int result;
+
+    printk("Porta: ate %d entradas, a aguardar bilhetes\n\r", GATE_TICKETS);
+    while(1) {
+        k_msgq_get(&gate_rx_msgq, &line, K_FOREVER);
+        start = k_cycle_get_32();
+        result = gate_check(line.text);
+        us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+        if(us > gate_stats.check_max_us) {
+            STATS_SET(gate_stats, check_max_us, us);
+        }
+        STATS_INC(gate_stats, scans);
+        switch(result) {
+            case GATE_ADMITTED:
+                STATS_INC(gate_stats, admitted);
+            break;
+            case GATE_USED:
+                STATS_INC(gate_stats, used);
+            break;
+            case GATE_INVALID:
+                STATS_INC(gate_stats, invalid);
+            break;
+            case GATE_MALFORMED:
+                STATS_INC(gate_stats, malformed);
+            break;
+            default:
+                STATS_INC(gate_stats, full);
+            break;
+        }
+        printk("%s\n\r", results[result]);
+    }
+}
+
+/**
+ * @brief Brief decription of gate_uart_isr().
+ *
+ * UART interrupt: assembles the scanned lines
+ *
+ * @param *dev        UART device
+ * @param *user_data  Unused
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void gate_uart_isr(const struct device *dev, void *user_data) {
+    uint8_t c;
+
+    ARG_UNUSED(user_data);
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(!uart_irq_rx_ready(dev)) {
+            continue;
+        }
+        while(uart_fifo_read(dev, &c, 1) == 1) {
+            if((c == '\n') || (c == '\r')) {
+                /* The customer scans again when a line is dropped */
+                if(rx_len > 0) {
+                    rx_line.text[rx_len] = '\0';
+                    if(k_msgq_put(&gate_rx_msgq, &rx_line, K_NO_WAIT) != 0) {
+                        STATS_INC(gate_stats, dropped);
+                    }
+                }
+                rx_len = 0;
+            } else if(rx_len < GATE_LINE_LEN - 1) {
+                rx_line.text[rx_len++] = c;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of gate_init().
+ *
+ * Empties the set, enables the scanner UART interrupts and registers
+ * the stats
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int gate_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    ticket_set_init(&used, buckets, ARRAY_SIZE(buckets), GATE_TICKETS);
+    if(!device_is_ready(gate_dev)) {
+        printk("Error: scanner uart is not ready\n");
+        return -ENODEV;
+    }
+    uart_irq_callback_user_data_set(gate_dev, gate_uart_isr, NULL);
+    uart_irq_rx_enable(gate_dev);
+    return stats_init_and_reg(STATS_HDR(gate_stats), STATS_SIZE_32, 8,
+                              STATS_NAME_INIT_PARMS(gate_stats), "gate");
+}
+
+SYS_INIT(gate_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
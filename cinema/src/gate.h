@@ -0,0 +1,30 @@
+/** @file gate.h
+ * @brief Door validator
+ *
+ * With CONFIG_CINEMA_GATE the firmware checks tickets at the door
+ * instead of selling them: a serial barcode scanner on the UART chosen
+ * as cinema,scanner-uart sends the text of the QR code of each ticket
+ * (see sell_Ticket() in main.c) as one line:
+ *
+ *     CINEMA3000/<kiosk>/<seq>/<version>/<session>/<price>/<signature>
+ *
+ * A ticket is let in once if its signature is right (ticket_sign.h).
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef GATE_H
+#define GATE_H
+
+/* Results of a scan */
+#define GATE_ADMITTED 0
+#define GATE_USED 1         // Already went through the door
+#define GATE_INVALID 2      // Bad signature
+#define GATE_MALFORMED 3    // Not a ticket code
+#define GATE_FULL 4         // No room left to record it
+
+void gate_run(void);
+
+#endif /* GATE_H */
@@ -0,0 +1,89 @@
+/** @file hmac.c
+ * @brief HMAC-SHA256 (RFC 2104) on the sign_hash.h backends
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <string.h>
+
+#include "hmac.h"
+
+/* Defines */
+#define IPAD 0x36
+#define OPAD 0x5c
+
+/**
+ * @brief Brief decription of hmac_setkey().
+ *
+ * Prepares the pad contexts of a key, keys longer than a block are
+ * hashed first
+ *
+ * @param *key     Prepared key
+ * @param *secret  Key bytes
+ * @param len      Number of key bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+void hmac_setkey(struct hmac_key *key, const uint8_t *secret, size_t len) {
+    uint8_t block[SIGN_BLOCK_LEN];
+    int i;
+
+    memset(block, 0, sizeof(block));
+    if(len > SIGN_BLOCK_LEN) {
+        sign_hash_init(&key->inner);
+        sign_hash_update(&key->inner, secret, len);
+        sign_hash_final(&key->inner, block);
+    } else {
+        memcpy(block, secret, len);
+    }
+
+    for(i=0; i<SIGN_BLOCK_LEN; i++) {
+        block[i] ^= IPAD;
+    }
+    sign_hash_init(&key->inner);
+    sign_hash_update(&key->inner, block, SIGN_BLOCK_LEN);
+    for(i=0; i<SIGN_BLOCK_LEN; i++) {
+        block[i] ^= IPAD ^ OPAD;
+    }
+    sign_hash_init(&key->outer);
+    sign_hash_update(&key->outer, block, SIGN_BLOCK_LEN);
+    memset(block, 0, sizeof(block));
+}
+
+/**
+ * @brief Brief decription of hmac_start().
+ *
+ * Starts a MAC, the message is then hashed into ctx with sign_hash_update()
+ *
+ * @param *key  Prepared key
+ * @param *ctx  Context of the MAC
+ *
+ * @return Doesn't return anything
+ *
+ */
+void hmac_start(const struct hmac_key *key, sign_hash_ctx *ctx) {
+    *ctx = key->inner;
+}
+
+/**
+ * @brief Brief decription of hmac_finish().
+ *
+ * @param *key  Prepared key, the one given to hmac_start()
+ * @param *ctx  Context of the MAC, with the whole message
+ * @param *mac  SIGN_HASH_LEN bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+void hmac_finish(const struct hmac_key *key, sign_hash_ctx *ctx, uint8_t *mac) {
+    uint8_t inner[SIGN_HASH_LEN];
+
+    sign_hash_final(ctx, inner);
+    *ctx = key->outer;
+    sign_hash_update(ctx, inner, SIGN_HASH_LEN);
+    sign_hash_final(ctx, mac);
+}
@@ -0,0 +1,31 @@
+/** @file hmac.h
+ * @brief HMAC-SHA256 (RFC 2104) on the sign_hash.h backends
+ *
+ * The key is hashed into the inner and outer pad contexts once, every
+ * MAC then starts from copies of them. Plain C, also built on the host
+ * by scripts/sign_check.c.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef HMAC_H
+#define HMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sign_hash.h"
+
+/* Structure of a prepared key */
+struct hmac_key {
+    sign_hash_ctx inner;        // After the key XOR ipad block
+    sign_hash_ctx outer;        // After the key XOR opad block
+};
+
+void hmac_setkey(struct hmac_key *key, const uint8_t *secret, size_t len);
+void hmac_start(const struct hmac_key *key, sign_hash_ctx *ctx);
+void hmac_finish(const struct hmac_key *key, sign_hash_ctx *ctx, uint8_t *mac);
+
+#endif /* HMAC_H */
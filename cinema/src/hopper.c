@@ -0,0 +1,280 @@
+/** @file hopper.c
+ * @brief Asynchronous coin hopper payout driver
+ *
+ * One hopper per coin type. Each coin is paid by a HOPPER_PULSE_MS pulse
+ * on the hopper output and confirmed by a pulse of its exit sensor, seen
+ * by a GPIO interrupt. The sequence runs from a delayable work item, so
+ * hopper_payout() only queues the job and the state machine keeps
+ * drawing and reading inputs. A hopper that does not confirm a coin within
+ * HOPPER_EXIT_TIMEOUT_MS is reported as failed and the job moves on to the
+ * next coin type. The result of each job is queued as a hopper_event.
+ * Jobs queued while one is being paid wait for it to end.
+ *
+ * On native_posix the hoppers are wired to free pins of the emulated gpio0.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/gpio.h>
+#include <sys/atomic.h>
+#include <sys/printk.h>
+#include <string.h>
+
+#include "hopper.h"
+#include "power.h"
+
+/* Defines */
+#ifdef CONFIG_ARCH_POSIX
+#define HOPPER_GPIO_NODE DT_NODELABEL(gpio0)    // Emulated port, pins free of the buttons and keypad
+#else
+#define HOPPER_GPIO_NODE DT_NODELABEL(gpio1)
+#endif
+#define HOPPER_PULSE_MS 50              // Output pulse per coin
+#define HOPPER_EXIT_TIMEOUT_MS 1000     // Time for a coin to reach the exit sensor
+#define HOPPER_QUEUE_LEN 4
+#define HOPPER_EVENTS_LEN (HOPPER_QUEUE_LEN + 1)  // Queued payouts and the running one
+
+/* Phases of the coin being paid */
+#define PHASE_IDLE 0
+#define PHASE_PULSE 1       // Output active
+#define PHASE_EXIT 2        // Waiting for the exit sensor
+
+#ifdef CONFIG_ARCH_POSIX
+static const uint8_t hopper_out_pins[N_COINS] = {14,15,16,17};
+static const uint8_t hopper_exit_pins[N_COINS] = {18,19,20,21};
+#else
+static const uint8_t hopper_out_pins[N_COINS] = {4,5,6,7};       /* P1.04..P1.07, hopper outputs */
+static const uint8_t hopper_exit_pins[N_COINS] = {10,11,12,13};  /* P1.10..P1.13, exit sensors */
+#endif
+
+static const struct device * hopper_dev = DEVICE_DT_GET(HOPPER_GPIO_NODE);
+static struct gpio_callback hopper_cb_data;
+
+K_MSGQ_DEFINE(hopper_jobs, N_COINS, HOPPER_QUEUE_LEN, 1);
+K_MSGQ_DEFINE(hopper_events, sizeof(struct hopper_event), HOPPER_EVENTS_LEN, 1);
+
+/* Payouts accepted whose result was not taken yet, at most HOPPER_EVENTS_LEN */
+static atomic_t owed = ATOMIC_INIT(0);
+
+/* Job being paid, only touched by the work item */
+static struct hopper_event job;
+static int coin = 0;
+static int phase = PHASE_IDLE;
+static int64_t pulse_end;
+
+/* Set by the exit sensor interrupt of the active hopper */
+static atomic_t exit_seen = ATOMIC_INIT(0);
+static atomic_t active_pin = ATOMIC_INIT(-1);
+
+static void hopper_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(hopper_work, hopper_work_handler);
+static void next_coin(void);
+
+/**
+ * @brief Brief decription of next_job().
+ *
+ * Takes the next queued payout, if any, and starts its first coin
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void next_job(void) {
+    if(k_msgq_get(&hopper_jobs, job.requested, K_NO_WAIT) == 0) {
+        memset(job.dispensed, 0, sizeof(job.dispensed));
+        job.failed = 0;
+        coin = 0;
+        next_coin();
+    }
+}
+
+/**
+ * @brief Brief decription of next_coin().
+ *
+ * Starts the pulse of the next coin of the job, or ends the job
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void next_coin(void) {
+    while((coin < N_COINS) && (job.dispensed[coin] >= job.requested[coin])) {
+        coin++;
+    }
+    if(coin == N_COINS) {
+        /* Job done; its result has room, hopper_payout() only takes a job while it has */
+        if(k_msgq_put(&hopper_events, &job, K_NO_WAIT) != 0) {
+            printk("Error: hopper event lost\n");
+        }
+        power_activity();   // Wake the state machine to handle the result
+        phase = PHASE_IDLE;
+        next_job();
+        return;
+    }
+    atomic_set(&exit_seen, 0);
+    atomic_set(&active_pin, hopper_exit_pins[coin]);
+    gpio_pin_set(hopper_dev, hopper_out_pins[coin], 1);
+    phase = PHASE_PULSE;
+    pulse_end = k_uptime_get() + HOPPER_PULSE_MS;
+    k_work_reschedule(&hopper_work, K_MSEC(HOPPER_PULSE_MS));
+}
+
+/**
+ * @brief Brief decription of hopper_work_handler().
+ *
+ * Advances the payout: ends the output pulse, then waits for the exit
+ * sensor (the interrupt reschedules the work right away) or the timeout.
+ * A late reschedule from the interrupt can run the handler once more,
+ * so the pulse is only ended at its deadline
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void hopper_work_handler(struct k_work *work) {
+    int64_t left;
+
+    ARG_UNUSED(work);
+
+    switch(phase){
+        case(PHASE_PULSE):
+            left = pulse_end - k_uptime_get();
+            if(left > 0) {
+                k_work_reschedule(&hopper_work, K_MSEC(left));
+                break;
+            }
+            gpio_pin_set(hopper_dev, hopper_out_pins[coin], 0);
+            phase = PHASE_EXIT;
+            /* The coin may have left during the pulse */
+            k_work_reschedule(&hopper_work, atomic_get(&exit_seen) ? K_NO_WAIT : K_MSEC(HOPPER_EXIT_TIMEOUT_MS));
+        break;
+
+        case(PHASE_EXIT):
+            /* 0 -> 2 claims the timeout, the interrupt can no longer confirm the coin */
+            if(atomic_cas(&exit_seen, 0, 2)) {
+                job.failed |= BIT(coin);
+                coin++;     // Empty or jammed, skip the rest of this coin type
+            } else {
+                job.dispensed[coin]++;
+            }
+            atomic_set(&active_pin, -1);
+            next_coin();
+        break;
+
+        default:
+            next_job();
+        break;
+    }
+}
+
+/**
+ * @brief Brief decription of hopper_exit().
+ *
+ * Exit sensor interrupt, confirms the coin of the active hopper
+ *
+ * @param *dev  Pointer to the GPIO Device that triggered the callback
+ * @param *cb   Pointer to the gpio_callback structure
+ * @param pins  Bitmask indicating which pins triggered the callback
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void hopper_exit(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    atomic_val_t pin = atomic_get(&active_pin);
+
+    if((pin >= 0) && (pins & BIT(pin)) && atomic_cas(&exit_seen, 0, 1)) {
+        k_work_reschedule(&hopper_work, K_NO_WAIT);
+    }
+}
+
+/**
+ * @brief Brief decription of hopper_payout().
+ *
+ * Queues a payout, returns immediately. A payout in progress is not
+ * disturbed: its work item is always scheduled (pulse end or exit
+ * timeout) and k_work_schedule() leaves a scheduled item alone, so the
+ * work only runs now when the hoppers are idle. A payout is refused
+ * while HOPPER_EVENTS_LEN results are still owed to hopper_get_event(),
+ * so the result of every payout taken is kept until it is read
+ *
+ * @param coins  Number of coins of each type to pay
+ *
+ * @return 0 on success, -EBUSY if too many payouts are pending
+ *
+ */
+int hopper_payout(const uint8_t coins[N_COINS]) {
+    if(atomic_inc(&owed) >= HOPPER_EVENTS_LEN) {
+        atomic_dec(&owed);
+        return -EBUSY;
+    }
+    if(k_msgq_put(&hopper_jobs, coins, K_NO_WAIT) != 0) {
+        atomic_dec(&owed);
+        return -EBUSY;
+    }
+    k_work_schedule(&hopper_work, K_NO_WAIT);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of hopper_get_event().
+ *
+ * Result of a finished payout, never waits
+ *
+ * @param *event  Filled with the result
+ *
+ * @return 0 if there was a result, -EAGAIN otherwise
+ *
+ */
+int hopper_get_event(struct hopper_event *event) {
+    if(k_msgq_get(&hopper_events, event, K_NO_WAIT) != 0) {
+        return -EAGAIN;
+    }
+    atomic_dec(&owed);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of hopper_init().
+ *
+ * Configures the hopper outputs and the exit sensor interrupts
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int hopper_init(const struct device *dev) {
+    uint32_t pinmask = 0;
+    int ret, i;
+
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(hopper_dev)) {
+        printk("Error: hopper gpio device is not ready\n");
+        return -ENODEV;
+    }
+    for(i=0; i<N_COINS; i++) {
+        ret = gpio_pin_configure(hopper_dev, hopper_out_pins[i], GPIO_OUTPUT_INACTIVE);
+        if(ret < 0) {
+            printk("Error: gpio_pin_configure failed for hopper %d output, error:%d\n\r", i, ret);
+            return ret;
+        }
+        ret = gpio_pin_configure(hopper_dev, hopper_exit_pins[i], GPIO_INPUT | GPIO_PULL_UP);
+        if(ret == 0) {
+            ret = gpio_pin_interrupt_configure(hopper_dev, hopper_exit_pins[i], GPIO_INT_EDGE_TO_ACTIVE);
+        }
+        if(ret < 0) {
+            printk("Error: gpio configuration failed for hopper %d sensor, error:%d\n\r", i, ret);
+            return ret;
+        }
+        pinmask |= BIT(hopper_exit_pins[i]);
+    }
+    gpio_init_callback(&hopper_cb_data, hopper_exit, pinmask);
+    return gpio_add_callback(hopper_dev, &hopper_cb_data);
+}
+
+SYS_INIT(hopper_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
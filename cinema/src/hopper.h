@@ -0,0 +1,32 @@
+/** @file hopper.h
+ * @brief Asynchronous coin hopper payout driver
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef HOPPER_H
+#define HOPPER_H
+
+#include <errno.h>
+#include <stdint.h>
+
+#include "cinema.h"
+
+/* Structure reported to the state machine when a payout ends */
+struct hopper_event {
+    uint8_t requested[N_COINS];
+    uint8_t dispensed[N_COINS];
+    uint8_t failed;             // Bitmask of coin types whose hopper timed out (empty or jammed)
+};
+
+#ifdef CONFIG_CINEMA_HOPPER
+int hopper_payout(const uint8_t coins[N_COINS]);
+int hopper_get_event(struct hopper_event *event);
+#else
+static inline int hopper_payout(const uint8_t coins[N_COINS]) { return 0; }
+static inline int hopper_get_event(struct hopper_event *event) { return -EAGAIN; }
+#endif
+
+#endif /* HOPPER_H */
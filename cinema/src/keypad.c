@@ -0,0 +1,387 @@
+/** @file keypad.c
+ * @brief Matrix keypad of the console station
+ *
+ * A 4x3 phone keypad (1 to 9, *, 0, #) on 7 pins instead of one pin per
+ * key. P1 has not 7 pins left once uart1 (P1.01, P1.02), station 1 or
+ * the hoppers (P1.04 to P1.07, P1.10 to P1.13) and the spi1 MISO of the
+ * display (P1.08) are counted, and P0 has even fewer with the buttons,
+ * the LEDs, the QSPI flash and the display buses, so on the board the
+ * rows are on P1 and the columns on P0.02 and the NFC pins (see the pin
+ * list of the board overlay). While no key is down every row is driven low
+ * and the columns, pulled up, have their interrupt on: the keypad costs
+ * no CPU time until a key closes a column. The interrupt then turns the
+ * columns off and starts a burst of scans in the system work queue, one
+ * row driven at a time every SCAN_MS. A key set is taken when it reads
+ * the same for CONFIG_CINEMA_DEBOUNCE_MS, each key that went down is a
+ * press of station 0 through press_Button(), the same input path as the
+ * buttons: digits are BUT_DIGIT + n, * is RETURN and # is SELECT. Once
+ * every key is up and settled the rows are driven again and the columns
+ * rearmed.
+ *
+ * The rows not being scanned are left floating instead of driven high,
+ * so two keys down in one column do not short two rows. With three keys
+ * down a fourth may read down too (ghosting), such key sets give no press.
+ *
+ * With the GPIO emulator (native_posix) keypad_emul_key() holds a key
+ * down: the column levels are worked out from the rows driven, as the
+ * wires of the matrix would, and the scan runs as on the board.
+ *
+ * Interrupts, scans, keys and ghost key sets are counted in the "keypad"
+ * stats group.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/gpio.h>
+#ifdef CONFIG_GPIO_EMUL
+#include <drivers/gpio/gpio_emul.h>
+#endif
+#include <sys/util.h>
+#include <sys/printk.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "cinema.h"
+#include "keypad.h"
+
+/* Defines */
+#ifdef CONFIG_ARCH_POSIX
+#define ROW_NODE DT_NODELABEL(gpio0)        // Emulated port, pins free of the buttons
+#define COL_NODE DT_NODELABEL(gpio0)
+static const uint8_t row_pins[] = {0,1,2,5};
+static const uint8_t col_pins[] = {6,7,8};
+#else
+#define ROW_NODE DT_NODELABEL(gpio1)        // P1 pins free of uart1, station 1, the hoppers and spi1
+#define COL_NODE DT_NODELABEL(gpio0)        // P0.02 and the NFC pins, free of the buttons, LEDs and displays
+static const uint8_t row_pins[] = {3,9,14,15};
+static const uint8_t col_pins[] = {2,9,10};
+#endif
+#define N_ROWS ARRAY_SIZE(row_pins)
+#define N_COLS ARRAY_SIZE(col_pins)
+#define ALL_ROWS (BIT(N_ROWS) - 1)
+#define SCAN_MS CONFIG_CINEMA_KEYPAD_SCAN_MS
+#define STABLE_SCANS DIV_ROUND_UP(CONFIG_CINEMA_DEBOUNCE_MS, SCAN_MS)
+#define SETTLE_US 5             // Columns follow a row through the pull-ups
+#define MAX_KEYS 2              // More keys down at once may read ghosts
+
+static const char keymap[] = "123456789*0#";    /* Key of each row * N_COLS + column */
+
+static const struct device * row_dev = DEVICE_DT_GET(ROW_NODE);
+static const struct device * col_dev = DEVICE_DT_GET(COL_NODE);
+static struct gpio_callback keypad_cb_data;
+
+/* Scan state, only touched by the work item */
+static uint16_t last;           // Keys down at the last scan, BIT(key)
+static uint16_t down;           // Keys taken as down
+static int stable;              // Scans in a row that read last
+
+#ifdef CONFIG_GPIO_EMUL
+static K_MUTEX_DEFINE(emul_lock);
+static uint16_t held;           // Keys held down by keypad_emul_key()
+static uint8_t driven;          // Rows driven low, BIT(row)
+#endif
+
+static void scan_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(scan_work, scan_handler);
+
+BUILD_ASSERT(sizeof(keymap) - 1 == ARRAY_SIZE(row_pins) * ARRAY_SIZE(col_pins), "one key per crossing");
+
+/* Keypad stats */
+STATS_SECT_START(keypad_stats)
+STATS_SECT_ENTRY32(irqs)
+STATS_SECT_ENTRY32(scans)
+STATS_SECT_ENTRY32(keys)
+STATS_SECT_ENTRY32(ghosts)
+STATS_SECT_END;
+
+STATS_SECT_DECL(keypad_stats) keypad_stats;
+
+STATS_NAME_START(keypad_stats)
+STATS_NAME(keypad_stats, irqs)
+STATS_NAME(keypad_stats, scans)
+STATS_NAME(keypad_stats, keys)
+STATS_NAME(keypad_stats, ghosts)
+STATS_NAME_END(keypad_stats);
+
+#ifdef CONFIG_GPIO_EMUL
+/**
+ * @brief Brief decription of emul_wire().
+ *
+ * Sets the emulated column levels: a column is low when a held key
+ * joins it to a driven row. Called with emul_lock taken
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void emul_wire(void) {
+    int r, c, level;
+
+    for(c=0; c<N_COLS; c++) {
+        level = 1;
+        for(r=0; r<N_ROWS; r++) {
+            if((driven & BIT(r)) && (held & BIT(r * N_COLS + c))) {
+                level = 0;
+            }
+        }
+        gpio_emul_input_set(col_dev, col_pins[c], level);
+    }
+}
+
+/**
+ * @brief Brief decription of keypad_emul_key().
+ *
+ * Holds a key of the emulated keypad down or lets it go, for host tests
+ *
+ * @param key   Key, as printed on it ('0' to '9', '*' or '#')
+ * @param down  true to press the key, false to release it
+ *
+ * @return 0 on success, -EINVAL if the keypad has no such key
+ *
+ */
+int keypad_emul_key(char key, bool down) {
+    const char *k = strchr(keymap, key);
+
+    if((key == '\0') || (k == NULL)) {
+        return -EINVAL;
+    }
+    k_mutex_lock(&emul_lock, K_FOREVER);
+    WRITE_BIT(held, k - keymap, down);
+    emul_wire();
+    k_mutex_unlock(&emul_lock);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Brief decription of drive_rows().
+ *
+ * Drives the rows in mask low, the others float
+ *
+ * @param mask  Rows to drive, BIT(row)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void drive_rows(uint32_t mask) {
+    int r;
+
+    for(r=0; r<N_ROWS; r++) {
+        gpio_pin_configure(row_dev, row_pins[r], (mask & BIT(r)) ? (GPIO_OUTPUT_ACTIVE | GPIO_ACTIVE_LOW) : GPIO_INPUT);
+    }
+#ifdef CONFIG_GPIO_EMUL
+    driven = mask;
+    emul_wire();
+#endif
+}
+
+/**
+ * @brief Brief decription of read_cols().
+ *
+ * @return Columns pulled low, BIT(column)
+ *
+ */
+static uint32_t read_cols(void) {
+    uint32_t level, cols = 0;
+    int c;
+
+    if(gpio_port_get_raw(col_dev, &level) != 0) {
+        return 0;
+    }
+    for(c=0; c<N_COLS; c++) {
+        if(!(level & BIT(col_pins[c]))) {
+            cols |= BIT(c);
+        }
+    }
+    return cols;
+}
+
+/**
+ * @brief Brief decription of arm_cols().
+ *
+ * @param on  true to turn the column interrupts on, false to turn them off
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void arm_cols(bool on) {
+    int c;
+
+    for(c=0; c<N_COLS; c++) {
+        gpio_pin_interrupt_configure(col_dev, col_pins[c], on ? GPIO_INT_EDGE_TO_ACTIVE : GPIO_INT_DISABLE);
+    }
+}
+
+/**
+ * @brief Brief decription of col_pressed().
+ *
+ * Interrupt of the columns, a key closed while the keypad was idle. Turns
+ * the columns off and starts the scan burst
+ *
+ * @param *dev  Pointer to the GPIO Device that triggered the callback
+ * @param *cb   Pointer to the gpio_callback structure
+ * @param pins  Bitmask indicating which pins triggered the callback
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void col_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    ARG_UNUSED(dev);
+    ARG_UNUSED(cb);
+    ARG_UNUSED(pins);
+
+    STATS_INC(keypad_stats, irqs);
+    arm_cols(false);
+    k_work_reschedule(&scan_work, K_NO_WAIT);
+}
+
+/**
+ * @brief Brief decription of key_input().
+ *
+ * @param key  Key, as printed on it
+ *
+ * @return Index of the input it gives, BUT_x
+ *
+ */
+static int key_input(char key) {
+    if(key == '*') {
+        return BUT_RETURN;
+    }
+    if(key == '#') {
+        return BUT_SELECT;
+    }
+    return BUT_DIGIT + (key - '0');
+}
+
+/**
+ * @brief Brief decription of scan_matrix().
+ *
+ * Drives one row at a time and reads the columns, then drives every row
+ * again
+ *
+ * @return Keys down, BIT(row * N_COLS + column)
+ *
+ */
+static uint16_t scan_matrix(void) {
+    uint32_t cols;
+    uint16_t keys = 0;
+    int r, c;
+
+#ifdef CONFIG_GPIO_EMUL
+    k_mutex_lock(&emul_lock, K_FOREVER);
+#endif
+    for(r=0; r<N_ROWS; r++) {
+        drive_rows(BIT(r));
+        k_busy_wait(SETTLE_US);
+        cols = read_cols();
+        for(c=0; c<N_COLS; c++) {
+            if(cols & BIT(c)) {
+                keys |= BIT(r * N_COLS + c);
+            }
+        }
+    }
+    drive_rows(ALL_ROWS);
+#ifdef CONFIG_GPIO_EMUL
+    k_mutex_unlock(&emul_lock);
+#endif
+    return keys;
+}
+
+/**
+ * @brief Brief decription of scan_handler().
+ *
+ * One scan of the burst. A key set read STABLE_SCANS times in a row is
+ * taken, its new keys are pressed. The burst ends when no key is down
+ * and the columns are armed again; a key closed while they were off is
+ * caught by reading them after arming
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void scan_handler(struct k_work *work) {
+    uint16_t keys, fresh;
+    int k;
+
+    ARG_UNUSED(work);
+
+    keys = scan_matrix();
+    STATS_INC(keypad_stats, scans);
+    if(keys != last) {
+        last = keys;
+        stable = 0;
+    } else if(stable < STABLE_SCANS) {
+        stable++;
+    }
+
+    if((stable == STABLE_SCANS) && (keys != down)) {
+        fresh = keys & ~down;
+        if(__builtin_popcount(keys) > MAX_KEYS) {
+            STATS_INC(keypad_stats, ghosts);
+            fresh = 0;
+        }
+        for(k=0; k<ARRAY_SIZE(keymap)-1; k++) {
+            if(fresh & BIT(k)) {
+                STATS_INC(keypad_stats, keys);
+                press_Button(key_input(keymap[k]));
+            }
+        }
+        down = keys;
+    }
+
+    if((stable == STABLE_SCANS) && (keys == 0)) {
+        arm_cols(true);
+        if(read_cols() == 0) {
+            stable = 0;             // The next burst starts unsettled
+            return;                 // Idle until the next key
+        }
+        arm_cols(false);
+    }
+    k_work_schedule(&scan_work, K_MSEC(SCAN_MS));
+}
+
+/**
+ * @brief Brief decription of keypad_init().
+ *
+ * Configures the columns with their pull-ups and interrupt, and drives
+ * every row
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int keypad_init(const struct device *dev) {
+    uint32_t pinmask = 0;
+    int ret = 0, c;
+
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(row_dev) || !device_is_ready(col_dev)) {
+        printk("Error: keypad gpio device is not ready\n");
+        return -ENODEV;
+    }
+    for(c=0; (c<N_COLS) && (ret == 0); c++) {
+        ret = gpio_pin_configure(col_dev, col_pins[c], GPIO_INPUT | GPIO_PULL_UP | GPIO_ACTIVE_LOW);
+    }
+    if(ret < 0) {
+        printk("Error: gpio configuration failed for the keypad, error:%d\n\r", ret);
+        return ret;
+    }
+    drive_rows(ALL_ROWS);
+    for(c=0; c<N_COLS; c++) {
+        pinmask |= BIT(col_pins[c]);
+    }
+    gpio_init_callback(&keypad_cb_data, col_pressed, pinmask);
+    gpio_add_callback(col_dev, &keypad_cb_data);
+    arm_cols(true);
+    return stats_init_and_reg(STATS_HDR(keypad_stats), STATS_SIZE_32, 4,
+                              STATS_NAME_INIT_PARMS(keypad_stats), "keypad");
+}
+
+SYS_INIT(keypad_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
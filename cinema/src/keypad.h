@@ -0,0 +1,18 @@
+/** @file keypad.h
+ * @brief Matrix keypad of the console station
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdbool.h>
+
+#if defined(CONFIG_CINEMA_KEYPAD) && defined(CONFIG_GPIO_EMUL)
+int keypad_emul_key(char key, bool down);
+#endif
+
+#endif /* KEYPAD_H */
@@ -1,7 +1,10 @@
 /** @file main.c
  * @brief main.c file brief decription 
  *
- * Program that emulates a ticket vending machine for a cinema
+ * Program that emulates a ticket vending machine for a cinema.
+ * One MCU can drive CONFIG_CINEMA_TERMINALS customer stations, each
+ * with its own buttons, screen (UART) and transaction, all selling
+ * from the same catalog
  * 
  * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
  * @date 15 May 2023
@@ -13,69 +16,232 @@
 #include <device.h>
 #include <devicetree.h>
 #include <drivers/gpio.h>
+#include <drivers/uart.h>
+#include <sys/atomic.h>
 #include <sys/util.h>
 #include <sys/printk.h>
+#include <stats/stats.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <kernel.h>
 
+#include "cinema.h"
+#include "catalog.h"
+#include "pricing.h"
+#include "snapshot.h"
+#include "sales.h"
+#include "analytics.h"
+#include "change.h"
+#include "hopper.h"
+#include "card.h"
+#include "coin_pulse.h"
+#include "seats.h"
+#include "session_view.h"
+#include "printer.h"
+#include "ticket_sign.h"
+#include "gate.h"
+#include "power.h"
+#include "screen.h"
+#ifdef CONFIG_CINEMA_STACK_REPORT
+#include "stack_report.h"
+#endif
+
 /* Defines */
 #define SLEEP_TIME_MS 300
-#define MAX_SESSIONS 3  // Maximum number of session for one movie
-#define MOVIE_A 0       // Movie A state
-#define MOVIE_B 1       // Movie B state
-#define MENU 2          // Menu state
-#define h_19 0          
-#define h_21 1
-#define h_23 2
+#define MENU 0          // Menu state
+#define MOVIE 1         // Movie state, sessions of the selected movie
+#define TICKET 2        // Ticket type state
+#define CARD 3          // Waiting for the card terminal
+#define SEAT 4          // Waiting for a seat from the other kiosk
+#define QUANTITY 5      // Number of tickets state
+#define N_TERMINALS CONFIG_CINEMA_TERMINALS
+#define TERMINAL_LINE_LEN 128
+#define TERMINAL_PRIORITY 0     // Same as main, which runs station 0
+#define KEY_QUEUE_LEN 64        // Keys typed ahead of the state machine
+#define KEY_ESC 0x1b
+#define DEBOUNCE_MS CONFIG_CINEMA_DEBOUNCE_MS
+#define GROUP_MAX CONFIG_CINEMA_GROUP_MAX     // Tickets per purchase
+#define GROUP_MIN CONFIG_CINEMA_GROUP_MIN     // Tickets that pay the group price
 
 /* Get node ID for GPI0, which has buttons*/
 #define GPIO0_NODE DT_NODELABEL(gpio0)
+#define GPIO1_NODE DT_NODELABEL(gpio1)
 #define LED1_PIN 13
 
+#ifdef CONFIG_CINEMA_COIN_PULSE
+const uint8_t buttons_pins[] = {11,12,24,25}; /*Coins come from the acceptor line on pin 3, see coin_pulse.c*/
+#else
 const uint8_t buttons_pins[] = {11,12,24,25,3,4,28,29}; /*Vector with pins where buttons are connected*/
+#endif
+
+#if N_TERMINALS > 1
+static const uint8_t station1_pins[] = {10,11,12,13,4,5,6,7}; /*Buttons of station 1 on gpio1, same order*/
+#endif
 
 /* Now get the device pointer for GPIO0 */
 static const struct device * gpio0_dev = DEVICE_DT_GET(GPIO0_NODE);
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+static const struct device * console_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+#endif
+
+/* Per station stats: presses seen, time from a press to the end of the redraw that handled it,
+ * rebuilds of the sessions on sale, button interrupts and the button events they gave */
+STATS_SECT_START(terminal_stats)
+STATS_SECT_ENTRY32(presses)
+STATS_SECT_ENTRY32(latency_max_us)
+STATS_SECT_ENTRY32(loop_max_us)
+STATS_SECT_ENTRY32(views)
+STATS_SECT_ENTRY32(irqs)
+STATS_SECT_ENTRY32(accepted)
+STATS_SECT_END;
+
+STATS_NAME_START(terminal_stats)
+STATS_NAME(terminal_stats, presses)
+STATS_NAME(terminal_stats, latency_max_us)
+STATS_NAME(terminal_stats, loop_max_us)
+STATS_NAME(terminal_stats, views)
+STATS_NAME(terminal_stats, irqs)
+STATS_NAME(terminal_stats, accepted)
+STATS_NAME_END(terminal_stats);
+
+/* Structure with the context of one customer station */
+struct terminal {
+    int id;                             // Also the catalog reader index
+    const char *name;
+    const struct device *gpio;          // Port of the buttons
+    const uint8_t *pins;                // Pins of the buttons, BUT_x order
+    int n_pins;
+    const struct device *uart;          // Screen, NULL for the console
+    struct gpio_callback button_cb;     // It defines which pin triggers the callback and the address of the function
+    atomic_t buttons;                   // Pressed buttons, BIT(BUT_x)
+    atomic_t pressed_at;                // Cycle count of the first press not yet drawn, 0 if none
+    atomic_t masked;                    // Pins with the interrupt off until they settle, BIT(pin)
+    atomic_t fresh;                     // Masked pins not yet seen by debounce_handler()
+    uint32_t level;                     // Port level at the last debounce_handler(), 1 is pressed
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+    struct k_msgq keys;                 // Buttons typed on the screen UART, BUT_x
+    char keys_buf[KEY_QUEUE_LEN];
+    uint8_t esc;                        // Bytes of an arrow key escape sequence seen
+#endif
+    STATS_SECT_DECL(terminal_stats) stats;
+
+    /* Transaction */
+    const struct catalog *cat;          // Catalog held for the transaction
+    struct session_view view;           // Movies and sessions of cat still on sale
+    int state;
+    int saldo;
+    int select;
+    int movie;                          // Movie selected
+    int sessao;                         // Session being bought
+    int tipo;                           // Ticket type chosen, TICKET_x
+    int quantidade;                     // Tickets being bought
+    int preco;                          // Price of each of them
+    int custo;                          // Price of the purchase
+    int card_id;                        // Card request being paid
+    bool pay_card;                      // The seat being claimed is paid by card
+    bool holding;                       // Keeps the machine awake, see hold_Power()
+    struct print_job job;               // Ticket being sold, kept off the stack
+    uint64_t seats;                     // Seats of the purchase, see seats_release()
+};
 
-/* It defines which pin triggers the callback and the address of the function */
-static struct gpio_callback button_cb_data;
+#ifdef CONFIG_CINEMA_QR
+static K_MUTEX_DEFINE(qr_lock);         // qr_encode() is shared by the stations
+#endif
 
-/* Variables to use when a button is pressed */
-volatile int But1 = 0;      // UP
-volatile int But2 = 0;      //DOWN
-volatile int But3 = 0;      //SELECT
-volatile int But4 = 0;      //RETURN
-volatile int But5 = 0;      //1 euro
-volatile int But6 = 0;      //2 euros
-volatile int But7 = 0;      //5 euros
-volatile int But8 = 0;      //10 euros
+static struct terminal terminals[N_TERMINALS] = {
+    {
+        .id = 0, .name = "term0",
+        .gpio = DEVICE_DT_GET(GPIO0_NODE), .pins = buttons_pins, .n_pins = sizeof(buttons_pins),
+        .uart = NULL,
+    },
+#if N_TERMINALS > 1
+    {
+        .id = 1, .name = "term1",
+        .gpio = DEVICE_DT_GET(GPIO1_NODE), .pins = station1_pins, .n_pins = sizeof(station1_pins),
+        .uart = DEVICE_DT_GET(DT_CHOSEN(cinema_station1_uart)),
+    },
+#endif
+};
 
 /**
  * @brief Brief decription of reset_Buttons().
  *
- * Resets all the button states to not pressed
+ * Resets all the button states of a station to not pressed
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void reset_Buttons(struct terminal *t) {
+    atomic_clear(&t->buttons);
+}
+
+/**
+ * @brief Brief decription of pressed().
+ *
+ * @param *t   Station
+ * @param but  Button, BUT_x
+ * 
+ * @return true if the button was pressed since the last reset_Buttons()
+ * 
+ */
+static bool pressed(struct terminal *t, int but) {
+    return atomic_test_bit(&t->buttons, but);
+}
+
+/**
+ * @brief Brief decription of terminal_press().
+ *
+ * Marks the button with index i (BUT_UP ... BUT_10EUR, or a keypad digit
+ * BUT_DIGIT + n) of a station as pressed. Every input source (GPIO
+ * interrupt, keypad, scripted load, ...) goes through here so the state
+ * machine sees one single input path
+ * 
+ * @param *t  Station
+ * @param i   Index of the button, BUT_x
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void terminal_press(struct terminal *t, int i) {
+    power_activity();
+
+    if((i >= 0) && (i < N_INPUTS)) {
+        atomic_cas(&t->pressed_at, 0, k_cycle_get_32() | 1);
+        atomic_set_bit(&t->buttons, i);
+    }
+}
+
+/**
+ * @brief Brief decription of press_Button().
+ *
+ * Presses a button of station 0, for the input sources outside main.c
+ * 
+ * @param i  Index of the button, BUT_x
  * 
  * @return Doesn't return anything
  * 
  */
-void reset_Buttons(void) {
-    But1 = 0;
-    But2 = 0;
-    But3 = 0;
-    But4 = 0;
-    But5 = 0;
-    But6 = 0;
-    But7 = 0;
-    But8 = 0;
+void press_Button(int i) {
+    terminal_press(&terminals[0], i);
 }
 
+static void debounce_handler(struct k_work *work);
+
+/* One work item debounces every pin of every station */
+static K_WORK_DELAYABLE_DEFINE(debounce_work, debounce_handler);
+
 /**
  * @brief Brief decription of button_pressed().
  *
  * Interrupt function to detect if a button is pressed and determine what button was pressed.
- * LED1 switches state when a button is pressed
+ * The first edge of a press is the event; the pin interrupt is then turned
+ * off until debounce_handler() sees the pin settled, so the bounces of a
+ * button or a coin switch cost no further interrupts.
+ * LED1 switches state when a button of station 0 is pressed
  * 
  * @param *dev  Pointer to the GPIO Device that triggered the callback
  * @param *cb   Pointer to the gpio_callback structure that contains information about the callback function
@@ -85,60 +251,256 @@ void reset_Buttons(void) {
  * 
  */
 void button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins) {
+    struct terminal *t = CONTAINER_OF(cb, struct terminal, button_cb);
 	int i=0;
 
+    STATS_INC(t->stats, irqs);
+
+    /* An edge latched just before its pin was masked is part of the same bounce */
+    pins &= ~(uint32_t)atomic_get(&t->masked);
+    if(pins == 0) {
+        return;
+    }
+
     /* Toggle led1 */
-	gpio_pin_toggle(gpio0_dev,LED1_PIN);
+    if(t->id == 0) {
+	    gpio_pin_toggle(gpio0_dev,LED1_PIN);
+    }
 
 	/* Identify the button(s) that was(ere) hit*/
-	for(i=0; i<sizeof(buttons_pins); i++){		
-		if(BIT(buttons_pins[i]) & pins) {
+	for(i=0; i<t->n_pins; i++){		
+		if(BIT(t->pins[i]) & pins) {
 			//printk("Button %d pressed\n\r",i+1);
-            switch(i){
-                case(0):
-                    But1 = 1;       //Botao Up
-                break;
+            gpio_pin_interrupt_configure(dev, t->pins[i], GPIO_INT_DISABLE);
+            STATS_INC(t->stats, accepted);
+            terminal_press(t, i);
+		}
+	}
+    atomic_or(&t->fresh, pins);
+    atomic_or(&t->masked, pins);
+    k_work_schedule(&debounce_work, K_MSEC(DEBOUNCE_MS));
+}
+
+/**
+ * @brief Brief decription of debounce_handler().
+ *
+ * Runs every DEBOUNCE_MS while a pin is masked. A pin is settled when it
+ * reads the same level two runs in a row (DEBOUNCE_MS apart); its
+ * interrupt is turned back on once it is settled released. A button held
+ * down stays masked until then, so the bounces of its release are not
+ * presses and one press is one event whatever the contacts do
+ *
+ * @param *work  Debounce work item
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void debounce_handler(struct k_work *work) {
+    struct terminal *t;
+    uint32_t masked, fresh, level, settled, released;
+    bool again = false;
+    int n, i;
+
+    ARG_UNUSED(work);
+
+    for(n=0; n<N_TERMINALS; n++) {
+        t = &terminals[n];
+        masked = atomic_get(&t->masked);
+        if((masked == 0) || (gpio_port_get(t->gpio, &level) != 0)) {
+            continue;
+        }
+        /* Pins masked since the last run only get their level taken */
+        fresh = atomic_and(&t->fresh, ~masked) & masked;
+        settled = masked & ~fresh & ~(level ^ t->level);
+        released = settled & ~level;
+        t->level = level;
+        for(i=0; i<t->n_pins; i++) {
+            if(BIT(t->pins[i]) & released) {
+                atomic_and(&t->masked, ~BIT(t->pins[i]));
+                gpio_pin_interrupt_configure(t->gpio, t->pins[i], GPIO_INT_EDGE_TO_ACTIVE);
+            }
+        }
+        again |= ((masked & ~released) != 0);
+    }
+    if(again) {
+        k_work_schedule(&debounce_work, K_MSEC(DEBOUNCE_MS));
+    }
+}
+
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+/**
+ * @brief Brief decription of key_Button().
+ *
+ * Maps a key typed on the screen of a station to a button: '1' to '8'
+ * are But1 to But8, the arrows are UP and DOWN, Enter is SELECT and
+ * Backspace is RETURN
+ *
+ * @param *t  Station, for the escape sequences
+ * @param c   Byte received
+ *
+ * @return Index of the button, BUT_x, -1 if the key is not a button
+ *
+ */
+static int key_Button(struct terminal *t, uint8_t c) {
+    if(t->esc == 1) {
+        t->esc = (c == '[') ? 2 : 0;
+        return -1;
+    }
+    if(t->esc == 2) {
+        t->esc = 0;
+        return (c == 'A') ? BUT_UP : (c == 'B') ? BUT_DOWN : -1;
+    }
+    if(c == KEY_ESC) {
+        t->esc = 1;
+        return -1;
+    }
+    if((c >= '1') && (c < '1' + N_BUTTONS)) {
+        return c - '1';
+    }
+    if(c == '\r') {
+        return BUT_SELECT;
+    }
+    if((c == '\b') || (c == 0x7f)) {
+        return BUT_RETURN;
+    }
+    return -1;
+}
 
-                case(1):
-                    But2 = 1;       //Botao Down
-                break;
+/**
+ * @brief Brief decription of key_pressed().
+ *
+ * UART interrupt of the screen of a station: queues the keys, which the
+ * state machine takes one per pass (wait_Input()), so keys sent faster
+ * than the screen is drawn are not merged. Keys beyond KEY_QUEUE_LEN
+ * waiting are dropped
+ *
+ * @param *dev        UART device
+ * @param *user_data  Station
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void key_pressed(const struct device *dev, void *user_data) {
+    struct terminal *t = user_data;
+    uint8_t c, key;
+    int but;
 
-                case(2):
-                    But3 = 1;       //Botao Select
-                break;
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(!uart_irq_rx_ready(dev)) {
+            continue;
+        }
+        while(uart_fifo_read(dev, &c, 1) == 1) {
+            but = key_Button(t, c);
+            if(but >= 0) {
+                key = but;
+                k_msgq_put(&t->keys, &key, K_NO_WAIT);
+                power_activity();
+            }
+        }
+    }
+}
+#endif
 
-                case(3):
-                    But4 = 1;       //Botao Return
-                break;
+/**
+ * @brief Brief decription of wait_Input().
+ *
+ * Waits for the next pass of the state machine: SLEEP_TIME_MS, or less
+ * if a key arrives, which is then pressed
+ *
+ * @param *t  Station
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void wait_Input(struct terminal *t) {
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+    uint8_t but;
 
-                case(4):
-                    But5 = 1;       // 1 euro
-                break;
+    if(k_msgq_get(&t->keys, &but, K_MSEC(SLEEP_TIME_MS)) == 0) {
+        terminal_press(t, but);
+    }
+#else
+    k_msleep(SLEEP_TIME_MS);
+#endif
+}
 
-                case(5):
-                    But6 = 1;       //2 euros
-                break;
+/**
+ * @brief Brief decription of config_Terminal().
+ *
+ * Configures the buttons of one station and the interruptions for the same,
+ * and registers its stats
+ * 
+ * @param *t  Station
+ * 
+ * @return 0 on success, negative error code otherwise
+ * 
+ */
+static int config_Terminal(struct terminal *t) {
+	int ret, i;
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+	const struct device *uart;
+#endif
+	uint32_t pinmask = 0; /* Mask for setting the pins that shall generate interrupts */
 
-                case(6):
-                    But7 = 1;       //5 euros
-                break;
+	/* Check if the gpio device of the station is ready */
+	if (!device_is_ready(t->gpio)) {
+		printk("Error: %s gpio device is not ready\n", t->name);
+		return -ENODEV;
+	}
+	if ((t->uart != NULL) && !device_is_ready(t->uart)) {
+		printk("Error: %s uart device is not ready\n", t->name);
+		return -ENODEV;
+	}
 
-                case(7):
-                    But8 = 1;       //10 euros
-                break;
+	/* Use internal pull-up to avoid the need for an external resistor (buttons close to ground, so active low) */
+	for(i=0; i<t->n_pins; i++) {
+		ret = gpio_pin_configure(t->gpio, t->pins[i], GPIO_INPUT | GPIO_PULL_UP | GPIO_ACTIVE_LOW);
+		if (ret < 0) {
+			printk("Error: gpio_pin_configure failed for %s button %d/pin %d, error:%d\n\r", t->name, i+1, t->pins[i], ret);
+			return ret;
+		} else {
+			printk("Success: gpio_pin_configure for %s button %d/pin %d\n\r", t->name, i+1, t->pins[i]);
+		}
+	}
 
-                default:
-                break;
-            }
+	/* Configure the interrupt on the button's pin */
+	for(i=0; i<t->n_pins; i++) {
+		ret = gpio_pin_interrupt_configure(t->gpio, t->pins[i], GPIO_INT_EDGE_TO_ACTIVE );
+		if (ret < 0) {
+			printk("Error: gpio_pin_interrupt_configure failed for %s button %d / pin %d, error:%d", t->name, i+1, t->pins[i], ret);
+			return ret;
 		}
 	}
 
+	/* Initialize the struct gpio_callback of the station */
+	for(i=0; i<t->n_pins; i++) {
+		pinmask |= BIT(t->pins[i]);
+	}
+    gpio_init_callback(&t->button_cb, button_pressed, pinmask); 	
+	
+	/* Add the callback function by calling gpio_add_callback()   */
+	gpio_add_callback(t->gpio, &t->button_cb);
+
+#ifdef CONFIG_CINEMA_CONSOLE_KEYS
+	/* Keys typed on the screen of the station (the console for station 0) */
+	k_msgq_init(&t->keys, t->keys_buf, 1, KEY_QUEUE_LEN);
+	uart = (t->uart != NULL) ? t->uart : console_dev;
+	if (!device_is_ready(uart)) {
+		printk("Error: %s key uart is not ready\n", t->name);
+		return -ENODEV;
+	}
+	uart_irq_callback_user_data_set(uart, key_pressed, t);
+	uart_irq_rx_enable(uart);
+#endif
+
+	return stats_init_and_reg(STATS_HDR(t->stats), STATS_SIZE_32, 6,
+	                          STATS_NAME_INIT_PARMS(terminal_stats), t->name);
 }
 
 /**
  * @brief Brief decription of config().
  *
- * Function to configure the buttons and the interruptions for the same. 
+ * Function to configure the buttons of every station and the interruptions for the same. 
  * Also configures LED1
  * 
  * @return Doesn't return anything
@@ -147,7 +509,6 @@ void button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t
 void config(void) {
     
 	int ret, i;
-	uint32_t pinmask = 0; /* Mask for setting the pins that shall generate interrupts */
 	
 	/* Welcome message */
 	printk("Digital IO accessing IO pins not set via DT (external buttons in the case) \n\r");
@@ -161,311 +522,754 @@ void config(void) {
 		printk("Success: gpio0 device is ready\n");
 	}
 
-    /* Configure the GPIO pins - LED1 for output and buttons 1-4 + IOPINS 2,4,28 and 29 for input
-	 * Use internal pull-up to avoid the need for an external resistor (buttons) */
+    /* Configure the GPIO pins - LED1 for output and the buttons of each station for input */
 	ret = gpio_pin_configure(gpio0_dev,LED1_PIN, GPIO_OUTPUT_ACTIVE);
 	if (ret < 0) {
 		printk("Error: gpio_pin_configure failed for led1, error:%d\n\r", ret);
 		return;
 	}
 
-	for(i=0; i<sizeof(buttons_pins); i++) {
-		ret = gpio_pin_configure(gpio0_dev, buttons_pins[i], GPIO_INPUT | GPIO_PULL_UP);
-		if (ret < 0) {
-			printk("Error: gpio_pin_configure failed for button %d/pin %d, error:%d\n\r", i+1,buttons_pins[i], ret);
-			return;
-		} else {
-			printk("Success: gpio_pin_configure for button %d/pin %d\n\r", i+1,buttons_pins[i]);
-		}
-	}
-
-	/* Configure the interrupt on the button's pin */
-	for(i=0; i<sizeof(buttons_pins); i++) {
-		ret = gpio_pin_interrupt_configure(gpio0_dev, buttons_pins[i], GPIO_INT_EDGE_TO_ACTIVE );
-		if (ret < 0) {
-			printk("Error: gpio_pin_interrupt_configure failed for button %d / pin %d, error:%d", i+1, buttons_pins[i], ret);
+	for(i=0; i<N_TERMINALS; i++) {
+		if (config_Terminal(&terminals[i]) < 0) {
 			return;
 		}
 	}
 
     /* HW init done!*/
 	printk("All devices initialized sucesfully!\n\r");
+}
 
-	/* Initialize the static struct gpio_callback variable   */
-	pinmask=0;
-	for(i=0; i<sizeof(buttons_pins); i++) {
-		pinmask |= BIT(buttons_pins[i]);
-	}
-    gpio_init_callback(&button_cb_data, button_pressed, pinmask); 	
-	
-	/* Add the callback function by calling gpio_add_callback()   */
-	gpio_add_callback(gpio0_dev, &button_cb_data);
+/**
+ * @brief Brief decription of term_print().
+ *
+ * printk() to the screen of a station
+ * 
+ * @param *t    Station
+ * @param *fmt  Format, as printk()
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void term_print(struct terminal *t, const char *fmt, ...) {
+    char line[TERMINAL_LINE_LEN];
+    va_list ap;
+    int len, i;
+
+    va_start(ap, fmt);
+    len = vsnprintk(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if(t->uart == NULL) {
+        printk("%s", line);
+        screen_write(line);         // Drawn on the display by screen_flush()
+    } else {
+        len = MIN(len, (int)sizeof(line) - 1);
+        for(i=0; i<len; i++) {
+            uart_poll_out(t->uart, line[i]);
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of hold_Screen().
+ *
+ * Leaves a message on the screen of a station for a while, the display
+ * of the console station is brought up to date first
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void hold_Screen(struct terminal *t) {
+    if(t->uart == NULL) {
+        screen_flush();
+    }
+    k_msleep(SLEEP_TIME_MS*3);
+}
+
+/**
+ * @brief Brief decription of update_View().
+ *
+ * Brings the sessions on sale of a station up to date, a rebuild only
+ * happens on a new minute of the wall clock or a new catalog
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void update_View(struct terminal *t) {
+    if(session_view_update(&t->view, t->cat)) {
+        STATS_INC(t->stats, views);
+    }
+}
+
+/**
+ * @brief Brief decription of draw_Menu().
+ *
+ * Prints the main menu with the movies that still have sessions on sale
+ * 
+ * @param *t  Station (catalog and its view, movie of the view under the cursor, balance)
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void draw_Menu(struct terminal *t) {
+    int m;
 
+    term_print(t, "------------------------Cinema 3000------------------------\n\n\r");
+    for(m=0; m<t->view.n_movies; m++) {
+        term_print(t, " %s%s\n\n\r", (t->select == m) ? "-> " : "   ", movie_nome(t->cat, t->view.movies[m].movie));
+    }
+    if(t->view.n_movies == 0) {
+        term_print(t, "   Sem sessoes hoje\n\n\r");
+    }
+    term_print(t, " Saldo:%d euros\n\n\n\r",t->saldo);
+}
+
+/**
+ * @brief Brief decription of draw_Movie().
+ *
+ * Prints the menu of one movie with its sessions on sale and normal prices
+ * 
+ * @param *t   Station (catalog, movie shown, session of the view under the
+ *             cursor where n_sessoes is "Voltar atras", balance)
+ * @param *vm  Movie shown, in the view of the station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void draw_Movie(struct terminal *t, const struct view_movie *vm) {
+    int s, sessao;
+
+    term_print(t, "------------------------Cinema 3000------------------------\n\n\r  %s\n\n\r",movie_nome(t->cat, t->movie));
+    for(s=0; s<vm->n_sessoes; s++) {
+        sessao = view_session(&t->view, vm, s);
+        term_print(t, "%s%s%d horas  %d euros\n\n\r", (s == 0) ? "    Sessao : " : "             ",
+               (t->select == s) ? "-> " : "   ", (int)movie_session(t->cat, t->movie, sessao)->horas,
+               price_get(t->cat, session_id(t->cat, t->movie, sessao), TICKET_NORMAL));
+    }
+    term_print(t, "             %sVoltar atras\n\n\r", (t->select == vm->n_sessoes) ? "-> " : "   ");
+    term_print(t, " Saldo:%d euros\n\n\n\r",t->saldo);
+}
+
+/**
+ * @brief Brief decription of draw_Ticket().
+ *
+ * Prints the menu to choose the ticket type of one session
+ * 
+ * @param *t  Station (catalog, movie and session chosen, ticket type under
+ *            the cursor where N_TICKET_TYPES - 1 is "Voltar atras", balance)
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void draw_Ticket(struct terminal *t) {
+    int k, lugares;
+
+    term_print(t, "------------------------Cinema 3000------------------------\n\n\r  %s  %d horas\n\n\r",
+           movie_nome(t->cat, t->movie), (int)movie_session(t->cat, t->movie, t->sessao)->horas);
+    lugares = seats_available(t->cat->versao, session_id(t->cat, t->movie, t->sessao));
+    if(lugares >= 0) {
+        term_print(t, "  Lugares livres:%d\n\n\r", lugares);
+    }
+    /* The group price is not a choice, it comes with the quantity */
+    for(k=0; k<TICKET_BUNDLE; k++) {
+        term_print(t, "%s%s%-10s%d euros\n\n\r", (k == 0) ? "    Bilhete : " : "              ",
+               (t->select == k) ? "-> " : "   ", ticket_names[k],
+               price_get(t->cat, session_id(t->cat, t->movie, t->sessao), k));
+    }
+    term_print(t, "              %sVoltar atras\n\n\r", (t->select == TICKET_BUNDLE) ? "-> " : "   ");
+    term_print(t, " Saldo:%d euros\n\n\n\r",t->saldo);
+}
+
+/**
+ * @brief Brief decription of unit_Price().
+ *
+ * Price of each ticket of the purchase: the price of the type chosen, or
+ * the group price (TICKET_BUNDLE) when at least GROUP_MIN tickets are
+ * bought and it is lower
+ * 
+ * @param *t      Station (session, ticket type chosen)
+ * @param n       Number of tickets
+ * @param *type   Ticket type sold, TICKET_x
+ * 
+ * @return Price of each ticket in euros
+ * 
+ */
+static int unit_Price(struct terminal *t, int n, int *type) {
+    int sid = session_id(t->cat, t->movie, t->sessao);
+    int price = price_get(t->cat, sid, t->tipo);
+
+    *type = t->tipo;
+    if((n >= GROUP_MIN) && (price_get(t->cat, sid, TICKET_BUNDLE) < price)) {
+        *type = TICKET_BUNDLE;
+        price = price_get(t->cat, sid, TICKET_BUNDLE);
+    }
+    return price;
+}
+
+/**
+ * @brief Brief decription of draw_Quantity().
+ *
+ * Prints the menu to choose how many tickets of the type chosen to buy
+ * 
+ * @param *t  Station (session and ticket type chosen, number of tickets
+ *            under the cursor where 0 is "Voltar atras", balance)
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void draw_Quantity(struct terminal *t) {
+    int type, price, lugares;
+
+    term_print(t, "------------------------Cinema 3000------------------------\n\n\r  %s  %d horas\n\n\r",
+           movie_nome(t->cat, t->movie), (int)movie_session(t->cat, t->movie, t->sessao)->horas);
+    lugares = seats_available(t->cat->versao, session_id(t->cat, t->movie, t->sessao));
+    if(lugares >= 0) {
+        term_print(t, "  Lugares livres:%d\n\n\r", lugares);
+    }
+    term_print(t, "    Bilhete : %s\n\n\r", ticket_names[t->tipo]);
+    if(t->select == 0) {
+        term_print(t, " Quantidade : -> Voltar atras\n\n\r");
+    } else {
+        price = unit_Price(t, t->select, &type);
+        term_print(t, " Quantidade : -> %d x %d euros = %d euros%s\n\n\r", t->select, price,
+               t->select * price, (type == TICKET_BUNDLE) ? " (Grupo)" : "");
+    }
+    term_print(t, "              UP/DOWN ou teclado, 1 a %d\n\n\r", GROUP_MAX);
+    term_print(t, " Saldo:%d euros\n\n\n\r",t->saldo);
+}
+
+/**
+ * @brief Brief decription of insert_Coin().
+ *
+ * Credits one coin to the customer and adds it to the coin stock. The
+ * acceptor only reports a coin it already took, so every coin is
+ * credited; the balance above CHANGE_MAX is paid back at once
+ * 
+ * @param *t    Station, its balance is credited
+ * @param coin  Coin type, COIN_x
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void insert_Coin(struct terminal *t, int coin) {
+    uint8_t coins[N_COINS];
+    int excess;
+
+    t->saldo += coin_values[coin];
+    change_coin_in(coin);
+    analytics_coin(coin);
+
+    /* Change is only known up to CHANGE_MAX euros */
+    excess = t->saldo - CHANGE_MAX;
+    if(excess <= 0) {
+        return;
+    }
+    if(change_make(excess, coins) != 0) {
+        term_print(t, "Saldo acima de %d euros, sem troco. Chamar funcionario\n\n\r",CHANGE_MAX);
+    } else if(hopper_payout(coins) != 0) {
+        /* Hoppers still busy with earlier payouts, the balance stays credited */
+        change_return(coins);
+        term_print(t, "Saldo acima de %d euros. Chamar funcionario\n\n\r",CHANGE_MAX);
+    } else {
+        t->saldo -= excess;
+        term_print(t, "Saldo maximo %d euros. %d euros devolvidos\n\n\r",CHANGE_MAX,excess);
+    }
+    hold_Screen(t);
+}
+
+/**
+ * @brief Brief decription of sell_Tickets().
+ *
+ * Records the sale of every ticket of the purchase and queues them for
+ * printing, the printer works in the background. Each ticket keeps its
+ * own number and signature, the door checks them one by one
+ * 
+ * @param *t  Station, with the seats already taken and the purchase paid
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void sell_Tickets(struct terminal *t) {
+    int sid = session_id(t->cat, t->movie, t->sessao);
+    struct print_job *job = &t->job;
+    int i, type;
+#ifdef CONFIG_CINEMA_QR
+    char code[QR_MAX_PAYLOAD + 1], hex[TICKET_SIG_HEX] = "";
+    int len;
+#endif
+
+    unit_Price(t, t->quantidade, &type);
+    for(i=0; i<t->quantidade; i++) {
+        memset(job, 0, sizeof(*job));
+        job->horas = movie_session(t->cat, t->movie, t->sessao)->horas;
+        job->price = t->preco;
+        job->station = t->id;
+        job->seq = sales_record(t->cat->versao, sid, type, t->preco);
+        analytics_sale(t->cat->versao, sid, t->preco);
+        strncpy(job->filme, movie_nome(t->cat, t->movie), sizeof(job->filme) - 1);
+        strncpy(job->tipo, ticket_names[type], sizeof(job->tipo) - 1);
+#ifdef CONFIG_CINEMA_SIGN
+        if(ticket_sign(job->seq, t->cat->versao, sid, t->preco, job->sig) != 0) {
+            printk("Error: ticket %06u not signed\n", (unsigned int)job->seq);
+        }
+#endif
+#ifdef CONFIG_CINEMA_QR
+#ifdef CONFIG_CINEMA_SIGN
+        ticket_sig_hex(job->sig, hex);
+#endif
+        /* Everything the door needs to check the signature: kiosk, ticket, catalog, session and price */
+        len = snprintf(code, sizeof(code), "CINEMA3000/%d/%06u/%u/%d/%d/%s", SEAT_KIOSK_ID,
+                       (unsigned int)job->seq, (unsigned int)t->cat->versao, sid, t->preco, hex);
+        k_mutex_lock(&qr_lock, K_FOREVER);
+        if(qr_encode((const uint8_t *)code, len, &job->code) != 0) {
+            job->code.size = 0;
+        }
+        k_mutex_unlock(&qr_lock);
+#endif
+        if(printer_submit(job) != 0) {
+            term_print(t, "Bilhete %06u nao impresso, chamar funcionario\n\r",(unsigned int)job->seq);
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of handle_Coins().
+ *
+ * Handles the buttons that are the same in every state: return and coins
+ * (coin buttons or coins decoded from the pulse acceptor)
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void handle_Coins(struct terminal *t) {
+    uint8_t coins[N_COINS];
+    int c;
+
+    /* Every coin of the pulse acceptor is queued, several may arrive between polls.
+     * The acceptor, like the hoppers and the card terminal, belongs to station 0 */
+    while((t->id == 0) && ((c = coin_pulse_get()) >= 0)) {
+        insert_Coin(t, c);
+    }
+
+    if(pressed(t, BUT_RETURN)) {          //Return 
+        /* Every balance is payable: the change of each purchase was reserved when it was checked */
+        if(change_reserve(t->id, t->saldo) != 0) {
+            term_print(t, "Sem troco para %d euros, chamar funcionario",t->saldo);
+        } else {
+            change_commit(t->id, coins);
+            if(hopper_payout(coins) != 0) {
+                /* Hoppers still busy with earlier payouts */
+                change_return(coins);
+                term_print(t, "Aguarde, troco a ser devolvido");
+            } else {
+                term_print(t, "%d euros devolvidos",t->saldo);
+                for(c=N_COINS-1; c>=0; c--) {
+                    if(coins[c] > 0) {
+                        term_print(t, " %dx%d",coins[c],coin_values[c]);
+                    }
+                }
+                t->saldo = 0;
+            }
+        }
+        reset_Buttons(t);
+        hold_Screen(t);
+    }
+    if(pressed(t, BUT_1EUR)) {          //1 euro
+        insert_Coin(t, COIN_1EUR);
+        reset_Buttons(t);
+    }
+    if(pressed(t, BUT_2EUR)) {          //2 euros
+        insert_Coin(t, COIN_2EUR);
+        reset_Buttons(t);
+    }
+    if(pressed(t, BUT_5EUR)) {          //5 euros
+        insert_Coin(t, COIN_5EUR);
+        reset_Buttons(t);
+    }
+    if(pressed(t, BUT_10EUR)) {          //10 euros
+        insert_Coin(t, COIN_10EUR);
+        reset_Buttons(t);
+    }
+}
+
+/**
+ * @brief Brief decription of keep_Change().
+ *
+ * A purchase that did not go through gives back the change it reserved:
+ * the reservation covers the whole balance again. If the other station
+ * took those coins meanwhile the smaller reservation is kept
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void keep_Change(struct terminal *t) {
+    (void)change_reserve(t->id, t->saldo);
+}
+
+/**
+ * @brief Brief decription of handle_Payout().
+ *
+ * Checks the result of the change being paid by the hoppers. An empty or
+ * jammed hopper takes its coin type out of the stock and the missing
+ * amount is paid again with the other coin types when possible
+ * (the hoppers are only built with a single station)
+ *
+ * @param *t  Station
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void handle_Payout(struct terminal *t) {
+    struct hopper_event event;
+    uint8_t coins[N_COINS];
+    int c, falta = 0;
+
+    if(hopper_get_event(&event) != 0) {
+        return;
+    }
+    for(c=0; c<N_COINS; c++) {
+        falta += (event.requested[c] - event.dispensed[c]) * coin_values[c];
+        if(event.failed & BIT(c)) {
+            change_empty(c);
+        }
+    }
+    if(falta == 0) {
+        return;
+    }
+    if((change_make(falta, coins) == 0) && (hopper_payout(coins) == 0)) {
+        return;
+    }
+    term_print(t, "Faltam %d euros de troco, chamar funcionario",falta);
+    hold_Screen(t);
+}
+
+/**
+ * @brief Brief decription of hold_Power().
+ *
+ * While a station waits on the other kiosk (SEAT) or on the card terminal
+ * (CARD) no input comes, the machine is kept out of idle until the
+ * transaction ends
+ * 
+ * @param *t  Station
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void hold_Power(struct terminal *t) {
+    bool busy = (t->state == SEAT) || (t->state == CARD);
+
+    if(busy && !t->holding) {
+        power_hold();
+    } else if(!busy && t->holding) {
+        power_release();
+    }
+    t->holding = busy;
 }
 
 /**
  * @brief Brief decription of StateMachine().
  *
- * Function which handles the state machine and all the events/actions that happen inside it
+ * Function which handles the state machine of one station and all the events/actions that happen inside it
+ * 
+ * @param *t  Station
  * 
  * @return Doesn't return anything
  * 
  */
-void StateMachine(void) {
-    /* Structure to define hours and price for each session */
-    struct session {
-        int horas;
-        int custo;
-    };
-
-    struct session movie_a[] = {
-        {19,9},
-        {21,11},
-        {23,9}
-    };
-
-    struct session movie_b[] = {
-        {19,10},
-        {21,12}
-    };
-    
-    int state = MENU;
-    int saldo = 0;
-    int select = 0;
+void StateMachine(struct terminal *t) {
+    struct card_event card;
+    const struct view_movie *vm;
+    uint32_t since, start, us;
+    atomic_val_t seen;
+    int ret, m;
 
+    t->cat = snapshot_acquire(t->id);
+    t->state = MENU;
 
     while(1) {
-        k_msleep(SLEEP_TIME_MS);
-        switch(state){
+        /* After a deep-idle the last screen is redrawn right away.
+         * Station 0 holds the idle policy, activity on any station keeps it awake */
+        if((t->id != 0) || !power_idle()) {
+            wait_Input(t);
+        }
+        since = atomic_get(&t->pressed_at);
+        seen = atomic_get(&t->buttons);
+        start = k_cycle_get_32();
+        term_print(t, "\033[2J\033[H");
+        switch(t->state){
             case MENU:
-                printk("\033[2J\033[H");
-                if(select == 0) {   //menu filme A selecionado
-                    printk("------------------------Cinema 3000------------------------\n\n\r -> Filme A\n\n\r    Filme B\n\n\r Saldo:%d euros\n\n\n\r",saldo);
-                }
-                if(select == 1) {   //menu filme B selecionado
-                    printk("------------------------Cinema 3000------------------------\n\n\r    Filme A\n\n\r -> Filme B\n\n\r Saldo:%d euros\n\n\n\r",saldo);
+                /* Between transactions: pick up the latest catalog and prices */
+                t->cat = snapshot_acquire(t->id);
+                update_View(t);
+                if(t->select >= t->view.n_movies) {
+                    t->select = 0;
                 }
+                draw_Menu(t);
                                 
-                if(But1) {          //UP mudar select
-                    if(select == 1) {
-                        select=0;
+                if(pressed(t, BUT_UP)) {          //UP mudar select
+                    if(t->select > 0) {
+                        t->select--;
                     }
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But2) {          //DOWN mudar select
-                    if(select == 0) {
-                        select=1;
+                if(pressed(t, BUT_DOWN)) {          //DOWN mudar select
+                    if(t->select < t->view.n_movies - 1) {
+                        t->select++;
                     }
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But3) {          //Select
-                    if(select == 0){
-                        state = MOVIE_A;
-                        select = 0;
-                    }else{
-                        state = MOVIE_B;
-                        select = 0;
+                if(pressed(t, BUT_SELECT)) {          //Select
+                    if(t->view.n_movies > 0) {
+                        t->movie = t->view.movies[t->select].movie;
+                        t->state = MOVIE;
+                        t->select = 0;
                     }
-                    reset_Buttons();
-                }
-                if(But4) {          //Return 
-                    printk("%d euros devolvidos",saldo);
-                    saldo = 0;
-                    reset_Buttons();
-                    k_msleep(SLEEP_TIME_MS*3);
-                }
-                if(But5) {          //1 euro
-                    saldo++;
-                    reset_Buttons();
-                }
-                if(But6) {          //2 euros
-                    saldo += 2;
-                    reset_Buttons();
-                }
-                if(But7) {          //5 euros
-                    saldo += 5;
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But8) {          //10 euros
-                    saldo += 10;
-                    reset_Buttons();
-                }
-
             break;
 
-            case MOVIE_A:
-                printk("\033[2J\033[H");
-                if(select == 0) {   //movie A sessao 19 horas
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme A\n\n\r    Sessao : -> 19 horas  %d euros\n\n\r                21 horas  %d euros\n\n\r                23 horas  %d euros\n\n\r                Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_a[h_19].custo,movie_a[h_21].custo,movie_a[h_23].custo,saldo);
-                }
-                if(select == 1) {   //movie A sessao 21 horas
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme A\n\n\r    Sessao :    19 horas  %d euros\n\n\r             -> 21 horas  %d euros\n\n\r                23 horas  %d euros\n\n\r                Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_a[h_19].custo,movie_a[h_21].custo,movie_a[h_23].custo,saldo);
+            case MOVIE:
+                /* Sessions that start while the customer looks at them are taken off the list */
+                update_View(t);
+                m = session_view_find(&t->view, t->movie);
+                if(m < 0) {
+                    term_print(t, "Sessoes ja iniciadas\n\n\r");
+                    t->select = 0;
+                    t->state = MENU;
+                    hold_Screen(t);
+                    break;
                 }
-                if(select == 2) {   //movie A sessao 23 horas
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme A\n\n\r    Sessao :    19 horas  %d euros\n\n\r                21 horas  %d euros\n\n\r             -> 23 horas  %d euros\n\n\r                Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_a[h_19].custo,movie_a[h_21].custo,movie_a[h_23].custo,saldo);
+                vm = &t->view.movies[m];
+                if(t->select > vm->n_sessoes) {
+                    t->select = vm->n_sessoes;
                 }
-                if(select == 3) {   //movie A voltar atras
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme A\n\n\r    Sessao :    19 horas  %d euros\n\n\r                21 horas  %d euros\n\n\r                23 horas  %d euros\n\n\r             -> Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_a[h_19].custo,movie_a[h_21].custo,movie_a[h_23].custo,saldo);
-                }
-                if(But1) {          //UP mudar select
-                    if((select == 1) || (select == 2) || (select == 3)) {
-                        select--;
+                draw_Movie(t, vm);
+
+                if(pressed(t, BUT_UP)) {          //UP mudar select
+                    if(t->select > 0) {
+                        t->select--;
                     }
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But2) {          //DOWN mudar select
-                    if((select == 0) || (select == 1) || (select == 2))  {
-                        select++;
+                if(pressed(t, BUT_DOWN)) {          //DOWN mudar select
+                    if(t->select < vm->n_sessoes)  {
+                        t->select++;
                     }
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But3) {          //Select
-                    if(select == 0){
-                        if(saldo >= movie_a[h_19].custo){
-                            saldo -= movie_a[h_19].custo;
-                            state = 0;
-                            state = MENU;
-                            printk("Bilhete comprado para Filme A as %d horas.\n\rSaldo:%d\n\n\r",movie_a[h_19].horas, saldo);
-                        }else{
-                            printk("Saldo insuficiente. Inserir %d euros\n\n\r",(movie_a[h_19].custo-saldo));
-                        }
-                        k_msleep(SLEEP_TIME_MS*3);
-                    }
-                    if(select == 1){
-                        if(saldo >= movie_a[h_21].custo){
-                            saldo -= movie_a[h_21].custo;
-                            select = 0;
-                            state = MENU;
-                            printk("Bilhete comprado para Filme A as %d horas.\n\rSaldo:%d\n\n\r",movie_a[h_21].horas, saldo);
-                        }else{
-                            printk("Saldo insuficiente. Inserir %d euros\n\n\r",(movie_a[h_21].custo-saldo));
-                        }
-                        k_msleep(SLEEP_TIME_MS*3);
+                if(pressed(t, BUT_SELECT)) {          //Select
+                    if(t->select == vm->n_sessoes) {   //Voltar atras
+                        t->select = m;
+                        t->state = MENU;
+                    } else {
+                        t->sessao = view_session(&t->view, vm, t->select);
+                        t->select = TICKET_NORMAL;
+                        t->state = TICKET;
                     }
-                    if(select == 2){
-                        if(saldo >= movie_a[h_23].custo){
-                            saldo -= movie_a[h_23].custo;
-                            select = 0;
-                            state = MENU;
-                            printk("Bilhete comprado para Filme A as %d horas.\n\rSaldo:%d\n\n\r",movie_a[h_23].horas, saldo);
-                        }else{
-                            printk("Saldo insuficiente. Inserir %d euros\n\n\r",(movie_a[h_23].custo-saldo));
-                        }
-                        k_msleep(SLEEP_TIME_MS*3);
-                    }
-                    if(select == 3){
-                        select = 0;
-                        state = MENU;
-                    }
-                    reset_Buttons();
-                }
-                if(But4) {          //Return 
-                    printk("%d euros devolvidos",saldo);
-                    saldo = 0;
-                    reset_Buttons();
-                    k_msleep(SLEEP_TIME_MS*3);
+                    reset_Buttons(t);
                 }
-                if(But5) {          //1 euro
-                    saldo++;
-                    reset_Buttons();
-                }
-                if(But6) {          //2 euros
-                    saldo += 2;
-                    reset_Buttons();
+            break;
+
+            case TICKET:
+                draw_Ticket(t);
+
+                if(pressed(t, BUT_UP)) {          //UP mudar select
+                    if(t->select > 0) {
+                        t->select--;
+                    }
+                    reset_Buttons(t);
                 }
-                if(But7) {          //5 euros
-                    saldo += 5;
-                    reset_Buttons();
+                if(pressed(t, BUT_DOWN)) {          //DOWN mudar select
+                    if(t->select < TICKET_BUNDLE) {
+                        t->select++;
+                    }
+                    reset_Buttons(t);
                 }
-                if(But8) {          //10 euros
-                    saldo += 10;
-                    reset_Buttons();
+                if(pressed(t, BUT_SELECT)) {          //Select
+                    if(t->select == TICKET_BUNDLE) {   //Voltar atras
+                        t->state = MOVIE;
+                        m = session_view_find(&t->view, t->movie);
+                        t->select = (m < 0) ? 0 : MAX(view_find_session(&t->view, &t->view.movies[m], t->sessao), 0);
+                    } else {
+                        t->tipo = t->select;
+                        t->select = 1;
+                        t->state = QUANTITY;
+                    }
+                    reset_Buttons(t);
                 }
             break;
 
-            case MOVIE_B:
-                
-                printk("\033[2J\033[H");
-                if(select == 0) {   //movie B sessao 19 horas
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme B\n\n\r    Sessao : -> 19 horas  %d euros\n\n\r                21 horas  %d euros\n\n\r                Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_b[h_19].custo,movie_b[h_21].custo,saldo);
-                }
-                if(select == 1) {   //movie B sessao 21 horas
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme B\n\n\r    Sessao :    19 horas  %d euros\n\n\r             -> 21 horas  %d euros\n\n\r                Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_b[h_19].custo,movie_b[h_21].custo,saldo);
-                }
-                if(select == 2) {   //movie B voltar
-                    printk("------------------------Cinema 3000------------------------\n\n\r  Filme B\n\n\r    Sessao :    19 horas  %d euros\n\n\r                21 horas  %d euros\n\n\r             -> Voltar atras\n\n\r Saldo:%d euros\n\n\n\r",movie_b[h_19].custo,movie_b[h_21].custo,saldo);
+            case QUANTITY:
+                draw_Quantity(t);
+
+                if(pressed(t, BUT_UP)) {          //UP mais bilhetes
+                    if(t->select < GROUP_MAX) {
+                        t->select++;
+                    }
+                    reset_Buttons(t);
                 }
-                if(But1) {          //UP mudar select
-                    if((select == 1) || (select == 2)) {
-                        select--;
+                if(pressed(t, BUT_DOWN)) {          //DOWN menos bilhetes
+                    if(t->select > 0) {
+                        t->select--;
                     }
-                    reset_Buttons();
+                    reset_Buttons(t);
                 }
-                if(But2) {          //DOWN mudar select
-                    if((select == 0) || (select == 1))  {
-                        select++;
+                for(m=0; m<=MIN(GROUP_MAX, 9); m++) {          //Teclado, 0 volta atras
+                    if(pressed(t, BUT_DIGIT + m)) {
+                        t->select = m;
+                        reset_Buttons(t);
                     }
-                    reset_Buttons();
                 }
-                if(But3) {          //Select
-                    if(select == 0){
-                        if(saldo >= movie_b[h_19].custo){
-                            saldo -= movie_b[h_19].custo;
-                            select = 0;
-                            state = MENU;
-                            printk("Bilhete comprado para Filme B as %d horas.\n\rSaldo:%d\n\n\r",movie_b[h_19].horas, saldo);
-                        }else{
-                            printk("Saldo insuficiente. Inserir %d euros\n\n\r",(movie_b[h_19].custo-saldo));
-                        }
-                        k_msleep(SLEEP_TIME_MS*3);
+                if(pressed(t, BUT_SELECT)) {          //Select
+                    if(t->select == 0) {   //Voltar atras
+                        t->select = t->tipo;
+                        t->state = TICKET;
+                        reset_Buttons(t);
+                        break;
                     }
-                    if(select == 1){
-                        if(saldo >= movie_b[h_21].custo){
-                            saldo -= movie_b[h_21].custo;
-                            select = 0;
-                            state = MENU;
-                            printk("Bilhete comprado para Filme B as %d horas.\n\rSaldo:%d\n\n\r",movie_b[h_21].horas, saldo);
-                        }else{
-                            printk("Saldo insuficiente. Inserir %d euros\n\n\r",(movie_b[h_21].custo-saldo));
-                        }
-                        k_msleep(SLEEP_TIME_MS*3);
+                    /* One check, one seat claim and one payment for every ticket */
+                    t->quantidade = t->select;
+                    t->preco = unit_Price(t, t->quantidade, &m);
+                    t->custo = t->quantidade * t->preco;
+                    if(printer_full(t->quantidade)){
+                        term_print(t, "Impressora ocupada, aguarde\n\n\r");
+                    }else if((t->saldo >= t->custo) && (change_reserve(t->id, t->saldo - t->custo) != 0)){
+                        term_print(t, "Sem troco para %d euros. Inserir o valor exato\n\n\r",(t->saldo-t->custo));
+                    }else if((t->saldo >= t->custo) || ((t->saldo == 0) && IS_ENABLED(CONFIG_CINEMA_CARD))){
+                        /* The seats first, then the payment (no coins inserted: with the card terminal) */
+                        t->pay_card = (t->saldo < t->custo);
+                        t->state = SEAT;
+                        reset_Buttons(t);
+                        break;
+                    }else{
+                        term_print(t, "Saldo insuficiente. Inserir %d euros\n\n\r",(t->custo-t->saldo));
                     }
-                    if(select == 2) {
-                        select = 0;
-                        state = MENU;
+                    hold_Screen(t);
+                    reset_Buttons(t);
+                }
+            break;
+
+            case SEAT:
+                /* All the seats of the purchase or none */
+                ret = seats_claim(t->cat->versao, session_id(t->cat, t->movie, t->sessao), t->quantidade, &t->seats);
+                if(ret == -EINPROGRESS) {
+                    term_print(t, "A reservar %d lugar(es)...\n\n\rReturn para cancelar\n\r",t->quantidade);
+                    if(pressed(t, BUT_RETURN)) {          //Return cancela
+                        keep_Change(t);
+                        t->state = QUANTITY;
+                        reset_Buttons(t);
                     }
-                    reset_Buttons();
+                    break;
                 }
-                if(But4) {          //Return 
-                    printk("%d euros devolvidos",saldo);
-                    saldo = 0;
-                    reset_Buttons();
-                    k_msleep(SLEEP_TIME_MS*3);
+                if(ret != 0) {
+                    keep_Change(t);
+                    term_print(t, "%s\n\n\r",(ret != -ENOSPC) ? "Sem ligacao ao outro terminal" :
+                                         (t->quantidade == 1) ? "Sessao esgotada" : "Lugares insuficientes");
+                    t->state = QUANTITY;
+                } else if(!t->pay_card) {
+                    t->saldo -= t->custo;
+                    sell_Tickets(t);
+                    t->select = 0;
+                    t->state = MENU;
+                    term_print(t, "%d bilhete(s) comprado(s) para %s as %d horas.\n\rSaldo:%d\n\n\r",t->quantidade,movie_nome(t->cat, t->movie),(int)movie_session(t->cat, t->movie, t->sessao)->horas, t->saldo);
+                } else if((t->card_id = card_authorize(t->custo)) > 0) {
+                    t->state = CARD;
+                    break;
+                } else {
+                    seats_release(t->cat->versao, session_id(t->cat, t->movie, t->sessao), t->seats);
+                    term_print(t, "Pagamento com cartao indisponivel\n\n\r");
+                    t->state = QUANTITY;
                 }
-                if(But5) {          //1 euro
-                    saldo++;
-                    reset_Buttons();
+                hold_Screen(t);
+            break;
+
+            case CARD:
+                term_print(t, "Pagamento com cartao: %d euros\n\rAguarde...\n\n\rReturn para cancelar\n\r",t->custo);
+
+                if(pressed(t, BUT_RETURN)) {          //Return cancela, o resultado chega como evento
+                    card_cancel(t->card_id);
+                    reset_Buttons(t);
                 }
-                if(But6) {          //2 euros
-                    saldo += 2;
-                    reset_Buttons();
+                if(card_get_event(&card) != 0) {
+                    break;
                 }
-                if(But7) {          //5 euros
-                    saldo += 5;
-                    reset_Buttons();
+                if(card.id != t->card_id) {
+                    /* Answer to a request no purchase waits for any more, nothing was sold */
+                    if(card.result == CARD_APPROVED) {
+                        card_reverse(card.id);
+                    }
+                    break;
                 }
-                if(But8) {          //10 euros
-                    saldo += 10;
-                    reset_Buttons();
+                if(card.result == CARD_APPROVED) {
+                    sell_Tickets(t);
+                    term_print(t, "%d bilhete(s) comprado(s) para %s as %d horas.\n\rAutorizacao:%06u\n\n\r",t->quantidade,movie_nome(t->cat, t->movie),(int)movie_session(t->cat, t->movie, t->sessao)->horas,(unsigned int)card.auth);
+                    t->select = 0;
+                    t->state = MENU;
+                } else {
+                    seats_release(t->cat->versao, session_id(t->cat, t->movie, t->sessao), t->seats);
+                    term_print(t, "%s\n\n\r",(card.result == CARD_DECLINED) ? "Cartao recusado" :
+                                         (card.result == CARD_CANCELLED) ? "Pagamento cancelado" : "Terminal sem resposta");
+                    t->state = QUANTITY;
                 }
+                hold_Screen(t);
             break;
 
             default:
             break;
         }
+        hold_Power(t);
+        handle_Coins(t);
+        handle_Payout(t);
+        /* Keys this state has no use for are dropped, not kept for a later one.
+         * Keys pressed during the pass are left for the next pass */
+        atomic_and(&t->buttons, ~seen);
+        if(t->uart == NULL) {
+            screen_flush();         // Only the cells that changed reach the display
+        }
+
+        /* Worst case response of the station, with every station busy */
+        us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+        if(us > t->stats.loop_max_us) {
+            STATS_SET(t->stats, loop_max_us, us);
+        }
+        if((since != 0) && atomic_cas(&t->pressed_at, since, 0)) {
+            us = k_cyc_to_us_floor32(k_cycle_get_32() - since);
+            STATS_INC(t->stats, presses);
+            if(us > t->stats.latency_max_us) {
+                STATS_SET(t->stats, latency_max_us, us);
+            }
+        }
     }
 }
 
+#if N_TERMINALS > 1
+/**
+ * @brief Brief decription of terminal_thread().
+ *
+ * Runs the state machine of station 1, station 0 runs in main()
+ * 
+ * @return Doesn't return anything
+ * 
+ */
+static void terminal_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    StateMachine(&terminals[1]);
+}
+
+K_THREAD_DEFINE(terminal1, CONFIG_MAIN_STACK_SIZE, terminal_thread, NULL, NULL, NULL,
+                TERMINAL_PRIORITY, 0, K_TICKS_FOREVER);
+#endif
+
 /**
  * @brief Brief decription of main().
  *
@@ -479,6 +1283,15 @@ void StateMachine(void) {
 int main(void) {
     config();
     k_msleep(SLEEP_TIME_MS*10);
-    StateMachine();
+#ifdef CONFIG_CINEMA_GATE
+    gate_run();         // Door validator, nothing is sold
+#endif
+#ifdef CONFIG_CINEMA_STACK_REPORT
+    stack_report_start();
+#endif
+#if N_TERMINALS > 1
+    k_thread_start(terminal1);
+#endif
+    StateMachine(&terminals[0]);
     return 0;
 }
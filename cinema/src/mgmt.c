@@ -0,0 +1,454 @@
+/** @file mgmt.c
+ * @brief Framed binary management protocol
+ *
+ * Management channel on the UART chosen as cinema,mgmt-uart (see mgmt.h
+ * for the frame format). Bytes are received and sent by interrupts
+ * through a frame queue and a TX ring buffer, and commands run in a low
+ * priority thread, so long exports (sales record) stream back to back at
+ * line rate and the state machine never waits for them.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+#include <sys/printk.h>
+#include <sys/ring_buffer.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "mgmt.h"
+#include "cobs.h"
+#include "sales.h"
+#include "analytics.h"
+#include "snapshot.h"
+#include "wallclock.h"
+#ifdef CONFIG_CINEMA_CATALOG_UPDATE
+#include "catalog_update.h"
+#endif
+
+/* Defines */
+#define MGMT_UART_NODE DT_CHOSEN(cinema_mgmt_uart)
+#define MGMT_STACK_SIZE 1024
+#define MGMT_PRIORITY 10            // Below the state machine
+#define MGMT_RX_QUEUE_LEN 4
+#define MGMT_TX_BUF_SIZE 512
+#define MGMT_HDR_LEN 2              // cmd, seq
+#define MGMT_CRC_LEN 2
+#define MGMT_MAX_PAYLOAD (MGMT_MAX_FRAME - MGMT_HDR_LEN - MGMT_CRC_LEN)
+#define SALES_PER_FRAME (MGMT_MAX_PAYLOAD / sizeof(struct sale))
+#define HOURS_PER_FRAME ((MGMT_MAX_PAYLOAD - 1) / sizeof(struct hour_bucket))
+#define SESSIONS_PER_FRAME ((MGMT_MAX_PAYLOAD - 1 - sizeof(uint32_t)) / sizeof(struct session_bucket))
+#define ANALYTICS_HOURS_TAG 'H'
+#define ANALYTICS_SESSIONS_TAG 'S'
+
+static const struct device * mgmt_dev = DEVICE_DT_GET(MGMT_UART_NODE);
+
+/* Structure of one received frame, still COBS encoded */
+struct mgmt_rx_frame {
+    uint8_t len;
+    uint8_t data[COBS_MAX(MGMT_MAX_FRAME)];
+};
+
+K_MSGQ_DEFINE(mgmt_rx_msgq, sizeof(struct mgmt_rx_frame), MGMT_RX_QUEUE_LEN, 4);
+static struct mgmt_rx_frame rx_frame;
+static bool rx_overflow = false;
+
+RING_BUF_DECLARE(mgmt_tx_ring, MGMT_TX_BUF_SIZE);
+static K_SEM_DEFINE(tx_space_sem, 0, 1);
+
+/**
+ * @brief Brief decription of tx_write().
+ *
+ * Queues bytes for transmission, waiting for room in the ring buffer
+ *
+ * @param *data  Bytes to send
+ * @param len    Number of bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void tx_write(const uint8_t *data, int len) {
+    uint32_t put;
+
+    while(len > 0) {
+        put = ring_buf_put(&mgmt_tx_ring, data, len);
+        data += put;
+        len -= put;
+        uart_irq_tx_enable(mgmt_dev);
+        if(len > 0) {
+            k_sem_take(&tx_space_sem, K_FOREVER);
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of mgmt_send().
+ *
+ * Builds, encodes and queues one frame
+ *
+ * @param cmd       Command byte
+ * @param seq       Sequence byte of the request
+ * @param *payload  Payload (may be NULL when len is 0)
+ * @param len       Size of the payload, at most MGMT_MAX_PAYLOAD
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void mgmt_send(uint8_t cmd, uint8_t seq, const void *payload, int len) {
+    uint8_t raw[MGMT_MAX_FRAME];
+    uint8_t enc[COBS_MAX(MGMT_MAX_FRAME) + 1];
+    int n;
+
+    raw[0] = cmd;
+    raw[1] = seq;
+    if(len > 0) {
+        memcpy(&raw[MGMT_HDR_LEN], payload, len);
+    }
+    sys_put_le16(crc16_ccitt(0xffff, raw, MGMT_HDR_LEN + len), &raw[MGMT_HDR_LEN + len]);
+    n = cobs_encode(raw, MGMT_HDR_LEN + len + MGMT_CRC_LEN, enc);
+    enc[n++] = 0;
+    tx_write(enc, n);
+}
+
+/* Structure of the counters frame being built */
+struct counters_frame {
+    uint8_t seq;
+    int len;                                // Bytes of buf used
+    uint8_t buf[MGMT_MAX_PAYLOAD];
+};
+
+/**
+ * @brief Brief decription of counters_start().
+ *
+ * Starts a counters frame with the name of the group
+ *
+ * @param *f    Frame
+ * @param *hdr  Stats group
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void counters_start(struct counters_frame *f, const struct stats_hdr *hdr) {
+    int len = strlen(hdr->s_name);
+
+    f->buf[0] = len;
+    memcpy(&f->buf[1], hdr->s_name, len);
+    f->len = 1 + len;
+}
+
+/**
+ * @brief Brief decription of counters_entry().
+ *
+ * stats_walk() callback, appends one counter to the frame being built.
+ * A group that does not fit one frame goes on in another frame with the
+ * same group name. 64-bit counters saturate at UINT32_MAX
+ *
+ * @return 0 to continue the walk
+ *
+ */
+static int counters_entry(struct stats_hdr *hdr, void *arg, const char *name, uint16_t off) {
+    struct counters_frame *f = arg;
+    const uint8_t *value = (const uint8_t *)hdr + off;
+    int len = strlen(name);
+    uint64_t val;
+
+    if(f->len + 1 + len + sizeof(uint32_t) > MGMT_MAX_PAYLOAD) {
+        mgmt_send(MGMT_COUNTERS | MGMT_RESPONSE, f->seq, f->buf, f->len);
+        counters_start(f, hdr);
+    }
+    switch(hdr->s_size){
+        case(STATS_SIZE_16):
+            val = *(const uint16_t *)value;
+        break;
+
+        case(STATS_SIZE_64):
+            val = *(const uint64_t *)value;
+        break;
+
+        default:
+            val = *(const uint32_t *)value;
+        break;
+    }
+    f->buf[f->len] = len;
+    memcpy(&f->buf[f->len + 1], name, len);
+    sys_put_le32(MIN(val, UINT32_MAX), &f->buf[f->len + 1 + len]);
+    f->len += 1 + len + sizeof(uint32_t);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of counters_group().
+ *
+ * stats_group_walk() callback, sends the frames of one stats group
+ *
+ * @return 0 to continue the walk
+ *
+ */
+static int counters_group(struct stats_hdr *hdr, void *arg) {
+    struct counters_frame f;
+
+    f.seq = *(uint8_t *)arg;
+    counters_start(&f, hdr);
+    stats_walk(hdr, counters_entry, &f);
+    mgmt_send(MGMT_COUNTERS | MGMT_RESPONSE, f.seq, f.buf, f.len);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of send_sales().
+ *
+ * Streams the sales record from a sequence number, as many records per
+ * frame as fit, then an empty frame with the next sequence number
+ *
+ * @param seq       Sequence byte of the request
+ * @param from_seq  First sale wanted
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void send_sales(uint8_t seq, uint32_t from_seq) {
+    struct sale sales[SALES_PER_FRAME];
+    uint8_t next[sizeof(uint32_t)];
+    int n;
+
+    while((n = sales_read(from_seq, sales, SALES_PER_FRAME)) > 0) {
+        mgmt_send(MGMT_SALES | MGMT_RESPONSE, seq, sales, n * sizeof(struct sale));
+        from_seq = sales[n - 1].seq + 1;
+    }
+    sys_put_le32(from_seq, next);
+    mgmt_send(MGMT_SALES | MGMT_RESPONSE, seq, next, sizeof(next));
+}
+
+/**
+ * @brief Brief decription of send_analytics().
+ *
+ * Sends the hourly buckets and the per session counters. They are
+ * copied in one go so every frame of a kind is from the same instant
+ *
+ * @param seq  Sequence byte of the request
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void send_analytics(uint8_t seq) {
+    static struct hour_bucket hours[CONFIG_CINEMA_ANALYTICS_HOURS];
+    static struct session_bucket sessions[CONFIG_CINEMA_ANALYTICS_SESSIONS];
+    uint8_t out[MGMT_MAX_PAYLOAD];
+    uint32_t versao;
+    int n, i, chunk;
+
+    n = analytics_hours(hours, ARRAY_SIZE(hours));
+    for(i=0; i<n; i+=chunk) {
+        chunk = MIN(n - i, HOURS_PER_FRAME);
+        out[0] = ANALYTICS_HOURS_TAG;
+        memcpy(&out[1], &hours[i], chunk * sizeof(struct hour_bucket));
+        mgmt_send(MGMT_ANALYTICS | MGMT_RESPONSE, seq, out, 1 + chunk * sizeof(struct hour_bucket));
+    }
+
+    n = analytics_sessions(&versao, sessions, ARRAY_SIZE(sessions));
+    for(i=0; i<n; i+=chunk) {
+        chunk = MIN(n - i, SESSIONS_PER_FRAME);
+        out[0] = ANALYTICS_SESSIONS_TAG;
+        sys_put_le32(versao, &out[1]);
+        memcpy(&out[5], &sessions[i], chunk * sizeof(struct session_bucket));
+        mgmt_send(MGMT_ANALYTICS | MGMT_RESPONSE, seq, out, 5 + chunk * sizeof(struct session_bucket));
+    }
+    mgmt_send(MGMT_ANALYTICS | MGMT_RESPONSE, seq, NULL, 0);
+}
+
+/**
+ * @brief Brief decription of mgmt_handle().
+ *
+ * Executes one decoded, CRC checked request
+ *
+ * @param *frame  Request: cmd, seq, payload
+ * @param len     Size of the request without crc
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void mgmt_handle(const uint8_t *frame, int len) {
+    uint8_t cmd = frame[0], seq = frame[1];
+    const uint8_t *payload = &frame[MGMT_HDR_LEN];
+    int plen = len - MGMT_HDR_LEN;
+    uint8_t out[MGMT_MAX_PAYLOAD];
+    const struct catalog *cat;
+    uint32_t local_s;
+    uint8_t err = EINVAL;
+
+    switch(cmd){
+        case(MGMT_PING):
+            out[0] = MGMT_PROTOCOL;
+            mgmt_send(cmd | MGMT_RESPONSE, seq, out, 1);
+            return;
+
+        case(MGMT_CATALOG_INFO):
+            cat = snapshot_peek();
+            sys_put_le32(cat->versao, &out[0]);
+            sys_put_le16(cat->n_movies, &out[4]);
+            sys_put_le16(cat->n_sessions, &out[6]);
+            mgmt_send(cmd | MGMT_RESPONSE, seq, out, 8);
+            return;
+
+        case(MGMT_COUNTERS):
+            stats_group_walk(counters_group, &seq);
+            mgmt_send(cmd | MGMT_RESPONSE, seq, NULL, 0);
+            return;
+
+        case(MGMT_ANALYTICS):
+            send_analytics(seq);
+            return;
+
+        case(MGMT_CLOCK):
+            if(plen == sizeof(uint32_t)) {
+                wallclock_set(sys_get_le32(payload));
+            } else if(plen != 0) {
+                break;
+            }
+            if(wallclock_get(&local_s) != 0) {
+                err = EAGAIN;
+                break;
+            }
+            sys_put_le32(local_s, out);
+            mgmt_send(cmd | MGMT_RESPONSE, seq, out, sizeof(local_s));
+            return;
+
+        case(MGMT_SALES):
+            if(plen == sizeof(uint32_t)) {
+                send_sales(seq, sys_get_le32(payload));
+                return;
+            }
+        break;
+
+#ifdef CONFIG_CINEMA_CATALOG_UPDATE
+        case(MGMT_CATALOG_LINE):
+            if(plen < UPDATE_LINE_LEN) {
+                char line[UPDATE_LINE_LEN];
+
+                memcpy(line, payload, plen);
+                line[plen] = '\0';
+                catalog_update_line(line, (char *)out, sizeof(out));
+                mgmt_send(cmd | MGMT_RESPONSE, seq, out, strlen((char *)out));
+                return;
+            }
+        break;
+#endif
+
+        default:
+            err = ENOTSUP;
+        break;
+    }
+    mgmt_send(MGMT_ERROR | MGMT_RESPONSE, seq, &err, 1);
+}
+
+/**
+ * @brief Brief decription of mgmt_thread().
+ *
+ * Decodes and checks the received frames and executes them
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void mgmt_thread(void *p1, void *p2, void *p3) {
+    struct mgmt_rx_frame enc;
+    uint8_t frame[MGMT_MAX_FRAME];
+    int len;
+
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while(1) {
+        k_msgq_get(&mgmt_rx_msgq, &enc, K_FOREVER);
+        len = cobs_decode(enc.data, enc.len, frame, sizeof(frame));
+        if(len < MGMT_HDR_LEN + MGMT_CRC_LEN) {
+            continue;
+        }
+        len -= MGMT_CRC_LEN;
+        if(crc16_ccitt(0xffff, frame, len) != sys_get_le16(&frame[len])) {
+            continue;       // The host times out and retries
+        }
+        mgmt_handle(frame, len);
+    }
+}
+
+K_THREAD_DEFINE(mgmt, MGMT_STACK_SIZE, mgmt_thread, NULL, NULL, NULL, MGMT_PRIORITY, 0, 0);
+
+/**
+ * @brief Brief decription of mgmt_uart_isr().
+ *
+ * UART interrupt: splits the received bytes in frames and feeds the
+ * transmitter from the ring buffer
+ *
+ * @param *dev        UART device
+ * @param *user_data  Unused
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void mgmt_uart_isr(const struct device *dev, void *user_data) {
+    uint8_t c, *data;
+    uint32_t len;
+
+    ARG_UNUSED(user_data);
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(uart_irq_rx_ready(dev)) {
+            while(uart_fifo_read(dev, &c, 1) == 1) {
+                if(c == 0) {
+                    /* Frames that overflowed or do not fit in the queue are dropped */
+                    if(!rx_overflow && (rx_frame.len > 0)) {
+                        k_msgq_put(&mgmt_rx_msgq, &rx_frame, K_NO_WAIT);
+                    }
+                    rx_frame.len = 0;
+                    rx_overflow = false;
+                } else if(rx_frame.len < sizeof(rx_frame.data)) {
+                    rx_frame.data[rx_frame.len++] = c;
+                } else {
+                    rx_overflow = true;
+                }
+            }
+        }
+        if(uart_irq_tx_ready(dev)) {
+            len = ring_buf_get_claim(&mgmt_tx_ring, &data, MGMT_TX_BUF_SIZE);
+            if(len == 0) {
+                uart_irq_tx_disable(dev);
+            } else {
+                len = uart_fifo_fill(dev, data, len);
+                ring_buf_get_finish(&mgmt_tx_ring, len);
+                k_sem_give(&tx_space_sem);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of mgmt_init().
+ *
+ * Enables the management UART interrupts
+ *
+ * @return 0 on success, -ENODEV if the UART is not ready
+ *
+ */
+static int mgmt_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(mgmt_dev)) {
+        printk("Error: management uart is not ready\n");
+        return -ENODEV;
+    }
+    uart_irq_callback_user_data_set(mgmt_dev, mgmt_uart_isr, NULL);
+    uart_irq_rx_enable(mgmt_dev);
+    return 0;
+}
+
+SYS_INIT(mgmt_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
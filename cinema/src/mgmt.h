@@ -0,0 +1,43 @@
+/** @file mgmt.h
+ * @brief Framed binary management protocol
+ *
+ * Frames are COBS encoded and terminated by a 0x00 byte. Decoded frame:
+ *
+ *     [cmd u8][seq u8][payload ...][crc16 u16 le]
+ *
+ * crc16 is crc16_ccitt(0xffff, ...) over cmd, seq and payload. Answers
+ * use cmd | MGMT_RESPONSE and the seq of the request. Multi-byte fields
+ * of the payloads are little-endian.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef MGMT_H
+#define MGMT_H
+
+/* Defines */
+#define MGMT_PROTOCOL 1         // Version answered to MGMT_PING
+#define MGMT_MAX_FRAME 128      // Maximum decoded frame, with header and crc
+#define MGMT_RESPONSE 0x80
+
+/* Commands */
+#define MGMT_PING 0x01          // -> [protocol u8]
+#define MGMT_CATALOG_INFO 0x02  // -> [versao u32][n_movies u16][n_sessions u16]
+#define MGMT_COUNTERS 0x03      // -> frames of one stats group each:
+                                //    [name_len u8][group][n x ([name_len u8][name][value u32])]
+                                //    a big group takes several frames with the same group,
+                                //    UINT32_MAX is a 64-bit counter at or above it,
+                                //    then an empty frame
+#define MGMT_SALES 0x04         // [from_seq u32] -> frames of struct sale records,
+                                //    then an empty frame with [next_seq u32]
+#define MGMT_CATALOG_LINE 0x05  // [update line] -> [answer text]
+#define MGMT_ANALYTICS 0x06     // -> frames ['H'][struct hour_bucket ...], newest hour first,
+                                //    frames ['S'][versao u32][struct session_bucket ...],
+                                //    then an empty frame
+#define MGMT_CLOCK 0x07         // [local_s u32] sets the wall clock, empty reads it
+                                //    -> [local_s u32], seconds since 1970 in local time
+#define MGMT_ERROR 0x7f         // -> [errno u8], unknown command or bad payload
+
+#endif /* MGMT_H */
@@ -0,0 +1,169 @@
+/** @file power.c
+ * @brief Deep-idle policy of the vending machine
+ *
+ * After CONFIG_CINEMA_IDLE_TIMEOUT_S seconds without any input the screen
+ * is blanked, the console UART is suspended through device power management
+ * and the state machine thread blocks on a semaphore, so the tickless kernel
+ * has nothing to wake up for. The GPIOTE button interrupts stay armed and any
+ * input gives the semaphore back, resuming the UART and redrawing the screen.
+ * With CONFIG_CINEMA_CONSOLE_KEYS the console UART stays on, so a key can
+ * wake the machine too.
+ *
+ * The number of wake-ups and the time spent in each state are kept in the
+ * "power" stats group.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <pm/device.h>
+#include <stats/stats.h>
+#include <sys/printk.h>
+#include <sys/atomic.h>
+
+#include "power.h"
+#include "screen.h"
+
+/* Defines */
+#define IDLE_TIMEOUT_MS (CONFIG_CINEMA_IDLE_TIMEOUT_S * 1000)
+
+/* Console UART, suspended while idle */
+static const struct device * uart_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+
+/* Given by every input, taken by the state machine while idle */
+static K_SEM_DEFINE(wake_sem, 0, 1);
+
+/* Uptime of the last input and of the last state change */
+static volatile uint32_t last_activity = 0;
+static uint32_t state_since = 0;
+
+/* Transactions in progress, the machine does not idle while there is one */
+static atomic_t holds = ATOMIC_INIT(0);
+
+/* Power stats */
+STATS_SECT_START(power_stats)
+STATS_SECT_ENTRY32(wakeups)
+STATS_SECT_ENTRY32(idle_entries)
+STATS_SECT_ENTRY32(active_ms)
+STATS_SECT_ENTRY32(idle_ms)
+STATS_SECT_END;
+
+STATS_SECT_DECL(power_stats) power_stats;
+
+STATS_NAME_START(power_stats)
+STATS_NAME(power_stats, wakeups)
+STATS_NAME(power_stats, idle_entries)
+STATS_NAME(power_stats, active_ms)
+STATS_NAME(power_stats, idle_ms)
+STATS_NAME_END(power_stats);
+
+/**
+ * @brief Brief decription of power_init().
+ *
+ * Registers the power stats group
+ *
+ * @return 0 on success, negative error code from the stats subsystem otherwise
+ *
+ */
+static int power_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    state_since = k_uptime_get_32();
+    last_activity = state_since;
+    return stats_init_and_reg(STATS_HDR(power_stats), STATS_SIZE_32, 4,
+                              STATS_NAME_INIT_PARMS(power_stats), "power");
+}
+
+SYS_INIT(power_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/**
+ * @brief Brief decription of power_activity().
+ *
+ * Marks user activity, restarting the inactivity timeout and waking the
+ * state machine if it is idle. Safe to call from interrupt context
+ *
+ * @return Doesn't return anything
+ *
+ */
+void power_activity(void) {
+    last_activity = k_uptime_get_32();
+    k_sem_give(&wake_sem);
+}
+
+/**
+ * @brief Brief decription of power_hold().
+ *
+ * Keeps the machine out of idle until power_release(), for a transaction
+ * that waits on the other kiosk or on the card terminal without input
+ *
+ * @return Doesn't return anything
+ *
+ */
+void power_hold(void) {
+    atomic_inc(&holds);
+    power_activity();
+}
+
+/**
+ * @brief Brief decription of power_release().
+ *
+ * Ends a power_hold(), the inactivity timeout starts again from here
+ *
+ * @return Doesn't return anything
+ *
+ */
+void power_release(void) {
+    atomic_dec(&holds);
+    power_activity();
+}
+
+/**
+ * @brief Brief decription of power_idle().
+ *
+ * Called once per iteration of the state machine. If the inactivity timeout
+ * expired and no transaction holds the machine (power_hold()) it blanks the screen, suspends the UART and blocks until the next
+ * input, then restores the UART
+ *
+ * @return true if the machine was idle and the screen must be redrawn now,
+ *         false if nothing happened
+ *
+ */
+bool power_idle(void) {
+    uint32_t now = k_uptime_get_32();
+    int ret;
+
+    if(((now - last_activity) < IDLE_TIMEOUT_MS) || (atomic_get(&holds) > 0)) {
+        return false;
+    }
+
+    /* Arm the wake-up, an input between the check and here still wakes us */
+    k_sem_reset(&wake_sem);
+    if(((k_uptime_get_32() - last_activity) < IDLE_TIMEOUT_MS) || (atomic_get(&holds) > 0)) {
+        return false;
+    }
+
+    printk("\033[2J\033[H");
+    screen_blank(true);
+    STATS_INCN(power_stats, active_ms, now - state_since);
+    STATS_INC(power_stats, idle_entries);
+    state_since = now;
+
+    ret = IS_ENABLED(CONFIG_CINEMA_CONSOLE_KEYS) ? -EALREADY : pm_device_action_run(uart_dev, PM_DEVICE_ACTION_SUSPEND);
+    k_sem_take(&wake_sem, K_FOREVER);
+    if(ret == 0) {
+        pm_device_action_run(uart_dev, PM_DEVICE_ACTION_RESUME);
+    }
+    screen_blank(false);
+
+    now = k_uptime_get_32();
+    STATS_INCN(power_stats, idle_ms, now - state_since);
+    STATS_INC(power_stats, wakeups);
+    state_since = now;
+    return true;
+}
@@ -0,0 +1,26 @@
+/** @file power.h
+ * @brief Deep-idle policy of the vending machine
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+
+#ifdef CONFIG_CINEMA_IDLE
+void power_activity(void);
+void power_hold(void);
+void power_release(void);
+bool power_idle(void);
+#else
+static inline void power_activity(void) {}
+static inline void power_hold(void) {}
+static inline void power_release(void) {}
+static inline bool power_idle(void) { return false; }
+#endif
+
+#endif /* POWER_H */
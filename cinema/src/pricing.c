@@ -0,0 +1,133 @@
+/** @file pricing.c
+ * @brief Pricing rules engine
+ *
+ * Rules are evaluated only when a catalog is loaded: pricing_compile() applies
+ * them in order to the base price (custo) of every session and stores the
+ * result in a flat table indexed by (session, ticket type). Looking up a
+ * price is then a single array read, whatever the number of rules.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <sys/util.h>
+#include <stdbool.h>
+
+#include "pricing.h"
+
+const char *const ticket_names[N_TICKET_TYPES] = {
+    "Normal",
+    "Estudante",
+    "Senior",
+    "Grupo"
+};
+
+/* Rules used with the built-in catalog, applied in this order */
+const struct price_rule default_rules[] = {
+    /* Tuesday: every ticket starts at 6 euros */
+    { ALL_TYPES, BIT(2), 0, 23, RULE_FIXED, 6 },
+    /* Matinee: sessions before 18 h are 2 euros cheaper */
+    { ALL_TYPES, ALL_DAYS, 0, 17, RULE_AMOUNT_OFF, 2 },
+    /* Student and senior discounts */
+    { BIT(TICKET_STUDENT), ALL_DAYS, 0, 23, RULE_PERCENT_OFF, 20 },
+    { BIT(TICKET_SENIOR), ALL_DAYS, 0, 23, RULE_PERCENT_OFF, 30 },
+    /* Group purchase, 1 euro off each ticket */
+    { BIT(TICKET_BUNDLE), ALL_DAYS, 0, 23, RULE_AMOUNT_OFF, 1 },
+};
+
+const int n_default_rules = ARRAY_SIZE(default_rules);
+
+/**
+ * @brief Brief decription of rule_matches().
+ *
+ * Checks if a rule applies to a session/ticket type on a given weekday
+ *
+ * @param *rule    Rule to check
+ * @param horas    Hour of the session
+ * @param type     Ticket type
+ * @param weekday  Day of the week (0 is Sunday) or WEEKDAY_UNKNOWN
+ *
+ * @return true if the rule applies
+ *
+ */
+static bool rule_matches(const struct price_rule *rule, int horas, int type, int weekday) {
+    if(!(rule->types & BIT(type))) {
+        return false;
+    }
+    if((horas < rule->from_h) || (horas > rule->to_h)) {
+        return false;
+    }
+    if(rule->days != ALL_DAYS) {
+        if((weekday == WEEKDAY_UNKNOWN) || !(rule->days & BIT(weekday))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Brief decription of rule_apply().
+ *
+ * Applies one rule to a price. Prices are rounded down to whole euros,
+ * since only euro coins are accepted, and never go below zero
+ *
+ * @param *rule  Rule to apply
+ * @param price  Current price
+ *
+ * @return New price
+ *
+ */
+static int rule_apply(const struct price_rule *rule, int price) {
+    switch(rule->kind){
+        case(RULE_PERCENT_OFF):
+            price -= (price * rule->value + 99) / 100;
+        break;
+
+        case(RULE_AMOUNT_OFF):
+            price -= rule->value;
+        break;
+
+        case(RULE_FIXED):
+            price = rule->value;
+        break;
+
+        default:
+        break;
+    }
+    return MAX(price, 0);
+}
+
+/**
+ * @brief Brief decription of pricing_compile().
+ *
+ * Builds the price table of a catalog, one row per session id
+ *
+ * @param *table   Table to fill, cat->n_sessions rows
+ * @param *cat     Catalog with the base prices
+ * @param *rules   Rules, applied in order
+ * @param n_rules  Number of rules
+ * @param weekday  Day of the week (0 is Sunday) or WEEKDAY_UNKNOWN
+ *
+ * @return Doesn't return anything
+ *
+ */
+void pricing_compile(int16_t (*table)[N_TICKET_TYPES], const struct catalog *cat,
+                     const struct price_rule *rules, int n_rules, int weekday) {
+    int s, t, r, price;
+    const struct session *sessao;
+
+    for(s=0; s<cat->n_sessions; s++) {
+        sessao = &cat->sessoes[s];
+        for(t=0; t<N_TICKET_TYPES; t++) {
+            price = sessao->custo;
+            for(r=0; r<n_rules; r++) {
+                if(rule_matches(&rules[r], sessao->horas, t, weekday)) {
+                    price = rule_apply(&rules[r], price);
+                }
+            }
+            table[s][t] = price;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/** @file pricing.h
+ * @brief Pricing rules engine
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef PRICING_H
+#define PRICING_H
+
+#include <stdint.h>
+
+#include "catalog.h"
+
+/* Kind of adjustment made by a rule */
+#define RULE_PERCENT_OFF 0  // value % off the current price
+#define RULE_AMOUNT_OFF 1   // value euros off the current price
+#define RULE_FIXED 2        // price becomes value euros
+
+#define MAX_RULES 16        // Rules of a catalog held in RAM
+#define ALL_TYPES 0xff      // Rule applies to every ticket type
+#define ALL_DAYS 0          // Rule applies every day
+#define WEEKDAY_UNKNOWN (-1)// No wall clock, rules restricted to some days are skipped
+
+/* Structure to define one pricing rule */
+struct price_rule {
+    uint8_t types;      // Mask of ticket types, BIT(TICKET_x)
+    uint8_t days;       // Mask of weekdays, BIT(0) is Sunday, ALL_DAYS for every day
+    uint8_t from_h;     // First session hour covered by the rule
+    uint8_t to_h;       // Last session hour covered by the rule
+    uint8_t kind;       // RULE_x
+    int16_t value;
+};
+
+extern const struct price_rule default_rules[];
+extern const int n_default_rules;
+extern const char *const ticket_names[N_TICKET_TYPES];
+
+void pricing_compile(int16_t (*table)[N_TICKET_TYPES], const struct catalog *cat,
+                     const struct price_rule *rules, int n_rules, int weekday);
+
+/**
+ * @brief Brief decription of price_get().
+ *
+ * Price of a ticket, a single read from the compiled table
+ *
+ * @param *cat  Catalog with compiled prices
+ * @param sess  Session id, session_id(cat, movie, sessao)
+ * @param type  Ticket type, TICKET_x
+ *
+ * @return Price in euros
+ *
+ */
+static inline int price_get(const struct catalog *cat, int sess, int type) {
+    return cat->prices[sess][type];
+}
+
+#endif /* PRICING_H */
@@ -0,0 +1,495 @@
+/** @file printer.c
+ * @brief Ticket printer
+ *
+ * A worker thread takes the tickets from a bounded queue and streams
+ * them to the printer through a TX ring buffer fed by the UART interrupt.
+ * Flow control is XON/XOFF (CONFIG_CINEMA_PRINTER_XONXOFF) or RTS/CTS done
+ * by the UART itself (hw-flow-control in the devicetree). The roll sensor
+ * is read before and after each ticket (DLE EOT 4); a ticket is kept and
+ * printed again while the printer reports paper out or does not answer.
+ * After a stall the bytes left in the ring are dropped, and a bitmap the
+ * printer was in the middle of is finished with blank lines before the
+ * printer is asked anything again.
+ * Tickets go as text in the printer font, or as a bitmap rendered one
+ * dot line at a time (CONFIG_CINEMA_PRINTER_RASTER, see raster.c).
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <sys/atomic.h>
+#include <sys/printk.h>
+#include <sys/ring_buffer.h>
+#include <sys/util.h>
+#include <stats/stats.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "printer.h"
+#include "raster.h"
+
+/* Defines */
+#define PRINTER_UART_NODE DT_CHOSEN(cinema_printer_uart)
+#define PRINTER_STACK_SIZE 1024
+#define PRINTER_PRIORITY 7                  // Below the stations
+#define PRINTER_TX_BUF_SIZE 128
+#define PRINTER_TICKET_LEN 256
+#define PRINTER_STATUS_TIMEOUT_MS 500
+#define PRINTER_STALL_MS 10000              // Longest XOFF (or CTS off) before giving up the ticket
+#define PRINTER_RETRY_MS (CONFIG_CINEMA_PRINTER_RETRY_S * MSEC_PER_SEC)
+
+/* Flow control and ESC/POS */
+#define XON 0x11
+#define XOFF 0x13
+#define ESC 0x1b
+#define GS 0x1d
+#define DLE 0x10
+#define EOT 0x04
+#define ROLL_STATUS 4               // DLE EOT 4: roll paper sensor status
+#define PAPER_END 0x60              // Bits 5 and 6 of the roll sensor status
+#define IMAGE_HEADER_LEN 10         // ESC @ and GS v 0 with its size
+
+static const struct device * printer_dev = DEVICE_DT_GET(PRINTER_UART_NODE);
+static bool printer_ready = false;
+
+K_MSGQ_DEFINE(print_jobs, sizeof(struct print_job), CONFIG_CINEMA_PRINTER_QUEUE_LEN, 4);
+
+RING_BUF_DECLARE(printer_tx_ring, PRINTER_TX_BUF_SIZE);
+static K_SEM_DEFINE(tx_space_sem, 0, 1);    // Given by the ISR when it takes bytes from the ring
+static K_SEM_DEFINE(status_sem, 0, 1);      // Given by the ISR when a status byte arrives
+static atomic_t xoff = ATOMIC_INIT(0);
+static atomic_t tx_count;                   // Bytes given to the UART so far
+static volatile uint8_t status_byte;
+
+/* Printer stats */
+STATS_SECT_START(printer_stats)
+STATS_SECT_ENTRY32(jobs)
+STATS_SECT_ENTRY32(printed)
+STATS_SECT_ENTRY32(reprints)
+STATS_SECT_ENTRY32(paper_out)
+STATS_SECT_ENTRY32(offline)
+STATS_SECT_ENTRY32(xoff)
+STATS_SECT_END;
+
+STATS_SECT_DECL(printer_stats) printer_stats;
+
+STATS_NAME_START(printer_stats)
+STATS_NAME(printer_stats, jobs)
+STATS_NAME(printer_stats, printed)
+STATS_NAME(printer_stats, reprints)
+STATS_NAME(printer_stats, paper_out)
+STATS_NAME(printer_stats, offline)
+STATS_NAME(printer_stats, xoff)
+STATS_NAME_END(printer_stats);
+
+/**
+ * @brief Brief decription of printer_submit().
+ *
+ * Queues a ticket, never waits
+ *
+ * @param *job  Ticket, copied
+ *
+ * @return 0 on success, -ENOBUFS if the queue is full, -ENODEV if
+ *         there is no printer
+ *
+ */
+int printer_submit(const struct print_job *job) {
+    if(!printer_ready) {
+        return -ENODEV;
+    }
+    if(k_msgq_put(&print_jobs, job, K_NO_WAIT) != 0) {
+        return -ENOBUFS;
+    }
+    STATS_INC(printer_stats, jobs);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of printer_full().
+ *
+ * @param n  Tickets of the purchase
+ *
+ * @return true if printer_submit() would fail for one of n tickets
+ *         because the queue is full
+ *
+ */
+bool printer_full(int n) {
+    return printer_ready && (k_msgq_num_free_get(&print_jobs) < n);
+}
+
+/**
+ * @brief Brief decription of printer_flush().
+ *
+ * Drops the bytes the printer did not take, after a stall
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void printer_flush(void) {
+    unsigned int key;
+
+    uart_irq_tx_disable(printer_dev);
+    key = irq_lock();
+    ring_buf_reset(&printer_tx_ring);
+    irq_unlock(key);
+}
+
+/**
+ * @brief Brief decription of printer_write().
+ *
+ * Copies data to the TX ring, waiting for the printer when the ring is full.
+ * On a stall the ring is flushed
+ *
+ * @param *data  Bytes to send
+ * @param len    Number of bytes
+ *
+ * @return 0 on success, -ETIMEDOUT if the printer held the line for
+ *         more than PRINTER_STALL_MS
+ *
+ */
+static int printer_write(const uint8_t *data, uint32_t len) {
+    uint32_t n;
+
+    while(len > 0) {
+        n = ring_buf_put(&printer_tx_ring, data, len);
+        data += n;
+        len -= n;
+        if(!atomic_get(&xoff)) {
+            uart_irq_tx_enable(printer_dev);
+        }
+        if((len > 0) && (k_sem_take(&tx_space_sem, K_MSEC(PRINTER_STALL_MS)) != 0)) {
+            printer_flush();
+            return -ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of printer_drain().
+ *
+ * Waits until the TX ring is empty. On a stall the ring is flushed
+ *
+ * @return 0 on success, -ETIMEDOUT if the printer held the line for
+ *         more than PRINTER_STALL_MS
+ *
+ */
+static int printer_drain(void) {
+    while(!ring_buf_is_empty(&printer_tx_ring)) {
+        if(k_sem_take(&tx_space_sem, K_MSEC(PRINTER_STALL_MS)) != 0) {
+            printer_flush();
+            return -ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of printer_status().
+ *
+ * Reads the roll paper sensor
+ *
+ * @return 0 if there is paper, -ENOSPC on paper out, -ETIMEDOUT if the
+ *         printer did not answer
+ *
+ */
+static int printer_status(void) {
+    static const uint8_t query[] = { DLE, EOT, ROLL_STATUS };
+
+    k_sem_reset(&status_sem);
+    if((printer_write(query, sizeof(query)) != 0) ||
+       (k_sem_take(&status_sem, K_MSEC(PRINTER_STATUS_TIMEOUT_MS)) != 0)) {
+        STATS_INC(printer_stats, offline);
+        return -ETIMEDOUT;
+    }
+    if(status_byte & PAPER_END) {
+        STATS_INC(printer_stats, paper_out);
+        return -ENOSPC;
+    }
+    return 0;
+}
+
+#ifdef CONFIG_CINEMA_PRINTER_RASTER
+/* Last bitmap sent, until the printer has taken all of it */
+static uint8_t image_header[IMAGE_HEADER_LEN];
+static uint32_t image_len;                  // Header included, 0 if there is none
+static uint32_t image_start;                // tx_count when the header went to the ring
+
+/**
+ * @brief Brief decription of finish_image().
+ *
+ * The printer reads every byte after GS v 0 as dots until the declared
+ * size is in, a status query included. Sends what a stall left out of the
+ * last bitmap: the rest of its header and blank lines
+ *
+ * @return 0 if there is no bitmap left open, negative error code from
+ *         printer_write() or printer_drain() otherwise
+ *
+ */
+static int finish_image(void) {
+    static const uint8_t blank[RASTER_LINE_BYTES];
+    uint32_t sent, n;
+    int ret = 0;
+
+    sent = atomic_get(&tx_count) - image_start;
+    if((sent == 0) || (sent >= image_len)) {
+        /* Flushed before the UART took any of it, or all taken */
+        image_len = 0;
+        return 0;
+    }
+    if(sent < IMAGE_HEADER_LEN) {
+        ret = printer_write(&image_header[sent], IMAGE_HEADER_LEN - sent);
+        sent = IMAGE_HEADER_LEN;
+    }
+    while((ret == 0) && (sent < image_len)) {
+        n = MIN(sizeof(blank), image_len - sent);
+        ret = printer_write(blank, n);
+        sent += n;
+    }
+    if(ret == 0) {
+        ret = printer_drain();
+    }
+    if(ret == 0) {
+        image_len = 0;
+    }
+    return ret;
+}
+
+/**
+ * @brief Brief decription of write_ticket().
+ *
+ * Sends a ticket as one GS v 0 bitmap, rendered while it is sent
+ *
+ * @param *job     Ticket
+ * @param reprint  true if the ticket was already (partly) printed
+ *
+ * @return 0 on success, negative error code from printer_write() otherwise
+ *
+ */
+static int write_ticket(const struct print_job *job, bool reprint) {
+    static const uint8_t cut[] = { '\n', '\n', '\n', GS, 'V', '1' };     // GS V 1: partial cut
+    static struct raster r;
+    static uint8_t line[RASTER_LINE_BYTES];
+    uint8_t header[IMAGE_HEADER_LEN] = { ESC, '@', GS, 'v', '0', 0,     // GS v 0: raster bit image
+                                         RASTER_LINE_BYTES & 0xff, RASTER_LINE_BYTES >> 8, 0, 0 };
+    int height, ret;
+
+    raster_begin(&r, job, reprint);
+    height = raster_height(&r);
+    header[8] = height & 0xff;
+    header[9] = height >> 8;
+
+    /* The ring is empty here, so the header is the next byte out */
+    memcpy(image_header, header, sizeof(header));
+    image_len = sizeof(header) + (uint32_t)height * RASTER_LINE_BYTES;
+    image_start = atomic_get(&tx_count);
+    ret = printer_write(header, sizeof(header));
+    while((ret == 0) && raster_next_line(&r, line)) {
+        ret = printer_write(line, sizeof(line));
+    }
+    if(ret == 0) {
+        ret = printer_write(cut, sizeof(cut));
+    }
+    return ret;
+}
+#else
+/**
+ * @brief Brief decription of write_ticket().
+ *
+ * Sends a ticket as ESC/POS text
+ *
+ * @param *job     Ticket
+ * @param reprint  true if the ticket was already (partly) printed
+ *
+ * @return 0 on success, negative error code from printer_write() otherwise
+ *
+ */
+static int write_ticket(const struct print_job *job, bool reprint) {
+    static char buf[PRINTER_TICKET_LEN];
+    char code[TICKET_SIG_HEX + 8] = "";     // "Codigo <hex>\n"
+    int len;
+#ifdef CONFIG_CINEMA_SIGN
+    char hex[TICKET_SIG_HEX];
+
+    ticket_sig_hex(job->sig, hex);
+    snprintf(code, sizeof(code), "Codigo %s\n", hex);
+#endif
+
+    len = snprintf(buf, PRINTER_TICKET_LEN,
+                   "\x1b@"                      // ESC @: reset
+                   "\x1b" "a1"                  // ESC a 1: centered
+                   "\x1b" "E1" "Cinema 3000" "\x1b" "E0" "\n\n"      // ESC E: bold on and off
+                   "%s\n%d horas\n\n%s  %d euros\n\nBilhete %06u  Terminal %d\n%s%s"
+                   "\n\n\n\x1d" "V1",            // GS V 1: partial cut
+                   job->filme, job->horas, job->tipo, job->price,
+                   (unsigned int)job->seq, job->station + 1, code, reprint ? "Reimpressao\n" : "");
+    return printer_write((const uint8_t *)buf, MIN(len, PRINTER_TICKET_LEN - 1));
+}
+
+/**
+ * @brief Brief decription of finish_image().
+ *
+ * Text tickets leave no bitmap open
+ *
+ * @return 0
+ *
+ */
+static int finish_image(void) {
+    return 0;
+}
+#endif
+
+/**
+ * @brief Brief decription of print_ticket().
+ *
+ * Prints one ticket, checking the paper before and after it. A bitmap
+ * left open by an earlier stall is finished first
+ *
+ * @param *job   Ticket
+ * @param *sent  true if the ticket was already (partly) printed, set to
+ *               true once it goes to the printer
+ *
+ * @return 0 if the ticket was printed, negative error code from
+ *         finish_image(), printer_status() or printer_write() otherwise
+ *
+ */
+static int print_ticket(const struct print_job *job, bool *sent) {
+    bool reprint = *sent;
+    int ret;
+
+    ret = finish_image();
+    if(ret == 0) {
+        ret = printer_status();
+    }
+    if(ret == 0) {
+        *sent = true;
+        ret = write_ticket(job, reprint);
+    }
+    if(ret == 0) {
+        ret = printer_drain();
+    }
+    if(ret == 0) {
+        /* The paper may have ended in the middle of the ticket */
+        ret = printer_status();
+    }
+    return ret;
+}
+
+/**
+ * @brief Brief decription of printer_thread().
+ *
+ * Prints the queued tickets in order. A ticket that fails is retried
+ * every CONFIG_CINEMA_PRINTER_RETRY_S seconds until it is printed, the
+ * tickets behind it wait in the queue
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void printer_thread(void *p1, void *p2, void *p3) {
+    static struct print_job job;    // Too large for the stack with the QR code
+    bool reprint;
+
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    if(!printer_ready) {
+        return;
+    }
+    while(1) {
+        k_msgq_get(&print_jobs, &job, K_FOREVER);
+        reprint = false;
+        while(print_ticket(&job, &reprint) != 0) {
+            printk("Impressora: bilhete %06u por imprimir\n\r", (unsigned int)job.seq);
+            k_msleep(PRINTER_RETRY_MS);
+            if(reprint) {
+                STATS_INC(printer_stats, reprints);
+            }
+        }
+        STATS_INC(printer_stats, printed);
+    }
+}
+
+K_THREAD_DEFINE(printer, PRINTER_STACK_SIZE, printer_thread, NULL, NULL, NULL,
+                PRINTER_PRIORITY, 0, 0);
+
+/**
+ * @brief Brief decription of printer_uart_isr().
+ *
+ * UART interrupt: handles XON/XOFF and the status bytes, and feeds the
+ * transmitter from the ring buffer while the printer accepts data
+ *
+ * @param *dev        UART device
+ * @param *user_data  Unused
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void printer_uart_isr(const struct device *dev, void *user_data) {
+    uint8_t c, *data;
+    uint32_t len;
+
+    ARG_UNUSED(user_data);
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(uart_irq_rx_ready(dev)) {
+            while(uart_fifo_read(dev, &c, 1) == 1) {
+                if(IS_ENABLED(CONFIG_CINEMA_PRINTER_XONXOFF) && (c == XOFF)) {
+                    if(!atomic_set(&xoff, 1)) {
+                        STATS_INC(printer_stats, xoff);
+                    }
+                } else if(IS_ENABLED(CONFIG_CINEMA_PRINTER_XONXOFF) && (c == XON)) {
+                    atomic_clear(&xoff);
+                    if(!ring_buf_is_empty(&printer_tx_ring)) {
+                        uart_irq_tx_enable(dev);
+                    }
+                } else {
+                    status_byte = c;
+                    k_sem_give(&status_sem);
+                }
+            }
+        }
+        if(uart_irq_tx_ready(dev)) {
+            len = atomic_get(&xoff) ? 0 : ring_buf_get_claim(&printer_tx_ring, &data, PRINTER_TX_BUF_SIZE);
+            if(len == 0) {
+                uart_irq_tx_disable(dev);
+            } else {
+                len = uart_fifo_fill(dev, data, len);
+                ring_buf_get_finish(&printer_tx_ring, len);
+                atomic_add(&tx_count, len);
+                k_sem_give(&tx_space_sem);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of printer_init().
+ *
+ * Enables the printer UART interrupts and registers the stats
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int printer_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(printer_dev)) {
+        printk("Error: printer uart is not ready\n");
+        return -ENODEV;
+    }
+    uart_irq_callback_user_data_set(printer_dev, printer_uart_isr, NULL);
+    uart_irq_rx_enable(printer_dev);
+    printer_ready = true;
+    return stats_init_and_reg(STATS_HDR(printer_stats), STATS_SIZE_32, 6,
+                              STATS_NAME_INIT_PARMS(printer_stats), "printer");
+}
+
+SYS_INIT(printer_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
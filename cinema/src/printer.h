@@ -0,0 +1,51 @@
+/** @file printer.h
+ * @brief Ticket printer
+ *
+ * Tickets are queued by the state machine and printed by a worker thread
+ * on a serial thermal printer (ESC/POS commands) on the UART chosen as
+ * cinema,printer-uart. The state machine never waits for the printer.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ticket_sign.h"
+#ifdef CONFIG_CINEMA_QR
+#include "qr.h"
+#endif
+
+/* Defines */
+#define PRINTER_NAME_LEN 24
+
+/* Structure of one ticket to print */
+struct print_job {
+    uint32_t seq;                   // Sale sequence number, printed as the ticket number
+    uint8_t horas;                  // Session time
+    uint8_t price;                  // Price paid in euros
+    uint8_t station;                // Station that sold it
+    char filme[PRINTER_NAME_LEN];
+    char tipo[PRINTER_NAME_LEN];    // Ticket type
+#ifdef CONFIG_CINEMA_SIGN
+    uint8_t sig[TICKET_SIG_LEN];    // Signature of the ticket id, session and price
+#endif
+#ifdef CONFIG_CINEMA_QR
+    struct qr_code code;            // Validation code, encoded at the sale
+#endif
+};
+
+#ifdef CONFIG_CINEMA_PRINTER
+int printer_submit(const struct print_job *job);
+bool printer_full(int n);
+#else
+static inline int printer_submit(const struct print_job *job) { return 0; }
+static inline bool printer_full(int n) { return false; }
+#endif
+
+#endif /* PRINTER_H */
@@ -0,0 +1,683 @@
+/** @file qr.c
+ * @brief QR code encoder for the ticket validation codes
+ *
+ * Reed-Solomon runs from GF(256) log/antilog tables (primitive polynomial
+ * 0x11d) with the generator polynomials already in log form. The symbol
+ * is kept as one 64-bit word per row, so a mask is applied to a whole row
+ * with one XOR and most of the penalty rules are bit operations. The masks
+ * are scored row by row and a mask is dropped as soon as its rows alone
+ * score worse than the best mask so far. The columns are scored on the
+ * symbol transposed once, with transposed mask patterns. The tables were generated offline and checked
+ * against the examples of ISO/IEC 18004.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qr.h"
+
+/* Defines */
+#define MODE_BYTE 0x4
+#define PAD0 0xec
+#define PAD1 0x11
+#define MAX_BLOCKS 2
+#define MAX_DATA 64                 // Data codewords of version 4-M
+#define MAX_CODEWORDS 100           // All codewords of version 4
+#define MAX_EC 26
+#define FINDER_LIKE_A 0x5d0         // 1011101 0000, one module per bit
+#define FINDER_LIKE_B 0x05d         // 0000 1011101
+#define PENALTY_N1 3
+#define PENALTY_N2 3
+#define PENALTY_N3 40
+#define PENALTY_N4 10
+#define MAX_ABS(a, b) ((abs(a) > abs(b)) ? abs(a) : abs(b))     // Chebyshev distance
+
+/* GF(256) antilog table, twice so a sum of two logs needs no modulo */
+static const uint8_t gf_exp[510] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
+    0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
+    0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
+    0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1,
+    0x5f, 0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0,
+    0xfd, 0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2,
+    0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce,
+    0x81, 0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc,
+    0x85, 0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54,
+    0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73,
+    0xe6, 0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff,
+    0xe3, 0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6,
+    0x51, 0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16,
+    0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26, 0x4c,
+    0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0, 0x9d,
+    0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23, 0x46,
+    0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1, 0x5f,
+    0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0, 0xfd,
+    0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2, 0xd9,
+    0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce, 0x81,
+    0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc, 0x85,
+    0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54, 0xa8,
+    0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73, 0xe6,
+    0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff, 0xe3,
+    0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6, 0x51,
+    0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16, 0x2c,
+    0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e,
+};
+
+/* GF(256) log table, gf_log[0] is not used */
+static const uint8_t gf_log[256] = {
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x03, 0xdf, 0x33, 0xee, 0x1b, 0x68, 0xc7, 0x4b,
+    0x04, 0x64, 0xe0, 0x0e, 0x34, 0x8d, 0xef, 0x81, 0x1c, 0xc1, 0x69, 0xf8, 0xc8, 0x08, 0x4c, 0x71,
+    0x05, 0x8a, 0x65, 0x2f, 0xe1, 0x24, 0x0f, 0x21, 0x35, 0x93, 0x8e, 0xda, 0xf0, 0x12, 0x82, 0x45,
+    0x1d, 0xb5, 0xc2, 0x7d, 0x6a, 0x27, 0xf9, 0xb9, 0xc9, 0x9a, 0x09, 0x78, 0x4d, 0xe4, 0x72, 0xa6,
+    0x06, 0xbf, 0x8b, 0x62, 0x66, 0xdd, 0x30, 0xfd, 0xe2, 0x98, 0x25, 0xb3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xd0, 0x94, 0xce, 0x8f, 0x96, 0xdb, 0xbd, 0xf1, 0xd2, 0x13, 0x5c, 0x83, 0x38, 0x46, 0x40,
+    0x1e, 0x42, 0xb6, 0xa3, 0xc3, 0x48, 0x7e, 0x6e, 0x6b, 0x3a, 0x28, 0x54, 0xfa, 0x85, 0xba, 0x3d,
+    0xca, 0x5e, 0x9b, 0x9f, 0x0a, 0x15, 0x79, 0x2b, 0x4e, 0xd4, 0xe5, 0xac, 0x73, 0xf3, 0xa7, 0x57,
+    0x07, 0x70, 0xc0, 0xf7, 0x8c, 0x80, 0x63, 0x0d, 0x67, 0x4a, 0xde, 0xed, 0x31, 0xc5, 0xfe, 0x18,
+    0xe3, 0xa5, 0x99, 0x77, 0x26, 0xb8, 0xb4, 0x7c, 0x11, 0x44, 0x92, 0xd9, 0x23, 0x20, 0x89, 0x2e,
+    0x37, 0x3f, 0xd1, 0x5b, 0x95, 0xbc, 0xcf, 0xcd, 0x90, 0x87, 0x97, 0xb2, 0xdc, 0xfc, 0xbe, 0x61,
+    0xf2, 0x56, 0xd3, 0xab, 0x14, 0x2a, 0x5d, 0x9e, 0x84, 0x3c, 0x39, 0x53, 0x47, 0x6d, 0x41, 0xa2,
+    0x1f, 0x2d, 0x43, 0xd8, 0xb7, 0x7b, 0xa4, 0x76, 0xc4, 0x17, 0x49, 0xec, 0x7f, 0x0c, 0x6f, 0xf6,
+    0x6c, 0xa1, 0x3b, 0x52, 0x29, 0x9d, 0x55, 0xaa, 0xfb, 0x60, 0x86, 0xb1, 0xbb, 0xcc, 0x3e, 0x5a,
+    0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
+    0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf,
+};
+
+/* Generator polynomials of 10, 16, 18 and 26 error correction codewords, logs of the coefficients */
+static const uint8_t gen10_log[10] = {
+    0xfb, 0x43, 0x2e, 0x3d, 0x76, 0x46, 0x40, 0x5e, 0x20, 0x2d,
+};
+static const uint8_t gen16_log[16] = {
+    0x78, 0x68, 0x6b, 0x6d, 0x66, 0xa1, 0x4c, 0x03, 0x5b, 0xbf, 0x93, 0xa9, 0xb6, 0xc2, 0xe1, 0x78,
+};
+static const uint8_t gen18_log[18] = {
+    0xd7, 0xea, 0x9e, 0x5e, 0xb8, 0x61, 0x76, 0xaa, 0x4f, 0xbb, 0x98, 0x94, 0xfc, 0xb3, 0x05, 0x62,
+    0x60, 0x99,
+};
+static const uint8_t gen26_log[26] = {
+    0xad, 0x7d, 0x9e, 0x02, 0x67, 0xb6, 0x76, 0x11, 0x91, 0xc9, 0x6f, 0x1c, 0xa5, 0x35, 0xa1, 0x15,
+    0xf5, 0x8e, 0x0d, 0x66, 0x30, 0xe3, 0x99, 0x91, 0xda, 0x46,
+};
+/* Format information of level M for each mask, BCH(15,5) coded and masked with 0x5412 */
+static const uint16_t format_m[8] = {
+    0x5412, 0x5125, 0x5e7c, 0x5b4b, 0x45f9, 0x40ce, 0x4f97, 0x4aa0,
+};
+
+/* Mask patterns, periodic in 12 rows: bit 63 - x of mask_rows[m][y % 12] is inverted in module (x, y) */
+static const uint64_t mask_rows[8][12] = {
+    {
+        0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL,
+        0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL,
+        0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL,
+    },
+    {
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0xffffffffffffffffULL,
+        0x0000000000000000ULL, 0xffffffffffffffffULL, 0x0000000000000000ULL,
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0xffffffffffffffffULL,
+        0x0000000000000000ULL, 0xffffffffffffffffULL, 0x0000000000000000ULL,
+    },
+    {
+        0x9249249249249249ULL, 0x9249249249249249ULL, 0x9249249249249249ULL,
+        0x9249249249249249ULL, 0x9249249249249249ULL, 0x9249249249249249ULL,
+        0x9249249249249249ULL, 0x9249249249249249ULL, 0x9249249249249249ULL,
+        0x9249249249249249ULL, 0x9249249249249249ULL, 0x9249249249249249ULL,
+    },
+    {
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+    },
+    {
+        0xe38e38e38e38e38eULL, 0xe38e38e38e38e38eULL, 0x1c71c71c71c71c71ULL,
+        0x1c71c71c71c71c71ULL, 0xe38e38e38e38e38eULL, 0xe38e38e38e38e38eULL,
+        0x1c71c71c71c71c71ULL, 0x1c71c71c71c71c71ULL, 0xe38e38e38e38e38eULL,
+        0xe38e38e38e38e38eULL, 0x1c71c71c71c71c71ULL, 0x1c71c71c71c71c71ULL,
+    },
+    {
+        0xffffffffffffffffULL, 0x8208208208208208ULL, 0x9249249249249249ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x9249249249249249ULL, 0x8208208208208208ULL,
+        0xffffffffffffffffULL, 0x8208208208208208ULL, 0x9249249249249249ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x9249249249249249ULL, 0x8208208208208208ULL,
+    },
+    {
+        0xffffffffffffffffULL, 0xe38e38e38e38e38eULL, 0xdb6db6db6db6db6dULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xb6db6db6db6db6dbULL, 0x8e38e38e38e38e38ULL,
+        0xffffffffffffffffULL, 0xe38e38e38e38e38eULL, 0xdb6db6db6db6db6dULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xb6db6db6db6db6dbULL, 0x8e38e38e38e38e38ULL,
+    },
+    {
+        0xaaaaaaaaaaaaaaaaULL, 0x1c71c71c71c71c71ULL, 0x8e38e38e38e38e38ULL,
+        0x5555555555555555ULL, 0xe38e38e38e38e38eULL, 0x71c71c71c71c71c7ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x1c71c71c71c71c71ULL, 0x8e38e38e38e38e38ULL,
+        0x5555555555555555ULL, 0xe38e38e38e38e38eULL, 0x71c71c71c71c71c7ULL,
+    },
+};
+
+/* Same, transposed: bit 63 - y of mask_cols[m][x % 12] */
+static const uint64_t mask_cols[8][12] = {
+    {
+        0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL,
+        0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL,
+        0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 0x5555555555555555ULL,
+    },
+    {
+        0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL, 0xaaaaaaaaaaaaaaaaULL,
+    },
+    {
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+        0xffffffffffffffffULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    },
+    {
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+        0x9249249249249249ULL, 0x2492492492492492ULL, 0x4924924924924924ULL,
+    },
+    {
+        0xccccccccccccccccULL, 0xccccccccccccccccULL, 0xccccccccccccccccULL,
+        0x3333333333333333ULL, 0x3333333333333333ULL, 0x3333333333333333ULL,
+        0xccccccccccccccccULL, 0xccccccccccccccccULL, 0xccccccccccccccccULL,
+        0x3333333333333333ULL, 0x3333333333333333ULL, 0x3333333333333333ULL,
+    },
+    {
+        0xffffffffffffffffULL, 0x8208208208208208ULL, 0x9249249249249249ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x9249249249249249ULL, 0x8208208208208208ULL,
+        0xffffffffffffffffULL, 0x8208208208208208ULL, 0x9249249249249249ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x9249249249249249ULL, 0x8208208208208208ULL,
+    },
+    {
+        0xffffffffffffffffULL, 0xe38e38e38e38e38eULL, 0xdb6db6db6db6db6dULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xb6db6db6db6db6dbULL, 0x8e38e38e38e38e38ULL,
+        0xffffffffffffffffULL, 0xe38e38e38e38e38eULL, 0xdb6db6db6db6db6dULL,
+        0xaaaaaaaaaaaaaaaaULL, 0xb6db6db6db6db6dbULL, 0x8e38e38e38e38e38ULL,
+    },
+    {
+        0xaaaaaaaaaaaaaaaaULL, 0x1c71c71c71c71c71ULL, 0x8e38e38e38e38e38ULL,
+        0x5555555555555555ULL, 0xe38e38e38e38e38eULL, 0x71c71c71c71c71c7ULL,
+        0xaaaaaaaaaaaaaaaaULL, 0x1c71c71c71c71c71ULL, 0x8e38e38e38e38e38ULL,
+        0x5555555555555555ULL, 0xe38e38e38e38e38eULL, 0x71c71c71c71c71c7ULL,
+    },
+};
+
+/* Structure with the blocks of one version at level M, all blocks are the same size up to version 4 */
+struct qr_version {
+    uint8_t blocks;
+    uint8_t data;               // Data codewords per block
+    uint8_t ec;                 // Error correction codewords per block
+    const uint8_t *gen_log;     // Generator polynomial of degree ec, without the leading 1
+};
+
+static const struct qr_version versions[QR_MAX_VERSION + 1] = {
+    { 0, 0, 0, NULL },
+    { 1, 16, 10, gen10_log },
+    { 1, 28, 16, gen16_log },
+    { 1, 44, 26, gen26_log },
+    { 2, 32, 18, gen18_log },
+};
+
+/* Scratch area of qr_encode() */
+static struct {
+    uint8_t data[MAX_DATA];
+    uint8_t ec[MAX_BLOCKS][MAX_EC];
+    uint8_t codewords[MAX_CODEWORDS];
+    uint64_t func[QR_MAX_SIZE];     // Function modules (finders, timing, alignment, format)
+    uint64_t func_cols[QR_MAX_SIZE];
+    uint64_t cols[QR_MAX_SIZE];     // Unmasked symbol, transposed
+    uint64_t masked[QR_MAX_SIZE];
+} scratch;
+
+/**
+ * @brief Brief decription of rs_remainder().
+ *
+ * Reed-Solomon error correction codewords of one block
+ *
+ * @param *data     Data codewords
+ * @param len       Number of data codewords
+ * @param *gen_log  Generator polynomial, logs of its coefficients
+ * @param deg       Degree of the generator, number of codewords in out
+ * @param *out      Error correction codewords
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void rs_remainder(const uint8_t *data, int len, const uint8_t *gen_log, int deg, uint8_t *out) {
+    uint8_t factor;
+    int i, j, lf;
+
+    memset(out, 0, deg);
+    for(i=0; i<len; i++) {
+        factor = data[i] ^ out[0];
+        memmove(out, out + 1, deg - 1);
+        out[deg - 1] = 0;
+        if(factor != 0) {
+            lf = gf_log[factor];
+            for(j=0; j<deg; j++) {
+                out[j] ^= gf_exp[gen_log[j] + lf];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of put().
+ *
+ * @param *rows  Matrix
+ * @param x      Column
+ * @param y      Row
+ * @param dark   Color of the module
+ *
+ * @return Doesn't return anything
+ *
+ */
+static inline void put(uint64_t *rows, int x, int y, bool dark) {
+    uint64_t bit = 1ULL << (63 - x);
+
+    rows[y] = dark ? (rows[y] | bit) : (rows[y] & ~bit);
+}
+
+/**
+ * @brief Brief decription of put_xy().
+ *
+ * put() on a matrix that may be transposed
+ *
+ * @return Doesn't return anything
+ *
+ */
+static inline void put_xy(uint64_t *rows, int x, int y, bool dark, bool transposed) {
+    if(transposed) {
+        put(rows, y, x, dark);
+    } else {
+        put(rows, x, y, dark);
+    }
+}
+
+/**
+ * @brief Brief decription of put_function().
+ *
+ * Sets a function module and marks it in the function map
+ *
+ * @param *qr   Symbol
+ * @param x     Column
+ * @param y     Row
+ * @param dark  Color of the module
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void put_function(struct qr_code *qr, int x, int y, bool dark) {
+    put(qr->rows, x, y, dark);
+    put(scratch.func, x, y, true);
+}
+
+/**
+ * @brief Brief decription of draw_function_patterns().
+ *
+ * Draws the timing patterns, the finders with their separators and the
+ * alignment pattern, and reserves the format areas
+ *
+ * @param *qr  Symbol, rows cleared, version and size set
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void draw_function_patterns(struct qr_code *qr) {
+    static const int8_t finders[3][2] = { { 3, 3 }, { -4, 3 }, { 3, -4 } };   // Centers, negative from the far side
+    int size = qr->size, i, f, cx, cy, dx, dy, dist;
+
+    memset(scratch.func, 0, sizeof(scratch.func));
+    for(i=0; i<size; i++) {
+        put_function(qr, 6, i, (i % 2) == 0);
+        put_function(qr, i, 6, (i % 2) == 0);
+    }
+    for(f=0; f<3; f++) {
+        cx = (finders[f][0] < 0) ? size + finders[f][0] : finders[f][0];
+        cy = (finders[f][1] < 0) ? size + finders[f][1] : finders[f][1];
+        for(dy=-4; dy<=4; dy++) {
+            for(dx=-4; dx<=4; dx++) {
+                dist = MAX_ABS(dx, dy);
+                if((cx + dx >= 0) && (cx + dx < size) && (cy + dy >= 0) && (cy + dy < size)) {
+                    put_function(qr, cx + dx, cy + dy, (dist != 2) && (dist != 4));
+                }
+            }
+        }
+    }
+    /* Up to version 6 the only alignment pattern not on a finder is near the bottom right corner */
+    if(qr->version >= 2) {
+        for(dy=-2; dy<=2; dy++) {
+            for(dx=-2; dx<=2; dx++) {
+                put_function(qr, size - 7 + dx, size - 7 + dy, MAX_ABS(dx, dy) != 1);
+            }
+        }
+    }
+    /* Format areas, written later, and the dark module */
+    for(i=0; i<9; i++) {
+        put(scratch.func, 8, i, true);
+        put(scratch.func, i, 8, true);
+    }
+    for(i=0; i<8; i++) {
+        put(scratch.func, size - 1 - i, 8, true);
+        put(scratch.func, 8, size - 1 - i, true);
+    }
+}
+
+/**
+ * @brief Brief decription of draw_format().
+ *
+ * Writes both copies of the format information (level M, mask) and the dark module
+ *
+ * @param *rows       Matrix
+ * @param size        Modules per side
+ * @param mask        Mask pattern, 0 to 7
+ * @param transposed  true if rows holds the columns
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void draw_format(uint64_t *rows, int size, int mask, bool transposed) {
+    int bits = format_m[mask], i;
+
+    for(i=0; i<=5; i++) {
+        put_xy(rows, 8, i, (bits >> i) & 1, transposed);
+    }
+    put_xy(rows, 8, 7, (bits >> 6) & 1, transposed);
+    put_xy(rows, 8, 8, (bits >> 7) & 1, transposed);
+    put_xy(rows, 7, 8, (bits >> 8) & 1, transposed);
+    for(i=9; i<15; i++) {
+        put_xy(rows, 14 - i, 8, (bits >> i) & 1, transposed);
+    }
+    for(i=0; i<8; i++) {
+        put_xy(rows, size - 1 - i, 8, (bits >> i) & 1, transposed);
+    }
+    for(i=8; i<15; i++) {
+        put_xy(rows, 8, size - 15 + i, (bits >> i) & 1, transposed);
+    }
+    put_xy(rows, 8, size - 8, true, transposed);
+}
+
+/**
+ * @brief Brief decription of place_codewords().
+ *
+ * Writes the codewords in the two module wide zigzag columns, from the
+ * bottom right corner, skipping the function modules. The remainder
+ * bits stay light
+ *
+ * @param *qr  Symbol with the function patterns drawn
+ * @param *cw  Codewords, interleaved
+ * @param n    Number of codewords
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void place_codewords(struct qr_code *qr, const uint8_t *cw, int n) {
+    int size = qr->size, i = 0, right, vert, j, x, y;
+    bool upward;
+
+    for(right=size-1; right>=1; right-=2) {
+        if(right == 6) {
+            right = 5;      // The vertical timing pattern is skipped
+        }
+        upward = ((right + 1) & 2) == 0;
+        for(vert=0; vert<size; vert++) {
+            y = upward ? size - 1 - vert : vert;
+            for(j=0; j<2; j++) {
+                x = right - j;
+                if(((scratch.func[y] >> (63 - x)) & 1) || (i >= n * 8)) {
+                    continue;
+                }
+                put(qr->rows, x, y, (cw[i >> 3] >> (7 - (i & 7))) & 1);
+                i++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of run_penalty().
+ *
+ * Penalty rule 1 for one color of a line: a run of n >= 5 modules costs
+ * N1 + n - 5, that is one per window of five modules inside the run
+ * plus two per run
+ *
+ * @param v       Line, the color looked at is 1
+ * @param valid5  Columns where a window of five modules fits
+ *
+ * @return Penalty
+ *
+ */
+static inline int run_penalty(uint64_t v, uint64_t valid5) {
+    uint64_t windows = v & (v << 1) & (v << 2) & (v << 3) & (v << 4) & valid5;
+
+    return __builtin_popcountll(windows) + (PENALTY_N1 - 1) * __builtin_popcountll(windows & ~(windows >> 1));
+}
+
+/**
+ * @brief Brief decription of finder_like().
+ *
+ * Windows of 11 modules of a line that match a pattern, all of them at once
+ *
+ * @param e        Line with the quiet zone, leftmost module at bit 63
+ * @param pattern  11 bit pattern, first module in bit 10
+ * @param valid    Windows that fit in the line and its quiet zone
+ *
+ * @return Number of matches
+ *
+ */
+static inline int finder_like(uint64_t e, unsigned int pattern, uint64_t valid) {
+    uint64_t match = valid;
+    int k;
+
+    for(k=0; k<11; k++) {
+        match &= ((pattern >> (10 - k)) & 1) ? (e << k) : ~(e << k);
+    }
+    return __builtin_popcountll(match);
+}
+
+/**
+ * @brief Brief decription of line_penalty().
+ *
+ * Penalty rules 1 (runs of five or more modules of the same color) and
+ * 3 (1:1:3:1:1 finder-like patterns with four light modules on one side,
+ * the quiet zone counts as light) over the rows, or over the columns when
+ * given the transposed matrix. Every rule is evaluated on the whole line
+ * with shifts and ANDs
+ *
+ * @param *lines  Rows or columns, bits past size are light
+ * @param size    Modules per side
+ *
+ * @return Penalty
+ *
+ */
+static int line_penalty(const uint64_t *lines, int size) {
+    uint64_t width = ~0ULL << (64 - size);
+    uint64_t valid5 = ~0ULL << (64 - (size - 4));
+    uint64_t valid11 = ~0ULL << (64 - (size - 2));     // Windows over size + 8 modules of line and quiet zone
+    uint64_t v, e;
+    int penalty = 0, matches = 0, y;
+
+    for(y=0; y<size; y++) {
+        v = lines[y];
+        penalty += run_penalty(v, valid5) + run_penalty(~v & width, valid5);
+        /* Four light modules of quiet zone on the left, the right side is already light */
+        e = v >> 4;
+        matches += finder_like(e, FINDER_LIKE_A, valid11) + finder_like(e, FINDER_LIKE_B, valid11);
+    }
+    return penalty + PENALTY_N3 * matches;
+}
+
+/**
+ * @brief Brief decription of block_penalty().
+ *
+ * Penalty rules 2 (2x2 blocks of the same color) and 4 (balance of dark modules)
+ *
+ * @param *rows  Matrix, bits past size are light
+ * @param size   Modules per side
+ *
+ * @return Penalty
+ *
+ */
+static int block_penalty(const uint64_t *rows, int size) {
+    uint64_t inner = ~0ULL << (64 - (size - 1));    // Columns with a right neighbour
+    uint64_t a, b;
+    int penalty = 0, dark = 0, total = size * size, y, k;
+
+    for(y=0; y<size; y++) {
+        dark += __builtin_popcountll(rows[y]);
+        if(y < size - 1) {
+            a = rows[y];
+            b = rows[y + 1];
+            penalty += PENALTY_N2 * __builtin_popcountll(~(a ^ b) & ~(a ^ (a << 1)) & ~(b ^ (b << 1)) & inner);
+        }
+    }
+    k = (abs(dark * 20 - total * 10) + total - 1) / total - 1;
+    return penalty + PENALTY_N4 * k;
+}
+
+/**
+ * @brief Brief decription of transpose().
+ *
+ * @param *rows  Matrix
+ * @param *cols  Transposed matrix, bit 63 - y of cols[x] is module (x, y)
+ * @param size   Modules per side
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void transpose(const uint64_t *rows, uint64_t *cols, int size) {
+    int x, y;
+
+    memset(cols, 0, size * sizeof(cols[0]));
+    for(y=0; y<size; y++) {
+        for(x=0; x<size; x++) {
+            cols[x] |= ((rows[y] >> (63 - x)) & 1) << (63 - y);
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of apply_mask().
+ *
+ * Masks a whole row (or column) with one XOR
+ *
+ * @param *in         Unmasked matrix
+ * @param *out        Masked matrix with the format information of mask
+ * @param size        Modules per side
+ * @param mask        Mask pattern, 0 to 7
+ * @param transposed  true if in and out hold the columns
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void apply_mask(const uint64_t *in, uint64_t *out, int size, int mask, bool transposed) {
+    const uint64_t *pattern = transposed ? mask_cols[mask] : mask_rows[mask];
+    const uint64_t *func = transposed ? scratch.func_cols : scratch.func;
+    uint64_t width = ~0ULL << (64 - size);
+    int y;
+
+    for(y=0; y<size; y++) {
+        out[y] = in[y] ^ (pattern[y % 12] & ~func[y] & width);
+    }
+    draw_format(out, size, mask, transposed);
+}
+
+/**
+ * @brief Brief decription of qr_encode().
+ *
+ * Encodes data in the smallest version that fits, with the mask of the
+ * lowest penalty
+ *
+ * @param *data  Payload
+ * @param len    Size of data in bytes
+ * @param *qr    Encoded symbol
+ *
+ * @return 0 on success, -EMSGSIZE if data does not fit in version QR_MAX_VERSION
+ *
+ */
+int qr_encode(const uint8_t *data, int len, struct qr_code *qr) {
+    const struct qr_version *ver = NULL;
+    int v, n_data, bit, i, b, m, score, best = -1, best_mask = 0;
+    uint8_t *cw = scratch.data;
+
+    for(v=1; v<=QR_MAX_VERSION; v++) {
+        /* Mode indicator and 8 bit character count */
+        if(len <= (versions[v].blocks * versions[v].data * 8 - 12) / 8) {
+            ver = &versions[v];
+            break;
+        }
+    }
+    if((ver == NULL) || (len < 0)) {
+        return -EMSGSIZE;
+    }
+
+    /* Data codewords: mode, count, payload, terminator (here always 4 bits), then pad codewords */
+    n_data = ver->blocks * ver->data;
+    memset(cw, 0, n_data);
+    cw[0] = (MODE_BYTE << 4) | (len >> 4);
+    cw[1] = len << 4;
+    for(i=0; i<len; i++) {
+        cw[1 + i] |= data[i] >> 4;
+        cw[2 + i] = data[i] << 4;
+    }
+    for(i=len+2, bit=0; i<n_data; i++, bit^=1) {
+        cw[i] = bit ? PAD1 : PAD0;
+    }
+
+    /* Error correction per block, then the codewords of the blocks interleaved */
+    for(b=0; b<ver->blocks; b++) {
+        rs_remainder(cw + b * ver->data, ver->data, ver->gen_log, ver->ec, scratch.ec[b]);
+    }
+    for(i=0; i<ver->data; i++) {
+        for(b=0; b<ver->blocks; b++) {
+            scratch.codewords[i * ver->blocks + b] = cw[b * ver->data + i];
+        }
+    }
+    for(i=0; i<ver->ec; i++) {
+        for(b=0; b<ver->blocks; b++) {
+            scratch.codewords[n_data + i * ver->blocks + b] = scratch.ec[b][i];
+        }
+    }
+
+    qr->version = v;
+    qr->size = 17 + 4 * v;
+    memset(qr->rows, 0, sizeof(qr->rows));
+    draw_function_patterns(qr);
+    place_codewords(qr, scratch.codewords, ver->blocks * (ver->data + ver->ec));
+
+    /* The columns are transposed once, each mask is then applied to the rows and to the columns */
+    transpose(qr->rows, scratch.cols, qr->size);
+    transpose(scratch.func, scratch.func_cols, qr->size);
+    for(m=0; m<8; m++) {
+        apply_mask(qr->rows, scratch.masked, qr->size, m, false);
+        score = block_penalty(scratch.masked, qr->size) + line_penalty(scratch.masked, qr->size);
+        if((best >= 0) && (score >= best)) {
+            continue;       // The columns can only add to it
+        }
+        apply_mask(scratch.cols, scratch.masked, qr->size, m, true);
+        score += line_penalty(scratch.masked, qr->size);
+        if((best < 0) || (score < best)) {
+            best = score;
+            best_mask = m;
+        }
+    }
+    apply_mask(qr->rows, qr->rows, qr->size, best_mask, false);
+    qr->mask = best_mask;
+    return 0;
+}
@@ -0,0 +1,50 @@
+/** @file qr.h
+ * @brief QR code encoder for the ticket validation codes
+ *
+ * Byte mode, error correction level M, versions 1 to QR_MAX_VERSION
+ * (the smallest that fits is used). No heap: the symbol is written to
+ * the caller's struct and the encoder works in a static scratch area,
+ * so qr_encode() must not be called by two threads at the same time.
+ * Plain C, also built on the host by scripts/qr_bench.c.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef QR_H
+#define QR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+#define QR_MAX_VERSION 4
+#define QR_MAX_SIZE (17 + 4 * QR_MAX_VERSION)
+#define QR_MAX_PAYLOAD 62           // Bytes that fit in version 4-M
+
+/* Structure of an encoded symbol, without the quiet zone */
+struct qr_code {
+    uint8_t version;
+    uint8_t size;                   // Modules per side, 17 + 4 * version
+    uint8_t mask;
+    uint64_t rows[QR_MAX_SIZE];     // Bit 63 - x of rows[y] is module (x, y), 1 is dark
+};
+
+int qr_encode(const uint8_t *data, int len, struct qr_code *qr);
+
+/**
+ * @brief Brief decription of qr_module().
+ *
+ * @param *qr  Symbol
+ * @param x    Column
+ * @param y    Row
+ *
+ * @return true if the module is dark
+ *
+ */
+static inline bool qr_module(const struct qr_code *qr, int x, int y) {
+    return (qr->rows[y] >> (63 - x)) & 1;
+}
+
+#endif /* QR_H */
@@ -0,0 +1,261 @@
+/** @file raster.c
+ * @brief 1bpp raster ticket renderer
+ *
+ * Each dot line is built in RASTER_WORDS 32-bit words. A glyph row is
+ * widened for the scale with a lookup table and placed with one 64-bit
+ * shift and two ORs, whatever its position, instead of setting the dots
+ * one by one.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <string.h>
+
+#include "raster.h"
+#include "font.h"
+
+/* Defines */
+#define CELL_W 6                    // Glyph and one blank column
+#define CELL_H 8                    // Glyph and one blank line
+#define MAX_SCALE 4
+#define ITEM_GAP 8                  // Blank dot lines after each item
+#define QR_SCALE 4                  // Dots per module, 0.5 mm at 203 dpi
+#define QR_QUIET 4                  // Blank modules around the symbol
+
+#if (RASTER_DOTS % 32) != 0
+#error "RASTER_DOTS must be a multiple of 32"
+#endif
+
+/* Glyph rows widened for each scale: bit (5 * scale - 1) is the leftmost dot */
+static uint32_t widen[MAX_SCALE][1 << FONT_GLYPH_W];
+static bool widen_ready = false;
+
+/**
+ * @brief Brief decription of widen_init().
+ *
+ * Fills widen[], every dot of a glyph row repeated scale times
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void widen_init(void) {
+    int s, v, b, k;
+
+    for(s=0; s<MAX_SCALE; s++) {
+        for(v=0; v<(1 << FONT_GLYPH_W); v++) {
+            widen[s][v] = 0;
+            for(b=FONT_GLYPH_W-1; b>=0; b--) {
+                for(k=0; k<=s; k++) {
+                    widen[s][v] = (widen[s][v] << 1) | ((v >> b) & 1);
+                }
+            }
+        }
+    }
+    widen_ready = true;
+}
+
+/**
+ * @brief Brief decription of add_item().
+ *
+ * Adds one centered text line to the ticket, cut to the paper width
+ *
+ * @param *r      Ticket
+ * @param scale   Size of the dots, 1 to MAX_SCALE
+ * @param *text   Text, UTF-8
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void add_item(struct raster *r, int scale, const char *text) {
+    struct raster_item *item = &r->items[r->n_items];
+    int max = RASTER_DOTS / (CELL_W * scale);
+    int g;
+
+    if(r->n_items == RASTER_ITEMS) {
+        return;
+    }
+    if(max > RASTER_TEXT_LEN) {
+        max = RASTER_TEXT_LEN;
+    }
+    item->qr = NULL;
+    item->scale = scale;
+    item->len = 0;
+    while((*text != '\0') && (item->len < max)) {
+        g = font_glyph(&text);
+        if(g >= 0) {
+            item->glyphs[item->len++] = g;
+        }
+    }
+    item->x = (RASTER_DOTS - item->len * CELL_W * scale) / 2;
+    r->n_items++;
+}
+
+#ifdef CONFIG_CINEMA_QR
+/**
+ * @brief Brief decription of add_qr().
+ *
+ * Adds a centered QR code to the ticket, with its quiet zone
+ *
+ * @param *r    Ticket
+ * @param *qr   Symbol, size 0 for none, must stay valid until the ticket is rendered
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void add_qr(struct raster *r, const struct qr_code *qr) {
+    struct raster_item *item = &r->items[r->n_items];
+
+    if((r->n_items == RASTER_ITEMS) || (qr->size == 0) || (qr->size * QR_SCALE > RASTER_DOTS)) {
+        return;
+    }
+    item->qr = qr;
+    item->scale = QR_SCALE;
+    item->len = 0;
+    item->x = (RASTER_DOTS - qr->size * QR_SCALE) / 2;
+    r->n_items++;
+}
+#endif
+
+/**
+ * @brief Brief decription of item_height().
+ *
+ * @param *item  Text line or QR code
+ *
+ * @return Number of dot lines of the item, with the gap after it
+ *
+ */
+static int item_height(const struct raster_item *item) {
+    if(item->qr != NULL) {
+        return (item->qr->size + 2 * QR_QUIET) * item->scale;
+    }
+    return CELL_H * item->scale + ITEM_GAP;
+}
+
+/**
+ * @brief Brief decription of raster_begin().
+ *
+ * Composes a ticket, the dot lines are then taken with raster_next_line()
+ *
+ * @param *r       Ticket
+ * @param *job     Ticket data
+ * @param reprint  true to mark the ticket as a reprint
+ *
+ * @return Doesn't return anything
+ *
+ */
+void raster_begin(struct raster *r, const struct print_job *job, bool reprint) {
+    char text[RASTER_TEXT_LEN + PRINTER_NAME_LEN];
+
+    if(!widen_ready) {
+        widen_init();
+    }
+    r->n_items = 0;
+    r->item = 0;
+    r->row = 0;
+    add_item(r, 3, "Cinema 3000");
+    add_item(r, 2, job->filme);
+    snprintf(text, sizeof(text), "%d horas", job->horas);
+    add_item(r, 2, text);
+    snprintf(text, sizeof(text), "%s  %d euros", job->tipo, job->price);
+    add_item(r, 1, text);
+    snprintf(text, sizeof(text), "Bilhete %06u  Terminal %d", (unsigned int)job->seq, job->station + 1);
+    add_item(r, 1, text);
+#ifdef CONFIG_CINEMA_SIGN
+    strcpy(text, "Codigo ");
+    ticket_sig_hex(job->sig, &text[7]);
+    add_item(r, 1, text);
+#endif
+#ifdef CONFIG_CINEMA_QR
+    add_qr(r, &job->code);
+#endif
+    if(reprint) {
+        add_item(r, 1, "Reimpressao");
+    }
+}
+
+/**
+ * @brief Brief decription of raster_height().
+ *
+ * @param *r  Ticket
+ *
+ * @return Number of dot lines of the ticket
+ *
+ */
+int raster_height(const struct raster *r) {
+    int i, h = 0;
+
+    for(i=0; i<r->n_items; i++) {
+        h += item_height(&r->items[i]);
+    }
+    return h;
+}
+
+/**
+ * @brief Brief decription of raster_next_line().
+ *
+ * Renders the next dot line of the ticket
+ *
+ * @param *r    Ticket
+ * @param *out  RASTER_LINE_BYTES bytes, leftmost dot in the MSB of out[0]
+ *
+ * @return true if a line was rendered, false at the end of the ticket
+ *
+ */
+bool raster_next_line(struct raster *r, uint8_t *out) {
+    uint32_t line[RASTER_WORDS + 1];        // One spare word for the glyphs that end in the last word
+    const struct raster_item *item;
+    const uint32_t *wide;
+    uint32_t x;
+    uint64_t bits;
+    int i, y, w, step;
+
+    if(r->item == r->n_items) {
+        return false;
+    }
+    item = &r->items[r->item];
+    memset(line, 0, sizeof(line));
+
+    y = r->row / item->scale;
+    if(item->qr != NULL) {
+        /* Five modules at a time through the same tables as the glyph rows */
+        y -= QR_QUIET;
+        if((y >= 0) && (y < item->qr->size)) {
+            wide = widen[item->scale - 1];
+            w = FONT_GLYPH_W * item->scale;
+            x = item->x;
+            for(i=0; i<item->qr->size; i+=FONT_GLYPH_W, x+=w) {
+                bits = ((uint64_t)wide[(item->qr->rows[y] >> (64 - FONT_GLYPH_W - i)) & 31] << (64 - w)) >> (x & 31);
+                line[x >> 5] |= (uint32_t)(bits >> 32);
+                line[(x >> 5) + 1] |= (uint32_t)bits;
+            }
+        }
+    } else if(y < FONT_GLYPH_H) {
+        wide = widen[item->scale - 1];
+        w = FONT_GLYPH_W * item->scale;
+        step = CELL_W * item->scale;
+        x = item->x;
+        for(i=0; i<item->len; i++, x+=step) {
+            /* Glyph row aligned at the top of 64 bits, then down to its dot x inside the word pair */
+            bits = ((uint64_t)wide[font_5x7[item->glyphs[i]][y]] << (64 - w)) >> (x & 31);
+            line[x >> 5] |= (uint32_t)(bits >> 32);
+            line[(x >> 5) + 1] |= (uint32_t)bits;
+        }
+    }
+
+    for(i=0; i<RASTER_WORDS; i++) {
+        out[4*i] = line[i] >> 24;
+        out[4*i + 1] = line[i] >> 16;
+        out[4*i + 2] = line[i] >> 8;
+        out[4*i + 3] = line[i];
+    }
+
+    if(++r->row == item_height(item)) {
+        r->row = 0;
+        r->item++;
+    }
+    return true;
+}
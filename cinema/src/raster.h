@@ -0,0 +1,57 @@
+/** @file raster.h
+ * @brief 1bpp raster ticket renderer
+ *
+ * Composes a ticket with a fixed 5x7 bitmap font and hands it out one
+ * dot line at a time (RASTER_LINE_BYTES bytes, leftmost dot in the MSB
+ * of the first byte, as GS v 0 of ESC/POS wants it). The whole bitmap
+ * is never in RAM. A QR code can take the place of a text line, it is
+ * rendered from the symbol rows in the same way. Plain C, also built on the host by
+ * scripts/raster_bench.c.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "printer.h"
+#include "qr.h"
+
+/* Defines */
+#ifdef CONFIG_CINEMA_PRINTER_DOTS
+#define RASTER_DOTS CONFIG_CINEMA_PRINTER_DOTS
+#else
+#define RASTER_DOTS 384                     // 58 mm paper at 203 dpi
+#endif
+#define RASTER_WORDS (RASTER_DOTS / 32)
+#define RASTER_LINE_BYTES (RASTER_DOTS / 8)
+#define RASTER_ITEMS 8                      // Text lines of a ticket
+#define RASTER_TEXT_LEN 32
+
+/* Structure of one text line of the ticket, already in glyph indexes, or of a QR code */
+struct raster_item {
+    const struct qr_code *qr;   // NULL for text
+    uint8_t glyphs[RASTER_TEXT_LEN];
+    uint8_t len;
+    uint8_t scale;              // 1 to 4
+    uint16_t x;                 // First dot, centered
+};
+
+/* Structure of a ticket being rendered */
+struct raster {
+    struct raster_item items[RASTER_ITEMS];
+    uint8_t n_items;
+    uint8_t item;               // Item being rendered
+    uint16_t row;               // Dot line inside that item
+};
+
+void raster_begin(struct raster *r, const struct print_job *job, bool reprint);
+int raster_height(const struct raster *r);
+bool raster_next_line(struct raster *r, uint8_t *out);
+
+#endif /* RASTER_H */
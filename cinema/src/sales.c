@@ -0,0 +1,210 @@
+/** @file sales.c
+ * @brief Sales record
+ *
+ * Every purchase is appended to a ring of CONFIG_CINEMA_SALES_LOG_PAGES
+ * pages of CONFIG_CINEMA_SALES_PAGE_SIZE bytes, encoded with sales_codec.c.
+ * Pages are laid out as flash pages would be: one is filled from the
+ * start, every page starts with a sale written in full so it decodes on
+ * its own, and when the ring wraps the oldest page is dropped whole (the
+ * "pages" counter is the number of erases flash would take). Records are
+ * numbered with a sequence number so a reader (the management protocol)
+ * can resume where it stopped. Totals are kept in the "sales" stats group.
+ * With CONFIG_CINEMA_SEQ_STORE the numbers go on after a reboot: they
+ * are reserved SALES_SEQ_BLOCK at a time in flash (seq_store.c), so only
+ * one sale in SALES_SEQ_BLOCK writes to it. A ticket id (kiosk and
+ * sequence number) is then never given twice.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <init.h>
+#include <stats/stats.h>
+#include <sys/printk.h>
+#include <string.h>
+
+#include "sales.h"
+#include "sales_codec.h"
+#include "catalog.h"
+#include "seq_store.h"
+
+/* Defines */
+#define SALES_PAGES CONFIG_CINEMA_SALES_LOG_PAGES
+#define SALES_PAGE_SIZE CONFIG_CINEMA_SALES_PAGE_SIZE
+#define SALES_SEQ_BLOCK 256                 // Sequence numbers reserved in flash at a time
+
+/* Structure of one page of the record */
+struct sales_page {
+    uint32_t first_seq;             // Sequence number of the first sale of the page
+    uint16_t used;                  // Bytes written
+    uint8_t data[SALES_PAGE_SIZE];
+};
+
+static struct sales_page sales_log[SALES_PAGES];
+static uint32_t head = 0;           // Page being written is sales_log[head % SALES_PAGES]
+static struct sales_codec encoder;
+static uint32_t next_seq = 0;
+static uint32_t seq_limit = 0;      // Sequence numbers below it are reserved
+static K_MUTEX_DEFINE(sales_lock);
+
+BUILD_ASSERT(N_TICKET_TYPES <= 4, "The ticket type is 2 bits of the record header");
+BUILD_ASSERT(SALES_PAGE_SIZE >= SALE_ENC_MAX, "A page must hold a sale written in full");
+
+/* Sales stats */
+STATS_SECT_START(sales_stats)
+STATS_SECT_ENTRY32(tickets)
+STATS_SECT_ENTRY32(revenue)
+STATS_SECT_ENTRY32(pages)
+STATS_SECT_ENTRY32(bytes)
+STATS_SECT_END;
+
+STATS_SECT_DECL(sales_stats) sales_stats;
+
+STATS_NAME_START(sales_stats)
+STATS_NAME(sales_stats, tickets)
+STATS_NAME(sales_stats, revenue)
+STATS_NAME(sales_stats, pages)
+STATS_NAME(sales_stats, bytes)
+STATS_NAME_END(sales_stats);
+
+/**
+ * @brief Brief decription of sales_init().
+ *
+ * Starts the sequence numbers past the ones given before the reboot and
+ * registers the sales stats group
+ *
+ * @return 0 on success, negative error code from the stats subsystem otherwise
+ *
+ */
+static int sales_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    next_seq = seq_store_load();
+    seq_limit = next_seq;
+    sales_log[0].first_seq = next_seq;
+    return stats_init_and_reg(STATS_HDR(sales_stats), STATS_SIZE_32, 4,
+                              STATS_NAME_INIT_PARMS(sales_stats), "sales");
+}
+
+SYS_INIT(sales_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/**
+ * @brief Brief decription of sales_record().
+ *
+ * Appends one sale to the record, on a new page (over the oldest one
+ * when the ring is full) if it does not fit what is left of the current one
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param type     Ticket type
+ * @param price    Price paid in euros
+ *
+ * @return Sequence number of the sale
+ *
+ */
+uint32_t sales_record(uint32_t versao, int session, int type, int price) {
+    struct sales_page *page;
+    struct sales_codec next;
+    struct sale sale;
+    uint8_t buf[SALE_ENC_MAX];
+    int n;
+
+    k_mutex_lock(&sales_lock, K_FOREVER);
+    if(next_seq >= seq_limit) {
+        /* Saved before the first number of the block is given */
+        seq_limit = next_seq + SALES_SEQ_BLOCK;
+        if(seq_store_save(seq_limit) != 0) {
+            printk("Error: ticket numbers from %u not saved\n", (unsigned int)next_seq);
+        }
+    }
+    sale.seq = next_seq++;
+    sale.uptime_ms = k_uptime_get_32();
+    sale.versao = versao;
+    sale.session = session;
+    sale.type = type;
+    sale.price = price;
+
+    page = &sales_log[head % SALES_PAGES];
+    next = encoder;
+    n = sales_encode(&next, &sale, buf);
+    if(page->used + n > SALES_PAGE_SIZE) {
+        head++;
+        page = &sales_log[head % SALES_PAGES];
+        page->first_seq = sale.seq;
+        page->used = 0;
+        sales_codec_reset(&next);
+        n = sales_encode(&next, &sale, buf);
+        STATS_INC(sales_stats, pages);
+    }
+    memcpy(&page->data[page->used], buf, n);
+    page->used += n;
+    encoder = next;
+    k_mutex_unlock(&sales_lock);
+
+    STATS_INC(sales_stats, tickets);
+    STATS_INCN(sales_stats, revenue, price);
+    STATS_INCN(sales_stats, bytes, n);
+    return sale.seq;
+}
+
+/**
+ * @brief Brief decription of sales_read().
+ *
+ * Decodes records starting at a sequence number, from the newest page
+ * that starts at or before it. Records already overwritten are skipped,
+ * the caller sees the gap in the sequence
+ *
+ * @param from_seq  First sequence number wanted
+ * @param *out      Buffer for the records
+ * @param max       Size of out, in records
+ *
+ * @return Number of records copied, 0 when from_seq is the next sale
+ *
+ */
+int sales_read(uint32_t from_seq, struct sale *out, int max) {
+    const struct sales_page *page;
+    struct sales_decoder decoder;
+    uint32_t oldest, p;
+    int n = 0, got, used, off, i, k;
+
+    k_mutex_lock(&sales_lock, K_FOREVER);
+    if(from_seq >= next_seq) {
+        k_mutex_unlock(&sales_lock);
+        return 0;
+    }
+    oldest = (head >= SALES_PAGES) ? (head - SALES_PAGES + 1) : 0;
+    for(p=head; (p > oldest) && (sales_log[p % SALES_PAGES].first_seq > from_seq); p--) {
+    }
+    for(; (p <= head) && (n < max); p++) {
+        page = &sales_log[p % SALES_PAGES];
+        sales_decoder_reset(&decoder);
+        for(off=0; (off < page->used) && (n < max); off+=used) {
+            got = sales_decode(&decoder, &page->data[off], page->used - off, &out[n], max - n, &used);
+            if(got < 0) {
+                break;
+            }
+            /* Drop the sales of the page before from_seq */
+            for(i=0, k=n; i<got; i++) {
+                if(out[n + i].seq >= from_seq) {
+                    out[k++] = out[n + i];
+                }
+            }
+            n = k;
+        }
+    }
+    k_mutex_unlock(&sales_lock);
+    return n;
+}
+/**
+ * @brief Brief decription of sales_next_seq().
+ *
+ * @return Sequence number the next sale will get
+ *
+ */
+uint32_t sales_next_seq(void) {
+    return next_seq;
+}
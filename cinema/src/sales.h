@@ -0,0 +1,28 @@
+/** @file sales.h
+ * @brief Sales record
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SALES_H
+#define SALES_H
+
+#include <stdint.h>
+
+/* Structure of one sale */
+struct sale {
+    uint32_t seq;           // Sequence number, never reused
+    uint32_t uptime_ms;     // Time of the sale
+    uint32_t versao;        // Catalog version, gives meaning to session
+    uint16_t session;       // Session id in that catalog
+    uint8_t type;           // Ticket type
+    uint8_t price;          // Price paid in euros
+};
+
+uint32_t sales_record(uint32_t versao, int session, int type, int price);
+int sales_read(uint32_t from_seq, struct sale *out, int max);
+uint32_t sales_next_seq(void);
+
+#endif /* SALES_H */
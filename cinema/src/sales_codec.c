@@ -0,0 +1,272 @@
+/** @file sales_codec.c
+ * @brief Compact encoding of the sales records
+ *
+ * Record layout (see sales_codec.h): one header byte, 01pvsqtt, where tt
+ * is the ticket type and q, v, s and p say the sequence gap, the catalog
+ * version, the session and the price follow. The fields are varints in
+ * the order sequence gap, version, uptime delta (always present),
+ * session, price. Gaps and deltas are taken modulo 2^32, so a sequence
+ * number or an uptime that wraps costs nothing special.
+ *
+ * The decoder is a byte at a time state machine: it takes the bytes in
+ * whatever pieces they arrive (flash reads, frames of a link) and hands
+ * out every record as soon as its last byte is in.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <string.h>
+
+#include "sales_codec.h"
+
+/* Defines */
+#define HDR_MARK 0x40           // Bits 7-6 of every header are 01
+#define HDR_MARK_MASK 0xc0
+#define HDR_TYPE_MASK 0x03
+#define HDR_SEQ 0x04
+#define HDR_VERSAO 0x08
+#define HDR_SESSION 0x10
+#define HDR_PRICE 0x20
+#define HDR_BAD 0xff            // Decoder stopped on a bad byte
+
+#define FIELD_SEQ 0
+#define FIELD_VERSAO 1
+#define FIELD_TIME 2
+#define FIELD_SESSION 3
+#define FIELD_PRICE 4
+#define FIELD_DONE 5
+
+/* Header flag of each field, 0 for the uptime delta which is always there */
+static const uint8_t field_flag[FIELD_DONE] = { HDR_SEQ, HDR_VERSAO, 0, HDR_SESSION, HDR_PRICE };
+
+/**
+ * @brief Brief decription of put_varint().
+ *
+ * @param *out   Buffer, at least 5 bytes
+ * @param value  Value to write
+ *
+ * @return Number of bytes written
+ *
+ */
+static int put_varint(uint8_t *out, uint32_t value) {
+    int n = 0;
+
+    while(value >= 0x80) {
+        out[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * @brief Brief decription of sales_codec_reset().
+ *
+ * Forgets the previous sale, the next record is written in full. Called
+ * at the start of every page
+ *
+ * @param *c  Encoder state
+ *
+ * @return Doesn't return anything
+ *
+ */
+void sales_codec_reset(struct sales_codec *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * @brief Brief decription of sales_encode().
+ *
+ * Encodes one sale against the previous one and makes it the previous one
+ *
+ * @param *c    Encoder state
+ * @param *s    Sale
+ * @param *out  Buffer, at least SALE_ENC_MAX bytes
+ *
+ * @return Number of bytes written, -EINVAL if the ticket type does not fit the header
+ *
+ */
+int sales_encode(struct sales_codec *c, const struct sale *s, uint8_t *out) {
+    uint8_t hdr = HDR_MARK | s->type;
+    int n = 1;
+
+    if(s->type > HDR_TYPE_MASK) {
+        return -EINVAL;
+    }
+    if(s->seq != c->seq) {
+        hdr |= HDR_SEQ;
+        n += put_varint(&out[n], s->seq - c->seq);
+    }
+    if(s->versao != c->versao) {
+        hdr |= HDR_VERSAO;
+        n += put_varint(&out[n], s->versao);
+    }
+    n += put_varint(&out[n], s->uptime_ms - c->uptime_ms);
+    if(s->session != c->session) {
+        hdr |= HDR_SESSION;
+        n += put_varint(&out[n], s->session);
+    }
+    if(s->price != c->price) {
+        hdr |= HDR_PRICE;
+        n += put_varint(&out[n], s->price);
+    }
+    out[0] = hdr;
+
+    c->seq = s->seq + 1;
+    c->uptime_ms = s->uptime_ms;
+    c->versao = s->versao;
+    c->session = s->session;
+    c->price = s->price;
+    return n;
+}
+
+/**
+ * @brief Brief decription of sales_decoder_reset().
+ *
+ * Starts decoding a page, also after sales_decode() returned an error
+ *
+ * @param *d  Decoder
+ *
+ * @return Doesn't return anything
+ *
+ */
+void sales_decoder_reset(struct sales_decoder *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+/**
+ * @brief Brief decription of next_field().
+ *
+ * @param hdr    Header of the record
+ * @param field  First field to consider, FIELD_x
+ *
+ * @return The first field from there the record has, FIELD_DONE if none
+ *
+ */
+static int next_field(uint8_t hdr, int field) {
+    while((field < FIELD_DONE) && (field_flag[field] != 0) && !(hdr & field_flag[field])) {
+        field++;
+    }
+    return field;
+}
+
+/**
+ * @brief Brief decription of store_field().
+ *
+ * @param *d  Decoder, with the value of its current field complete
+ *
+ * @return 0 on success, -EBADMSG if the value does not fit the field
+ *
+ */
+static int store_field(struct sales_decoder *d) {
+    switch(d->field) {
+    case FIELD_SEQ:
+        d->sale.seq = d->prev.seq + d->value;
+        break;
+    case FIELD_VERSAO:
+        d->sale.versao = d->value;
+        break;
+    case FIELD_TIME:
+        d->sale.uptime_ms = d->prev.uptime_ms + d->value;
+        break;
+    case FIELD_SESSION:
+        if(d->value > UINT16_MAX) {
+            return -EBADMSG;
+        }
+        d->sale.session = d->value;
+        break;
+    default:
+        if(d->value > UINT8_MAX) {
+            return -EBADMSG;
+        }
+        d->sale.price = d->value;
+        break;
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of sales_decode().
+ *
+ * Decodes the next bytes of a page. A record split across calls is kept
+ * in the decoder and handed out by the call that brings its last byte.
+ * Stops at the end of the bytes, when out is full or on a bad byte; the
+ * records before a bad byte are returned first, the decoder then answers
+ * -EBADMSG until it is reset
+ *
+ * @param *d     Decoder
+ * @param *in    Bytes
+ * @param len    Number of bytes
+ * @param *out   Buffer for the records
+ * @param max    Size of out, in records
+ * @param *used  Number of bytes consumed, the position of the bad byte on error
+ *
+ * @return Number of records decoded, -EBADMSG if the next byte is not a
+ *         valid record (the end of a page in erased flash)
+ *
+ */
+int sales_decode(struct sales_decoder *d, const uint8_t *in, int len, struct sale *out, int max, int *used) {
+    int i = 0, n = 0, bad = 0;
+    uint8_t b;
+
+    if(d->hdr == HDR_BAD) {
+        *used = 0;
+        return -EBADMSG;
+    }
+    while((i < len) && (n < max)) {
+        b = in[i++];
+        if(d->hdr == 0) {
+            if((b & HDR_MARK_MASK) != HDR_MARK) {
+                bad = 1;
+                break;
+            }
+            d->hdr = b;
+            d->sale.seq = d->prev.seq;
+            d->sale.versao = d->prev.versao;
+            d->sale.session = d->prev.session;
+            d->sale.price = d->prev.price;
+            d->sale.type = b & HDR_TYPE_MASK;
+            d->field = next_field(b, FIELD_SEQ);
+            d->shift = 0;
+            d->value = 0;
+            continue;
+        }
+
+        if((d->shift > 28) || ((d->shift == 28) && (b & 0x70))) {
+            bad = 1;                // More than 32 bits
+            break;
+        }
+        d->value |= (uint32_t)(b & 0x7f) << d->shift;
+        d->shift += 7;
+        if(b & 0x80) {
+            continue;
+        }
+        if(store_field(d) != 0) {
+            bad = 1;
+            break;
+        }
+        d->field = next_field(d->hdr, d->field + 1);
+        d->shift = 0;
+        d->value = 0;
+        if(d->field == FIELD_DONE) {
+            out[n++] = d->sale;
+            d->prev.seq = d->sale.seq + 1;
+            d->prev.uptime_ms = d->sale.uptime_ms;
+            d->prev.versao = d->sale.versao;
+            d->prev.session = d->sale.session;
+            d->prev.price = d->sale.price;
+            d->hdr = 0;
+        }
+    }
+    if(bad) {
+        d->hdr = HDR_BAD;
+        *used = i - 1;
+        return (n > 0) ? n : -EBADMSG;
+    }
+    *used = i;
+    return n;
+}
@@ -0,0 +1,57 @@
+/** @file sales_codec.h
+ * @brief Compact encoding of the sales records
+ *
+ * Each sale is stored as the difference to the sale before it: a header
+ * byte with the ticket type and a flag per field that changed, then
+ * varints (7 bits per byte, low bits first) for the fields that are not
+ * implied. The uptime is always a delta, the sequence number is only
+ * written when it does not follow the previous one, and the catalog
+ * version, session and price only when they change. A sale in the middle
+ * of a run takes 3 to 5 bytes instead of sizeof(struct sale).
+ *
+ * A record only decodes after the records before it, so a page of records
+ * starts from sales_codec_reset() and its first sale is written in full.
+ * 0xff is never a valid header, the end of a page in erased flash is
+ * found without a length. Plain C, also built on the host by
+ * scripts/sales_bench.c.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SALES_CODEC_H
+#define SALES_CODEC_H
+
+#include <stdint.h>
+
+#include "sales.h"
+
+/* Defines */
+#define SALE_ENC_MAX 21             // Header, 3 varints of 5 bytes, session 3, price 2
+
+/* Structure of the state shared by the encoder and the decoder: the previous sale */
+struct sales_codec {
+    uint32_t seq;                   // Sequence number that follows
+    uint32_t uptime_ms;
+    uint32_t versao;
+    uint16_t session;
+    uint8_t price;
+};
+
+/* Structure of a streaming decoder, records may be split across calls */
+struct sales_decoder {
+    struct sales_codec prev;
+    struct sale sale;               // Record being decoded
+    uint8_t hdr;                    // Header of that record, 0 before it is read
+    uint8_t field;                  // Next field to read
+    uint8_t shift;                  // Bits of the varint read so far
+    uint32_t value;
+};
+
+void sales_codec_reset(struct sales_codec *c);
+int sales_encode(struct sales_codec *c, const struct sale *s, uint8_t *out);
+void sales_decoder_reset(struct sales_decoder *d);
+int sales_decode(struct sales_decoder *d, const uint8_t *in, int len, struct sale *out, int max, int *used);
+
+#endif /* SALES_CODEC_H */
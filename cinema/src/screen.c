@@ -0,0 +1,402 @@
+/** @file screen.c
+ * @brief Pixel display backend of the console station
+ *
+ * What station 0 prints on the console is also drawn on a display of the
+ * Zephyr display API (SSD1306, ST7789, the dummy display, ...) with the
+ * 5x7 font, one 6x8 cell per character. The text goes into a grid of
+ * cells as the ANSI terminal would show it, fitted to the small screen:
+ * blank lines take no row, runs of spaces or dashes are cut to two, and
+ * lines are cut at the right edge.
+ *
+ * screen_flush() compares the grid with the one on the display. Each row
+ * with changes is one dirty rectangle, from its first to its last changed
+ * cell, and only those pixels go over the bus, so a new balance or a
+ * cursor move costs a few cells and never the whole frame. The pixels are
+ * built in the format of the display (1 bit per pixel vertical tiled as
+ * on the SSD1306, or 16, 24 or 32 bits) in a buffer of SCREEN_BUF_SIZE
+ * bytes, in as many writes as needed. The "display" stats group counts
+ * the updates, rectangles, writes and bytes, with the bytes of the last
+ * update and of a full frame to compare with.
+ *
+ * Only the thread of station 0 calls these functions.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <init.h>
+#include <drivers/display.h>
+#include <sys/printk.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "screen.h"
+#include "font.h"
+
+/* Defines */
+#define SCREEN_COLS CONFIG_CINEMA_DISPLAY_COLS
+#define SCREEN_ROWS CONFIG_CINEMA_DISPLAY_ROWS
+#define SCREEN_BUF_SIZE 1024            // Bytes of pixels per display_write()
+#define CELL_W 6                        // Glyph and one blank column
+#define CELL_H 8                        // Glyph and one blank line, one page of a tiled display
+#define BLANK 0                         // Glyph of ' '
+#define DASH ('-' - FONT_FIRST)
+#define MAX_RUN 2                       // Longest run of spaces or dashes drawn
+#define KEY_ESC 0x1b
+#define FORMATS (PIXEL_FORMAT_MONO01 | PIXEL_FORMAT_MONO10 | PIXEL_FORMAT_RGB_565 | \
+                 PIXEL_FORMAT_BGR_565 | PIXEL_FORMAT_RGB_888 | PIXEL_FORMAT_ARGB_8888)
+
+static const struct device *display_dev;
+static struct display_capabilities caps;
+static int bits;                        // Bits per pixel
+static bool ready = false;
+
+/* Grid being drawn and grid on the display, glyph indexes of font_5x7 */
+static uint8_t text[SCREEN_ROWS][SCREEN_COLS];
+static uint8_t shown[SCREEN_ROWS][SCREEN_COLS];
+static int cols, rows;                  // Cells that fit the display
+static int row, col;                    // Cursor
+static int last = -1, run;              // Last glyph of the line and how many in a row
+static bool line_used;                  // Something was drawn on the row of the cursor
+static uint8_t esc;                     // Bytes of an escape sequence seen
+
+static uint8_t buf[SCREEN_BUF_SIZE];
+
+/* Display stats */
+STATS_SECT_START(display_stats)
+STATS_SECT_ENTRY32(updates)
+STATS_SECT_ENTRY32(rects)
+STATS_SECT_ENTRY32(writes)
+STATS_SECT_ENTRY32(bytes)
+STATS_SECT_ENTRY32(last_bytes)
+STATS_SECT_ENTRY32(frame_bytes)
+STATS_SECT_END;
+
+STATS_SECT_DECL(display_stats) display_stats;
+
+STATS_NAME_START(display_stats)
+STATS_NAME(display_stats, updates)
+STATS_NAME(display_stats, rects)
+STATS_NAME(display_stats, writes)
+STATS_NAME(display_stats, bytes)
+STATS_NAME(display_stats, last_bytes)
+STATS_NAME(display_stats, frame_bytes)
+STATS_NAME_END(display_stats);
+
+/**
+ * @brief Brief decription of lit().
+ *
+ * @param x  Column of the pixel
+ * @param y  Row of the pixel
+ *
+ * @return true if the pixel of the grid on the display is on
+ *
+ */
+static bool lit(int x, int y) {
+    int c = x / CELL_W, r = y / CELL_H, gx = x % CELL_W, gy = y % CELL_H;
+
+    if((c >= cols) || (r >= rows) || (gx >= FONT_GLYPH_W) || (gy >= FONT_GLYPH_H)) {
+        return false;
+    }
+    return (font_5x7[shown[r][c]][gy] >> (FONT_GLYPH_W - 1 - gx)) & 1;
+}
+
+/**
+ * @brief Brief decription of render().
+ *
+ * Builds the pixels of a region of the display in its pixel format
+ *
+ * @param x  First column
+ * @param y  First row, a multiple of 8 for a tiled display
+ * @param w  Width in pixels
+ * @param h  Height in pixels, at most 8
+ *
+ * @return Number of bytes in buf
+ *
+ */
+static int render(int x, int y, int w, int h) {
+    bool mono_on = (caps.current_pixel_format == PIXEL_FORMAT_MONO01);
+    bool msb = (caps.screen_info & SCREEN_INFO_MONO_MSB_FIRST) != 0;
+    int i, j, n = 0, bit;
+    uint8_t b;
+
+    if(bits == 1) {
+        /* One byte per column of 8 pixels, the first pixel in bit 0 unless MSB_FIRST */
+        for(i=0; i<w; i++) {
+            b = 0;
+            for(j=0; j<h; j++) {
+                bit = msb ? (7 - j) : j;
+                if(lit(x + i, y + j) == mono_on) {
+                    b |= BIT(bit);
+                }
+            }
+            buf[n++] = b;
+        }
+        return n;
+    }
+    for(j=0; j<h; j++) {
+        for(i=0; i<w; i++) {
+            b = lit(x + i, y + j) ? 0xff : 0x00;
+            memset(&buf[n], b, bits / 8);
+            if(caps.current_pixel_format == PIXEL_FORMAT_ARGB_8888) {
+                buf[n + 3] = 0xff;     // Opaque
+            }
+            n += bits / 8;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Brief decription of push().
+ *
+ * Writes a region of the display from the grid on the display, in as
+ * many writes as buf needs
+ *
+ * @param x  First column
+ * @param y  First row
+ * @param w  Width in pixels
+ * @param h  Height in pixels, at most 8
+ *
+ * @return Number of bytes written
+ *
+ */
+static int push(int x, int y, int w, int h) {
+    struct display_buffer_descriptor desc;
+    int per_write = (bits == 1) ? SCREEN_BUF_SIZE : SCREEN_BUF_SIZE / (h * bits / 8);
+    int total = 0, n;
+
+    while(w > 0) {
+        desc.width = MIN(w, per_write);
+        desc.height = h;
+        desc.pitch = desc.width;
+        n = render(x, y, desc.width, h);
+        desc.buf_size = n;
+        display_write(display_dev, x, y, &desc, buf);
+        STATS_INC(display_stats, writes);
+        total += n;
+        x += desc.width;
+        w -= desc.width;
+    }
+    return total;
+}
+
+/**
+ * @brief Brief decription of put_glyph().
+ *
+ * Puts one glyph at the cursor of the grid being drawn
+ *
+ * @param g  Glyph index
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void put_glyph(int g) {
+    if(((g == BLANK) || (g == DASH)) && (g == last)) {
+        if(++run > MAX_RUN) {
+            return;
+        }
+    } else {
+        last = g;
+        run = 1;
+    }
+    if((row < rows) && (col < cols)) {
+        text[row][col] = g;
+    }
+    col++;
+    line_used = true;
+}
+
+/**
+ * @brief Brief decription of screen_write().
+ *
+ * Draws text printed on the console into the grid. Handles the ANSI
+ * sequences the menus use (clear screen, cursor home), CR and LF
+ *
+ * @param *s  Text, UTF-8
+ *
+ * @return Doesn't return anything
+ *
+ */
+void screen_write(const char *s) {
+    int g;
+
+    if(!ready) {
+        return;
+    }
+    while(*s != '\0') {
+        if(esc > 0) {
+            /* ESC [ parameters, ended by a letter: J clears, H homes */
+            if((esc == 1) || ((*s >= '0') && (*s <= '9')) || (*s == ';')) {
+                esc = 2;
+            } else {
+                if(*s == 'J') {
+                    memset(text, BLANK, sizeof(text));
+                } else if(*s == 'H') {
+                    row = col = 0;
+                    last = -1;
+                    line_used = false;
+                }
+                esc = 0;
+            }
+            s++;
+        } else if(*s == KEY_ESC) {
+            esc = 1;
+            s++;
+        } else if(*s == '\n') {
+            if(line_used) {
+                row++;
+                col = 0;
+                last = -1;
+                line_used = false;
+            }
+            s++;
+        } else if(*s == '\r') {
+            col = 0;
+            last = -1;
+            s++;
+        } else {
+            g = font_glyph(&s);
+            if(g >= 0) {
+                put_glyph(g);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of screen_flush().
+ *
+ * Sends the dirty rectangles of the grid to the display: one per row with
+ * changes, from its first to its last changed cell
+ *
+ * @return Doesn't return anything
+ *
+ */
+void screen_flush(void) {
+    int r, first, last, x, w, bytes = 0;
+
+    if(!ready) {
+        return;
+    }
+    for(r=0; r<rows; r++) {
+        for(first=0; (first < cols) && (text[r][first] == shown[r][first]); first++) {
+        }
+        if(first == cols) {
+            continue;
+        }
+        for(last=cols-1; text[r][last] == shown[r][last]; last--) {
+        }
+        memcpy(&shown[r][first], &text[r][first], last - first + 1);
+
+        x = first * CELL_W;
+        w = (last - first + 1) * CELL_W;
+        bytes += push(x, r * CELL_H, w, CELL_H);
+        STATS_INC(display_stats, rects);
+    }
+    if(bytes > 0) {
+        STATS_INC(display_stats, updates);
+        STATS_INCN(display_stats, bytes, bytes);
+        STATS_SET(display_stats, last_bytes, bytes);
+    }
+}
+
+/**
+ * @brief Brief decription of screen_blank().
+ *
+ * Turns the display off during the deep-idle, and on again
+ *
+ * @param blank  true to turn it off
+ *
+ * @return Doesn't return anything
+ *
+ */
+void screen_blank(bool blank) {
+    if(!ready) {
+        return;
+    }
+    if(blank) {
+        display_blanking_on(display_dev);
+    } else {
+        display_blanking_off(display_dev);
+    }
+}
+
+/**
+ * @brief Brief decription of screen_init().
+ *
+ * Picks a pixel format this backend draws, sizes the grid to the display
+ * and clears it
+ *
+ * @return 0 on success, -ENODEV without a usable display
+ *
+ */
+static int screen_init(const struct device *dev) {
+    uint32_t usable;
+    int y, frame = 0;
+
+    ARG_UNUSED(dev);
+
+#ifdef CONFIG_DUMMY_DISPLAY
+    display_dev = device_get_binding(CONFIG_DUMMY_DISPLAY_DEV_NAME);
+#else
+    display_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
+#endif
+    if((display_dev == NULL) || !device_is_ready(display_dev)) {
+        printk("Error: display is not ready\n");
+        return -ENODEV;
+    }
+    display_get_capabilities(display_dev, &caps);
+    if(!(caps.current_pixel_format & FORMATS)) {
+        usable = caps.supported_pixel_formats & FORMATS;
+        if((usable == 0) || (display_set_pixel_format(display_dev, usable & -usable) != 0)) {
+            printk("Error: no pixel format of the display is supported\n");
+            return -ENODEV;
+        }
+        display_get_capabilities(display_dev, &caps);
+    }
+    switch(caps.current_pixel_format) {
+    case PIXEL_FORMAT_MONO01:
+    case PIXEL_FORMAT_MONO10:
+        if(!(caps.screen_info & SCREEN_INFO_MONO_VTILED)) {
+            printk("Error: only vertically tiled monochrome displays are supported\n");
+            return -ENODEV;
+        }
+        bits = 1;
+        break;
+    case PIXEL_FORMAT_RGB_888:
+        bits = 24;
+        break;
+    case PIXEL_FORMAT_ARGB_8888:
+        bits = 32;
+        break;
+    default:
+        bits = 16;
+        break;
+    }
+    cols = MIN(caps.x_resolution / CELL_W, SCREEN_COLS);
+    rows = MIN(caps.y_resolution / CELL_H, SCREEN_ROWS);
+
+    memset(text, BLANK, sizeof(text));
+    memset(shown, BLANK, sizeof(shown));
+    for(y=0; y<caps.y_resolution; y+=CELL_H) {
+        frame += push(0, y, caps.x_resolution, MIN(CELL_H, caps.y_resolution - y));
+    }
+    display_blanking_off(display_dev);
+    ready = true;
+
+    stats_init_and_reg(STATS_HDR(display_stats), STATS_SIZE_32, 6,
+                       STATS_NAME_INIT_PARMS(display_stats), "display");
+    STATS_SET(display_stats, frame_bytes, frame);
+    printk("Display %dx%d, %d bits per pixel, %dx%d cells, %d bytes per frame\n",
+           caps.x_resolution, caps.y_resolution, bits, cols, rows, frame);
+    return 0;
+}
+
+SYS_INIT(screen_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,24 @@
+/** @file screen.h
+ * @brief Pixel display backend of the console station
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdbool.h>
+
+#ifdef CONFIG_CINEMA_DISPLAY
+void screen_write(const char *text);
+void screen_flush(void);
+void screen_blank(bool blank);
+#else
+static inline void screen_write(const char *text) {}
+static inline void screen_flush(void) {}
+static inline void screen_blank(bool blank) {}
+#endif
+
+#endif /* SCREEN_H */
@@ -0,0 +1,407 @@
+/** @file seat_sync.c
+ * @brief Seat inventory sync between two kiosks
+ *
+ * Link to the other kiosk on the UART chosen as cinema,peer-uart (see
+ * seat_sync.h for the frames). Records are batched: the first record
+ * arms a SEAT_SYNC_BATCH_MS timer and everything queued until then goes
+ * out in one frame. Nothing waits for an answer, claims of several
+ * sessions can be in flight at once and grants come back in later
+ * batches. A lost claim times out in seats.c; a lost grant only loses
+ * seats, it never sells one twice.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <spinlock.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+#include <sys/printk.h>
+#include <sys/ring_buffer.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "seat_sync.h"
+#include "seats.h"
+#include "cobs.h"
+
+/* Defines */
+#define SEAT_SYNC_UART_NODE DT_CHOSEN(cinema_peer_uart)
+#define SEAT_SYNC_MAX_FRAME 128
+#define SEAT_SYNC_HDR_LEN 4         // versao
+#define SEAT_SYNC_CRC_LEN 2
+#define SEAT_SYNC_BATCH_MS 10
+#define SEAT_SYNC_RX_QUEUE_LEN 4
+#define SEAT_SYNC_TX_BUF_SIZE 512
+#define CLAIM_LEN 4
+#define SEATS_LEN 11
+
+static const struct device * sync_dev = DEVICE_DT_GET(SEAT_SYNC_UART_NODE);
+
+/* Structure of one received frame, still COBS encoded */
+struct sync_rx_frame {
+    uint8_t len;
+    uint8_t data[COBS_MAX(SEAT_SYNC_MAX_FRAME)];
+};
+
+K_MSGQ_DEFINE(sync_rx_msgq, sizeof(struct sync_rx_frame), SEAT_SYNC_RX_QUEUE_LEN, 1);
+static struct sync_rx_frame rx_frame;
+static bool rx_overflow = false;
+
+RING_BUF_DECLARE(sync_tx_ring, SEAT_SYNC_TX_BUF_SIZE);
+
+/* Batch being filled, protected by batch_lock */
+static uint8_t batch[SEAT_SYNC_MAX_FRAME];
+static int batch_len = 0;
+static uint32_t batch_versao;
+static struct k_spinlock batch_lock;
+
+static void sync_rx_handler(struct k_work *work);
+static void sync_flush_handler(struct k_work *work);
+static K_WORK_DEFINE(sync_rx_work, sync_rx_handler);
+static K_WORK_DELAYABLE_DEFINE(sync_flush_work, sync_flush_handler);
+
+/* Link stats */
+STATS_SECT_START(seat_sync_stats)
+STATS_SECT_ENTRY32(tx_frames)
+STATS_SECT_ENTRY32(rx_frames)
+STATS_SECT_ENTRY32(records)
+STATS_SECT_ENTRY32(bad_frames)
+STATS_SECT_ENTRY32(tx_drops)
+STATS_SECT_END;
+
+STATS_SECT_DECL(seat_sync_stats) seat_sync_stats;
+
+STATS_NAME_START(seat_sync_stats)
+STATS_NAME(seat_sync_stats, tx_frames)
+STATS_NAME(seat_sync_stats, rx_frames)
+STATS_NAME(seat_sync_stats, records)
+STATS_NAME(seat_sync_stats, bad_frames)
+STATS_NAME(seat_sync_stats, tx_drops)
+STATS_NAME_END(seat_sync_stats);
+
+/**
+ * @brief Brief decription of flush().
+ *
+ * Encodes the batch as one frame and queues it for transmission,
+ * must be called with batch_lock held
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void flush(void) {
+    uint8_t enc[COBS_MAX(SEAT_SYNC_MAX_FRAME) + 1];
+    int n;
+
+    if(batch_len == 0) {
+        return;
+    }
+    sys_put_le32(batch_versao, batch);
+    sys_put_le16(crc16_ccitt(0xffff, batch, batch_len), &batch[batch_len]);
+    n = cobs_encode(batch, batch_len + SEAT_SYNC_CRC_LEN, enc);
+    enc[n++] = 0;
+    batch_len = 0;
+
+    /* A full ring drops the whole frame, never half of it */
+    if(ring_buf_space_get(&sync_tx_ring) < n) {
+        STATS_INC(seat_sync_stats, tx_drops);
+        return;
+    }
+    ring_buf_put(&sync_tx_ring, enc, n);
+    uart_irq_tx_enable(sync_dev);
+    STATS_INC(seat_sync_stats, tx_frames);
+}
+
+/**
+ * @brief Brief decription of add_record().
+ *
+ * Appends a record to the batch, sending the batch first if it is full
+ * or refers to another catalog
+ *
+ * @param versao  Catalog version of the record
+ * @param *rec    Record
+ * @param len     Size of rec
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void add_record(uint32_t versao, const uint8_t *rec, int len) {
+    k_spinlock_key_t key = k_spin_lock(&batch_lock);
+
+    if((batch_len > 0) && ((versao != batch_versao) ||
+       (batch_len + len + SEAT_SYNC_CRC_LEN > SEAT_SYNC_MAX_FRAME))) {
+        flush();
+    }
+    if(batch_len == 0) {
+        batch_len = SEAT_SYNC_HDR_LEN;
+        batch_versao = versao;
+        k_work_schedule(&sync_flush_work, K_MSEC(SEAT_SYNC_BATCH_MS));
+    }
+    memcpy(&batch[batch_len], rec, len);
+    batch_len += len;
+    k_spin_unlock(&batch_lock, key);
+}
+
+/**
+ * @brief Brief decription of add_seats().
+ *
+ * Appends a record with a seat set
+ *
+ * @param type     SEAT_SYNC_GRANT, SEAT_SYNC_SOLD or SEAT_SYNC_FREED
+ * @param versao   Catalog version
+ * @param session  Session id
+ * @param seats    Seat set
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void add_seats(uint8_t type, uint32_t versao, int session, uint64_t seats) {
+    uint8_t rec[SEATS_LEN];
+
+    rec[0] = type;
+    sys_put_le16(session, &rec[1]);
+    sys_put_le64(seats, &rec[3]);
+    add_record(versao, rec, sizeof(rec));
+}
+
+/**
+ * @brief Brief decription of add_claim().
+ *
+ * Appends a record with a seat count
+ *
+ * @param type     SEAT_SYNC_CLAIM or SEAT_SYNC_BUSY
+ * @param versao   Catalog version
+ * @param session  Session id
+ * @param count    Seats
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void add_claim(uint8_t type, uint32_t versao, int session, int count) {
+    uint8_t rec[CLAIM_LEN];
+
+    rec[0] = type;
+    sys_put_le16(session, &rec[1]);
+    rec[3] = MIN(count, SEATS_PER_SESSION);
+    add_record(versao, rec, sizeof(rec));
+}
+
+/**
+ * @brief Brief decription of seat_sync_claim().
+ *
+ * Asks the other kiosk for seats, the grant comes to seats_peer_grant()
+ * (or seats_peer_busy() when the claims crossed)
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param count    Seats wanted
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seat_sync_claim(uint32_t versao, int session, int count) {
+    add_claim(SEAT_SYNC_CLAIM, versao, session, count);
+}
+
+/**
+ * @brief Brief decription of seat_sync_sold().
+ *
+ * Tells the other kiosk about seats sold or given back
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param seats    Seat set
+ * @param sold     true if sold, false if given back
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seat_sync_sold(uint32_t versao, int session, uint64_t seats, bool sold) {
+    add_seats(sold ? SEAT_SYNC_SOLD : SEAT_SYNC_FREED, versao, session, seats);
+}
+
+/**
+ * @brief Brief decription of sync_flush_handler().
+ *
+ * Sends the batch SEAT_SYNC_BATCH_MS after its first record
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sync_flush_handler(struct k_work *work) {
+    k_spinlock_key_t key = k_spin_lock(&batch_lock);
+
+    ARG_UNUSED(work);
+
+    flush();
+    k_spin_unlock(&batch_lock, key);
+}
+
+/**
+ * @brief Brief decription of apply_records().
+ *
+ * Applies the records of one frame of the other kiosk, answering claims
+ *
+ * @param versao  Catalog version of the frame
+ * @param *rec    Records
+ * @param len     Size of the records
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void apply_records(uint32_t versao, const uint8_t *rec, int len) {
+    uint64_t seats;
+    int session;
+
+    while(len > 0) {
+        session = sys_get_le16(&rec[1]);
+        if((rec[0] == SEAT_SYNC_CLAIM) && (len >= CLAIM_LEN)) {
+            if(seats_peer_claim(versao, session, rec[3], &seats) == 0) {
+                add_seats(SEAT_SYNC_GRANT, versao, session, seats);
+            } else {
+                add_claim(SEAT_SYNC_BUSY, versao, session, rec[3]);
+            }
+            rec += CLAIM_LEN;
+            len -= CLAIM_LEN;
+        } else if((rec[0] == SEAT_SYNC_BUSY) && (len >= CLAIM_LEN)) {
+            seats_peer_busy(versao, session);
+            rec += CLAIM_LEN;
+            len -= CLAIM_LEN;
+        } else if(len >= SEATS_LEN) {
+            seats = sys_get_le64(&rec[3]);
+            switch(rec[0]){
+                case(SEAT_SYNC_GRANT):
+                    seats_peer_grant(versao, session, seats);
+                break;
+
+                case(SEAT_SYNC_SOLD):
+                case(SEAT_SYNC_FREED):
+                    seats_peer_sold(versao, session, seats, rec[0] == SEAT_SYNC_SOLD);
+                break;
+
+                default:
+                    STATS_INC(seat_sync_stats, bad_frames);
+                return;
+            }
+            rec += SEATS_LEN;
+            len -= SEATS_LEN;
+        } else {
+            STATS_INC(seat_sync_stats, bad_frames);
+            return;
+        }
+        STATS_INC(seat_sync_stats, records);
+    }
+}
+
+/**
+ * @brief Brief decription of sync_rx_handler().
+ *
+ * Decodes and checks the frames received from the other kiosk
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sync_rx_handler(struct k_work *work) {
+    struct sync_rx_frame enc;
+    uint8_t frame[SEAT_SYNC_MAX_FRAME];
+    int len;
+
+    ARG_UNUSED(work);
+
+    while(k_msgq_get(&sync_rx_msgq, &enc, K_NO_WAIT) == 0) {
+        len = cobs_decode(enc.data, enc.len, frame, sizeof(frame));
+        if(len < SEAT_SYNC_HDR_LEN + SEAT_SYNC_CRC_LEN) {
+            STATS_INC(seat_sync_stats, bad_frames);
+            continue;
+        }
+        len -= SEAT_SYNC_CRC_LEN;
+        if(crc16_ccitt(0xffff, frame, len) != sys_get_le16(&frame[len])) {
+            STATS_INC(seat_sync_stats, bad_frames);
+            continue;
+        }
+        STATS_INC(seat_sync_stats, rx_frames);
+        apply_records(sys_get_le32(frame), &frame[SEAT_SYNC_HDR_LEN], len - SEAT_SYNC_HDR_LEN);
+    }
+}
+
+/**
+ * @brief Brief decription of sync_uart_isr().
+ *
+ * UART interrupt: splits the received bytes in frames and feeds the
+ * transmitter from the ring buffer
+ *
+ * @param *dev        UART device
+ * @param *user_data  Unused
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sync_uart_isr(const struct device *dev, void *user_data) {
+    uint8_t c, *data;
+    uint32_t len;
+
+    ARG_UNUSED(user_data);
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if(uart_irq_rx_ready(dev)) {
+            while(uart_fifo_read(dev, &c, 1) == 1) {
+                if(c == 0) {
+                    /* Frames that overflowed or do not fit in the queue are dropped */
+                    if(!rx_overflow && (rx_frame.len > 0) &&
+                       (k_msgq_put(&sync_rx_msgq, &rx_frame, K_NO_WAIT) == 0)) {
+                        k_work_submit(&sync_rx_work);
+                    }
+                    rx_frame.len = 0;
+                    rx_overflow = false;
+                } else if(rx_frame.len < sizeof(rx_frame.data)) {
+                    rx_frame.data[rx_frame.len++] = c;
+                } else {
+                    rx_overflow = true;
+                }
+            }
+        }
+        if(uart_irq_tx_ready(dev)) {
+            len = ring_buf_get_claim(&sync_tx_ring, &data, SEAT_SYNC_TX_BUF_SIZE);
+            if(len == 0) {
+                uart_irq_tx_disable(dev);
+            } else {
+                len = uart_fifo_fill(dev, data, len);
+                ring_buf_get_finish(&sync_tx_ring, len);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of seat_sync_init().
+ *
+ * Enables the link UART interrupts and registers the stats
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int seat_sync_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    if(!device_is_ready(sync_dev)) {
+        printk("Error: seat sync uart is not ready\n");
+        return -ENODEV;
+    }
+    uart_irq_callback_user_data_set(sync_dev, sync_uart_isr, NULL);
+    uart_irq_rx_enable(sync_dev);
+    return stats_init_and_reg(STATS_HDR(seat_sync_stats), STATS_SIZE_32, 5,
+                              STATS_NAME_INIT_PARMS(seat_sync_stats), "seat_sync");
+}
+
+SYS_INIT(seat_sync_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,45 @@
+/** @file seat_sync.h
+ * @brief Seat inventory sync between two kiosks
+ *
+ * COBS encoded frames terminated by a 0x00 byte. Decoded frame:
+ *
+ *     [versao u32 le][record ...][crc16 u16 le]
+ *
+ * crc16 is crc16_ccitt(0xffff, ...) over versao and the records. Records
+ * refer to the sessions of catalog versao:
+ *
+ *     'C' [session u16][count u8]      claim count seats
+ *     'B' [session u16][count u8]      busy, claim refused for a claim of its own in flight
+ *     'G' [session u16][seats u64]     grant, the seats change owner (0 if none)
+ *     'S' [session u16][seats u64]     seats sold
+ *     'F' [session u16][seats u64]     sold seats given back
+ *
+ * Multi-byte fields are little-endian.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SEAT_SYNC_H
+#define SEAT_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Records */
+#define SEAT_SYNC_CLAIM 'C'
+#define SEAT_SYNC_BUSY 'B'
+#define SEAT_SYNC_GRANT 'G'
+#define SEAT_SYNC_SOLD 'S'
+#define SEAT_SYNC_FREED 'F'
+
+#ifdef CONFIG_CINEMA_SEAT_SYNC
+void seat_sync_claim(uint32_t versao, int session, int count);
+void seat_sync_sold(uint32_t versao, int session, uint64_t seats, bool sold);
+#else
+static inline void seat_sync_claim(uint32_t versao, int session, int count) {}
+static inline void seat_sync_sold(uint32_t versao, int session, uint64_t seats, bool sold) {}
+#endif
+
+#endif /* SEAT_SYNC_H */
@@ -0,0 +1,383 @@
+/** @file seats.c
+ * @brief Seat inventory of the sessions on sale
+ *
+ * One bit per seat. Every seat is owned by exactly one kiosk, and only its
+ * owner may sell it, so two kiosks selling the same session can never
+ * oversell. Without seat sync this kiosk owns every seat; with it the
+ * seats start split between the kiosks (even seats for kiosk 0, odd
+ * seats for kiosk 1). A sale of owned seats completes at once. When the
+ * owned seats run out, seats_claim() asks the other kiosk for more (plus
+ * SEAT_CLAIM_AHEAD, so the next sales are local again) and returns
+ * -EINPROGRESS until the grant arrives.
+ *
+ * Claims that cross on the link are resolved by kiosk id: a kiosk with a
+ * claim of its own in flight for the session still grants if it is
+ * kiosk 1 and answers busy if it is kiosk 0, so one of them always ends
+ * up with the seats. A busy answer only ends the claim, kiosk 1 claims
+ * again on its next sale; an empty grant means the other kiosk has no
+ * seat left and no more claims are sent until it gives some back.
+ * Each sale keeps the seats it took, so a failed payment gives back
+ * exactly those. Maps restart when the catalog version changes, like the
+ * analytics per session counters; sessions with ids of N_SEAT_SESSIONS
+ * and above, and customers still buying from the previous catalog, are
+ * not limited.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <init.h>
+#include <spinlock.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "seats.h"
+#include "seat_sync.h"
+#include "snapshot.h"
+
+/* Defines */
+#define ALL_SEATS ((SEATS_PER_SESSION == 64) ? ~0ULL : ((1ULL << SEATS_PER_SESSION) - 1))
+#define EVEN_SEATS 0x5555555555555555ULL
+#define SEAT_CLAIM_AHEAD 4          // Extra seats asked to the other kiosk
+#define SEAT_CLAIM_TIMEOUT_MS 2000
+
+/* Structure with the seats of one session */
+struct seat_map {
+    uint64_t owned;         // Seats this kiosk may sell
+    uint64_t sold;          // Seats sold by this kiosk
+    uint64_t peer_sold;     // Seats sold by the other kiosk, as reported by it
+    int64_t claim_started;  // Uptime of the claim in flight, 0 if none
+    bool peer_empty;        // The other kiosk had no seat to give
+};
+
+static struct seat_map maps[N_SEAT_SESSIONS];
+static uint32_t maps_versao;
+static bool maps_valid = false;
+static struct k_spinlock seats_lock;
+
+/* Seat stats */
+STATS_SECT_START(seats_stats)
+STATS_SECT_ENTRY32(local)
+STATS_SECT_ENTRY32(claims)
+STATS_SECT_ENTRY32(refused)
+STATS_SECT_ENTRY32(busy)
+STATS_SECT_ENTRY32(timeouts)
+STATS_SECT_ENTRY32(received)
+STATS_SECT_ENTRY32(lent)
+STATS_SECT_END;
+
+STATS_SECT_DECL(seats_stats) seats_stats;
+
+STATS_NAME_START(seats_stats)
+STATS_NAME(seats_stats, local)
+STATS_NAME(seats_stats, claims)
+STATS_NAME(seats_stats, refused)
+STATS_NAME(seats_stats, busy)
+STATS_NAME(seats_stats, timeouts)
+STATS_NAME(seats_stats, received)
+STATS_NAME(seats_stats, lent)
+STATS_NAME_END(seats_stats);
+
+/**
+ * @brief Brief decription of take_seats().
+ *
+ * @param from  Seats to pick from
+ * @param n     Number of seats wanted
+ *
+ * @return The n lowest seats of from, or all of them if there are fewer
+ *
+ */
+static uint64_t take_seats(uint64_t from, int n) {
+    uint64_t seats = 0, seat;
+
+    while((n-- > 0) && (from != 0)) {
+        seat = from & -from;
+        seats |= seat;
+        from &= ~seat;
+    }
+    return seats;
+}
+
+/**
+ * @brief Brief decription of session_map().
+ *
+ * Map of a session. The maps follow the catalog on sale and restart when
+ * its version changes. Must be called with seats_lock held
+ *
+ * @param versao   Catalog version the session id refers to
+ * @param session  Session id
+ *
+ * @return Pointer to the map, NULL if the session has no seat limit or
+ *         belongs to a catalog no longer on sale
+ *
+ */
+static struct seat_map *session_map(uint32_t versao, int session) {
+    int i;
+
+    if(!maps_valid || (versao != maps_versao)) {
+        if(versao != snapshot_peek()->versao) {
+            return NULL;
+        }
+        memset(maps, 0, sizeof(maps));
+        for(i=0; i<N_SEAT_SESSIONS; i++) {
+#ifdef CONFIG_CINEMA_SEAT_SYNC
+            maps[i].owned = ALL_SEATS & ((SEAT_KIOSK_ID == 0) ? EVEN_SEATS : ~EVEN_SEATS);
+#else
+            maps[i].owned = ALL_SEATS;
+#endif
+        }
+        maps_versao = versao;
+        maps_valid = true;
+    }
+    return ((session >= 0) && (session < N_SEAT_SESSIONS)) ? &maps[session] : NULL;
+}
+
+/**
+ * @brief Brief decription of seats_init().
+ *
+ * Registers the seat stats
+ *
+ * @return 0 on success, negative error code from the stats subsystem otherwise
+ *
+ */
+static int seats_init(const struct device *dev) {
+    ARG_UNUSED(dev);
+
+    return stats_init_and_reg(STATS_HDR(seats_stats), STATS_SIZE_32, 7,
+                              STATS_NAME_INIT_PARMS(seats_stats), "seats");
+}
+
+SYS_INIT(seats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/**
+ * @brief Brief decription of seats_claim().
+ *
+ * Sells n seats of a session. Never waits: when the seats must come from
+ * the other kiosk the claim is sent and the caller polls again
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param n        Number of seats
+ * @param *seats   Filled with the seats sold, for seats_release()
+ *                 (0 for a session without seat limit)
+ *
+ * @return 0 if the seats are sold, -EINPROGRESS while waiting for the other
+ *         kiosk, -ENOSPC if the session is sold out, -ETIMEDOUT if the other
+ *         kiosk did not answer
+ *
+ */
+int seats_claim(uint32_t versao, int session, int n, uint64_t *seats) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+    uint64_t free;
+    int missing = 0, ret = -ENOSPC;
+
+    *seats = 0;
+    if(map == NULL) {
+        ret = 0;
+    } else {
+        free = map->owned & ~map->sold;
+        if(__builtin_popcountll(free) >= n) {
+            *seats = take_seats(free, n);
+            map->sold |= *seats;
+            STATS_INC(seats_stats, local);
+            ret = 0;
+        } else if(IS_ENABLED(CONFIG_CINEMA_SEAT_SYNC)) {
+            if(map->claim_started != 0) {
+                if(k_uptime_get() - map->claim_started < SEAT_CLAIM_TIMEOUT_MS) {
+                    ret = -EINPROGRESS;
+                } else {
+                    map->claim_started = 0;
+                    STATS_INC(seats_stats, timeouts);
+                    ret = -ETIMEDOUT;
+                }
+            } else if(!map->peer_empty) {
+                missing = n - __builtin_popcountll(free) + SEAT_CLAIM_AHEAD;
+                map->claim_started = k_uptime_get();
+                STATS_INC(seats_stats, claims);
+                ret = -EINPROGRESS;
+            }
+        }
+    }
+    k_spin_unlock(&seats_lock, key);
+
+    if(*seats != 0) {
+        seat_sync_sold(versao, session, *seats, true);
+    }
+    if(missing > 0) {
+        seat_sync_claim(versao, session, missing);
+    }
+    return ret;
+}
+
+/**
+ * @brief Brief decription of seats_release().
+ *
+ * Gives back the seats of a sale whose payment failed
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ * @param seats    Seats returned by seats_claim() for that sale
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seats_release(uint32_t versao, int session, uint64_t seats) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+
+    /* Seats of a previous map were never sold in this one */
+    seats = (map != NULL) ? (seats & map->sold) : 0;
+    if(seats != 0) {
+        map->sold &= ~seats;
+    }
+    k_spin_unlock(&seats_lock, key);
+
+    if(seats != 0) {
+        seat_sync_sold(versao, session, seats, false);
+    }
+}
+
+/**
+ * @brief Brief decription of seats_available().
+ *
+ * @param versao   Version of the catalog on sale
+ * @param session  Session id
+ *
+ * @return Seats not sold by any kiosk, -1 if the session has no seat limit
+ *
+ */
+int seats_available(uint32_t versao, int session) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+    int n = -1;
+
+    if(map != NULL) {
+        n = SEATS_PER_SESSION - __builtin_popcountll(map->sold | map->peer_sold);
+    }
+    k_spin_unlock(&seats_lock, key);
+    return n;
+}
+
+/**
+ * @brief Brief decription of seats_peer_claim().
+ *
+ * Gives seats to the other kiosk
+ *
+ * @param versao   Catalog version of the other kiosk
+ * @param session  Session id
+ * @param count    Seats asked
+ * @param *seats   Filled with the seats given, their ownership moves to
+ *                 the other kiosk
+ *
+ * @return 0 on success (seats may be 0 if none is left), -EBUSY if this
+ *         kiosk keeps its seats for a claim of its own in flight
+ *
+ */
+int seats_peer_claim(uint32_t versao, int session, int count, uint64_t *seats) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+    int ret = 0;
+
+    *seats = 0;
+    if(map == NULL) {
+        ret = 0;
+    } else if((map->claim_started != 0) && (SEAT_KIOSK_ID == 0)) {
+        /* Crossing claims: kiosk 0 keeps its seats, kiosk 1 gives them */
+        ret = -EBUSY;
+    } else {
+        *seats = take_seats(map->owned & ~map->sold, count);
+        map->owned &= ~*seats;
+        if(*seats != 0) {
+            map->peer_empty = false;
+            STATS_INCN(seats_stats, lent, __builtin_popcountll(*seats));
+        }
+    }
+    k_spin_unlock(&seats_lock, key);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of seats_peer_grant().
+ *
+ * Answer of the other kiosk to our claim
+ *
+ * @param versao   Catalog version of the other kiosk
+ * @param session  Session id
+ * @param seats    Seats given to this kiosk, 0 if none
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seats_peer_grant(uint32_t versao, int session, uint64_t seats) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+
+    if(map != NULL) {
+        map->owned |= seats;
+        map->claim_started = 0;
+        if(seats == 0) {
+            map->peer_empty = true;
+            STATS_INC(seats_stats, refused);
+        } else {
+            STATS_INCN(seats_stats, received, __builtin_popcountll(seats));
+        }
+    }
+    k_spin_unlock(&seats_lock, key);
+}
+
+/**
+ * @brief Brief decription of seats_peer_busy().
+ *
+ * The other kiosk kept its seats for a claim of its own that crossed
+ * ours. Ends our claim without taking the other kiosk as sold out, the
+ * next sale claims again
+ *
+ * @param versao   Catalog version of the other kiosk
+ * @param session  Session id
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seats_peer_busy(uint32_t versao, int session) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+
+    if(map != NULL) {
+        map->claim_started = 0;
+        STATS_INC(seats_stats, busy);
+    }
+    k_spin_unlock(&seats_lock, key);
+}
+
+/**
+ * @brief Brief decription of seats_peer_sold().
+ *
+ * Seats sold (or given back) by the other kiosk, only for seats_available()
+ *
+ * @param versao   Catalog version of the other kiosk
+ * @param session  Session id
+ * @param seats    Seats
+ * @param sold     true if sold, false if given back
+ *
+ * @return Doesn't return anything
+ *
+ */
+void seats_peer_sold(uint32_t versao, int session, uint64_t seats, bool sold) {
+    k_spinlock_key_t key = k_spin_lock(&seats_lock);
+    struct seat_map *map = session_map(versao, session);
+
+    if(map != NULL) {
+        if(sold) {
+            map->peer_sold |= seats;
+        } else {
+            map->peer_sold &= ~seats;
+            map->peer_empty = false;
+        }
+    }
+    k_spin_unlock(&seats_lock, key);
+}
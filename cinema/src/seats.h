@@ -0,0 +1,34 @@
+/** @file seats.h
+ * @brief Seat inventory of the sessions on sale
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SEATS_H
+#define SEATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+#define SEATS_PER_SESSION CONFIG_CINEMA_SEATS_PER_SESSION   // At most 64, one bit per seat
+#define N_SEAT_SESSIONS CONFIG_CINEMA_SEAT_SESSIONS         // Sessions with a seat limit
+#ifdef CONFIG_CINEMA_SEAT_KIOSK_ID
+#define SEAT_KIOSK_ID CONFIG_CINEMA_SEAT_KIOSK_ID
+#else
+#define SEAT_KIOSK_ID 0             // No other kiosk
+#endif
+
+int seats_claim(uint32_t versao, int session, int n, uint64_t *seats);
+void seats_release(uint32_t versao, int session, uint64_t seats);
+int seats_available(uint32_t versao, int session);
+
+/* Called by the seat sync link with the records of the other kiosk */
+int seats_peer_claim(uint32_t versao, int session, int count, uint64_t *seats);
+void seats_peer_grant(uint32_t versao, int session, uint64_t seats);
+void seats_peer_busy(uint32_t versao, int session);
+void seats_peer_sold(uint32_t versao, int session, uint64_t seats, bool sold);
+
+#endif /* SEATS_H */
@@ -0,0 +1,98 @@
+/** @file seq_store.c
+ * @brief Sale sequence numbers kept in flash across reboots
+ *
+ * The sales record reserves sequence numbers a block at a time and saves
+ * the end of the block here before using the first one, so after a reboot
+ * it starts past every number it may have given. The storage partition is
+ * a log of 32-bit words, one per block: the highest word is the last one
+ * saved. Words are written in order over the erased (0xffffffff) ones and
+ * a page is erased when the log wraps into it; the highest word is always
+ * in another page, so a power loss never loses it.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <storage/flash_map.h>
+#include <sys/printk.h>
+
+#include "seq_store.h"
+
+/* Defines */
+#define SEQ_AREA FLASH_AREA_ID(storage)
+#define SEQ_PAGE_SIZE 4096              // Erase page of the nRF52840 and of the flash simulator
+#define SEQ_ERASED 0xffffffff
+
+static const struct flash_area *area = NULL;
+static uint32_t next_off;               // Where the next word goes
+
+/**
+ * @brief Brief decription of seq_store_load().
+ *
+ * Opens the partition and finds the last word saved
+ *
+ * @return End of the last block saved, 0 if there is none or the
+ *         partition cannot be read
+ *
+ */
+uint32_t seq_store_load(void) {
+    uint32_t off, word, last = 0, last_off = 0;
+    bool found = false;
+
+    if(flash_area_open(SEQ_AREA, &area) != 0) {
+        printk("Error: no flash for the ticket numbers\n");
+        area = NULL;
+        return 0;
+    }
+    for(off=0; off + sizeof(word) <= area->fa_size; off+=sizeof(word)) {
+        if(flash_area_read(area, off, &word, sizeof(word)) != 0) {
+            printk("Error: ticket numbers not read\n");
+            break;
+        }
+        if((word != SEQ_ERASED) && (!found || (word > last))) {
+            last = word;
+            last_off = off;
+            found = true;
+        }
+    }
+    next_off = found ? (last_off + sizeof(word)) % area->fa_size : 0;
+    return last;
+}
+
+/**
+ * @brief Brief decription of seq_store_save().
+ *
+ * Saves the end of a new block of sequence numbers
+ *
+ * @param limit  First sequence number past the block
+ *
+ * @return 0 on success, -ENODEV without the partition, negative error
+ *         code from the flash otherwise
+ *
+ */
+int seq_store_save(uint32_t limit) {
+    uint32_t word;
+    int ret;
+
+    if(area == NULL) {
+        return -ENODEV;
+    }
+    /* A page not erased yet since the log last went through it */
+    if((next_off % SEQ_PAGE_SIZE) == 0) {
+        ret = flash_area_read(area, next_off, &word, sizeof(word));
+        if((ret == 0) && (word != SEQ_ERASED)) {
+            ret = flash_area_erase(area, next_off, SEQ_PAGE_SIZE);
+        }
+        if(ret != 0) {
+            return ret;
+        }
+    }
+    ret = flash_area_write(area, next_off, &limit, sizeof(limit));
+    if(ret == 0) {
+        next_off = (next_off + sizeof(limit)) % area->fa_size;
+    }
+    return ret;
+}
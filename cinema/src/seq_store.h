@@ -0,0 +1,22 @@
+/** @file seq_store.h
+ * @brief Sale sequence numbers kept in flash across reboots
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SEQ_STORE_H
+#define SEQ_STORE_H
+
+#include <stdint.h>
+
+#ifdef CONFIG_CINEMA_SEQ_STORE
+uint32_t seq_store_load(void);
+int seq_store_save(uint32_t limit);
+#else
+static inline uint32_t seq_store_load(void) { return 0; }
+static inline int seq_store_save(uint32_t limit) { return 0; }
+#endif
+
+#endif /* SEQ_STORE_H */
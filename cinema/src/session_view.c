@@ -0,0 +1,101 @@
+/** @file session_view.c
+ * @brief Sessions still on sale, by the wall clock
+ *
+ * The menus list the movies and sessions of a view instead of the whole
+ * catalog. A session leaves the view when its hour starts and every
+ * session is back at midnight, for the showings of the new day; a movie
+ * without sessions left is not listed. The view is only rebuilt when the
+ * minute of the wall clock or the catalog changes, the redraws in between
+ * just read it. While the wall clock is not set every session is listed.
+ * Each station keeps its own view, of the catalog it holds, so no lock
+ * is needed.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+
+#include "session_view.h"
+#include "wallclock.h"
+
+/**
+ * @brief Brief decription of rebuild().
+ *
+ * @param *v      View
+ * @param *cat    Catalog
+ * @param minute  Wall clock minute, WALLCLOCK_UNSET to list every session
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void rebuild(struct session_view *v, const struct catalog *cat, int32_t minute) {
+    int now = (minute == WALLCLOCK_UNSET) ? -1 : (int)(minute % MINUTES_PER_DAY);
+    int m, s, n_ids = 0;
+    struct view_movie *vm;
+
+    v->cat = cat;
+    v->versao = cat->versao;
+    v->minute = minute;
+    v->n_movies = 0;
+    for(m=0; (m < cat->n_movies) && (v->n_movies < VIEW_MAX_MOVIES); m++) {
+        vm = &v->movies[v->n_movies];
+        vm->movie = m;
+        vm->first = n_ids;
+        vm->n_sessoes = 0;
+        for(s=0; (s < cat->movies[m].n_sessoes) && (n_ids < VIEW_MAX_SESSIONS); s++) {
+            if(movie_session(cat, m, s)->horas * 60 > now) {
+                v->ids[n_ids++] = session_id(cat, m, s);
+                vm->n_sessoes++;
+            }
+        }
+        if(vm->n_sessoes > 0) {
+            v->n_movies++;
+        }
+    }
+}
+
+/**
+ * @brief Brief decription of session_view_update().
+ *
+ * Rebuilds the view if the wall clock went to another minute or the
+ * catalog is not the one it was built from
+ *
+ * @param *v    View, zeroed before the first call
+ * @param *cat  Catalog held by the station
+ *
+ * @return true if the view was rebuilt
+ *
+ */
+bool session_view_update(struct session_view *v, const struct catalog *cat) {
+    int32_t minute = wallclock_minute();
+
+    /* The snapshots are reused, the version tells two catalogs in the same store apart */
+    if((v->cat == cat) && (v->versao == cat->versao) && (v->minute == minute)) {
+        return false;
+    }
+    rebuild(v, cat, minute);
+    return true;
+}
+
+/**
+ * @brief Brief decription of session_view_find().
+ *
+ * @param *v     View
+ * @param movie  Movie index in the catalog
+ *
+ * @return Index of the movie in the view, -1 if none of its sessions is still on sale
+ *
+ */
+int session_view_find(const struct session_view *v, int movie) {
+    int i;
+
+    for(i=0; i<v->n_movies; i++) {
+        if(v->movies[i].movie == movie) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,76 @@
+/** @file session_view.h
+ * @brief Sessions still on sale, by the wall clock
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SESSION_VIEW_H
+#define SESSION_VIEW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "catalog.h"
+
+/* Defines */
+#define VIEW_MAX_MOVIES CONFIG_CINEMA_VIEW_MOVIES
+#define VIEW_MAX_SESSIONS CONFIG_CINEMA_VIEW_SESSIONS
+
+/* Structure of one movie of the view, its sessions are consecutive in ids */
+struct view_movie {
+    uint16_t movie;                 // Movie index in the catalog
+    uint16_t first;                 // Index of its first session in ids
+    uint16_t n_sessoes;
+};
+
+/* Structure with the movies and sessions that can still be sold */
+struct session_view {
+    const struct catalog *cat;      // Catalog the view was built from
+    uint32_t versao;
+    int32_t minute;                 // Wall clock minute it was built at
+    int n_movies;
+    struct view_movie movies[VIEW_MAX_MOVIES];
+    uint16_t ids[VIEW_MAX_SESSIONS];    // Session ids
+};
+
+bool session_view_update(struct session_view *v, const struct catalog *cat);
+int session_view_find(const struct session_view *v, int movie);
+
+/**
+ * @brief Brief decription of view_session().
+ *
+ * @param *v   View
+ * @param *vm  Movie of the view
+ * @param s    Session index inside that movie of the view
+ *
+ * @return Session index inside the movie of the catalog, for movie_session()
+ *
+ */
+static inline int view_session(const struct session_view *v, const struct view_movie *vm, int s) {
+    return v->ids[vm->first + s] - v->cat->movies[vm->movie].first;
+}
+
+/**
+ * @brief Brief decription of view_find_session().
+ *
+ * @param *v      View
+ * @param *vm     Movie of the view
+ * @param sessao  Session index inside the movie of the catalog
+ *
+ * @return Index of the session inside the movie of the view, -1 if it is no longer on sale
+ *
+ */
+static inline int view_find_session(const struct session_view *v, const struct view_movie *vm, int sessao) {
+    int s;
+
+    for(s=0; s<vm->n_sessoes; s++) {
+        if(view_session(v, vm, s) == sessao) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+#endif /* SESSION_VIEW_H */
@@ -0,0 +1,116 @@
+/** @file sign_cc310.c
+ * @brief SHA-256 on the nRF52840 CryptoCell 310
+ *
+ * Uses the nrf_cc310_bl library of nrfxlib. The CryptoCell is only
+ * powered during each call, and the calls are serialized with a mutex
+ * since the signing thread and the stations share it. The library keeps
+ * the hash state in the context between calls, so contexts can be copied
+ * like the software ones.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/printk.h>
+#include <hal/nrf_cryptocell.h>
+#include <nrf_cc310_bl_init.h>
+
+#include "sign_hash.h"
+
+static K_MUTEX_DEFINE(cc310_lock);
+
+/**
+ * @brief Brief decription of cc310_begin().
+ *
+ * Takes and powers the CryptoCell
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void cc310_begin(void) {
+    k_mutex_lock(&cc310_lock, K_FOREVER);
+    nrf_cryptocell_enable(NRF_CRYPTOCELL);
+}
+
+/**
+ * @brief Brief decription of cc310_end().
+ *
+ * Powers down and releases the CryptoCell
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void cc310_end(void) {
+    nrf_cryptocell_disable(NRF_CRYPTOCELL);
+    k_mutex_unlock(&cc310_lock);
+}
+
+/**
+ * @brief Brief decription of sign_hash_setup().
+ *
+ * Initializes the CryptoCell library
+ *
+ * @return 0 on success, -EIO otherwise
+ *
+ */
+int sign_hash_setup(void) {
+    int ret;
+
+    cc310_begin();
+    ret = nrf_cc310_bl_init();
+    cc310_end();
+    if(ret != CRYS_OK) {
+        printk("Error: cc310 init failed (0x%x)\n", ret);
+        return -EIO;
+    }
+    return 0;
+}
+
+/**
+ * @brief Brief decription of sign_hash_init().
+ *
+ * @param *ctx  Context to start
+ *
+ * @return Doesn't return anything
+ *
+ */
+void sign_hash_init(sign_hash_ctx *ctx) {
+    cc310_begin();
+    nrf_cc310_bl_hash_sha256_init(ctx);
+    cc310_end();
+}
+
+/**
+ * @brief Brief decription of sign_hash_update().
+ *
+ * @param *ctx   Context
+ * @param *data  Bytes to hash
+ * @param len    Number of bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+void sign_hash_update(sign_hash_ctx *ctx, const uint8_t *data, size_t len) {
+    cc310_begin();
+    nrf_cc310_bl_hash_sha256_update(ctx, data, len);
+    cc310_end();
+}
+
+/**
+ * @brief Brief decription of sign_hash_final().
+ *
+ * @param *ctx     Context
+ * @param *digest  SIGN_HASH_LEN bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+void sign_hash_final(sign_hash_ctx *ctx, uint8_t *digest) {
+    cc310_begin();
+    nrf_cc310_bl_hash_sha256_finalize(ctx, (nrf_cc310_bl_hash_digest_sha256_t *)digest);
+    cc310_end();
+}
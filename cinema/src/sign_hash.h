@@ -0,0 +1,45 @@
+/** @file sign_hash.h
+ * @brief SHA-256 backends of the ticket signatures
+ *
+ * The same streaming SHA-256 interface is implemented in plain C
+ * (sign_sw.c, also built on the host by scripts/sign_check.c) and on the
+ * nRF52840 CryptoCell 310 (sign_cc310.c, CONFIG_CINEMA_SIGN_CC310). A
+ * context is plain memory: it may be copied to resume a hash from the
+ * same point, which is how hmac.c reuses the key pads.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SIGN_HASH_H
+#define SIGN_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef CONFIG_CINEMA_SIGN_CC310
+#include <nrf_cc310_bl_hash_sha256.h>
+#endif
+
+/* Defines */
+#define SIGN_HASH_LEN 32
+#define SIGN_BLOCK_LEN 64
+
+#ifdef CONFIG_CINEMA_SIGN_CC310
+typedef nrf_cc310_bl_hash_context_sha256_t sign_hash_ctx;
+#else
+/* Structure of a software SHA-256 context */
+typedef struct {
+    uint32_t state[8];
+    uint64_t count;                 // Bytes hashed so far
+    uint8_t buf[SIGN_BLOCK_LEN];    // Partial block, count % SIGN_BLOCK_LEN bytes
+} sign_hash_ctx;
+#endif
+
+int sign_hash_setup(void);
+void sign_hash_init(sign_hash_ctx *ctx);
+void sign_hash_update(sign_hash_ctx *ctx, const uint8_t *data, size_t len);
+void sign_hash_final(sign_hash_ctx *ctx, uint8_t *digest);
+
+#endif /* SIGN_HASH_H */
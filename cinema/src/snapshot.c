@@ -0,0 +1,319 @@
+/** @file snapshot.c
+ * @brief Double-buffered catalog and price table
+ *
+ * SNAPSHOT_READERS + 2 RAM snapshots exist: the active one, one per
+ * reader (an idle station still holds the catalog of its last
+ * transaction) and one for the writer, so an update always finds a free
+ * one (a catalog blob in flash, when present, is another snapshot used
+ * at boot). The state machine of each
+ * customer station (one reader each) takes the active snapshot at the
+ * start of each transaction and keeps using it until the next one, so a
+ * customer keeps the prices they were quoted. An update is written into
+ * an inactive snapshot and made visible with a single atomic pointer
+ * store (RCU style).
+ *
+ * Readers never wait: each publishes the snapshot it holds and the writer
+ * refuses to stage over those snapshots until the readers have moved on.
+ * Writers (catalog updates, the repricing at midnight) each reserve the
+ * store they fill, a repricing only replaces the catalog it was made from.
+ *
+ * Rules restricted to some weekdays need the wall clock: every RAM store
+ * keeps its rules and the weekday its prices were compiled for, and at
+ * local midnight the catalog on sale is compiled again for the new day.
+ * A catalog blob keeps the prices compiled into it.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <init.h>
+#include <sys/atomic.h>
+#include <sys/util.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "wallclock.h"
+#ifdef CONFIG_CINEMA_CATALOG_BLOB
+#include "catalog_blob.h"
+#endif
+
+/* Defines */
+#define REPRICE_RETRY_MS 1000   // No free store, the stations are still on older catalogs
+#define CLOCK_POLL_MS 60000     // Clock not set yet
+
+static struct catalog_store stores[SNAPSHOT_READERS + 2];
+static K_MUTEX_DEFINE(writer_lock);     // Store reservations and repricing publish
+
+static void day_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(day_work, day_handler);
+
+BUILD_ASSERT(WALLCLOCK_UNSET == WEEKDAY_UNKNOWN, "wallclock_weekday() is a weekday for pricing_compile()");
+
+/* Snapshot on sale and snapshot held by each reader */
+static atomic_ptr_t active = ATOMIC_PTR_INIT(NULL);
+static atomic_ptr_t readers[SNAPSHOT_READERS];
+
+/**
+ * @brief Brief decription of snapshot_init().
+ *
+ * Puts the catalog blob on sale if there is a valid one in flash,
+ * otherwise the built-in catalog, with its prices compiled in the first store
+ *
+ * @return Always returns 0
+ *
+ */
+static int snapshot_init(const struct device *dev) {
+    const struct catalog *cat = NULL;
+
+    ARG_UNUSED(dev);
+
+#ifdef CONFIG_CINEMA_CATALOG_BLOB
+    cat = catalog_blob_open();
+#endif
+    if(cat == NULL) {
+        stores[0].cat = default_catalog;
+        snapshot_compile(&stores[0], default_rules, n_default_rules);
+        cat = &stores[0].cat;
+    }
+    atomic_ptr_set(&active, (void *)cat);
+    k_work_schedule(&day_work, K_MSEC(CLOCK_POLL_MS));
+    return 0;
+}
+
+SYS_INIT(snapshot_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/**
+ * @brief Brief decription of snapshot_acquire().
+ *
+ * Takes the active catalog. It stays valid until the next call,
+ * the previous catalog is released by calling this again
+ *
+ * @param reader  Customer station, 0 to SNAPSHOT_READERS - 1
+ *
+ * @return Pointer to the catalog on sale
+ *
+ */
+const struct catalog *snapshot_acquire(int reader) {
+    const struct catalog *cat;
+
+    /* Retry if a flip happened before the writer could see our pointer */
+    do {
+        cat = atomic_ptr_get(&active);
+        atomic_ptr_set(&readers[reader], (void *)cat);
+    } while(cat != atomic_ptr_get(&active));
+
+    return cat;
+}
+
+/**
+ * @brief Brief decription of snapshot_peek().
+ *
+ * Looks at the active catalog without holding it. Only for the writer
+ * (it is the one that could replace it) or for reading its header fields
+ *
+ * @return Pointer to the catalog on sale
+ *
+ */
+const struct catalog *snapshot_peek(void) {
+    return atomic_ptr_get(&active);
+}
+
+/**
+ * @brief Brief decription of snapshot_stage().
+ *
+ * Gives a writer a store that is neither on sale, held by a reader nor
+ * being filled by another writer. It stays reserved until
+ * snapshot_publish() or snapshot_unstage()
+ *
+ * @return Pointer to the store to fill, NULL if all are in use (the
+ *         stations hold catalogs of transactions started before the last updates)
+ *
+ */
+struct catalog_store *snapshot_stage(void) {
+    struct catalog_store *st = NULL;
+    int i, r;
+
+    k_mutex_lock(&writer_lock, K_FOREVER);
+    for(i=0; (i<ARRAY_SIZE(stores)) && (st == NULL); i++) {
+        if((atomic_ptr_get(&active) == &stores[i].cat) || stores[i].staged) {
+            continue;
+        }
+        for(r=0; (r<SNAPSHOT_READERS) && (atomic_ptr_get(&readers[r]) != &stores[i].cat); r++) {
+        }
+        if(r == SNAPSHOT_READERS) {
+            st = &stores[i];
+            st->staged = true;
+        }
+    }
+    k_mutex_unlock(&writer_lock);
+    return st;
+}
+
+/**
+ * @brief Brief decription of snapshot_unstage().
+ *
+ * Gives back a store from snapshot_stage() that is not going on sale
+ *
+ * @param *st  Store
+ *
+ * @return Doesn't return anything
+ *
+ */
+void snapshot_unstage(struct catalog_store *st) {
+    k_mutex_lock(&writer_lock, K_FOREVER);
+    st->staged = false;
+    k_mutex_unlock(&writer_lock);
+}
+
+/**
+ * @brief Brief decription of snapshot_compile().
+ *
+ * Compiles the prices of a store with its rules for the current weekday,
+ * the rules are kept to compile them again on another day
+ *
+ * @param *st      Store, with its catalog filled
+ * @param *rules   Rules, applied in order
+ * @param n_rules  Number of rules, at most MAX_RULES are kept
+ *
+ * @return Doesn't return anything
+ *
+ */
+void snapshot_compile(struct catalog_store *st, const struct price_rule *rules, int n_rules) {
+    st->n_rules = MIN(n_rules, MAX_RULES);
+    if(rules != st->rules) {
+        memcpy(st->rules, rules, st->n_rules * sizeof(struct price_rule));
+    }
+    st->weekday = wallclock_weekday();
+    pricing_compile(st->prices, &st->cat, st->rules, st->n_rules, st->weekday);
+    st->cat.prices = st->prices;
+}
+
+/**
+ * @brief Brief decription of snapshot_publish().
+ *
+ * Puts a staged catalog on sale
+ *
+ * @param *next  View of the store returned by snapshot_stage(), already filled
+ *
+ * @return Doesn't return anything
+ *
+ */
+void snapshot_publish(const struct catalog *next) {
+    struct catalog_store *st = CONTAINER_OF(next, struct catalog_store, cat);
+
+    k_mutex_lock(&writer_lock, K_FOREVER);
+    atomic_ptr_set(&active, (void *)next);
+    st->staged = false;
+    k_mutex_unlock(&writer_lock);
+}
+
+/**
+ * @brief Brief decription of store_of().
+ *
+ * @param *cat  Catalog
+ *
+ * @return RAM store of the catalog, NULL for a catalog blob
+ *
+ */
+static struct catalog_store *store_of(const struct catalog *cat) {
+    int i;
+
+    for(i=0; i<ARRAY_SIZE(stores); i++) {
+        if(cat == &stores[i].cat) {
+            return &stores[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Brief decription of snapshot_reprice().
+ *
+ * Puts the catalog on sale again with its prices compiled for the current
+ * weekday, if they were compiled for another day. The copy keeps the
+ * version, seats and sales of the catalog are not touched. Transactions
+ * already started keep the prices they were quoted
+ *
+ * @return 0 on success or if there was nothing to do, -EBUSY if no store
+ *         is free, -EAGAIN if an update was published meanwhile
+ *
+ */
+int snapshot_reprice(void) {
+    const struct catalog *cur = snapshot_peek();
+    struct catalog_store *src = store_of(cur), *st;
+    int m, ret = 0;
+
+    if((src == NULL) || (src->weekday == wallclock_weekday())) {
+        return 0;
+    }
+    st = snapshot_stage();
+    if(st == NULL) {
+        return -EBUSY;
+    }
+    /* The catalog on sale is never written, copying it needs no lock */
+    st->cat = *cur;
+    memcpy(st->movies, cur->movies, cur->n_movies * sizeof(struct movie));
+    memcpy(st->sessoes, cur->sessoes, cur->n_sessions * sizeof(struct session));
+    for(m=0; m<cur->n_movies; m++) {
+        st->movies[m].nome = m * MAX_NAME;
+        strncpy(&st->strings[m * MAX_NAME], movie_nome(cur, m), MAX_NAME - 1);
+        st->strings[m * MAX_NAME + MAX_NAME - 1] = '\0';
+    }
+    st->cat.movies = st->movies;
+    st->cat.sessoes = st->sessoes;
+    st->cat.strings = st->strings;
+    snapshot_compile(st, src->rules, src->n_rules);
+
+    k_mutex_lock(&writer_lock, K_FOREVER);
+    if(atomic_ptr_cas(&active, (void *)cur, &st->cat)) {
+        ret = 0;
+    } else {
+        ret = -EAGAIN;
+    }
+    st->staged = false;
+    k_mutex_unlock(&writer_lock);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of snapshot_clock_set().
+ *
+ * The wall clock was set: compiles the prices for its weekday now instead
+ * of at the midnight of the old clock, and plans the next midnight from it
+ *
+ * @return Doesn't return anything
+ *
+ */
+void snapshot_clock_set(void) {
+    k_work_reschedule(&day_work, K_NO_WAIT);
+}
+
+/**
+ * @brief Brief decription of day_handler().
+ *
+ * Compiles the prices again for the new day at local midnight, and tries
+ * again shortly when the stations still hold every free store. Until the
+ * wall clock is set it only looks at it now and then
+ *
+ * @param *work  Work item (unused)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void day_handler(struct k_work *work) {
+    uint32_t local_s;
+
+    ARG_UNUSED(work);
+
+    if(snapshot_reprice() != 0) {
+        k_work_schedule(&day_work, K_MSEC(REPRICE_RETRY_MS));
+    } else if(wallclock_get(&local_s) != 0) {
+        k_work_schedule(&day_work, K_MSEC(CLOCK_POLL_MS));
+    } else {
+        k_work_schedule(&day_work, K_SECONDS(WALLCLOCK_DAY_S - local_s % WALLCLOCK_DAY_S));
+    }
+}
@@ -0,0 +1,42 @@
+/** @file snapshot.h
+ * @brief Double-buffered catalog and price table
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+
+#include "catalog.h"
+#include "pricing.h"
+
+/* Defines */
+#define SNAPSHOT_READERS CONFIG_CINEMA_TERMINALS    // One reader per customer station
+
+/* Structure with the RAM records of a catalog and the view over them */
+struct catalog_store {
+    struct catalog cat;
+    struct movie movies[MAX_MOVIES];
+    struct session sessoes[MAX_SESSION_IDS];
+    char strings[MAX_MOVIES * MAX_NAME];
+    int16_t prices[MAX_SESSION_IDS][N_TICKET_TYPES];
+    struct price_rule rules[MAX_RULES]; // Rules the prices were compiled with
+    int n_rules;
+    int weekday;                        // Day they were compiled for, WEEKDAY_UNKNOWN without a clock
+    bool staged;                        // Being filled by a writer, see snapshot_stage()
+};
+
+const struct catalog *snapshot_acquire(int reader);
+const struct catalog *snapshot_peek(void);
+struct catalog_store *snapshot_stage(void);
+void snapshot_unstage(struct catalog_store *st);
+void snapshot_compile(struct catalog_store *st, const struct price_rule *rules, int n_rules);
+void snapshot_publish(const struct catalog *next);
+int snapshot_reprice(void);
+void snapshot_clock_set(void);
+
+#endif /* SNAPSHOT_H */
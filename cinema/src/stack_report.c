@@ -0,0 +1,217 @@
+/** @file stack_report.c
+ * @brief Stack usage instrumentation mode
+ *
+ * Drives the state machine with a scripted sequence of button presses,
+ * samples the high-water mark of every thread stack (and of the ISR stack)
+ * with the thread analyzer and prints a report with the suggested sizes
+ * for prj.conf. Only built with CONFIG_CINEMA_STACK_REPORT=y
+ * (west build -- -DOVERLAY_CONFIG=stack_report.conf)
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/printk.h>
+#include <sys/util.h>
+#include <debug/thread_analyzer.h>
+#include <string.h>
+
+#include "cinema.h"
+#include "stack_report.h"
+
+/* Defines */
+#define STACK_REPORT_STACK_SIZE 1024
+#define STACK_REPORT_PRIORITY 7
+#define STACK_REPORT_MAX_THREADS 24     // Every thread of a build with all the options, with room to spare
+#define STACK_REPORT_NAME_LEN 16
+#define STACK_REPORT_PRESS_MS 700       // Time between presses, the state machine polls every 300 ms
+#define STACK_REPORT_MARGIN_PCT 25      // Margin added to the measured usage
+#define STACK_REPORT_ALIGN 8            // ARM stacks are 8 byte aligned
+#define STACK_FILL 0xaa                 // Pattern written by CONFIG_INIT_STACKS
+
+/* The ISR stack is not a thread, so the analyzer does not see it */
+K_KERNEL_STACK_ARRAY_EXTERN(z_interrupt_stacks, CONFIG_MP_NUM_CPUS, CONFIG_ISR_STACK_SIZE);
+
+/* Structure with the high-water mark of one stack */
+struct stack_mark {
+    char name[STACK_REPORT_NAME_LEN];
+    size_t size;
+    size_t used;
+};
+
+static struct stack_mark marks[STACK_REPORT_MAX_THREADS];
+static int n_marks = 0;
+static int n_dropped = 0;               // Stacks seen with marks[] already full
+
+/* Scripted load: walks every menu, inserts all coins, buys and returns change */
+static const uint8_t script[] = {
+    BUT_10EUR, BUT_5EUR, BUT_2EUR, BUT_1EUR,
+    BUT_DOWN, BUT_UP, BUT_SELECT,                   // Filme A
+    BUT_DOWN, BUT_DOWN, BUT_DOWN, BUT_UP, BUT_UP, BUT_UP,
+    BUT_SELECT, BUT_SELECT,                         // Primeira sessao, bilhete normal
+    BUT_UP, BUT_SELECT,                             // Compra 2 bilhetes
+    BUT_DOWN, BUT_SELECT,                           // Filme B
+    BUT_DOWN, BUT_SELECT, BUT_SELECT,               // Segunda sessao, bilhete normal
+    BUT_DIGIT + 4, BUT_DOWN, BUT_DIGIT + 0,         // Quantidade 4, 3, voltar atras
+    BUT_SELECT,
+    BUT_DOWN, BUT_DOWN, BUT_DOWN, BUT_SELECT,       // Voltar atras
+    BUT_RETURN,
+    BUT_SELECT, BUT_SELECT, BUT_SELECT,             // Saldo insuficiente
+    BUT_DIGIT + 0, BUT_SELECT,
+};
+
+/**
+ * @brief Brief decription of record_mark().
+ *
+ * Keeps the biggest usage seen so far for the stack called name
+ *
+ * @param *name  Name of the thread (or "isr")
+ * @param size   Size of the stack in bytes
+ * @param used   Bytes of the stack used at sampling time
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void record_mark(const char *name, size_t size, size_t used) {
+    int i;
+
+    for(i=0; i<n_marks; i++) {
+        if(strncmp(marks[i].name, name, STACK_REPORT_NAME_LEN) == 0) {
+            marks[i].used = MAX(marks[i].used, used);
+            return;
+        }
+    }
+    if(n_marks < STACK_REPORT_MAX_THREADS) {
+        strncpy(marks[n_marks].name, name, STACK_REPORT_NAME_LEN - 1);
+        marks[n_marks].size = size;
+        marks[n_marks].used = used;
+        n_marks++;
+    } else {
+        n_dropped++;
+    }
+}
+
+/**
+ * @brief Brief decription of analyzer_cb().
+ *
+ * Callback of thread_analyzer_iterate(), called once per thread
+ *
+ * @param *info  Stack information of one thread
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void analyzer_cb(struct thread_analyzer_info *info) {
+    /* Our own thread is instrumentation, not part of the image budget */
+    if(strcmp(info->name, "stack_report") == 0) {
+        return;
+    }
+    record_mark(info->name, info->stack_size, info->stack_used);
+}
+
+/**
+ * @brief Brief decription of sample_isr_stack().
+ *
+ * Measures the ISR stack by looking for the first byte that
+ * no longer holds the CONFIG_INIT_STACKS fill pattern
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sample_isr_stack(void) {
+    const uint8_t *buf = (const uint8_t *)Z_KERNEL_STACK_BUFFER(z_interrupt_stacks[0]);
+    size_t size = K_KERNEL_STACK_SIZEOF(z_interrupt_stacks[0]);
+    size_t unused = 0;
+
+    while((unused < size) && (buf[unused] == STACK_FILL)) {
+        unused++;
+    }
+    record_mark("isr", size, size - unused);
+}
+
+/**
+ * @brief Brief decription of sample_stacks().
+ *
+ * Takes one sample of every stack
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sample_stacks(void) {
+    thread_analyzer_iterate(analyzer_cb);
+    sample_isr_stack();
+}
+
+/**
+ * @brief Brief decription of print_report().
+ *
+ * Prints the high-water marks and the suggested size of each stack
+ * (usage plus STACK_REPORT_MARGIN_PCT, rounded up to STACK_REPORT_ALIGN)
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void print_report(void) {
+    int i;
+    size_t suggested, total_size = 0, total_suggested = 0;
+
+    printk("\n\r----------------------Stack report-----------------------\n\r");
+    printk(" %-16s %8s %8s %10s\n\r", "stack", "size", "used", "suggested");
+    for(i=0; i<n_marks; i++) {
+        suggested = ROUND_UP(marks[i].used + (marks[i].used * STACK_REPORT_MARGIN_PCT) / 100, STACK_REPORT_ALIGN);
+        total_size += marks[i].size;
+        total_suggested += suggested;
+        printk(" %-16s %8u %8u %10u\n\r", marks[i].name, (unsigned int)marks[i].size,
+               (unsigned int)marks[i].used, (unsigned int)suggested);
+    }
+    printk(" Total %u bytes, suggested %u bytes\n\r", (unsigned int)total_size, (unsigned int)total_suggested);
+    if(n_dropped > 0) {
+        printk(" Truncated: more than %d stacks, %d samples left out of the report\n\r"
+               "            (raise STACK_REPORT_MAX_THREADS)\n\r", STACK_REPORT_MAX_THREADS, n_dropped);
+    }
+    printk(" Map: main -> CONFIG_MAIN_STACK_SIZE, isr -> CONFIG_ISR_STACK_SIZE,\n\r"
+           "      idle -> CONFIG_IDLE_STACK_SIZE, sysworkq -> CONFIG_SYSTEM_WORKQUEUE_STACK_SIZE\n\r");
+}
+
+/**
+ * @brief Brief decription of stack_report_thread().
+ *
+ * Plays the script pressing one button at a time, sampling the stacks
+ * after each press, and prints the report at the end of the script
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void stack_report_thread(void *p1, void *p2, void *p3) {
+    int i;
+
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    for(i=0; i<ARRAY_SIZE(script); i++) {
+        press_Button(script[i]);
+        k_msleep(STACK_REPORT_PRESS_MS);
+        sample_stacks();
+    }
+    print_report();
+}
+
+K_THREAD_DEFINE(stack_report, STACK_REPORT_STACK_SIZE, stack_report_thread, NULL, NULL, NULL,
+                STACK_REPORT_PRIORITY, 0, K_TICKS_FOREVER);
+
+/**
+ * @brief Brief decription of stack_report_start().
+ *
+ * Starts the scripted load, must be called once the state machine is about to run
+ *
+ * @return Doesn't return anything
+ *
+ */
+void stack_report_start(void) {
+    k_thread_start(stack_report);
+}
@@ -0,0 +1,14 @@
+/** @file stack_report.h
+ * @brief Stack usage instrumentation mode
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef STACK_REPORT_H
+#define STACK_REPORT_H
+
+void stack_report_start(void);
+
+#endif /* STACK_REPORT_H */
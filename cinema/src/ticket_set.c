@@ -0,0 +1,185 @@
+/** @file ticket_set.c
+ * @brief Compact set of the tickets that went through the door
+ *
+ * The first bucket of an id comes from its high half, the second from
+ * the first and a hash h of the stored key: b1 + b2 = h (mod n_buckets),
+ * so either bucket gives the other one from the stored key alone, and
+ * two ids only clash if they share both halves. Hashes are mapped to the
+ * table size with a multiply and a shift, so the table needs not be a
+ * power of two. When both buckets are full a key is kicked to its other
+ * bucket, and so on for at most SET_MAX_KICKS keys; the moves are
+ * recorded and undone if no free slot turns up, so a failed insertion
+ * leaves the set as it was.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <errno.h>
+#include <string.h>
+
+#include "ticket_set.h"
+
+/* Defines */
+#define SET_MAX_KICKS 32
+#define EMPTY 0
+
+/* Structure of one move of a kick chain */
+struct kick {
+    uint32_t bucket;
+    uint8_t way;
+};
+
+/**
+ * @brief Brief decription of split().
+ *
+ * @param *s    Set
+ * @param id    Ticket id
+ * @param *key  Stored half of id, never 0
+ *
+ * @return First bucket of id
+ *
+ */
+static inline uint32_t split(const struct ticket_set *s, uint64_t id, uint32_t *key) {
+    *key = (uint32_t)id;
+    if(*key == EMPTY) {
+        *key = 1;
+    }
+    return ((id >> 32) * s->n_buckets) >> 32;
+}
+
+/**
+ * @brief Brief decription of other().
+ *
+ * @param *s   Set
+ * @param b    One bucket of key
+ * @param key  Stored key
+ *
+ * @return The other bucket of key
+ *
+ */
+static inline uint32_t other(const struct ticket_set *s, uint32_t b, uint32_t key) {
+    uint32_t h = ((uint64_t)(key * 0x9e3779b1u) * s->n_buckets) >> 32;
+
+    return (h >= b) ? (h - b) : (h + s->n_buckets - b);
+}
+
+/**
+ * @brief Brief decription of find().
+ *
+ * @return Way of key in bucket b, -1 if it is not there
+ *
+ */
+static inline int find(const struct ticket_set *s, uint32_t b, uint32_t key) {
+    const uint32_t *keys = s->buckets[b].keys;
+    int i;
+
+    for(i=0; i<TICKET_SET_WAYS; i++) {
+        if(keys[i] == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Brief decription of ticket_set_init().
+ *
+ * @param *s         Set
+ * @param *buckets   Storage, n_buckets buckets
+ * @param n_buckets  Number of buckets, TICKET_SET_BUCKETS(max)
+ * @param max        Keys the set takes before it refuses new ones
+ *
+ * @return Doesn't return anything
+ *
+ */
+void ticket_set_init(struct ticket_set *s, struct ticket_bucket *buckets, uint32_t n_buckets, uint32_t max) {
+    memset(buckets, 0, n_buckets * sizeof(*buckets));
+    s->buckets = buckets;
+    s->n_buckets = n_buckets;
+    s->count = 0;
+    s->max = max;
+    s->kicks = 0;
+}
+
+/**
+ * @brief Brief decription of ticket_set_contains().
+ *
+ * @param *s  Set
+ * @param id  Ticket id
+ *
+ * @return true if id is in the set
+ *
+ */
+bool ticket_set_contains(const struct ticket_set *s, uint64_t id) {
+    uint32_t key, b1 = split(s, id, &key);
+
+    return (find(s, b1, key) >= 0) || (find(s, other(s, b1, key), key) >= 0);
+}
+
+/**
+ * @brief Brief decription of ticket_set_admit().
+ *
+ * Adds an id unless it is already in the set: the test and the insertion
+ * are one step, so an id is admitted only once
+ *
+ * @param *s  Set
+ * @param id  Ticket id
+ *
+ * @return 0 if the id was added, -EALREADY if it was already in the
+ *         set, -ENOSPC if the set is full
+ *
+ */
+int ticket_set_admit(struct ticket_set *s, uint64_t id) {
+    struct kick path[SET_MAX_KICKS];
+    uint32_t key, b1, b2, b, tmp;
+    int way, n;
+
+    b1 = split(s, id, &key);
+    b2 = other(s, b1, key);
+    if((find(s, b1, key) >= 0) || (find(s, b2, key) >= 0)) {
+        return -EALREADY;
+    }
+    if(s->count >= s->max) {
+        return -ENOSPC;
+    }
+
+    /* A free slot in the first bucket, else in the second */
+    way = find(s, b1, EMPTY);
+    b = b1;
+    if(way < 0) {
+        way = find(s, b2, EMPTY);
+        b = b2;
+    }
+    if(way >= 0) {
+        s->buckets[b].keys[way] = key;
+        s->count++;
+        return 0;
+    }
+
+    /* Both full: kick keys to their other bucket until one lands in a free slot */
+    b = b1;
+    for(n=0; n<SET_MAX_KICKS; n++) {
+        path[n].bucket = b;
+        path[n].way = (key + n) % TICKET_SET_WAYS;
+        tmp = s->buckets[b].keys[path[n].way];
+        s->buckets[b].keys[path[n].way] = key;
+        key = tmp;
+        b = other(s, b, key);
+        way = find(s, b, EMPTY);
+        if(way >= 0) {
+            s->buckets[b].keys[way] = key;
+            s->count++;
+            s->kicks += n + 1;
+            return 0;
+        }
+    }
+    while(n-- > 0) {
+        tmp = s->buckets[path[n].bucket].keys[path[n].way];
+        s->buckets[path[n].bucket].keys[path[n].way] = key;
+        key = tmp;
+    }
+    return -ENOSPC;
+}
@@ -0,0 +1,45 @@
+/** @file ticket_set.h
+ * @brief Compact set of the tickets that went through the door
+ *
+ * Bucketized cuckoo hash of 64-bit ticket ids: the high half picks the
+ * first of two candidate buckets and the low half is stored. A bucket
+ * holds TICKET_SET_WAYS keys in one 32-byte line, so a lookup reads at
+ * most two lines and the table can be filled to 90%. The ids must be
+ * evenly spread, like the bits of a hash. No heap:
+ * the caller gives the buckets. Not thread safe, the caller serializes
+ * the calls. Plain C, also built on the host by scripts/gate_load.c.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef TICKET_SET_H
+#define TICKET_SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+#define TICKET_SET_WAYS 8
+#define TICKET_SET_BUCKETS(n) (((n) * 10 / 9 + TICKET_SET_WAYS - 1) / TICKET_SET_WAYS)   // For n keys at most 90% full
+
+/* Structure of one bucket, 0 is an empty slot */
+struct ticket_bucket {
+    uint32_t keys[TICKET_SET_WAYS];
+} __attribute__((aligned(32)));
+
+/* Structure of a set */
+struct ticket_set {
+    struct ticket_bucket *buckets;
+    uint32_t n_buckets;
+    uint32_t count;
+    uint32_t max;                   // Keys it takes
+    uint32_t kicks;                 // Keys moved to their other bucket so far
+};
+
+void ticket_set_init(struct ticket_set *s, struct ticket_bucket *buckets, uint32_t n_buckets, uint32_t max);
+bool ticket_set_contains(const struct ticket_set *s, uint64_t id);
+int ticket_set_admit(struct ticket_set *s, uint64_t id);
+
+#endif /* TICKET_SET_H */
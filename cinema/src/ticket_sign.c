@@ -0,0 +1,265 @@
+/** @file ticket_sign.c
+ * @brief Signed ticket identifiers
+ *
+ * The MAC is HMAC-SHA256 with CONFIG_CINEMA_SIGN_KEY, truncated to
+ * TICKET_SIG_LEN bytes, over a message laid out so that everything known
+ * before the sale fills whole SHA-256 blocks:
+ *
+ *     block 0    kiosk id (1 byte), sequence number (LE32), zeros to 64 bytes
+ *     tail       catalog version (LE32), session id (LE16), price (1 byte)
+ *
+ * The hash of the key pad and of block 0 only depends on the ticket id,
+ * so a low priority thread hashes them ahead for the next
+ * CONFIG_CINEMA_SIGN_AHEAD sequence numbers. A sale then only hashes the
+ * tail and the outer pad: two SHA-256 blocks instead of four. A sale that
+ * finds no precomputed id (several sales in a row faster than the
+ * thread) hashes it on the spot, counted as a miss.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <init.h>
+#include <sys/byteorder.h>
+#include <sys/printk.h>
+#include <stats/stats.h>
+#include <string.h>
+
+#include "ticket_sign.h"
+#include "hmac.h"
+#include "sales.h"
+#include "seats.h"
+
+/* Defines */
+#define SIGN_STACK_SIZE 1024
+#define SIGN_PRIORITY 11                    // Below the management protocol
+#define SIGN_AHEAD CONFIG_CINEMA_SIGN_AHEAD
+#define SIGN_TAIL_LEN 7
+
+/* Structure of one precomputed ticket id */
+struct sign_slot {
+    uint32_t seq;
+    bool ready;
+    sign_hash_ctx ctx;              // HMAC after block 0
+};
+
+static struct hmac_key key;
+static struct sign_slot slots[SIGN_AHEAD];  // Sequence number seq in slots[seq % SIGN_AHEAD]
+static bool sign_ready = false;
+
+static K_MUTEX_DEFINE(sign_lock);
+static K_SEM_DEFINE(refill_sem, 0, 1);
+
+/* Signature stats */
+STATS_SECT_START(sign_stats)
+STATS_SECT_ENTRY32(tickets)
+STATS_SECT_ENTRY32(precomputed)
+STATS_SECT_ENTRY32(misses)
+STATS_SECT_END;
+
+STATS_SECT_DECL(sign_stats) sign_stats;
+
+STATS_NAME_START(sign_stats)
+STATS_NAME(sign_stats, tickets)
+STATS_NAME(sign_stats, precomputed)
+STATS_NAME(sign_stats, misses)
+STATS_NAME_END(sign_stats);
+
+/**
+ * @brief Brief decription of sign_id().
+ *
+ * Starts the MAC of a ticket id, up to the end of block 0
+ *
+ * @param kiosk  Kiosk that sold the ticket
+ * @param seq    Sequence number
+ * @param *ctx   Context of the MAC
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sign_id(int kiosk, uint32_t seq, sign_hash_ctx *ctx) {
+    uint8_t block[SIGN_BLOCK_LEN];
+
+    memset(block, 0, sizeof(block));
+    block[0] = kiosk;
+    sys_put_le32(seq, &block[1]);
+    hmac_start(&key, ctx);
+    sign_hash_update(ctx, block, sizeof(block));
+}
+
+/**
+ * @brief Brief decription of sign_tail().
+ *
+ * Ends the MAC of a ticket started by sign_id()
+ *
+ * @param *ctx     Context of the MAC
+ * @param versao   Catalog version
+ * @param session  Session id in that catalog
+ * @param price    Price paid in euros
+ * @param *mac     SIGN_HASH_LEN bytes
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sign_tail(sign_hash_ctx *ctx, uint32_t versao, int session, int price, uint8_t *mac) {
+    uint8_t tail[SIGN_TAIL_LEN];
+
+    sys_put_le32(versao, &tail[0]);
+    sys_put_le16(session, &tail[4]);
+    tail[6] = price;
+    sign_hash_update(ctx, tail, sizeof(tail));
+    hmac_finish(&key, ctx, mac);
+}
+
+/**
+ * @brief Brief decription of ticket_sign().
+ *
+ * Signs a ticket that was just sold, never waits for the signing thread
+ *
+ * @param seq      Sequence number from sales_record()
+ * @param versao   Catalog version
+ * @param session  Session id in that catalog
+ * @param price    Price paid in euros
+ * @param *sig     TICKET_SIG_LEN bytes
+ *
+ * @return 0 on success, -ENODEV if the hash backend did not start
+ *
+ */
+int ticket_sign(uint32_t seq, uint32_t versao, int session, int price, uint8_t *sig) {
+    struct sign_slot *slot = &slots[seq % SIGN_AHEAD];
+    uint8_t mac[SIGN_HASH_LEN];
+    sign_hash_ctx ctx;
+    bool hit = false;
+
+    if(!sign_ready) {
+        return -ENODEV;
+    }
+    k_mutex_lock(&sign_lock, K_FOREVER);
+    if(slot->ready && (slot->seq == seq)) {
+        ctx = slot->ctx;
+        slot->ready = false;
+        hit = true;
+    }
+    k_mutex_unlock(&sign_lock);
+    if(hit) {
+        STATS_INC(sign_stats, precomputed);
+    } else {
+        STATS_INC(sign_stats, misses);
+        sign_id(SEAT_KIOSK_ID, seq, &ctx);
+    }
+    sign_tail(&ctx, versao, session, price, mac);
+    memcpy(sig, mac, TICKET_SIG_LEN);
+    STATS_INC(sign_stats, tickets);
+    k_sem_give(&refill_sem);
+    return 0;
+}
+
+/**
+ * @brief Brief decription of ticket_verify().
+ *
+ * Checks the signature of a ticket sold by any kiosk with the same key,
+ * in a time that does not depend on where the signature differs
+ *
+ * @param kiosk    Kiosk that sold the ticket
+ * @param seq      Sequence number
+ * @param versao   Catalog version
+ * @param session  Session id in that catalog
+ * @param price    Price paid in euros
+ * @param *sig     TICKET_SIG_LEN bytes
+ *
+ * @return 0 if the signature is right, -EBADMSG if it is not, -ENODEV if
+ *         the hash backend did not start
+ *
+ */
+int ticket_verify(int kiosk, uint32_t seq, uint32_t versao, int session, int price, const uint8_t *sig) {
+    uint8_t mac[SIGN_HASH_LEN], diff = 0;
+    sign_hash_ctx ctx;
+    int i;
+
+    if(!sign_ready) {
+        return -ENODEV;
+    }
+    sign_id(kiosk, seq, &ctx);
+    sign_tail(&ctx, versao, session, price, mac);
+    for(i=0; i<TICKET_SIG_LEN; i++) {
+        diff |= mac[i] ^ sig[i];
+    }
+    return (diff == 0) ? 0 : -EBADMSG;
+}
+
+/**
+ * @brief Brief decription of sign_thread().
+ *
+ * Keeps the next SIGN_AHEAD ticket ids precomputed, woken after every
+ * signature. The hashing is done without the lock, so a sale is never
+ * held by it
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void sign_thread(void *p1, void *p2, void *p3) {
+    struct sign_slot *slot;
+    sign_hash_ctx ctx;
+    uint32_t next, seq;
+    bool done;
+
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    if(!sign_ready) {
+        return;
+    }
+    while(1) {
+        next = sales_next_seq();
+        for(seq=next; seq<next+SIGN_AHEAD; seq++) {
+            slot = &slots[seq % SIGN_AHEAD];
+            k_mutex_lock(&sign_lock, K_FOREVER);
+            done = slot->ready && (slot->seq == seq);
+            k_mutex_unlock(&sign_lock);
+            if(done) {
+                continue;
+            }
+            sign_id(SEAT_KIOSK_ID, seq, &ctx);
+            k_mutex_lock(&sign_lock, K_FOREVER);
+            slot->seq = seq;
+            slot->ctx = ctx;
+            slot->ready = true;
+            k_mutex_unlock(&sign_lock);
+        }
+        k_sem_take(&refill_sem, K_FOREVER);
+    }
+}
+
+K_THREAD_DEFINE(ticket_signer, SIGN_STACK_SIZE, sign_thread, NULL, NULL, NULL,
+                SIGN_PRIORITY, 0, 0);
+
+/**
+ * @brief Brief decription of sign_init().
+ *
+ * Sets up the hash backend, prepares the key and registers the stats
+ *
+ * @return 0 on success, negative error code otherwise
+ *
+ */
+static int sign_init(const struct device *dev) {
+    static const char secret[] = CONFIG_CINEMA_SIGN_KEY;
+    int ret;
+
+    ARG_UNUSED(dev);
+
+    ret = sign_hash_setup();
+    if(ret != 0) {
+        return ret;
+    }
+    hmac_setkey(&key, (const uint8_t *)secret, sizeof(secret) - 1);
+    sign_ready = true;
+    return stats_init_and_reg(STATS_HDR(sign_stats), STATS_SIZE_32, 3,
+                              STATS_NAME_INIT_PARMS(sign_stats), "sign");
+}
+
+SYS_INIT(sign_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
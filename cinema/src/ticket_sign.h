@@ -0,0 +1,52 @@
+/** @file ticket_sign.h
+ * @brief Signed ticket identifiers
+ *
+ * A ticket is identified by the kiosk id and the sale sequence number
+ * (monotonic, see sales.c) and carries a MAC over that id, the session
+ * (catalog version and session id) and the price paid, so a ticket
+ * cannot be forged or changed without the key.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef TICKET_SIGN_H
+#define TICKET_SIGN_H
+
+#include <errno.h>
+#include <stdint.h>
+
+/* Defines */
+#define TICKET_SIG_LEN 8            // HMAC-SHA256 truncated to 64 bits
+#define TICKET_SIG_HEX (2 * TICKET_SIG_LEN + 1)
+
+#ifdef CONFIG_CINEMA_SIGN
+int ticket_sign(uint32_t seq, uint32_t versao, int session, int price, uint8_t *sig);
+int ticket_verify(int kiosk, uint32_t seq, uint32_t versao, int session, int price, const uint8_t *sig);
+#else
+static inline int ticket_sign(uint32_t seq, uint32_t versao, int session, int price, uint8_t *sig) { return -ENOTSUP; }
+static inline int ticket_verify(int kiosk, uint32_t seq, uint32_t versao, int session, int price, const uint8_t *sig) { return -ENOTSUP; }
+#endif
+
+/**
+ * @brief Brief decription of ticket_sig_hex().
+ *
+ * @param *sig  TICKET_SIG_LEN bytes
+ * @param *out  TICKET_SIG_HEX chars, the signature in lowercase hex
+ *
+ * @return Doesn't return anything
+ *
+ */
+static inline void ticket_sig_hex(const uint8_t *sig, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    int i;
+
+    for(i=0; i<TICKET_SIG_LEN; i++) {
+        out[2*i] = digits[sig[i] >> 4];
+        out[2*i + 1] = digits[sig[i] & 0x0f];
+    }
+    out[2 * TICKET_SIG_LEN] = '\0';
+}
+
+#endif /* TICKET_SIGN_H */
@@ -0,0 +1,98 @@
+/** @file wallclock.c
+ * @brief Wall clock of the machine
+ *
+ * The board has no battery backed clock. The local time is set through
+ * the management protocol (MGMT_CLOCK, seconds since 1970 in the time
+ * zone of the cinema, so no time zone rules are needed here) and kept
+ * as an offset to the kernel uptime, which keeps counting through the
+ * deep-idle. Until it is set, and after every reset, the time is unknown.
+ * Setting it compiles the prices again for the weekday it falls on.
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <zephyr.h>
+#include <kernel.h>
+#include <spinlock.h>
+
+#include "wallclock.h"
+#include "snapshot.h"
+
+static int64_t offset_ms = 0;       // Local time minus uptime
+static bool clock_set = false;
+static struct k_spinlock clock_lock;
+
+/**
+ * @brief Brief decription of wallclock_set().
+ *
+ * @param local_s  Local time, seconds since 1970
+ *
+ * @return Doesn't return anything
+ *
+ */
+void wallclock_set(uint32_t local_s) {
+    k_spinlock_key_t key = k_spin_lock(&clock_lock);
+
+    offset_ms = (int64_t)local_s * MSEC_PER_SEC - k_uptime_get();
+    clock_set = true;
+    k_spin_unlock(&clock_lock, key);
+
+    snapshot_clock_set();
+}
+
+/**
+ * @brief Brief decription of wallclock_get().
+ *
+ * @param *local_s  Local time, seconds since 1970
+ *
+ * @return 0 on success, -EAGAIN if the clock was never set
+ *
+ */
+int wallclock_get(uint32_t *local_s) {
+    k_spinlock_key_t key = k_spin_lock(&clock_lock);
+    int ret = -EAGAIN;
+
+    if(clock_set) {
+        *local_s = (uint32_t)((k_uptime_get() + offset_ms) / MSEC_PER_SEC);
+        ret = 0;
+    }
+    k_spin_unlock(&clock_lock, key);
+    return ret;
+}
+
+/**
+ * @brief Brief decription of wallclock_minute().
+ *
+ * Minute of the local time, for the callers that only act when it
+ * changes. The minute of the day is wallclock_minute() % MINUTES_PER_DAY
+ *
+ * @return Minutes since 1970, WALLCLOCK_UNSET if the clock was never set
+ *
+ */
+int32_t wallclock_minute(void) {
+    uint32_t local_s;
+
+    if(wallclock_get(&local_s) != 0) {
+        return WALLCLOCK_UNSET;
+    }
+    return local_s / 60;
+}
+
+/**
+ * @brief Brief decription of wallclock_weekday().
+ *
+ * @return Day of the week of the local time (0 is Sunday, 1 January 1970
+ *         was a Thursday), WALLCLOCK_UNSET if the clock was never set
+ *
+ */
+int wallclock_weekday(void) {
+    uint32_t local_s;
+
+    if(wallclock_get(&local_s) != 0) {
+        return WALLCLOCK_UNSET;
+    }
+    return (local_s / WALLCLOCK_DAY_S + 4) % 7;
+}
@@ -0,0 +1,24 @@
+/** @file wallclock.h
+ * @brief Wall clock of the machine
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef WALLCLOCK_H
+#define WALLCLOCK_H
+
+#include <stdint.h>
+
+/* Defines */
+#define MINUTES_PER_DAY (24 * 60)
+#define WALLCLOCK_DAY_S (MINUTES_PER_DAY * 60)
+#define WALLCLOCK_UNSET (-1)        // Minute before the clock is set
+
+void wallclock_set(uint32_t local_s);
+int wallclock_get(uint32_t *local_s);
+int32_t wallclock_minute(void);
+int wallclock_weekday(void);
+
+#endif /* WALLCLOCK_H */
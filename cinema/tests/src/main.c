@@ -0,0 +1,23 @@
+/** @file main.c
+ * @brief Runs the test suites of the cinema application
+ *
+ * Build and run on the host with
+ * west build -b native_posix tests -t run
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+
+#include "tests.h"
+
+void test_main(void) {
+    test_pricing();
+    test_catalog_update();
+    test_hopper();
+    test_seats();
+    test_keypad();
+}
@@ -0,0 +1,93 @@
+/** @file test_catalog_update.c
+ * @brief Tests of the runtime catalog update
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+#include <string.h>
+
+#include "catalog_update.h"
+#include "snapshot.h"
+#include "tests.h"
+
+/* Defines */
+#define REPLY_LEN 32
+
+static char reply[REPLY_LEN];
+
+static int send(const char *line) {
+    return catalog_update_line(line, reply, sizeof(reply));
+}
+
+static void send_catalog(int versao) {
+    char line[REPLY_LEN];
+
+    snprintk(line, sizeof(line), "BEGIN %d", versao);
+    zassert_equal(send(line), 0, "%s: %s", line, reply);
+    zassert_equal(send("MOVIE Filme C"), 0, NULL);
+    zassert_equal(send("SESSION 20 8"), 0, NULL);
+    zassert_equal(send("COMMIT"), 0, "COMMIT: %s", reply);
+    zassert_equal(snapshot_peek()->versao, versao, NULL);
+}
+
+static void test_updates_with_idle_stations(void) {
+    int r;
+
+    /* Each station went idle holding a different older catalog */
+    for(r=0; r<SNAPSHOT_READERS; r++) {
+        snapshot_acquire(r);
+        send_catalog(10 + r);
+    }
+    send_catalog(10 + SNAPSHOT_READERS);
+}
+
+static void test_out_of_range_refused(void) {
+    zassert_equal(send("BEGIN 20"), 0, NULL);
+    zassert_equal(send("MOVIE Filme D"), 0, NULL);
+    zassert_equal(send("SESSION 24 8"), -EINVAL, "hour 24 accepted");
+    zassert_equal(send("SESSION 20 -1"), -EINVAL, "negative price accepted");
+    zassert_equal(send("SESSION 20 256"), -EINVAL, "price over a byte accepted");
+    zassert_equal(send("RULE 255 0 0 23 2 256"), -EINVAL, "fixed price over a byte accepted");
+    zassert_equal(send("RULE 255 0 0 23 3 1"), -EINVAL, "unknown rule kind accepted");
+    zassert_equal(send("RULE 255 0 0 23 0 150"), -EINVAL, "150% off accepted");
+    zassert_equal(send("RULE 255 0 20 18 1 1"), -EINVAL, "empty hour range accepted");
+    zassert_equal(send("RULE 255 128 0 23 1 1"), -EINVAL, "eighth weekday accepted");
+    zassert_equal(strcmp(reply, "ERR -22"), 0, NULL);
+
+    /* A movie without valid sessions is not put on sale */
+    zassert_equal(send("COMMIT"), -EINVAL, NULL);
+    zassert_equal(send("SESSION 20 8"), 0, NULL);
+    zassert_equal(send("SESSION 21 8"), 0, NULL);
+    zassert_equal(send("SESSION 22 8"), 0, NULL);
+    zassert_equal(send("SESSION 23 8"), -ENOMEM, "more than MAX_SESSIONS accepted");
+    zassert_equal(send("COMMIT"), 0, NULL);
+    zassert_equal(snapshot_peek()->n_sessions, MAX_SESSIONS, NULL);
+}
+
+static void test_version_refused(void) {
+    uint32_t versao = snapshot_peek()->versao;
+    char line[REPLY_LEN];
+
+    zassert_equal(send("BEGIN"), -EINVAL, "update without a version accepted");
+    zassert_equal(send("BEGIN 0"), -EINVAL, "version 0 accepted");
+    snprintk(line, sizeof(line), "BEGIN %u", versao);
+    zassert_equal(send(line), -EINVAL, "version on sale accepted again");
+    snprintk(line, sizeof(line), "BEGIN %u", versao - 1);
+    zassert_equal(send(line), -EINVAL, "older version accepted");
+    zassert_equal(strcmp(reply, "ERR -22"), 0, NULL);
+    zassert_equal(snapshot_peek()->versao, versao, NULL);
+
+    send_catalog(versao + 1);
+}
+
+void test_catalog_update(void) {
+    ztest_test_suite(catalog_update,
+                     ztest_unit_test(test_updates_with_idle_stations),
+                     ztest_unit_test(test_out_of_range_refused),
+                     ztest_unit_test(test_version_refused));
+    ztest_run_test_suite(catalog_update);
+}
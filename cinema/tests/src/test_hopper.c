@@ -0,0 +1,148 @@
+/** @file test_hopper.c
+ * @brief Tests of the coin hopper payout on the emulated gpio0
+ *
+ * The test plays the hoppers: every output pulse is answered, after the
+ * pulse ends, by a pulse on the exit sensor of that hopper
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/gpio.h>
+#include <drivers/gpio/gpio_emul.h>
+#include <string.h>
+
+#include "hopper.h"
+#include "tests.h"
+
+/* Defines */
+#define POLL_MS 5
+#define EXIT_DELAY_MS 20        // Coin reaching the exit sensor after the pulse
+#define PAYOUT_TIMEOUT_MS 10000
+#define MAX_UNREAD 16           // More results than the hoppers may keep
+
+static const uint8_t out_pins[N_COINS] = {14,15,16,17};
+static const uint8_t exit_pins[N_COINS] = {18,19,20,21};
+static const struct device * gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio0));
+
+/**
+ * @brief Brief decription of play_hoppers().
+ *
+ * Answers the hopper pulses until n_events payouts ended
+ *
+ * @param n_events  Payouts to wait for
+ * @param *events   Filled with their results
+ * @param *exits    Filled with the exit sensor pulses of each hopper
+ * @param *late     Coins to pay when the first pulse ends, NULL for none
+ *
+ * @return Number of payouts that ended
+ *
+ */
+static int play_hoppers(int n_events, struct hopper_event *events, int exits[N_COINS], const uint8_t *late) {
+    int level[N_COINS] = {0};
+    int wait[N_COINS] = {0};
+    int c, n = 0, ms;
+
+    memset(exits, 0, N_COINS * sizeof(int));
+    for(ms=0; (ms<PAYOUT_TIMEOUT_MS) && (n<n_events); ms+=POLL_MS) {
+        for(c=0; c<N_COINS; c++) {
+            if((level[c] == 1) && (gpio_emul_output_get(gpio_dev, out_pins[c]) == 0)) {
+                wait[c] = EXIT_DELAY_MS;
+                if(late != NULL) {
+                    /* Queued while a coin is on its way to the exit sensor */
+                    zassert_equal(hopper_payout(late), 0, NULL);
+                    late = NULL;
+                }
+            }
+            level[c] = gpio_emul_output_get(gpio_dev, out_pins[c]);
+            if((wait[c] > 0) && ((wait[c] -= POLL_MS) <= 0)) {
+                gpio_emul_input_set(gpio_dev, exit_pins[c], 1);
+                gpio_emul_input_set(gpio_dev, exit_pins[c], 0);
+                exits[c]++;
+            }
+        }
+        while((n < n_events) && (hopper_get_event(&events[n]) == 0)) {
+            n++;
+        }
+        k_msleep(POLL_MS);
+    }
+    return n;
+}
+
+static void test_payout_counts(void) {
+    const uint8_t coins[N_COINS] = {3, 1, 0, 2};
+    struct hopper_event event;
+    int exits[N_COINS], c;
+
+    zassert_equal(hopper_payout(coins), 0, NULL);
+    zassert_equal(play_hoppers(1, &event, exits, NULL), 1, "payout never ended");
+    zassert_equal(event.failed, 0, "a paid coin was taken as failed");
+    for(c=0; c<N_COINS; c++) {
+        zassert_equal(event.dispensed[c], coins[c], "coin type %d", c);
+        zassert_equal(exits[c], coins[c], "exit pulses of coin type %d", c);
+    }
+}
+
+static void test_payout_queued_during_payout(void) {
+    const uint8_t first[N_COINS] = {2, 0, 1, 0};
+    const uint8_t second[N_COINS] = {0, 2, 0, 1};
+    struct hopper_event events[2];
+    int exits[N_COINS], c;
+
+    zassert_equal(hopper_payout(first), 0, NULL);
+    zassert_equal(play_hoppers(2, events, exits, second), 2, "payouts never ended");
+    for(c=0; c<N_COINS; c++) {
+        zassert_equal(events[0].dispensed[c], first[c], "first payout, coin type %d", c);
+        zassert_equal(events[1].dispensed[c], second[c], "second payout, coin type %d", c);
+        zassert_equal(exits[c], first[c] + second[c], NULL);
+    }
+    zassert_equal(events[0].failed | events[1].failed, 0, "a paid coin was taken as failed");
+}
+
+static void test_empty_hopper(void) {
+    const uint8_t coins[N_COINS] = {0, 0, 0, 1};
+    struct hopper_event event;
+    int ms;
+
+    /* Nobody answers the pulse: the hopper is empty */
+    zassert_equal(hopper_payout(coins), 0, NULL);
+    for(ms=0; (ms<PAYOUT_TIMEOUT_MS) && (hopper_get_event(&event) != 0); ms+=POLL_MS) {
+        k_msleep(POLL_MS);
+    }
+    zassert_true(ms < PAYOUT_TIMEOUT_MS, "payout never ended");
+    zassert_equal(event.failed, BIT(COIN_10EUR), NULL);
+    zassert_equal(event.dispensed[COIN_10EUR], 0, NULL);
+}
+
+static void test_results_kept(void) {
+    const uint8_t none[N_COINS] = {0};
+    struct hopper_event event;
+    int accepted, taken;
+
+    /* Payouts end at once and nobody reads their results */
+    for(accepted=0; (accepted<MAX_UNREAD) && (hopper_payout(none) == 0); accepted++) {
+        k_msleep(POLL_MS);
+    }
+    zassert_true(accepted < MAX_UNREAD, "payouts taken without room for their result");
+    k_msleep(POLL_MS);
+    for(taken=0; hopper_get_event(&event) == 0; taken++) {
+    }
+    zassert_equal(taken, accepted, "results of accepted payouts lost");
+    zassert_equal(hopper_payout(none), 0, "no payout taken once the results were read");
+    k_msleep(POLL_MS);
+    zassert_equal(hopper_get_event(&event), 0, NULL);
+}
+
+void test_hopper(void) {
+    ztest_test_suite(hopper,
+                     ztest_unit_test(test_payout_counts),
+                     ztest_unit_test(test_payout_queued_during_payout),
+                     ztest_unit_test(test_empty_hopper),
+                     ztest_unit_test(test_results_kept));
+    ztest_run_test_suite(hopper);
+}
@@ -0,0 +1,149 @@
+/** @file test_keypad.c
+ * @brief Tests of the matrix keypad on the emulated gpio0
+ *
+ * The keys are held down with keypad_emul_key() and the presses the
+ * keypad gives to station 0 are caught by press_Button() below
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+
+#include "cinema.h"
+#include "keypad.h"
+#include "tests.h"
+
+/* Defines */
+#define MAX_PRESSES 16
+#define BOUNCE_MS (CONFIG_CINEMA_DEBOUNCE_MS / 4)      // Contact bounce, shorter than the debounce
+#define SETTLE_MS (CONFIG_CINEMA_DEBOUNCE_MS * 5)      // Key set taken, or keypad idle again
+
+/* Presses given to station 0 */
+static int presses[MAX_PRESSES];
+static atomic_t n_presses;
+
+void press_Button(int i) {
+    int n = atomic_inc(&n_presses);
+
+    if(n < MAX_PRESSES) {
+        presses[n] = i;
+    }
+}
+
+/**
+ * @brief Brief decription of bounce().
+ *
+ * Opens and closes the contact of a key a few times, ending on down
+ *
+ * @param key   Key, as printed on it
+ * @param down  Level the contact ends on
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void bounce(char key, bool down) {
+    int i;
+
+    for(i=0; i<4; i++) {
+        zassert_equal(keypad_emul_key(key, (i % 2) == 0), 0, NULL);
+        k_msleep(BOUNCE_MS);
+    }
+    zassert_equal(keypad_emul_key(key, down), 0, NULL);
+}
+
+/**
+ * @brief Brief decription of release_all().
+ *
+ * Lets every key go and waits for the keypad to be idle
+ *
+ * @return Doesn't return anything
+ *
+ */
+static void release_all(void) {
+    const char *k;
+
+    for(k="123456789*0#"; *k != '\0'; k++) {
+        keypad_emul_key(*k, false);
+    }
+    k_msleep(SETTLE_MS);
+}
+
+static void test_one_key(void) {
+    release_all();
+    atomic_set(&n_presses, 0);
+
+    zassert_equal(keypad_emul_key('5', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 1, NULL);
+    zassert_equal(presses[0], BUT_DIGIT + 5, NULL);
+
+    /* Held down, still one press */
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 1, NULL);
+
+    zassert_equal(keypad_emul_key('*', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 2, NULL);
+    zassert_equal(presses[1], BUT_RETURN, NULL);
+    zassert_equal(keypad_emul_key('x', true), -EINVAL, NULL);
+    release_all();
+}
+
+static void test_bouncing_key(void) {
+    release_all();
+    atomic_set(&n_presses, 0);
+
+    bounce('7', true);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 1, "a bouncing press is one press");
+    zassert_equal(presses[0], BUT_DIGIT + 7, NULL);
+
+    bounce('7', false);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 1, "the bounces of the release pressed the key");
+
+    /* Idle again, the next press is taken */
+    zassert_equal(keypad_emul_key('#', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 2, NULL);
+    zassert_equal(presses[1], BUT_SELECT, NULL);
+    release_all();
+}
+
+static void test_ghost_keys(void) {
+    release_all();
+    atomic_set(&n_presses, 0);
+
+    /* 1, 2 and 4 down together would read 5 too on a real matrix */
+    zassert_equal(keypad_emul_key('1', true), 0, NULL);
+    zassert_equal(keypad_emul_key('2', true), 0, NULL);
+    zassert_equal(keypad_emul_key('4', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 0, "a ghost key set was pressed");
+    release_all();
+
+    /* Two keys are taken, the third one of the set is not */
+    zassert_equal(keypad_emul_key('1', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(keypad_emul_key('2', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(keypad_emul_key('4', true), 0, NULL);
+    k_msleep(SETTLE_MS);
+    zassert_equal(atomic_get(&n_presses), 2, NULL);
+    zassert_equal(presses[0], BUT_DIGIT + 1, NULL);
+    zassert_equal(presses[1], BUT_DIGIT + 2, NULL);
+    release_all();
+    zassert_equal(atomic_get(&n_presses), 2, NULL);
+}
+
+void test_keypad(void) {
+    ztest_test_suite(keypad,
+        ztest_unit_test(test_one_key),
+        ztest_unit_test(test_bouncing_key),
+        ztest_unit_test(test_ghost_keys)
+    );
+    ztest_run_test_suite(keypad);
+}
@@ -0,0 +1,87 @@
+/** @file test_pricing.c
+ * @brief Tests of the price rules restricted to some weekdays
+ *
+ * Session 0 of the default catalog is at 19h and costs 9 euros, on
+ * Tuesdays the default rules sell it at a fixed 6 euros
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+
+#include "pricing.h"
+#include "snapshot.h"
+#include "wallclock.h"
+#include "tests.h"
+
+/* Defines */
+#define TUESDAY 2
+#define WEDNESDAY 3
+#define TUESDAY_S (5 * WALLCLOCK_DAY_S)         // 6 Jan 1970, 1 Jan was a Thursday
+#define EVENING_S (19 * 60 * 60)
+#define WEEK_S (7 * WALLCLOCK_DAY_S)
+#define REPRICE_WAIT_MS 100
+#define PRICE_TUESDAY 6
+#define PRICE_NORMAL 9
+
+static int16_t table[MAX_SESSION_IDS][N_TICKET_TYPES];
+
+static void test_compile_weekday(void) {
+    pricing_compile(table, &default_catalog, default_rules, n_default_rules, TUESDAY);
+    zassert_equal(table[0][TICKET_NORMAL], PRICE_TUESDAY, "Tuesday rule not applied");
+
+    pricing_compile(table, &default_catalog, default_rules, n_default_rules, WEDNESDAY);
+    zassert_equal(table[0][TICKET_NORMAL], PRICE_NORMAL, "Tuesday rule applied on Wednesday");
+
+    pricing_compile(table, &default_catalog, default_rules, n_default_rules, WEEKDAY_UNKNOWN);
+    zassert_equal(table[0][TICKET_NORMAL], PRICE_NORMAL, "Tuesday rule applied without a clock");
+}
+
+static void test_wallclock_weekday(void) {
+    wallclock_set(TUESDAY_S + EVENING_S);
+    zassert_equal(wallclock_weekday(), TUESDAY, NULL);
+
+    wallclock_set(TUESDAY_S + WALLCLOCK_DAY_S);
+    zassert_equal(wallclock_weekday(), WEDNESDAY, NULL);
+}
+
+static void test_reprice_on_day_change(void) {
+    const struct catalog *before;
+
+    wallclock_set(TUESDAY_S + EVENING_S);
+    zassert_equal(snapshot_reprice(), 0, NULL);
+    before = snapshot_peek();
+    zassert_equal(before->prices[0][TICKET_NORMAL], PRICE_TUESDAY, "catalog on sale not repriced for Tuesday");
+
+    /* Same day, nothing to compile again */
+    zassert_equal(snapshot_reprice(), 0, NULL);
+    zassert_equal_ptr(snapshot_peek(), before, NULL);
+
+    wallclock_set(TUESDAY_S + WALLCLOCK_DAY_S + EVENING_S);
+    zassert_equal(snapshot_reprice(), 0, NULL);
+    zassert_equal(snapshot_peek()->prices[0][TICKET_NORMAL], PRICE_NORMAL, "Tuesday price kept on Wednesday");
+    zassert_equal(snapshot_peek()->versao, before->versao, "repricing changed the catalog version");
+}
+
+static void test_reprice_on_clock_set(void) {
+    /* The day work of the snapshot reprices, no snapshot_reprice() here */
+    wallclock_set(TUESDAY_S + 2 * WEEK_S + EVENING_S);
+    k_msleep(REPRICE_WAIT_MS);
+    zassert_equal(snapshot_peek()->prices[0][TICKET_NORMAL], PRICE_TUESDAY, "not repriced when the clock was set");
+
+    wallclock_set(TUESDAY_S + 2 * WEEK_S + WALLCLOCK_DAY_S + EVENING_S);
+    k_msleep(REPRICE_WAIT_MS);
+    zassert_equal(snapshot_peek()->prices[0][TICKET_NORMAL], PRICE_NORMAL, "Tuesday price kept after the clock was set");
+}
+
+void test_pricing(void) {
+    ztest_test_suite(pricing,
+                     ztest_unit_test(test_compile_weekday),
+                     ztest_unit_test(test_wallclock_weekday),
+                     ztest_unit_test(test_reprice_on_day_change),
+                     ztest_unit_test(test_reprice_on_clock_set));
+    ztest_run_test_suite(pricing);
+}
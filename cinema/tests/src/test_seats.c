@@ -0,0 +1,146 @@
+/** @file test_seats.c
+ * @brief Tests of the seat inventory shared by two kiosks
+ *
+ * The test plays the other kiosk: the records this kiosk sends are caught
+ * by the seat_sync functions below and the answers are given with the
+ * seats_peer_x() calls the link would make. Runs as kiosk 0 and, in the
+ * cinema.unit.kiosk1 scenario, as kiosk 1
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+/* Includes */
+#include <ztest.h>
+
+#include "seats.h"
+#include "seat_sync.h"
+#include "snapshot.h"
+#include "tests.h"
+
+/* Defines */
+#define ALL_SEATS ((SEATS_PER_SESSION == 64) ? ~0ULL : ((1ULL << SEATS_PER_SESSION) - 1))
+#define OWN_SEATS (ALL_SEATS & ((SEAT_KIOSK_ID == 0) ? 0x5555555555555555ULL : ~0x5555555555555555ULL))
+#define PEER_SEATS (ALL_SEATS & ~OWN_SEATS)
+
+/* Records sent to the other kiosk */
+static int n_claims;
+static int claim_count;
+static uint64_t sold_seats;
+static int n_freed;
+static uint64_t freed_seats;
+
+void seat_sync_claim(uint32_t versao, int session, int count) {
+    n_claims++;
+    claim_count = count;
+}
+
+void seat_sync_sold(uint32_t versao, int session, uint64_t seats, bool sold) {
+    if(sold) {
+        sold_seats |= seats;
+    } else {
+        n_freed++;
+        freed_seats = seats;
+    }
+}
+
+/**
+ * @brief Brief decription of lowest().
+ *
+ * @param from  Seats to pick from
+ * @param n     Number of seats wanted
+ *
+ * @return The n lowest seats of from
+ *
+ */
+static uint64_t lowest(uint64_t from, int n) {
+    uint64_t seats = 0;
+
+    while(n-- > 0) {
+        seats |= from & -from;
+        from &= from - 1;
+    }
+    return seats;
+}
+
+static void test_crossing_claims(void) {
+    uint32_t versao = snapshot_peek()->versao;
+    int n_own = __builtin_popcountll(OWN_SEATS);
+    uint64_t seats, given;
+    int ret;
+
+    /* All but two of our seats */
+    zassert_equal(seats_claim(versao, 0, n_own - 2, &seats), 0, NULL);
+    zassert_equal(__builtin_popcountll(seats), n_own - 2, NULL);
+    zassert_equal(seats & ~OWN_SEATS, 0, NULL);
+    zassert_equal(sold_seats, seats, NULL);
+
+    /* Four more must come from the other kiosk, with SEAT_CLAIM_AHEAD */
+    n_claims = 0;
+    zassert_equal(seats_claim(versao, 0, 4, &seats), -EINPROGRESS, NULL);
+    zassert_equal(seats, 0, NULL);
+    zassert_equal(n_claims, 1, NULL);
+    zassert_equal(claim_count, 6, NULL);
+    zassert_equal(seats_claim(versao, 0, 4, &seats), -EINPROGRESS, NULL);
+    zassert_equal(n_claims, 1, "claimed again while the claim is in flight");
+
+    /* The other kiosk ran out too and its claim crosses ours */
+    ret = seats_peer_claim(versao, 0, 6, &given);
+    if(SEAT_KIOSK_ID == 0) {
+        zassert_equal(ret, -EBUSY, NULL);
+        zassert_equal(given, 0, NULL);
+
+        /* Kiosk 1 grants ours */
+        seats_peer_grant(versao, 0, lowest(PEER_SEATS, 6));
+    } else {
+        zassert_equal(ret, 0, NULL);
+        zassert_equal(__builtin_popcountll(given), 2, NULL);
+        zassert_equal(given & ~OWN_SEATS, 0, NULL);
+
+        /* Kiosk 0 keeps its seats; a busy answer is not a sold out kiosk */
+        seats_peer_busy(versao, 0);
+        zassert_equal(seats_claim(versao, 0, 4, &seats), -EINPROGRESS, NULL);
+        zassert_equal(n_claims, 2, "no new claim after a busy answer");
+        zassert_equal(claim_count, 8, NULL);
+        seats_peer_grant(versao, 0, lowest(PEER_SEATS, 8));
+    }
+    zassert_equal(seats_claim(versao, 0, 4, &seats), 0, NULL);
+    zassert_equal(__builtin_popcountll(seats), 4, NULL);
+    zassert_equal(seats & OWN_SEATS, 0, "sold a seat of the other kiosk");
+}
+
+static void test_release_exact(void) {
+    uint32_t versao = snapshot_peek()->versao;
+    uint64_t first, second, seats;
+    int freed;
+
+    zassert_equal(seats_claim(versao, 1, 3, &first), 0, NULL);
+    zassert_equal(seats_claim(versao, 1, 2, &second), 0, NULL);
+    zassert_equal(first & second, 0, NULL);
+
+    /* The payment of the second sale failed: its seats, not the lowest */
+    seats_release(versao, 1, second);
+    zassert_equal(freed_seats, second, NULL);
+    zassert_equal(seats_available(versao, 1), SEATS_PER_SESSION - 3, NULL);
+    zassert_equal(seats_claim(versao, 1, 2, &seats), 0, NULL);
+    zassert_equal(seats, second, NULL);
+
+    seats_release(versao, 1, first);
+    zassert_equal(freed_seats, first, NULL);
+    zassert_equal(seats_available(versao, 1), SEATS_PER_SESSION - 2, NULL);
+
+    /* Given back twice, the second time is ignored */
+    freed = n_freed;
+    seats_release(versao, 1, first);
+    zassert_equal(n_freed, freed, NULL);
+    zassert_equal(seats_available(versao, 1), SEATS_PER_SESSION - 2, NULL);
+}
+
+void test_seats(void) {
+    ztest_test_suite(seats,
+        ztest_unit_test(test_crossing_claims),
+        ztest_unit_test(test_release_exact)
+    );
+    ztest_run_test_suite(seats);
+}
@@ -0,0 +1,18 @@
+/** @file tests.h
+ * @brief Test suites of the cinema application
+ *
+ * @author Bernardo Tavares bernardot@ua.pt and João Rodrigues jpcr@ua.pt
+ * @date 15 May 2023
+ * @bug No known bugs.
+ */
+
+#ifndef TESTS_H
+#define TESTS_H
+
+void test_pricing(void);
+void test_catalog_update(void);
+void test_hopper(void);
+void test_seats(void);
+void test_keypad(void);
+
+#endif /* TESTS_H */